@@ -40,19 +40,30 @@ namespace VWrap {
 			VkMemoryPropertyFlags properties,
 			VmaAllocationCreateFlags flags);
 
+		/// <summary>
+		/// Creates a buffer owned by one queue family at a time, rather than shared by the graphics and transfer families.
+		/// Handing it to another family needs a release barrier on the owning queue and an acquire barrier on the other.
+		/// </summary>
+		static std::shared_ptr<Buffer> CreateExclusive(std::shared_ptr<Allocator> allocator,
+			VkDeviceSize size,
+			VkBufferUsageFlags usage,
+			VkMemoryPropertyFlags properties);
+
 		/// <summary>
 		/// Creates a buffer with parameters suited for staging
 		/// </summary>
 		static std::shared_ptr<Buffer> CreateStaging(std::shared_ptr<Allocator> allocator, VkDeviceSize size);
 
 		/// <summary>
-		/// Creates a buffer with parameters suited for persistent mapped memory
+		/// Creates a buffer with parameters suited for persistent mapped memory. Pass HOST_ACCESS_RANDOM in
+		/// access_flags for memory the host reads back.
 		/// </summary>
 		static std::shared_ptr<Buffer> CreateMapped(std::shared_ptr<Allocator> allocator,
 			VkDeviceSize size,
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
-			void*& data);
+			void*& data,
+			VmaAllocationCreateFlags access_flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 
 		/// <summary>
 		/// Gets the underlying buffer handle.
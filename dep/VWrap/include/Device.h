@@ -22,6 +22,11 @@ namespace VWrap {
 		/// </summary>
 		std::shared_ptr<PhysicalDevice> m_physical_device;
 
+		/// <summary>
+		/// Whether the timelineSemaphore feature was enabled
+		/// </summary>
+		bool m_timeline_semaphores = false;
+
 	public:
 
 		/// <summary>
@@ -46,6 +51,13 @@ namespace VWrap {
 			return m_physical_device;
 		}
 
+		/// <summary>
+		/// Gets whether timeline semaphores can be created. Requires a Vulkan 1.2 driver that supports them.
+		/// </summary>
+		bool SupportsTimelineSemaphores() const {
+			return m_timeline_semaphores;
+		}
+
 		/// <summary>
 		/// Destroys the underlying vulkan device
 		/// </summary>
@@ -24,9 +24,19 @@ namespace VWrap {
 	public:
 
 		/// <summary>
-		/// Creates a new fence from the given device
+		/// Creates a new fence from the given device, signaled unless told otherwise
 		/// </summary>
-		static std::shared_ptr<Fence> Create(std::shared_ptr<Device> device);
+		static std::shared_ptr<Fence> Create(std::shared_ptr<Device> device, bool signaled = true);
+
+		/// <summary>
+		/// Gets whether the fence is signaled, without waiting
+		/// </summary>
+		bool IsSignaled() const;
+
+		/// <summary>
+		/// Waits until the fence is signaled
+		/// </summary>
+		void Wait() const;
 
 		/// <summary>
 		/// Gets the underlying vulkan fence
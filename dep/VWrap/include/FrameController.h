@@ -8,23 +8,49 @@
 #include "Fence.h"
 #include "Device.h"
 #include "Surface.h"
+#include "RetirementQueue.h"
 #include <functional>
 
 namespace VWrap {
 
+	/// <summary>
+	/// A semaphore for a frame's submission to wait on before the given stages. The value is ignored for binary semaphores.
+	/// </summary>
+	struct SemaphoreWait {
+		std::shared_ptr<Semaphore> semaphore;
+		uint64_t value = 0;
+		VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	};
+
 	/// <summary>
 	/// Submits recorded command buffers to the graphics queue for rendering and presents their results to the surface.
 	/// Maintains the swapchain and its associated resources. Controls synchronization for the rendering and presentation of frames.
+	/// Frames are numbered from 1 in the order they are submitted. Where timeline semaphores are supported, each frame's submission
+	/// signals the frame timeline with its number, which paces the frames in flight and lets any queue or the host wait on any past
+	/// frame. Otherwise each frame in flight has a fence, as before, and waits on past frames go through those fences.
+	/// The swapchain's image acquire and present still use binary semaphores, which presentation requires.
+	/// Objects replaced while frames are in flight are retired to the controller's retirement queue, which is collected as frames
+	/// finish, so that swapchain recreation and other resource swaps need not wait for the device to idle.
 	/// </summary>
 	class FrameController {
 	private:
 
 		// CLASS PROPERTIES ----------------------------------------------------------------------------------
 		/// <summary>
-		/// The maximum number of frames that can be in flight at once.
+		/// The maximum number of frames that can be in flight at once, which the per-frame resources are created for.
 		/// </summary>
 		uint32_t frames;
 
+		/// <summary>
+		/// The number of frames in flight at once, at most the maximum. Frames use the first this many of the per-frame resources.
+		/// </summary>
+		uint32_t m_frames_in_flight;
+
+		/// <summary>
+		/// The present mode the swapchain is created with, where the surface supports it.
+		/// </summary>
+		VkPresentModeKHR m_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+
 		/// <summary>
 		/// Whether the swapchain needs to be resized.
 		/// </summary>
@@ -77,10 +103,30 @@ namespace VWrap {
 		std::vector<std::shared_ptr<Semaphore>> m_image_available_semaphores, m_render_finished_semaphores;
 
 		/// <summary>
-		/// The fences (per frame) used to synchronize the CPU and GPU.
+		/// The fences (per frame) used to synchronize the CPU and GPU, without timeline semaphores.
 		/// </summary>
 		std::vector<std::shared_ptr<Fence>> m_in_flight_fences;
 
+		/// <summary>
+		/// Signalled with each frame's number when it finishes. Null without timeline semaphores.
+		/// </summary>
+		std::shared_ptr<Semaphore> m_frame_timeline;
+
+		/// <summary>
+		/// The number of the frame last submitted from each frame in flight, 0 if none has been.
+		/// </summary>
+		std::vector<uint64_t> m_slot_frames;
+
+		/// <summary>
+		/// The number of the frame being recorded.
+		/// </summary>
+		uint64_t m_frame_number = 1;
+
+		/// <summary>
+		/// Holds replaced objects until the frames that may use them have finished.
+		/// </summary>
+		std::shared_ptr<RetirementQueue> m_retirement_queue;
+
 		/// <summary>
 		/// The graphics command pool used to allocate command buffers.
 		/// </summary>
@@ -91,6 +137,11 @@ namespace VWrap {
 		/// </summary>
 		std::shared_ptr<Queue> m_present_queue;
 
+		/// <summary>
+		/// The waits added for the current frame's submission, besides the image being available. Cleared by each submission.
+		/// </summary>
+		std::vector<SemaphoreWait> m_extra_waits;
+
 		// CLASS FUNCTIONS -----------------------------------------------------------------------------------
 		/// <summary>
 		/// Creates an image view for each swapchain image.
@@ -116,7 +167,7 @@ namespace VWrap {
 		/// <param name="surface"> The surface that the swapchain is created from </param>
 		/// <param name="graphics_pool"> The pool that rendering command buffers are allocated from </param>
 		/// <param name="present_queue"> The queue to present rendered images </param>
-		/// <param name="max_frames"> The maximumum number of frames-in-flight </param>
+		/// <param name="max_frames"> The maximumum number of frames-in-flight, which are all in flight until SetFramesInFlight </param>
 		/// <returns> A pointer to a new FrameController </returns>
 		static std::shared_ptr<FrameController> Create(std::shared_ptr<Device> device, std::shared_ptr<Surface> surface, std::shared_ptr<CommandPool> graphics_pool, std::shared_ptr<Queue> present_queue, uint32_t max_frames);
 
@@ -135,6 +186,28 @@ namespace VWrap {
 		/// </summary>
 		uint32_t GetCurrentFrame() { return m_current_frame; }
 
+		/// <summary>
+		/// Gets the number of frames in flight at once.
+		/// </summary>
+		uint32_t GetFramesInFlight() const { return m_frames_in_flight; }
+
+		/// <summary>
+		/// Sets the number of frames in flight at once, clamped to between 1 and the maximum. Waits for the device to idle, and starts
+		/// the next frame from the first of the per-frame resources. Must not be called between AcquireNext and Render.
+		/// </summary>
+		void SetFramesInFlight(uint32_t frames_in_flight);
+
+		/// <summary>
+		/// Gets the present mode of the swapchain, which may differ from the one set if the surface does not support that one.
+		/// </summary>
+		VkPresentModeKHR GetPresentMode() const { return m_swapchain->GetPresentMode(); }
+
+		/// <summary>
+		/// Sets the present mode to create the swapchain with, and recreates it if the mode differs. Falls back to mailbox, then FIFO,
+		/// where the surface does not support the mode. Must not be called between AcquireNext and Render.
+		/// </summary>
+		void SetPresentMode(VkPresentModeKHR present_mode);
+
 		/// <summary>
 		/// Gets the index of the image to be rendered to.
 		/// </summary>
@@ -146,7 +219,33 @@ namespace VWrap {
 		std::shared_ptr<CommandBuffer> GetCurrentCommandBuffer() { return m_command_buffers[m_current_frame]; }
 
 		/// <summary>
-		/// Waits for the GPU to finish rendering the current frame. Then it acquires the next image to be rendered to.
+		/// Gets the number of the frame being recorded, which is signalled on the frame timeline when it finishes.
+		/// </summary>
+		uint64_t GetFrameNumber() const { return m_frame_number; }
+
+		/// <summary>
+		/// Gets the number of the last frame the GPU has finished. Frames finish in order, so every earlier frame has too.
+		/// </summary>
+		uint64_t GetCompletedFrame() const;
+
+		/// <summary>
+		/// Waits on the host until the GPU has finished the given frame. Frames not yet submitted cannot be waited on.
+		/// </summary>
+		void WaitForFrame(uint64_t frame) const;
+
+		/// <summary>
+		/// Gets the frame timeline, for submissions to other queues that must wait on frames. Null without timeline semaphores.
+		/// </summary>
+		std::shared_ptr<Semaphore> GetFrameTimeline() const { return m_frame_timeline; }
+
+		/// <summary>
+		/// Gets the queue that objects still in use by frames in flight are retired to.
+		/// </summary>
+		std::shared_ptr<RetirementQueue> GetRetirementQueue() const { return m_retirement_queue; }
+
+		/// <summary>
+		/// Waits for the GPU to finish the frame last rendered from the current frame in flight, and drops the retired objects of the
+		/// frames finished. Then it acquires the next image to be rendered to.
 		/// </summary>
 		void AcquireNext();
 
@@ -156,7 +255,13 @@ namespace VWrap {
 		void Render();
 
 		/// <summary>
-		/// Recreates the swapchain and all associated resources.
+		/// Makes the current frame's submission also wait on the given semaphore, for work submitted to other queues.
+		/// Only applies to the next call to Render.
+		/// </summary>
+		void AddWait(const SemaphoreWait& wait) { m_extra_waits.push_back(wait); }
+
+		/// <summary>
+		/// Recreates the swapchain and all associated resources. The old swapchain and image views are retired, not waited on.
 		/// </summary>
 		void RecreateSwapchain();
 
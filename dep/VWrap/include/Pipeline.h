@@ -21,6 +21,9 @@ namespace VWrap {
 
 		std::vector<VkPushConstantRange> push_constant_ranges;
 		uint32_t subpass;
+
+		/// <summary> Optional specialization constants for the fragment stage. </summary>
+		const VkSpecializationInfo* fragment_specialization = nullptr;
 	};
 
 	/// <summary>
@@ -47,6 +50,12 @@ namespace VWrap {
 
 		static std::shared_ptr<Pipeline> Create(std::shared_ptr<Device> device, const PipelineCreateInfo& create_info, const std::vector<char>& vertex_shader_code, const std::vector<char>& fragment_shader_code);
 
+		/// <summary>
+		/// Creates a compute pipeline with a single descriptor set layout.
+		/// </summary>
+		/// <param name="specialization"> Optional specialization constants for the compute stage. </param>
+		static std::shared_ptr<Pipeline> CreateCompute(std::shared_ptr<Device> device, std::shared_ptr<DescriptorSetLayout> descriptor_set_layout, const std::vector<VkPushConstantRange>& push_constant_ranges, const std::vector<char>& compute_shader_code, const VkSpecializationInfo* specialization = nullptr);
+
 		VkPipeline Get() const { return m_pipeline; }
 
 		/// <summary> Gets the pipeline layout handle. </summary>
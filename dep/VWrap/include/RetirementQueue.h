@@ -0,0 +1,66 @@
+#pragma once
+#include <memory>
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+namespace VWrap {
+
+	/// <summary>
+	/// Keeps objects alive until the GPU has finished every frame that may use them, so that they can be replaced without waiting
+	/// for the device to idle. VWrap objects destroy their handles when their last reference goes; retiring an object hands that
+	/// reference to the queue, which drops it once the frame being recorded at the time has finished.
+	/// Objects retired between frames are kept for the frame recorded next, which does not use them, so they live a frame longer
+	/// than they need to.
+	/// </summary>
+	class RetirementQueue
+	{
+	private:
+
+		/// <summary>
+		/// The retired objects, oldest first, with the number of the last frame that may use each.
+		/// </summary>
+		std::deque<std::pair<uint64_t, std::shared_ptr<void>>> m_retired;
+
+		/// <summary>
+		/// The number of the frame being recorded.
+		/// </summary>
+		uint64_t m_frame = 1;
+
+	public:
+
+		/// <summary>
+		/// Creates an empty queue, for frames numbered from 1.
+		/// </summary>
+		static std::shared_ptr<RetirementQueue> Create();
+
+		/// <summary>
+		/// Keeps the object until the frame being recorded has finished. Does nothing for null objects.
+		/// </summary>
+		void Retire(std::shared_ptr<void> object);
+
+		/// <summary>
+		/// Retires each of the objects.
+		/// </summary>
+		template <typename T>
+		void Retire(const std::vector<std::shared_ptr<T>>& objects) {
+			for (const auto& object : objects)
+				Retire(object);
+		}
+
+		/// <summary>
+		/// Sets the number of the frame being recorded. Called by the frame controller after each submission.
+		/// </summary>
+		void SetFrame(uint64_t frame) { m_frame = frame; }
+
+		/// <summary>
+		/// Drops the objects of every frame up to the given one, which the GPU has finished.
+		/// </summary>
+		void Collect(uint64_t completed_frame);
+
+		/// <summary>
+		/// Gets the number of objects still held.
+		/// </summary>
+		size_t Size() const { return m_retired.size(); }
+	};
+}
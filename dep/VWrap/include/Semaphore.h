@@ -15,6 +15,9 @@ namespace VWrap {
 		/// <summary> The semaphore handle. </summary>
 		VkSemaphore m_semaphore;
 
+		/// <summary> Whether this is a timeline semaphore, which holds a counter, rather than a binary one. </summary>
+		bool m_timeline = false;
+
 		/// <summary>
 		/// The device that owns this semaphore.
 		/// </summary>
@@ -25,9 +28,26 @@ namespace VWrap {
 		/// <summary> Creates a new semaphore. </summary>
 		static std::shared_ptr<Semaphore> Create(std::shared_ptr<Device> device);
 
+		/// <summary>
+		/// Creates a new timeline semaphore with the given initial value. The device must support timeline semaphores.
+		/// </summary>
+		static std::shared_ptr<Semaphore> CreateTimeline(std::shared_ptr<Device> device, uint64_t initial_value = 0);
+
 		/// <summary> Gets the semaphore handle. </summary>
 		VkSemaphore Get() const { return m_semaphore; }
 
+		/// <summary> Gets whether this is a timeline semaphore. </summary>
+		bool IsTimeline() const { return m_timeline; }
+
+		/// <summary> Gets the current value of a timeline semaphore. </summary>
+		uint64_t GetValue() const;
+
+		/// <summary>
+		/// Waits until a timeline semaphore reaches the given value, or the timeout in nanoseconds passes.
+		/// </summary>
+		/// <returns> Whether the value was reached. </returns>
+		bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+
 		~Semaphore();
 	};
 }
\ No newline at end of file
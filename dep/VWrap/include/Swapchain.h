@@ -49,9 +49,9 @@ namespace VWrap {
 
 
 		/// <summary>
-		/// Returns the optimal present mode from a list of modes.
+		/// Returns the preferred present mode if it is in the list of modes, then mailbox, then FIFO, which is always supported.
 		/// </summary>
-		static VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> modes);
+		static VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> modes, VkPresentModeKHR preferred);
 
 		/// <summary>
 		/// Returns the optimal Extent given the capabilities.
@@ -60,8 +60,11 @@ namespace VWrap {
 
 	public:
 
-		/// <summary> Creates a swapchain for the given device and surface. </summary>
-		static std::shared_ptr<Swapchain> Create(std::shared_ptr<Device> device, std::shared_ptr<Surface> surface);
+		/// <summary>
+		/// Creates a swapchain for the given device and surface, presenting with the preferred mode where the surface supports it.
+		/// Replacing an old swapchain retires it: it can no longer acquire, but its images stay valid until it is destroyed.
+		/// </summary>
+		static std::shared_ptr<Swapchain> Create(std::shared_ptr<Device> device, std::shared_ptr<Surface> surface, VkPresentModeKHR preferred = VK_PRESENT_MODE_MAILBOX_KHR, std::shared_ptr<Swapchain> old_swapchain = nullptr);
 
 		/// <summary>
 		/// Gets the underlying Vulkan swapchain handle.
@@ -100,7 +100,7 @@ namespace VWrap {
 		std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
 		if (!file.is_open()) {
-			throw std::runtime_error("failed to open file!");
+			throw std::runtime_error("failed to open file " + filename + "!");
 		}
 		size_t fileSize = (size_t)file.tellg();
 		std::vector<char> buffer(fileSize);
@@ -156,6 +156,11 @@ namespace VWrap {
 	struct PushConstantBlock {
 		glm::mat4 NDCtoWorld;
 		glm::vec3 cameraPos;
+		float octreeScale;
+		glm::vec3 octreeLocation;
+		float lodFootprint;
+		glm::ivec2 renderSize;
+		int32_t beamColumns;
 	};
 }
 
@@ -35,6 +35,32 @@ namespace VWrap {
         return ret;
     }
 
+    std::shared_ptr<Buffer> Buffer::CreateExclusive(std::shared_ptr<Allocator> allocator,
+        VkDeviceSize size,
+        VkBufferUsageFlags usage,
+        VkMemoryPropertyFlags properties) {
+
+        auto ret = std::make_shared<Buffer>();
+
+        ret->m_allocator = allocator;
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.usage = usage;
+        bufferInfo.size = size;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+        allocInfo.requiredFlags = properties;
+
+        if (vmaCreateBuffer(allocator->Get(), &bufferInfo, &allocInfo, &ret->m_buffer, &ret->m_allocation, nullptr) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create buffer");
+        }
+
+        return ret;
+    }
+
     std::shared_ptr<Buffer> Buffer::CreateStaging(std::shared_ptr<Allocator> allocator,
         VkDeviceSize size) {
         return Create(
@@ -49,7 +75,8 @@ namespace VWrap {
         VkDeviceSize size,
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
-        void*& data) {
+        void*& data,
+        VmaAllocationCreateFlags access_flags) {
 
         auto ret = std::make_shared<Buffer>();
         ret->m_allocator = allocator;
@@ -68,7 +95,7 @@ namespace VWrap {
         VmaAllocationCreateInfo allocCreateInfo = {};
         allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
         allocCreateInfo.requiredFlags = properties;
-        allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+        allocCreateInfo.flags = access_flags |
             VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
         VmaAllocationInfo allocInfo;
@@ -26,9 +26,29 @@ namespace VWrap {
 
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+
+        // Timeline semaphores are core in 1.2, but optional before it; without them, callers fall back to fences and binary semaphores
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device->Get(), &properties);
+
+        VkPhysicalDeviceVulkan12Features supported12{};
+        supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        if (properties.apiVersion >= VK_API_VERSION_1_2) {
+            VkPhysicalDeviceFeatures2 supported{};
+            supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            supported.pNext = &supported12;
+            vkGetPhysicalDeviceFeatures2(physical_device->Get(), &supported);
+        }
+        ret->m_timeline_semaphores = supported12.timelineSemaphore == VK_TRUE;
+
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.timelineSemaphore = ret->m_timeline_semaphores ? VK_TRUE : VK_FALSE;
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = ret->m_timeline_semaphores ? &features12 : nullptr;
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pEnabledFeatures = &deviceFeatures;
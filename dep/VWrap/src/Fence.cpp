@@ -2,13 +2,13 @@
 
 namespace VWrap {
 
-	std::shared_ptr<Fence> Fence::Create(std::shared_ptr<Device> device) {
+	std::shared_ptr<Fence> Fence::Create(std::shared_ptr<Device> device, bool signaled) {
 		auto ret = std::make_shared<Fence>();
 		ret->m_device = device;
 
 		VkFenceCreateInfo info{};
 		info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		info.flags = signaled ? VK_FENCE_CREATE_SIGNALED_BIT : 0;
 
 		if (vkCreateFence(device->Get(), &info, nullptr, &ret->m_fence) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create Fence!");
@@ -17,6 +17,14 @@ namespace VWrap {
 		return ret;
 	}
 
+	bool Fence::IsSignaled() const {
+		return vkGetFenceStatus(m_device->Get(), m_fence) == VK_SUCCESS;
+	}
+
+	void Fence::Wait() const {
+		vkWaitForFences(m_device->Get(), 1, &m_fence, VK_TRUE, UINT64_MAX);
+	}
+
 	Fence::~Fence() {
 		if (m_fence != VK_NULL_HANDLE)
 			vkDestroyFence(m_device->Get(), m_fence, nullptr);
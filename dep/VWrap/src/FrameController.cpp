@@ -7,8 +7,10 @@ namespace VWrap {
 		ret->m_graphics_command_pool = graphics_pool;
 		ret->m_present_queue = present_queue;
 		ret->m_surface = surface;
-		ret->m_swapchain = Swapchain::Create(device, surface);
+		ret->m_retirement_queue = RetirementQueue::Create();
+		ret->m_swapchain = Swapchain::Create(device, surface, ret->m_present_mode);
 		ret->frames = max_frames;
+		ret->m_frames_in_flight = max_frames;
 		ret->CreateImageViews();
 		ret->CreateCommandBuffers();
 		ret->CreateSyncObjects();
@@ -16,9 +18,63 @@ namespace VWrap {
 		return ret;
 	}
 
+	uint64_t FrameController::GetCompletedFrame() const {
+		if (m_frame_timeline)
+			return m_frame_timeline->GetValue();
+
+		// The oldest frame still running bounds the ones finished
+		uint64_t completed = m_frame_number - 1;
+		for (size_t i = 0; i < frames; i++) {
+			if (m_slot_frames[i] != 0 && !m_in_flight_fences[i]->IsSignaled())
+				completed = std::min(completed, m_slot_frames[i] - 1);
+		}
+		return completed;
+	}
+
+	void FrameController::WaitForFrame(uint64_t frame) const {
+		if (frame >= m_frame_number)
+			throw std::invalid_argument("Cannot wait on a frame that has not been submitted!");
+
+		if (m_frame_timeline) {
+			m_frame_timeline->Wait(frame);
+			return;
+		}
+
+		// The frame's slot may since have been reused by a later frame; waiting on the earliest slot at or after it covers it
+		int slot = -1;
+		for (size_t i = 0; i < frames; i++) {
+			if (m_slot_frames[i] >= frame && (slot < 0 || m_slot_frames[i] < m_slot_frames[slot]))
+				slot = static_cast<int>(i);
+		}
+		if (slot >= 0)
+			m_in_flight_fences[slot]->Wait();
+	}
+
+	void FrameController::SetFramesInFlight(uint32_t frames_in_flight) {
+		frames_in_flight = std::clamp(frames_in_flight, 1u, frames);
+		if (frames_in_flight == m_frames_in_flight)
+			return;
+
+		// Every slot's semaphores must be unsignalled and its frame finished before the slots are renumbered
+		vkDeviceWaitIdle(m_device->Get());
+		m_frames_in_flight = frames_in_flight;
+		m_current_frame = 0;
+	}
+
+	void FrameController::SetPresentMode(VkPresentModeKHR present_mode) {
+		if (present_mode == m_present_mode)
+			return;
+
+		m_present_mode = present_mode;
+		RecreateSwapchain();
+	}
+
 	void FrameController::AcquireNext() {
-		VkFence fences[] = { m_in_flight_fences[m_current_frame]->Get() };
-		vkWaitForFences(m_device->Get(), 1, fences, VK_TRUE, UINT64_MAX);
+		if (m_frame_timeline)
+			m_frame_timeline->Wait(m_slot_frames[m_current_frame]);
+		else
+			m_in_flight_fences[m_current_frame]->Wait();
+		m_retirement_queue->Collect(GetCompletedFrame());
 
 		//uint32_t imageIndex;
 		VkResult result = vkAcquireNextImageKHR(m_device->Get(), m_swapchain->Get(), UINT64_MAX, m_image_available_semaphores[m_current_frame]->Get(), VK_NULL_HANDLE, &m_image_index);
@@ -38,36 +94,67 @@ namespace VWrap {
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore waitSemaphores[] = { m_image_available_semaphores[m_current_frame]->Get() };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
+		std::vector<VkSemaphore> waitSemaphores = { m_image_available_semaphores[m_current_frame]->Get() };
+		std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		std::vector<uint64_t> waitValues = { 0 };
+		bool waitsOnTimeline = false;
+		for (const auto& wait : m_extra_waits) {
+			waitSemaphores.push_back(wait.semaphore->Get());
+			waitStages.push_back(wait.stage);
+			waitValues.push_back(wait.value);
+			waitsOnTimeline |= wait.semaphore->IsTimeline();
+		}
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+
+		// The frame signals present with the binary semaphore, and its number on the timeline
+		std::vector<VkSemaphore> signalSemaphores = { m_render_finished_semaphores[m_current_frame]->Get() };
+		std::vector<uint64_t> signalValues = { 0 };
+		if (m_frame_timeline) {
+			signalSemaphores.push_back(m_frame_timeline->Get());
+			signalValues.push_back(m_frame_number);
+		}
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+		// Timeline waits and signals need their values; binary semaphores in the same submission ignore theirs
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+		timelineInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+		timelineInfo.pSignalSemaphoreValues = signalValues.data();
+		if (waitsOnTimeline || m_frame_timeline)
+			submitInfo.pNext = &timelineInfo;
 
 		submitInfo.commandBufferCount = 1;
 
 		std::array<VkCommandBuffer, 1> commandBuffers = { m_command_buffers[m_current_frame]->Get() };
 		submitInfo.pCommandBuffers = commandBuffers.data();
 
-		VkSemaphore signalSemaphores[] = { m_render_finished_semaphores[m_current_frame]->Get() };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
-
-		VkFence fences[] = { m_in_flight_fences[m_current_frame]->Get() };
-		vkResetFences(m_device->Get(), 1, fences);
+		VkFence fence = VK_NULL_HANDLE;
+		if (!m_frame_timeline) {
+			fence = m_in_flight_fences[m_current_frame]->Get();
+			vkResetFences(m_device->Get(), 1, &fence);
+		}
 
 		if (vkQueueSubmit(m_graphics_command_pool->GetQueue()->Get(),
 			1,
 			&submitInfo,
-			m_in_flight_fences[m_current_frame]->Get()) != VK_SUCCESS) {
+			fence) != VK_SUCCESS) {
 
 			throw std::runtime_error("Failed to submit to graphics queue!");
 		}
+		m_extra_waits.clear();
+		m_slot_frames[m_current_frame] = m_frame_number;
+		m_frame_number++;
+		m_retirement_queue->SetFrame(m_frame_number);
 
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores;
+		presentInfo.pWaitSemaphores = signalSemaphores.data();
 
 		VkSwapchainKHR swapchains[] = { m_swapchain->Get() };
 		presentInfo.swapchainCount = 1;
@@ -85,7 +172,7 @@ namespace VWrap {
 			throw std::runtime_error("failed to present swap chain image!");
 		}
 
-		m_current_frame = (m_current_frame + 1) % frames;
+		m_current_frame = (m_current_frame + 1) % m_frames_in_flight;
 	}
 
 	void FrameController::RecreateSwapchain() {
@@ -96,14 +183,13 @@ namespace VWrap {
 			glfwGetFramebufferSize(m_surface->GetWindow().get()[0], &width, &height);
 			glfwWaitEvents();
 		}
-		vkDeviceWaitIdle(m_device->Get());
 
-
-		for (auto image_view : m_image_views)
-			image_view.reset();
-		m_swapchain.reset();
-
-		m_swapchain = VWrap::Swapchain::Create(m_device, m_surface);
+		// Frames in flight may still render to the old images; the old swapchain is destroyed with them once they finish
+		m_retirement_queue->Retire(m_image_views);
+		m_image_views.clear();
+		auto old_swapchain = m_swapchain;
+		m_swapchain = VWrap::Swapchain::Create(m_device, m_surface, m_present_mode, old_swapchain);
+		m_retirement_queue->Retire(old_swapchain);
 		CreateImageViews();
 
 		if (m_resize_callback)
@@ -126,11 +212,17 @@ namespace VWrap {
 		m_image_available_semaphores.resize(frames);
 		m_render_finished_semaphores.resize(frames);
 		m_in_flight_fences.resize(frames);
+		m_slot_frames.assign(frames, 0);
+
+		// Frame 0 stands for no frame, which the timeline starts at
+		if (m_device->SupportsTimelineSemaphores())
+			m_frame_timeline = VWrap::Semaphore::CreateTimeline(m_device, 0);
 
 		for (size_t i = 0; i < frames; i++) {
 			m_image_available_semaphores[i] = VWrap::Semaphore::Create(m_device);
 			m_render_finished_semaphores[i] = VWrap::Semaphore::Create(m_device);
-			m_in_flight_fences[i] = VWrap::Fence::Create(m_device);
+			if (!m_frame_timeline)
+				m_in_flight_fences[i] = VWrap::Fence::Create(m_device);
 		}
 	}
 }
\ No newline at end of file
@@ -129,7 +129,8 @@ namespace VWrap
         appInfo.pApplicationName = "Hello Triangle";
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // 1.2 for timeline semaphores, which the device enables where the driver supports them
+        appInfo.apiVersion = VK_API_VERSION_1_2;
 
         // Define InstanceCreateInfo struct
         VkInstanceCreateInfo createInfo{};
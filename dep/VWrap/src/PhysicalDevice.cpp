@@ -46,7 +46,7 @@ namespace VWrap
             swapchainSupported = !swapchainSupport.formats.empty() && !swapchainSupport.presentModes.empty();
         }
 
-        return indices.isComplete() && extensionsSupported && swapchainSupported && supportedFeatures.samplerAnisotropy;
+        return indices.isComplete() && extensionsSupported && swapchainSupported && supportedFeatures.samplerAnisotropy && supportedFeatures.fragmentStoresAndAtomics;
     }
 
     bool PhysicalDevice::checkDeviceExtensions() {
@@ -98,7 +98,8 @@ namespace VWrap
 
         int i = 0;
         for (const auto& queueFamily : queueFamilyProperties) {
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            // The graphics queue also runs compute work, such as the GPU voxelizer
+            if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
                 indices.graphicsFamily = i;
             }
             else if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) {
@@ -21,6 +21,7 @@ namespace VWrap {
         fragShaderStageCreateInfo.module = fragShaderModule;
         fragShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         fragShaderStageCreateInfo.pName = "main";
+        fragShaderStageCreateInfo.pSpecializationInfo = create_info.fragment_specialization;
 
         VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCreateInfo, fragShaderStageCreateInfo };
 
@@ -117,6 +118,49 @@ namespace VWrap {
         return ret;
     }
 
+    std::shared_ptr<Pipeline> Pipeline::CreateCompute(std::shared_ptr<Device> device, std::shared_ptr<DescriptorSetLayout> descriptor_set_layout, const std::vector<VkPushConstantRange>& push_constant_ranges, const std::vector<char>& compute_shader_code, const VkSpecializationInfo* specialization)
+    {
+        auto ret = std::make_shared<Pipeline>();
+        ret->m_device = device;
+
+        VkShaderModule computeShaderModule = CreateShaderModule(device, compute_shader_code);
+
+        VkPipelineShaderStageCreateInfo computeShaderStageCreateInfo{};
+        computeShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        computeShaderStageCreateInfo.module = computeShaderModule;
+        computeShaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        computeShaderStageCreateInfo.pName = "main";
+        computeShaderStageCreateInfo.pSpecializationInfo = specialization;
+
+        std::array<VkDescriptorSetLayout, 1> descriptor_set_layout_handles = { descriptor_set_layout->Get() };
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptor_set_layout_handles.size());
+        pipelineLayoutInfo.pSetLayouts = descriptor_set_layout_handles.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(push_constant_ranges.size());
+        pipelineLayoutInfo.pPushConstantRanges = push_constant_ranges.data();
+
+        if (vkCreatePipelineLayout(device->Get(), &pipelineLayoutInfo, nullptr, &ret->m_pipeline_layout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipline layout!");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = computeShaderStageCreateInfo;
+        pipelineInfo.layout = ret->m_pipeline_layout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        if (vkCreateComputePipelines(device->Get(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &ret->m_pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute pipeline!");
+        }
+
+        vkDestroyShaderModule(device->Get(), computeShaderModule, nullptr);
+
+        return ret;
+    }
+
     VkShaderModule Pipeline::CreateShaderModule(std::shared_ptr<Device> device, const std::vector<char>& code) {
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -0,0 +1,19 @@
+#include "RetirementQueue.h"
+
+namespace VWrap {
+
+	std::shared_ptr<RetirementQueue> RetirementQueue::Create() {
+		return std::make_shared<RetirementQueue>();
+	}
+
+	void RetirementQueue::Retire(std::shared_ptr<void> object) {
+		if (object)
+			m_retired.push_back({ m_frame, std::move(object) });
+	}
+
+	void RetirementQueue::Collect(uint64_t completed_frame) {
+		// Objects are retired in frame order, so the finished ones are at the front
+		while (!m_retired.empty() && m_retired.front().first <= completed_frame)
+			m_retired.pop_front();
+	}
+}
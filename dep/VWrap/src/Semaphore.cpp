@@ -16,6 +16,49 @@ namespace VWrap {
 		return ret;
 	}
 
+	std::shared_ptr<Semaphore> Semaphore::CreateTimeline(std::shared_ptr<Device> device, uint64_t initial_value) {
+		auto ret = std::make_shared<Semaphore>();
+		ret->m_device = device;
+		ret->m_timeline = true;
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = initial_value;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		if (vkCreateSemaphore(device->Get(), &semaphoreInfo, nullptr, &ret->m_semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timeline semaphore!");
+		}
+
+		return ret;
+	}
+
+	uint64_t Semaphore::GetValue() const {
+		uint64_t value = 0;
+		if (vkGetSemaphoreCounterValue(m_device->Get(), m_semaphore, &value) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to read timeline semaphore!");
+		}
+		return value;
+	}
+
+	bool Semaphore::Wait(uint64_t value, uint64_t timeout) const {
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_semaphore;
+		waitInfo.pValues = &value;
+
+		VkResult result = vkWaitSemaphores(m_device->Get(), &waitInfo, timeout);
+		if (result != VK_SUCCESS && result != VK_TIMEOUT) {
+			throw std::runtime_error("Failed to wait on timeline semaphore!");
+		}
+		return result == VK_SUCCESS;
+	}
+
 	Semaphore::~Semaphore() {
 		if (m_semaphore != VK_NULL_HANDLE)
 			vkDestroySemaphore(m_device->Get(), m_semaphore, nullptr);
@@ -2,7 +2,7 @@
 
 namespace VWrap {
 
-	std::shared_ptr<Swapchain> Swapchain::Create(std::shared_ptr<Device> device, std::shared_ptr<Surface> surface) {
+	std::shared_ptr<Swapchain> Swapchain::Create(std::shared_ptr<Device> device, std::shared_ptr<Surface> surface, VkPresentModeKHR preferred, std::shared_ptr<Swapchain> old_swapchain) {
 		auto ret = std::make_shared<Swapchain>();
 		ret->m_device = device;
 
@@ -10,7 +10,7 @@ namespace VWrap {
         SwapchainSupportDetails details = device->GetPhysicalDevice()->QuerySwapchainSupport();
 
         VkExtent2D extent = chooseSwapExtent(details.capabilities, *surface->GetWindow());
-        VkPresentModeKHR mode = chooseSwapPresentMode(details.presentModes);
+        VkPresentModeKHR mode = chooseSwapPresentMode(details.presentModes, preferred);
         VkSurfaceFormatKHR format = chooseSwapSurfaceFormat(details.formats);
 
         // Determine the minimum image count
@@ -49,7 +49,7 @@ namespace VWrap {
         createInfo.preTransform = details.capabilities.currentTransform;
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.clipped = VK_TRUE;
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = old_swapchain ? old_swapchain->Get() : VK_NULL_HANDLE;
 
         // Create the swapchain
         if (vkCreateSwapchainKHR(device->Get(), &createInfo, nullptr, &ret->m_swapchain) != VK_SUCCESS) {
@@ -79,10 +79,10 @@ namespace VWrap {
         return formats[0];
     }
 
-    VkPresentModeKHR Swapchain::chooseSwapPresentMode(const std::vector<VkPresentModeKHR> modes) {
-        for (const auto& mode : modes) {
-            if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return mode;
+    VkPresentModeKHR Swapchain::chooseSwapPresentMode(const std::vector<VkPresentModeKHR> modes, VkPresentModeKHR preferred) {
+        for (VkPresentModeKHR candidate : { preferred, VK_PRESENT_MODE_MAILBOX_KHR }) {
+            if (std::find(modes.begin(), modes.end(), candidate) != modes.end()) {
+                return candidate;
             }
         }
         return VK_PRESENT_MODE_FIFO_KHR;
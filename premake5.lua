@@ -1,4 +1,11 @@
 -- premake5.lua
+
+-- The CPU tracer's ray packets use AVX2 (see SIMD.h); this option falls back to SSE2 for CPUs without it
+newoption {
+   trigger = "no-avx2",
+   description = "Build for CPUs without AVX2"
+}
+
 workspace "VulkanTutorial"
    configurations { "Debug", "Release" }
    platforms {"Win64"}
@@ -33,6 +40,29 @@ project "VulkanTutorial"
 
     links { "vulkan-1", "glfw3"}
 
+    -- Compile every shader before each build, so the .spv files loaded at startup never fall behind their sources
+    local shaderDir = path.getabsolute("shaders")
+    local glslc = path.translate(vulkanSDK .. "/Bin/glslc.exe")
+    local shaders = {
+       { "shader_tracer.vert", "vert_tracer.spv" },
+       { "shader_tracer.frag", "frag_tracer.spv" },
+       { "shader_tracer.comp", "comp_tracer.spv" },
+       { "shader_composite.frag", "frag_composite.spv" },
+       { "shader_beam.comp", "comp_beam.spv" },
+       { "shader_reproject.comp", "comp_reproject.spv" },
+       { "shader_upscale.comp", "comp_upscale.spv" },
+       { "shader_wavefront_generate.comp", "comp_wavefront_generate.spv" },
+       { "shader_wavefront_trace.comp", "comp_wavefront_trace.spv" },
+       { "shader_wavefront_shade.comp", "comp_wavefront_shade.spv" },
+       { "shader_wavefront_resolve.comp", "comp_wavefront_resolve.spv" },
+       { "shader_voxelize.comp", "comp_voxelize.spv" },
+       { "shader_rast.vert", "vert_rast.spv" },
+       { "shader_rast.frag", "frag_rast.spv" },
+    }
+    for _, shader in ipairs(shaders) do
+       prebuildcommands { '"' .. glslc .. '" "' .. path.translate(shaderDir .. "/" .. shader[1]) .. '" -o "' .. path.translate(shaderDir .. "/" .. shader[2]) .. '"' }
+    end
+
    filter "configurations:Debug"
       defines { "DEBUG" }
       symbols "On"
@@ -43,4 +73,7 @@ project "VulkanTutorial"
     
    filter { "platforms:Win64" }
       system "Windows"
-      architecture "x86_64"
\ No newline at end of file
+      architecture "x86_64"
+
+   filter { "platforms:Win64", "not options:no-avx2" }
+      vectorextensions "AVX2"
\ No newline at end of file
@@ -0,0 +1,19 @@
+// The beam prepass's output, shared by shader_beam.comp, which writes it, and the tracers that start their rays from it.
+// Included after tracer.glsl.
+
+// The size of the square blocks of pixels that share a beam. Must match OctreeTracer::BEAM_BLOCK_SIZE.
+const int BEAM_BLOCK_SIZE = 8;
+
+// A distance no pixel ray of each block hits anything before, row by row. 1e30 if no ray of the block can hit anything.
+layout(std430, binding = 8) buffer BeamDistances {
+    float beam_distance[];
+};
+
+// Gets the distance the ray of a pixel can start from, or 0 when the beam prepass is off.
+float beamStart(ivec2 pixel){
+    if(pushConstantBlock.beamColumns == 0){
+        return 0.0;
+    }
+    ivec2 block = pixel / BEAM_BLOCK_SIZE;
+    return beam_distance[block.y * pushConstantBlock.beamColumns + block.x];
+}
@@ -1,3 +1,12 @@
 C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_tracer.vert -o vert_tracer.spv
 C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_tracer.frag -o frag_tracer.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_tracer.comp -o comp_tracer.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_beam.comp -o comp_beam.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_reproject.comp -o comp_reproject.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_upscale.comp -o comp_upscale.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_composite.frag -o frag_composite.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_wavefront_generate.comp -o comp_wavefront_generate.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_wavefront_trace.comp -o comp_wavefront_trace.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_wavefront_shade.comp -o comp_wavefront_shade.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_wavefront_resolve.comp -o comp_wavefront_resolve.spv
 pause
\ No newline at end of file
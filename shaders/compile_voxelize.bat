@@ -0,0 +1,2 @@
+C:\VulkanSDK\1.3.250.1\Bin\glslc.exe shader_voxelize.comp -o comp_voxelize.spv
+pause
\ No newline at end of file
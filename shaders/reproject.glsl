@@ -0,0 +1,119 @@
+// Temporal reprojection of primary hits, shared by shader_reproject.comp, which carries the previous frame's hits into this frame,
+// and the tracers that start their rays from them. Included after tracer.glsl.
+
+// A pixel's hit, recorded for the next frame: where its ray entered the voxel that stopped it, and the voxel.
+// A voxel of LOD_HIT marks a pixel with nothing to reproject.
+struct HitRecord {
+    float t;
+    uint voxel;
+};
+
+// The hits of the last two frames, one per pixel row by row, in two halves that swap every frame.
+layout(std430, binding = 9) buffer HitHistory {
+    HitRecord history[];
+};
+
+// The previous frame's hit nearest the camera that lands in each pixel of this frame. t holds the distance's bits, which order like
+// the distance for positive floats, so the hits can be merged with atomicMin. NO_PREDICTION where none landed.
+struct Prediction {
+    uint t;
+    uint voxel;
+};
+
+layout(std430, binding = 10) buffer Predictions {
+    Prediction predictions[];
+};
+
+// Written by OctreeTracer every frame.
+layout(std430, binding = 11) readonly buffer ReprojectionParams {
+    mat4 previousNDCtoWorld;
+    mat4 worldToNDC;
+    vec3 previousCameraPos;
+    float pixelAngle; // The width of a pixel per unit of ray distance.
+    uint historyRead; // The first record of the previous frame's half of the history.
+    uint historyWrite; // The first record of this frame's half.
+    uint mode;
+    uint debugView; // Tints each pixel by how its ray started.
+    ivec2 previousSize; // The render size of the previous frame.
+} reprojection;
+
+const uint REPROJECTION_OFF = 0u;
+const uint REPROJECTION_RECORD = 1u; // The previous frame's hits are stale; this frame only records its own.
+const uint REPROJECTION_ON = 2u;
+
+const uint NO_PREDICTION = 0xFFFFFFFFu;
+
+// How a pixel's ray started.
+const uint RAY_FULL = 0u; // No hit was reprojected into the pixel, so it was traced from t_start.
+const uint RAY_REPROJECTED = 1u; // The ray started just before the predicted hit, and found it.
+const uint RAY_REJECTED = 2u; // The ray started just before the predicted hit, found something else, and was traced again from t_start.
+
+// How far, in voxels and pixel footprints, a hit may move between frames and still be the predicted one.
+const float REPROJECTION_MARGIN = 2.0;
+
+// Gets the window a pixel's ray is checked in: from just before the nearest hit predicted in its 3x3 neighbourhood, so that
+// the edges of nearer surfaces moving across the pixel are not skipped, to just past its own predicted hit.
+// surface_min is the nearest a hit on the predicted surface can be. Returns false if no hit landed in the pixel.
+bool predictHit(ivec2 pixel, ivec2 size, out float t_min, out float t_max, out float surface_min, out uint voxel){
+    Prediction center = predictions[pixel.y * size.x + pixel.x];
+    if(center.t == NO_PREDICTION){
+        return false;
+    }
+
+    float t = uintBitsToFloat(center.t);
+    float nearest = t;
+    for(int y = -1; y <= 1; y++){
+        for(int x = -1; x <= 1; x++){
+            ivec2 neighbour = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+            uint bits = predictions[neighbour.y * size.x + neighbour.x].t;
+            if(bits != NO_PREDICTION){
+                nearest = min(nearest, uintBitsToFloat(bits));
+            }
+        }
+    }
+
+    float voxel_size = 1.0 / float(BRICK_SIZE << MAX_DEPTH);
+    float margin = REPROJECTION_MARGIN * (voxel_size + t * reprojection.pixelAngle);
+    t_min = max(nearest - margin, 0.0);
+    t_max = t + margin;
+    surface_min = t - margin;
+    voxel = center.voxel;
+    return true;
+}
+
+// Traces a pixel as tracePixel does, starting from its predicted hit when there is one. The check traces only the predicted window,
+// and passes if it ends on the predicted voxel or no nearer than the predicted surface; otherwise the ray is traced again from
+// t_start. Records the pixel's hit for the next frame, and reports how its ray started in outcome and how far it went, as hitDistance
+// does, in distance.
+bool traceReprojected(ivec2 pixel, ivec2 size, vec2 ndc, float t_start, out vec3 color, inout int steps, out uint outcome, out float distance){
+    outcome = RAY_FULL;
+    float hit_t;
+    uint hit_voxel;
+    if(reprojection.mode == REPROJECTION_OFF){
+        bool entered = tracePixel(ndc, t_start, 1e30, color, steps, hit_t, hit_voxel);
+        distance = hitDistance(hit_t);
+        return entered;
+    }
+
+    bool entered = false;
+    float t_min;
+    float t_max;
+    float surface_min;
+    uint voxel;
+    if(reprojection.mode == REPROJECTION_ON && predictHit(pixel, size, t_min, t_max, surface_min, voxel)){
+        entered = tracePixel(ndc, max(t_start, t_min), t_max, color, steps, hit_t, hit_voxel);
+        outcome = hit_voxel != LOD_HIT && (hit_voxel == voxel || hit_t >= surface_min) ? RAY_REPROJECTED : RAY_REJECTED;
+    }
+    if(outcome != RAY_REPROJECTED){
+        entered = tracePixel(ndc, t_start, 1e30, color, steps, hit_t, hit_voxel);
+    }
+
+    history[reprojection.historyWrite + uint(pixel.y * size.x + pixel.x)] = HitRecord(hit_t, entered ? hit_voxel : LOD_HIT);
+    distance = hitDistance(hit_t);
+
+    if(reprojection.debugView != 0u && entered){
+        const vec3 tints[3] = vec3[3](vec3(0.2, 0.3, 1.0), vec3(0.2, 1.0, 0.3), vec3(1.0, 0.2, 0.2));
+        color = mix(color, tints[outcome], 0.5);
+    }
+    return entered;
+}
@@ -0,0 +1,27 @@
+#version 450
+
+// The image traced by shader_tracer.comp. Its top left renderSize texels hold the frame, which is stretched over the render pass.
+// Alpha holds hit distances, not coverage.
+layout(binding = 7, rgba16f) uniform readonly image2D traced;
+
+layout(push_constant) uniform CompositeConstants {
+    ivec2 renderSize;
+} compositeConstants;
+
+layout(location = 0) out vec4 outColor;
+
+vec4 texel(ivec2 coord) {
+    return imageLoad(traced, clamp(coord, ivec2(0), compositeConstants.renderSize - 1));
+}
+
+void main() {
+    // Bilinear between the four nearest traced texels. At full resolution the weights are 0 and each pixel copies its own texel.
+    vec2 scale = vec2(compositeConstants.renderSize) / vec2(imageSize(traced));
+    vec2 position = gl_FragCoord.xy * scale - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 weight = position - vec2(base);
+
+    vec4 top = mix(texel(base), texel(base + ivec2(1, 0)), weight.x);
+    vec4 bottom = mix(texel(base + ivec2(0, 1)), texel(base + ivec2(1, 1)), weight.x);
+    outColor = vec4(mix(top, bottom, weight.y).rgb, 1.0);
+}
@@ -0,0 +1,382 @@
+// The octree traversal shared by the tracer's fragment, compute and wavefront shaders. Included after #version and
+// #extension GL_GOOGLE_include_directive; the including shader declares its own inputs, outputs and main.
+
+// Set by OctreeTracer when the pipeline is built.
+layout(constant_id = 0) const int BRICK_SIZE = 8;
+layout(constant_id = 1) const int MAX_DEPTH = 8;
+layout(constant_id = 2) const int STEP_BUDGET = 1000;
+layout(constant_id = 3) const bool USE_MATERIALS = false;
+layout(constant_id = 4) const int BRICK_LEVELS = 3;
+layout(constant_id = 5) const int BRICK_WORDS = 19;
+
+layout(push_constant) uniform PushConstantBlock {
+	mat4 NDCtoWorld;
+	vec3 cameraPos;
+	float octreeScale;
+	vec3 octreeLocation;
+	float lodFootprint; // The width of a pixel per unit of ray distance, times the LOD threshold. 0 disables LOD.
+	ivec2 renderSize; // The pixels traced, from the top left of the traced image when the resolution is scaled.
+	int beamColumns; // The number of beam prepass blocks per row of the screen. 0 disables the prepass.
+} pushConstantBlock;
+
+// The occupancy of every brick slot, BRICK_WORDS words per slot: 1 bit per voxel, followed by BRICK_LEVELS - 1 coarser levels
+// where each bit covers 2^3 bits of the level below. Every level starts on a word boundary.
+layout(std430, binding = 0) readonly buffer BrickOccupancy {
+	uint occupancy[];
+};
+
+struct OctreeNode {
+	uint header;
+	int data;
+};
+
+layout(std430, binding = 1) readonly buffer NodeBuffer {
+	OctreeNode nodes[];
+};
+
+layout(std430, binding = 2) buffer TraversalStats {
+	uint total_steps;
+	uint total_rays;
+	uint reprojected_rays; // Rays that started from a reprojected hit. See reproject.glsl.
+	uint reprojection_hits; // Reprojected rays whose check found the predicted surface.
+} stats;
+
+// Maps each brick of the octree to its slot in the brick atlas.
+layout(std430, binding = 3) readonly buffer PageTable {
+	uint page_table[];
+};
+
+// Set for every brick a ray touches, so the brick pool can page in what is missing.
+layout(std430, binding = 4) buffer BrickFeedback {
+	uint brick_feedback[];
+};
+
+// The voxel values of every brick slot, 1 byte per voxel packed 4 to a word. Only bound to real data if USE_MATERIALS is set.
+layout(std430, binding = 5) readonly buffer BrickMaterials {
+	uint materials[];
+};
+
+// The prefiltered colour of every node in RGB and its coverage in A, packed as RGBA8. 0 for nodes with no prefiltered data.
+layout(std430, binding = 6) readonly buffer NodeLOD {
+	uint node_lod[];
+};
+
+const uint LEAF_FLAG = 0x100u;
+const uint CHILD_MASK = 0xFFu;
+const uint NON_RESIDENT = 0xFFFFFFFFu;
+const uint BRICK_VOXELS = uint(BRICK_SIZE * BRICK_SIZE * BRICK_SIZE);
+
+// Returned as the hit voxel when the ray ended in prefiltered cells rather than a voxel.
+const uint LOD_HIT = 0xFFFFFFFFu;
+
+// The accumulated coverage at which prefiltered cells stop the ray.
+const float LOD_OPAQUE = 0.95;
+
+const vec3 palette[8] = vec3[8](
+	vec3(1.0), vec3(1.0), vec3(0.85, 0.33, 0.31), vec3(0.36, 0.72, 0.36),
+	vec3(0.26, 0.55, 0.79), vec3(0.94, 0.76, 0.29), vec3(0.6, 0.4, 0.75), vec3(0.3, 0.75, 0.75)
+);
+
+float piOver2 = asin(1.0);
+vec4 skyColor = vec4(0.529, 0.808, 0.922, 1.0);
+vec4 horizonColor = vec4(0.8,0.9,1.0, 1.0);
+
+vec4 missColor(vec3 direction){
+    float dotProd = dot(direction, vec3(0.0,0.0,1.0));
+    dotProd = clamp(dotProd, -1.0, 1.0);
+    float theta = acos(dotProd) / piOver2;
+
+    if(theta < 1){ // sky (pi/2)
+        return skyColor*(1-theta) + horizonColor*theta;
+    }
+    else{
+	    return horizonColor*(2-theta);
+    }
+}
+
+vec3 faceShade(bvec3 face){
+    return vec3(1.0) - vec3(face) * 0.1;
+}
+
+// Blends a prefiltered cell behind what the ray has passed through so far, front to back. Returns true once the ray is opaque.
+bool blendLOD(uint lod, float coverage, bvec3 face, inout vec4 accum){
+    vec3 color = unpackUnorm4x8(lod).rgb * faceShade(face);
+    accum.rgb += (1.0 - accum.a) * coverage * color;
+    accum.a += (1.0 - accum.a) * coverage;
+    return accum.a >= LOD_OPAQUE;
+}
+
+// Returns the t at which the ray leaves the cube [cell_min, cell_min + size], and which faces it leaves through.
+float cellExit(vec3 cell_min, float size, vec3 origin, vec3 invDir, bvec3 positive, out bvec3 exit_face){
+    vec3 planes = cell_min + mix(vec3(0.0), vec3(size), positive);
+    vec3 t = (planes - origin) * invDir;
+    float tExit = min(min(t.x, t.y), t.z);
+    exit_face = equal(t, vec3(tExit));
+    return tExit;
+}
+
+// Tests one cell of an occupancy level of the brick whose words start at slot_word.
+bool cellOccupied(uint slot_word, int level, ivec3 cell){
+    uint offset = 0u;
+    for(int i = 0; i < level; i++){
+        uint side = uint(BRICK_SIZE >> i);
+        offset += (side * side * side + 31u) / 32u;
+    }
+    int side = BRICK_SIZE >> level;
+    uint index = uint((cell.z * side + cell.y) * side + cell.x);
+    return (occupancy[slot_word + offset + (index >> 5)] & (1u << (index & 31u))) != 0u;
+}
+
+// Hierarchical DDA through the brick in the given slot, starting at t. Empty cells are skipped at the coarsest level that is empty,
+// and the ray only refines to single voxels near surfaces. Refinement stops at min_level, where an occupied cell counts as a hit.
+// Returns true on a hit, with the level it was found at, t at the cell it entered and, for level 0, the slot-relative voxel index that was hit.
+bool traceBrick(uint slot, vec3 cell_min, float cell_size, vec3 origin, vec3 direction, vec3 invDir, bvec3 positive, inout float t, int min_level, inout int steps, inout bvec3 face, out uint hit_voxel, out int hit_level){
+    uint slot_word = slot * uint(BRICK_WORDS);
+
+    float voxel_size = cell_size / float(BRICK_SIZE);
+    vec3 point = origin + direction * t;
+    ivec3 voxel_coord = clamp(ivec3(floor((point - cell_min) / voxel_size)), ivec3(0), ivec3(BRICK_SIZE - 1));
+    int level = BRICK_LEVELS - 1;
+
+    while(steps < STEP_BUDGET){
+        steps++;
+
+        ivec3 cell = voxel_coord >> level;
+        if(cellOccupied(slot_word, level, cell)){
+            if(level <= min_level){
+                hit_voxel = slot * BRICK_VOXELS + uint((voxel_coord.z * BRICK_SIZE + voxel_coord.y) * BRICK_SIZE + voxel_coord.x);
+                hit_level = level;
+                return true;
+            }
+            level--;
+            continue;
+        }
+
+        // Jump to the exit of the empty cell. The exit axes step across the cell boundary; the others are clamped to the cell,
+        // so rounding in the recomputed position can never move the ray backwards.
+        ivec3 cell_lo = cell << level;
+        ivec3 cell_hi = cell_lo + ((1 << level) - 1);
+        t = cellExit(cell_min + vec3(cell_lo) * voxel_size, voxel_size * float(1 << level), origin, invDir, positive, face);
+
+        ivec3 inside = clamp(ivec3(floor((origin + direction * t - cell_min) / voxel_size)), cell_lo, cell_hi);
+        ivec3 across = mix(cell_lo - 1, cell_hi + 1, positive);
+        voxel_coord = mix(inside, across, face);
+
+        if(any(lessThan(voxel_coord, ivec3(0))) || any(greaterThanEqual(voxel_coord, ivec3(BRICK_SIZE)))){
+            return false;
+        }
+
+        // The next cell may be empty at a coarser level again
+        level = min(level + 1, BRICK_LEVELS - 1);
+    }
+    return false;
+}
+
+// Walks the octree front to back. Empty octants are skipped in a single step, and the voxel DDA only runs inside occupied leaves.
+// Cell bounds come from the ray's path rather than the node index, and parents are kept on the stack, so the same walk
+// also handles DAGs, where a child block is shared by several parents.
+// Cells narrower than a pixel's footprint are not descended into. Their prefiltered colours are blended into lod_color by coverage,
+// and the ray ends with LOD_HIT once they are opaque. Bricks are refined only to their coarsest level finer than the footprint.
+// The ray starts at t and gives up past t_max; on a hit, t is where it entered the cell that stopped it.
+bool traceOctree(vec3 origin, vec3 direction, vec3 invDir, inout float t, float t_max, inout int steps, inout bvec3 face, out uint hit_voxel, inout vec4 lod_color){
+    bvec3 positive = greaterThan(invDir, vec3(0.0));
+
+    uint stack[MAX_DEPTH];
+    int level = 0;
+    uint node = 0u;
+    vec3 cell_min = vec3(0.0);
+    float cell_size = 1.0;
+
+    while(steps < STEP_BUDGET && t <= t_max){
+        steps++;
+
+        bvec3 exit_face;
+        float tExit = cellExit(cell_min, cell_size, origin, invDir, positive, exit_face);
+
+        // Pop once the ray has left the current cell
+        if(t >= tExit){
+            if(level == 0){
+                return false;
+            }
+            level--;
+            node = stack[level];
+            cell_size *= 2.0;
+            cell_min = floor(cell_min / cell_size) * cell_size;
+            continue;
+        }
+
+        // The footprint of a pixel where the ray enters the cell, in octree space
+        float footprint = t * pushConstantBlock.lodFootprint;
+        uint lod = footprint > 0.0 ? node_lod[node] : 0u;
+        if(lod != 0u && cell_size <= footprint){
+            if(blendLOD(lod, unpackUnorm4x8(lod).a, face, lod_color)){
+                hit_voxel = LOD_HIT;
+                return true;
+            }
+            t = tExit;
+            face = exit_face;
+            continue;
+        }
+
+        OctreeNode current = nodes[node];
+        if((current.header & LEAF_FLAG) != 0u){
+            uint brick = uint(current.data);
+            if(brick_feedback[brick] == 0u){
+                brick_feedback[brick] = 1u;
+            }
+
+            // Bricks that are not resident yet are drawn prefiltered, or treated as empty, until the pool uploads them
+            uint slot = page_table[brick];
+            if(slot == NON_RESIDENT){
+                if(lod != 0u && blendLOD(lod, unpackUnorm4x8(lod).a, face, lod_color)){
+                    hit_voxel = LOD_HIT;
+                    return true;
+                }
+            }
+            else{
+                int min_level = 0;
+                if(lod != 0u){
+                    min_level = clamp(int(floor(log2(footprint * float(BRICK_SIZE) / cell_size))), 0, BRICK_LEVELS - 1);
+                }
+
+                int hit_level;
+                if(traceBrick(slot, cell_min, cell_size, origin, direction, invDir, positive, t, min_level, steps, face, hit_voxel, hit_level)){
+                    // Coarse brick cells are solid by construction, and take the brick's average colour
+                    if(hit_level > 0){
+                        blendLOD(lod, 1.0, face, lod_color);
+                        hit_voxel = LOD_HIT;
+                    }
+                    return true;
+                }
+            }
+            t = tExit;
+            face = exit_face;
+            continue;
+        }
+
+        // Find the child octant the ray is in at t. A ray moving in +x is in the upper half once it passes the middle plane,
+        // and a ray moving in -x is in the upper half until it reaches it.
+        float half_size = cell_size * 0.5;
+        vec3 tMid = (cell_min + half_size - origin) * invDir;
+        bvec3 upper = equal(greaterThanEqual(vec3(t), tMid), positive);
+        uint octant = uint(upper.x) | (uint(upper.y) << 1) | (uint(upper.z) << 2);
+        vec3 child_min = cell_min + vec3(upper) * half_size;
+
+        uint child_mask = current.header & CHILD_MASK;
+        if((child_mask & (1u << octant)) != 0u && level < MAX_DEPTH){
+            stack[level] = node;
+            level++;
+            node = uint(int(node) + current.data) + uint(bitCount(child_mask & ((1u << octant) - 1u)));
+            cell_min = child_min;
+            cell_size = half_size;
+        }
+        else{
+            t = cellExit(child_min, half_size, origin, invDir, positive, face);
+        }
+    }
+    return false;
+}
+
+// Splits the even and odd bits of a 6-bit Morton index into x and y, to walk an 8x8 tile in Morton order.
+uvec2 mortonDecode(uint index) {
+    uvec2 bits = uvec2(index, index >> 1) & 0x15u;
+    bits = (bits | (bits >> 1)) & 0x13u;
+    return (bits | (bits >> 2)) & 0x07u;
+}
+
+// Gets the world-space direction of the ray through a pixel, given the pixel's centre in NDC.
+vec3 pixelDirection(vec2 ndc){
+	vec4 transformed = pushConstantBlock.NDCtoWorld * vec4(ndc, 0.0, 1.0);
+    vec3 pixelLocation = transformed.xyz / transformed.w;
+	return normalize(pixelLocation - pushConstantBlock.cameraPos);
+}
+
+// Nudges zero direction components so that every plane test stays finite.
+vec3 safeDirection(vec3 direction){
+    return mix(direction, vec3(1e-7), lessThan(abs(direction), vec3(1e-7)));
+}
+
+// Clips a ray in octree space to the octree, which spans [0, 1]. Returns false if the ray misses it, otherwise the t at which the ray
+// enters it, clamped to 0 for rays that start inside, and the faces it enters through.
+bool enterOctree(vec3 origin, vec3 invDir, out float t, out bvec3 face){
+    vec3 tMin = (0.0 - origin) * invDir;
+    vec3 tMax = (1.0 - origin) * invDir;
+
+    // Swap values if necessary so tMin always holds the entry points and tMax the exit points
+    vec3 t1 = min(tMin, tMax);
+    vec3 t2 = max(tMin, tMax);
+
+    // Find the largest tMin and the smallest tMax
+    float tEntry = max(max(t1.x, t1.y), t1.z);
+    float tExit = min(min(t2.x, t2.y), t2.z);
+
+    // If the largest entry point is greater than the smallest exit point, the ray misses the cube
+    face = equal(t1, vec3(tEntry));
+    t = max(tEntry, 0.0);
+    return tEntry <= tExit && tExit >= 0.0;
+}
+
+// Gets the colour of a voxel value, or white if the brick pool has no materials.
+vec3 voxelAlbedo(uint hit_voxel){
+    if(!USE_MATERIALS){
+        return vec3(1.0);
+    }
+    uint material = (materials[hit_voxel >> 2] >> ((hit_voxel & 3u) * 8u)) & 0xFFu;
+    return palette[material & 7u];
+}
+
+// Traces the ray through a pixel, given the pixel's centre in NDC, and shades it. The ray starts no nearer than t_start, which must
+// not be past its first hit, and gives up past t_max. Returns false if the ray misses the octree, in which case the colour is the background.
+// steps is added to, so a caller that retraces a pixel counts both traces. On a hit, hit_t is where the ray entered the cell that
+// stopped it, otherwise 1e30. hit_voxel is the voxel hit, or LOD_HIT if the ray ended in or passed through prefiltered cells, whose
+// colours depend on the distance they are seen from.
+bool tracePixel(vec2 ndc, float t_start, float t_max, out vec3 color, inout int steps, out float hit_t, out uint hit_voxel) {
+    vec3 direction = pixelDirection(ndc);
+
+    // Trace in octree space, where the octree spans [0, 1]
+    vec3 origin = (pushConstantBlock.cameraPos - pushConstantBlock.octreeLocation) / pushConstantBlock.octreeScale;
+    vec3 safeDir = safeDirection(direction);
+    vec3 invDir = 1.0 / safeDir;
+
+    hit_t = 1e30;
+    hit_voxel = LOD_HIT;
+    float t;
+    bvec3 face;
+    if(!enterOctree(origin, invDir, t, face)){
+        color = missColor(direction).rgb;
+        return false;
+    }
+
+    uint voxel = 0u;
+    vec4 lod_color = vec4(0.0);
+    t = max(t, t_start);
+    bool hit = traceOctree(origin, safeDir, invDir, t, t_max, steps, face, voxel, lod_color);
+
+    // Whatever ends the ray shows through the prefiltered cells it passed
+    vec3 background;
+    if(hit && voxel == LOD_HIT){
+        background = lod_color.rgb / lod_color.a;
+    }
+    else if(hit){
+        background = voxelAlbedo(voxel) * faceShade(face);
+    }
+    else{
+        background = missColor(direction).rgb;
+    }
+    color = lod_color.rgb + (1.0 - lod_color.a) * background - vec3(steps / 250.0);
+
+    if(hit){
+        hit_t = t;
+        hit_voxel = lod_color.a > 0.0 ? LOD_HIT : voxel;
+    }
+    return true;
+}
+
+// How far a miss is taken to be by the temporal upscaler, in world units. Far enough that only the camera's rotation moves it.
+const float SKY_DISTANCE = 10000.0;
+
+// Converts a hit_t from tracePixel to the world distance the temporal upscaler reprojects the pixel by, which the tracers store in
+// the traced image's alpha.
+float hitDistance(float hit_t) {
+    return min(hit_t * pushConstantBlock.octreeScale, SKY_DISTANCE);
+}
@@ -0,0 +1,151 @@
+// The queues and helpers shared by the stages of the wavefront tracer. Each stage is its own dispatch: generate writes one primary ray
+// per pixel that enters the octree, trace runs a queue of rays through the octree, shade turns the hits into pixel records and
+// appends the secondary rays they need, and resolve lights the pixel records into the traced image. Included after #version and
+// #extension GL_GOOGLE_include_directive.
+
+#include "tracer.glsl"
+
+// One ray, hit or pixel per invocation. Must match WavefrontTracer::WORKGROUP_SIZE.
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+// Which queue the trace and shade stages read: 0 for primary rays, 1 for the shadow and occlusion rays they spawn.
+layout(constant_id = 6) const int BOUNCE = 0;
+
+// The wavefront's output, composited into the render pass by shader_composite.frag.
+layout(binding = 7, rgba16f) uniform image2D traced;
+
+const uint PRIMARY_RAYS = 0u;
+const uint SECONDARY_RAYS = 1u;
+
+// The length of each ray queue, and the indirect dispatch that covers it. Reset every frame, and grown by appendRays.
+struct Queue {
+    uint count;
+    uint groups_x;
+    uint groups_y;
+    uint groups_z;
+};
+
+layout(std430, binding = 8) buffer Queues {
+    Queue queues[2];
+};
+
+// A ray in octree space. The pixel it belongs to is in the low 30 bits of pixel_kind, and what it is for in the top 2.
+struct Ray {
+    vec3 origin;
+    uint pixel_kind;
+    vec3 direction;
+    float t_max;
+};
+
+// The primary queue holds up to one ray per pixel, followed by the secondary queue with up to two.
+layout(std430, binding = 9) buffer Rays {
+    Ray rays[];
+};
+
+// The end of each traced ray, at the same index as the ray in its queue. face_steps holds the faces the ray entered the hit cell
+// through in bits 0-2, whether it hit in bit 3, and its step count above that.
+struct Hit {
+    uint voxel;
+    float t;
+    uint face_steps;
+    uint lod;
+};
+
+layout(std430, binding = 10) buffer Hits {
+    Hit hits[];
+};
+
+// What resolve needs to light a pixel: the colour it has regardless of light, its albedo behind any prefiltered cells, the cosine
+// of its normal with the sun, its hit distance as hitDistance gives it, and which of its secondary rays got through. Colours are
+// packed as halves.
+struct PixelRecord {
+    uint base_rg;
+    uint base_b_ndotl;
+    uint albedo_rg;
+    uint albedo_b_distance;
+    uint visibility;
+};
+
+layout(std430, binding = 11) buffer Pixels {
+    PixelRecord pixels[];
+};
+
+const uint KIND_PRIMARY = 0u;
+const uint KIND_SHADOW = 1u;
+const uint KIND_OCCLUSION = 2u;
+
+// The visibility bits set when a secondary ray of each kind gets through.
+const uint SUN_VISIBLE = 1u;
+const uint SKY_VISIBLE = 2u;
+
+// The direction towards the sun, and the light from it and from the sky.
+const vec3 SUN_DIRECTION = normalize(vec3(0.3, 0.5, 0.8));
+const vec3 SUN_COLOR = vec3(0.7);
+const vec3 SKY_COLOR = vec3(0.35);
+
+// How far occlusion rays look for blockers, and how far secondary rays start off the surface, in octree units.
+const float OCCLUSION_RADIUS = 0.02;
+const float SURFACE_OFFSET = 2e-5;
+
+// The slot and count of this workgroup's entries in a queue, reserved by its first invocation.
+shared uint group_base;
+shared uint group_count;
+
+uint pixelCount() {
+    ivec2 size = imageSize(traced);
+    return uint(size.x * size.y);
+}
+
+// Gets the index of a queue's first ray in the ray buffer.
+uint queueBase(uint queue) {
+    return queue == PRIMARY_RAYS ? 0u : pixelCount();
+}
+
+// Reserves count consecutive slots in a queue and returns the first, relative to the queue. The whole workgroup reserves its slots
+// with one atomic, so the queue stays compact without a separate pass, and grows the queue's indirect dispatch to cover them.
+// Must be called by every invocation of the workgroup; those with nothing to append pass 0.
+uint appendRays(uint queue, uint count) {
+    if(gl_LocalInvocationIndex == 0u){
+        group_count = 0u;
+    }
+    barrier();
+
+    uint offset = atomicAdd(group_count, count);
+    barrier();
+
+    if(gl_LocalInvocationIndex == 0u && group_count > 0u){
+        group_base = atomicAdd(queues[queue].count, group_count);
+        atomicMax(queues[queue].groups_x, (group_base + group_count + gl_WorkGroupSize.x - 1u) / gl_WorkGroupSize.x);
+    }
+    barrier();
+
+    return group_base + offset;
+}
+
+// Gets the outward normal of the faces a ray entered a cell through.
+vec3 faceNormal(bvec3 face, vec3 direction) {
+    vec3 axis = face.x ? vec3(1.0, 0.0, 0.0) : (face.y ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0));
+    return -sign(direction) * axis;
+}
+
+uint hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Picks a direction on the hemisphere around n, weighted by cosine, from two uniform numbers in [0, 1).
+vec3 cosineDirection(vec3 n, vec2 u) {
+    vec3 tangent = abs(n.z) < 0.999 ? normalize(cross(n, vec3(0.0, 0.0, 1.0))) : vec3(1.0, 0.0, 0.0);
+    vec3 bitangent = cross(n, tangent);
+    float r = sqrt(u.x);
+    float phi = 6.28318530718 * u.y;
+    return normalize(tangent * (r * cos(phi)) + bitangent * (r * sin(phi)) + n * sqrt(max(1.0 - u.x, 0.0)));
+}
+
+void writePixel(uint pixel, vec3 base, vec3 albedo, float ndotl, float distance) {
+    pixels[pixel] = PixelRecord(packHalf2x16(base.rg), packHalf2x16(vec2(base.b, ndotl)), packHalf2x16(albedo.rg), packHalf2x16(vec2(albedo.b, distance)), 0u);
+}
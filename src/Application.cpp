@@ -6,6 +6,18 @@ void Application::Run() {
 	Cleanup();
 }
 
+void Application::TestGPUVoxelizer() {
+	InitWindow();
+	glfwHideWindow(m_glfw_window.get()[0]);
+	InitVulkan();
+
+	GPUVoxelizer::RunTests(m_device, m_allocator, m_graphics_command_pool, m_upload_service, m_frame_controller->GetRetirementQueue());
+
+	vkDeviceWaitIdle(m_device->Get());
+	glfwDestroyWindow(m_glfw_window.get()[0]);
+	glfwTerminate();
+}
+
 void Application::Init() {
 	InitWindow();
 	InitVulkan();
@@ -16,6 +28,7 @@ void Application::Init() {
 		m_device,
 		m_render_pass,
 		m_graphics_command_pool,
+		m_upload_service,
 		extent,
 		MAX_FRAMES_IN_FLIGHT);
 
@@ -24,10 +37,17 @@ void Application::Init() {
 		m_device,
 		m_render_pass,
 		m_graphics_command_pool,
+		m_upload_service,
+		m_frame_controller->GetRetirementQueue(),
 		extent,
 		MAX_FRAMES_IN_FLIGHT);
+	m_octree_tracer->SetMesh(m_mesh_rasterizer);
 
 	m_gpu_profiler = GPUProfiler::Create(m_device, MAX_FRAMES_IN_FLIGHT);
+	m_resolution_controller = ResolutionController::Create(m_app_state.target_frame_ms, DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE);
+
+	// Applying the profile may recreate the swapchain, so it waits until everything that resizes with it exists
+	m_latency_controller = LatencyController::Create(m_frame_controller, m_app_state.latency_profile);
 
 	m_camera = Camera::Create(45, ((float)extent.width / (float)extent.height), 0.1f, 10.0f);
 
@@ -87,6 +107,8 @@ void Application::InitVulkan() {
 	m_transfer_queue = VWrap::Queue::Create(m_device, indices.transferFamily.value());
 	m_graphics_command_pool = VWrap::CommandPool::Create(m_device, m_graphics_queue);
 	m_transfer_command_pool = VWrap::CommandPool::Create(m_device, m_transfer_queue);
+	m_staging_ring = StagingRing::Create(m_device, m_allocator, STAGING_RING_SIZE);
+	m_upload_service = UploadService::Create(m_device, m_allocator, m_staging_ring, m_transfer_command_pool, m_graphics_queue);
 
 	m_frame_controller = VWrap::FrameController::Create(m_device, m_surface, m_graphics_command_pool, m_present_queue, MAX_FRAMES_IN_FLIGHT);
 	m_frame_controller->SetResizeCallback([this]() { Resize(); });
@@ -132,13 +154,25 @@ void Application::MainLoop() {
 	auto last_time = std::chrono::high_resolution_clock::now();
 
 	while (!glfwWindowShouldClose(m_glfw_window.get()[0])) {
+
+		// Profile changes renumber the frames in flight and recreate the swapchain, so they come before the frame is acquired
+		if (m_app_state.latency_profile != m_latency_controller->GetProfile())
+			m_latency_controller->SetProfile(m_app_state.latency_profile);
+
+		// Late input sampling: waiting for the frame in flight before polling, rather than after, keeps the input fresh
+		bool late_input = m_latency_controller->SamplesInputLate();
+		if (late_input)
+			m_frame_controller->AcquireNext();
+
 		auto current_time = std::chrono::high_resolution_clock::now();
 		float dt = std::chrono::duration<float, std::chrono::seconds::period>(current_time - last_time).count();
 		last_time = current_time;
 
 		auto input_query = Input::Poll();
+		m_latency_controller->RecordInput();
 		ParseInputQuery(input_query);
 		
+		glm::vec3 last_position = m_camera->GetPosition();
 		if(m_app_state.focused) {
 			
 			ImGui::SetMouseCursor(ImGuiMouseCursor_None);
@@ -149,6 +183,36 @@ void Application::MainLoop() {
 			ImGui::SetMouseCursor(ImGuiMouseCursor_Arrow);
 		}
 
+		// Streamed scenes prefetch ahead of where the camera is heading
+		glm::vec3 velocity = dt > 0.0f ? (m_camera->GetPosition() - last_position) / dt : glm::vec3(0.0f);
+		m_octree_tracer->UpdateCamera(m_camera, velocity);
+
+
+		// Scene changes replace resources that in-flight frames may still be reading; the tracer retires them until those frames finish
+		if (m_app_state.scene != m_octree_tracer->GetScene())
+			m_octree_tracer->SetScene(m_app_state.scene);
+
+		// So do path changes, which create or free the wavefront path's queues
+		if (m_app_state.path != m_octree_tracer->GetPath())
+			m_octree_tracer->SetPath(m_app_state.path);
+
+		// And upscale mode changes, which create or free the upscaler's history
+		if (m_app_state.upscale_mode != m_octree_tracer->GetUpscaleMode())
+			m_octree_tracer->SetUpscaleMode(m_app_state.upscale_mode);
+		m_octree_tracer->SetBeamPrepass(m_app_state.beam_prepass);
+		m_octree_tracer->SetReprojection(m_app_state.reprojection, m_app_state.reprojection_debug);
+
+		// Edits only touch host copies; the brick pool uploads the changed bricks with the next frame
+		if (m_app_state.edit != EditAction::NONE) {
+			glm::vec3 target = m_camera->GetPosition() + m_camera->GetForward() * EDIT_DISTANCE;
+			uint8_t value = m_app_state.edit == EditAction::FILL ? 2 : 0;
+			m_octree_tracer->FillBox(target, static_cast<uint32_t>(m_app_state.edit_size), value);
+			m_app_state.edit = EditAction::NONE;
+		}
+
+		if (!late_input)
+			m_frame_controller->AcquireNext();
+		m_latency_controller->Poll();
 
 		m_gui_renderer->BeginFrame();
 		DrawFrame();
@@ -208,19 +272,31 @@ void Application::Cleanup() {
 
 void Application::DrawFrame() {
 
-	// ACQUIRE FRAME ------------------------------------------------
-	m_frame_controller->AcquireNext();
+	// ACQUIRE FRAME - ACQUIRED BY THE MAIN LOOP ------------------------------------------------
 	uint32_t image_index = m_frame_controller->GetImageIndex();
 	uint32_t frame_index = m_frame_controller->GetCurrentFrame();
 	auto command_buffer = m_frame_controller->GetCurrentCommandBuffer();
+	m_staging_ring->Reclaim(m_frame_controller->GetCompletedFrame());
 
 	// BEGIN RECORDING ------------------------------------------------
 	std::shared_ptr<VWrap::Framebuffer> framebuffer = m_framebuffers[image_index];
 	command_buffer->Begin();
 
+	// ACQUIRE UPLOADS ------------------------------------------------
+	m_upload_service->Collect();
+	for (const auto& wait : m_upload_service->CmdAcquire(command_buffer))
+		m_frame_controller->AddWait(wait);
+
 	// BEGIN PROFILING ------------------------------------------------
 	m_gpu_profiler->CmdBegin(command_buffer, frame_index);
 
+	// STREAM BRICKS ------------------------------------------------
+	m_octree_tracer->CmdUpdate(command_buffer, frame_index);
+	m_gpu_profiler->RecordBrickPool(frame_index, m_octree_tracer->GetBrickPoolStats());
+
+	// TRACE ------------------------------------------------
+	m_octree_tracer->CmdTrace(command_buffer, frame_index, m_camera, m_gpu_profiler);
+
 	// BEGIN RENDER PASS ------------------------------------------------
 	command_buffer->CmdBeginRenderPass(m_render_pass, framebuffer);
 
@@ -238,7 +314,25 @@ void Application::DrawFrame() {
 
 	// RECORD GUI COMMANDS ------------------------------------------------
 	GPUProfiler::PerformanceMetrics metrics = m_gpu_profiler->GetMetrics(frame_index);
-	m_gui_renderer->CmdDraw(command_buffer, metrics.render_time, metrics.fps, m_app_state.sensitivity, m_app_state.speed);
+	GUIMetrics gui_metrics{};
+	gui_metrics.performance = metrics;
+	gui_metrics.steps_per_ray = m_octree_tracer->GetAverageSteps();
+	gui_metrics.reprojected_fraction = m_octree_tracer->GetReprojectedFraction();
+	gui_metrics.reprojection_success = m_octree_tracer->GetReprojectionSuccessRate();
+	gui_metrics.render_extent = m_octree_tracer->GetRenderExtent();
+	gui_metrics.scene_stats = m_octree_tracer->GetSceneStats();
+	gui_metrics.input_latency_ms = m_latency_controller->GetLatency();
+	m_gui_renderer->CmdDraw(command_buffer, gui_metrics, m_app_state);
+
+	// The next frame's render scale follows the GPU time of the last frame this one's resources were used for
+	m_resolution_controller->SetTarget(m_app_state.target_frame_ms);
+	if (m_app_state.dynamic_resolution) {
+		m_octree_tracer->SetRenderScale(m_resolution_controller->Update(metrics.render_time));
+	}
+	else {
+		m_resolution_controller->Reset();
+		m_octree_tracer->SetRenderScale(1.0f);
+	}
 
 	// END RENDER PASS - TODO: ABSTRACT ------------------------------------------------
 	vkCmdEndRenderPass(command_buffer->Get());
@@ -248,10 +342,17 @@ void Application::DrawFrame() {
 	}
 
 	// RENDER -----------------------------------
+	m_staging_ring->EndFrame(m_frame_controller->GetFrameNumber());
 	m_frame_controller->Render();
 }
 
 void Application::Resize() {
+	// Frames in flight still render to the old attachments, which are destroyed once they finish
+	auto retirement_queue = m_frame_controller->GetRetirementQueue();
+	retirement_queue->Retire(m_framebuffers);
+	retirement_queue->Retire(m_color_image_view);
+	retirement_queue->Retire(m_depth_image_view);
+
 	CreateColorResources(m_render_pass->GetSamples());
 	CreateDepthResources(m_render_pass->GetSamples());
 	CreateFramebuffers();
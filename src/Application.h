@@ -39,6 +39,9 @@
 #include "Camera.h"
 #include "Input.h"
 #include "OctreeTracer.h"
+#include "ResolutionController.h"
+#include "LatencyController.h"
+#include "UploadService.h"
 
 // STD INCLUDES ----------------------------------------------------------------------------------------------
 #include <iostream>
@@ -62,9 +65,21 @@ const uint32_t WIDTH = 1200;
 const uint32_t HEIGHT = 900;
 
 /// <summary>
-/// The maximum number of frames that can be in flight at once.
+/// The maximum number of frames that can be in flight at once, which per-frame resources are created for. The latency profile
+/// picks how many of them are used.
 /// </summary>
-const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+/// <summary>
+/// The size of the ring that small uploads are staged in, shared by the frames in flight.
+/// </summary>
+const VkDeviceSize STAGING_RING_SIZE = 16 * 1024 * 1024;
+
+/// <summary>
+/// The range of the render scale the dynamic resolution controller may pick, per side of the screen.
+/// </summary>
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+const float DYNAMIC_RESOLUTION_MAX_SCALE = 1.0f;
 
 /// <summary>
 /// Whether or not to enable validation layers. (Debugging only.)
@@ -118,6 +133,11 @@ private:
 	std::shared_ptr<VWrap::Surface> m_surface;
 	std::shared_ptr<VWrap::FrameController> m_frame_controller;
 
+	/// <summary>
+	/// Sets the frames in flight and present mode of the frame controller, and measures the input latency they give.
+	/// </summary>
+	std::shared_ptr<LatencyController> m_latency_controller;
+
 	// COMMANDS
 	std::shared_ptr<VWrap::CommandPool> m_graphics_command_pool;
 	std::shared_ptr<VWrap::CommandPool> m_transfer_command_pool;
@@ -125,6 +145,16 @@ private:
 	std::shared_ptr<VWrap::Queue> m_present_queue;
 	std::shared_ptr<VWrap::Queue> m_transfer_queue;
 
+	/// <summary>
+	/// Uploads buffers on the transfer queue. Each frame acquires what it has uploaded since the last one.
+	/// </summary>
+	std::shared_ptr<UploadService> m_upload_service;
+
+	/// <summary>
+	/// Stages small uploads in persistently mapped memory, reclaimed as the frames that used it finish.
+	/// </summary>
+	std::shared_ptr<StagingRing> m_staging_ring;
+
 	// RENDER PASS
 	std::shared_ptr<VWrap::RenderPass> m_render_pass;
 	std::vector<std::shared_ptr<VWrap::Framebuffer>> m_framebuffers;
@@ -146,6 +176,11 @@ private:
 	/// </summary>
 	std::shared_ptr<GPUProfiler> m_gpu_profiler;
 
+	/// <summary>
+	/// Scales the tracer's render size to keep the GPU time of a frame at the target.
+	/// </summary>
+	std::shared_ptr<ResolutionController> m_resolution_controller;
+
 	/// <summary>
 	/// The camera used to view the scene.
 	/// </summary>
@@ -166,10 +201,11 @@ private:
 		}
 	};
 
-	struct AppState {
+	/// <summary>
+	/// The settings edited through the GUI, and the window state.
+	/// </summary>
+	struct AppState : GUISettings {
 		bool focused = true;
-		float sensitivity = 0.5f;
-		float speed = 5.0f;
 	};
 	AppState m_app_state;
 
@@ -183,6 +219,11 @@ public:
 	/// </summary>
 	void Run();
 
+	/// <summary>
+	/// Creates the window, hidden, and the vulkan objects, then runs GPUVoxelizer::RunTests on the graphics queue. Handles cleanup.
+	/// </summary>
+	void TestGPUVoxelizer();
+
 private:
 	/// <summary>
 	/// Callback function for when the window is resized. Notifies the frame controller to resize.
@@ -0,0 +1,444 @@
+#include "BrickPool.h"
+
+std::shared_ptr<BrickPool> BrickPool::Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::CommandPool> command_pool, std::shared_ptr<UploadService> upload_service, std::shared_ptr<VWrap::RetirementQueue> retirement_queue, size_t capacity_voxels, VkDeviceSize upload_budget, bool use_materials, uint32_t num_frames) {
+	auto ret = std::make_shared<BrickPool>();
+	ret->m_device = device;
+	ret->m_allocator = allocator;
+	ret->m_command_pool = command_pool;
+	ret->m_upload_service = upload_service;
+	ret->m_retirement_queue = retirement_queue;
+	ret->m_capacity_voxels = capacity_voxels;
+	ret->m_upload_budget = upload_budget;
+	ret->m_use_materials = use_materials;
+	ret->m_feedback_buffers.resize(num_frames);
+	ret->m_feedback_data.resize(num_frames);
+	ret->m_staging_buffers.resize(num_frames);
+	ret->m_staging_data.resize(num_frames);
+	return ret;
+}
+
+uint32_t BrickPool::GetLevelCount(uint32_t brick_size) {
+	uint32_t levels = 0;
+	while ((brick_size >> levels) >= 2) levels++;
+	return levels;
+}
+
+void BrickPool::PackOccupancy(const uint8_t* voxels, uint32_t brick_size, uint32_t* words) {
+	uint32_t level_count = GetLevelCount(brick_size);
+	uint32_t total_words = 0;
+	for (uint32_t level = 0; level < level_count; level++)
+		total_words += GetLevelWords(brick_size >> level);
+	memset(words, 0, total_words * sizeof(uint32_t));
+
+	size_t voxel_count = (size_t)brick_size * brick_size * brick_size;
+	for (size_t i = 0; i < voxel_count; i++) {
+		if (voxels[i] != 0)
+			words[i >> 5] |= 1u << (i & 31);
+	}
+
+	// Each coarser level ORs together 2x2x2 cells of the level below it
+	uint32_t* fine = words;
+	for (uint32_t level = 1; level < level_count; level++) {
+		uint32_t fine_side = brick_size >> (level - 1);
+		uint32_t side = brick_size >> level;
+		uint32_t* coarse = fine + GetLevelWords(fine_side);
+
+		for (uint32_t z = 0; z < fine_side; z++)
+		for (uint32_t y = 0; y < fine_side; y++)
+		for (uint32_t x = 0; x < fine_side; x++) {
+			uint32_t i = (z * fine_side + y) * fine_side + x;
+			if ((fine[i >> 5] & (1u << (i & 31))) == 0) continue;
+
+			uint32_t c = ((z >> 1) * side + (y >> 1)) * side + (x >> 1);
+			coarse[c >> 5] |= 1u << (c & 31);
+		}
+		fine = coarse;
+	}
+}
+
+void BrickPool::SetOctree(std::shared_ptr<Octree> octree, bool pinned) {
+	m_streamer = nullptr;
+	Reset(octree, octree->GetBrickCount(), pinned);
+}
+
+void BrickPool::SetStreamer(std::shared_ptr<BrickStreamer> streamer) {
+	m_streamer = streamer;
+	Reset(streamer->GetOctree(), streamer->GetBrickCount(), false);
+}
+
+void BrickPool::Reset(std::shared_ptr<Octree> octree, uint32_t brick_count, bool pinned) {
+	m_octree = octree;
+	m_brick_count = brick_count;
+	m_pinned = pinned;
+
+	uint32_t brick_size = octree->GetBrickSize();
+	if (brick_size < 4 || (brick_size & (brick_size - 1)) != 0) {
+		throw std::runtime_error("Brick size must be a power of two of at least 4 to build occupancy levels!");
+	}
+	if (octree->GetBrickVoxelCount() > m_capacity_voxels) {
+		throw std::runtime_error("Brick size is larger than the brick pool!");
+	}
+
+	if (octree->GetBrickSize() != m_brick_size) {
+		m_brick_size = octree->GetBrickSize();
+		m_capacity = static_cast<uint32_t>(m_capacity_voxels / octree->GetBrickVoxelCount());
+		m_level_count = GetLevelCount(m_brick_size);
+		m_slot_words = 0;
+		for (uint32_t level = 0; level < m_level_count; level++)
+			m_slot_words += GetLevelWords(m_brick_size >> level);
+		CreateSlotBuffers();
+		CreateStagingBuffers();
+	}
+
+	if (pinned && brick_count > m_capacity) {
+		throw std::runtime_error("Pinned octree has more bricks than the brick pool has slots!");
+	}
+
+	// Every slot starts out free, in LRU order
+	uint32_t capacity = GetCapacity();
+	m_slot_bricks.assign(capacity, NON_RESIDENT);
+	m_slot_last_used.assign(capacity, 0);
+	m_lru.clear();
+	m_lru_positions.resize(capacity);
+	for (uint32_t slot = 0; slot < capacity; slot++)
+		m_lru_positions[slot] = m_lru.insert(m_lru.end(), slot);
+
+	m_requests.clear();
+	m_requested.assign(brick_count, false);
+	m_dirty_bricks.clear();
+	m_dirty.assign(brick_count, false);
+	m_stats = {};
+	m_page_table.assign(std::max(brick_count, 1u), NON_RESIDENT);
+
+	// Pinned bricks live in the slot matching their index for as long as the octree is loaded. Since they are
+	// always resident, the tracer never requests them and nothing is ever uploaded over them.
+	if (m_pinned) {
+		for (uint32_t brick = 0; brick < m_brick_count; brick++) {
+			m_page_table[brick] = brick;
+			m_slot_bricks[brick] = brick;
+		}
+		m_stats.resident = m_brick_count;
+	}
+
+	CreateBrickBuffers();
+}
+
+void BrickPool::CreateSlotBuffers() {
+	m_retirement_queue->Retire(m_occupancy_buffer);
+	m_retirement_queue->Retire(m_material_buffer);
+
+	// Slots are only ever read after a brick has been copied or voxelized into them, so their initial contents do not matter
+	m_occupancy_buffer = VWrap::Buffer::Create(m_allocator,
+		m_capacity * GetOccupancyBytes(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+
+	m_material_buffer = VWrap::Buffer::Create(m_allocator,
+		m_use_materials ? m_capacity * GetMaterialBytes() : sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+}
+
+void BrickPool::CreateBrickBuffers() {
+	uint32_t brick_count = std::max(m_brick_count, 1u);
+
+	// Frames in flight still read the old octree's page table and write its feedback
+	m_retirement_queue->Retire(m_page_table_buffer);
+	m_retirement_queue->Retire(m_feedback_buffers);
+	m_upload_service->UploadBuffer(m_page_table_buffer,
+		m_page_table.data(),
+		m_page_table.size() * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+	for (size_t i = 0; i < m_feedback_buffers.size(); i++) {
+		void* data;
+		m_feedback_buffers[i] = VWrap::Buffer::CreateMapped(m_allocator,
+			brick_count * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			data,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+		m_feedback_data[i] = static_cast<uint32_t*>(data);
+		memset(data, 0, brick_count * sizeof(uint32_t));
+	}
+}
+
+void BrickPool::CreateStagingBuffers() {
+	VkDeviceSize brick_bytes = GetOccupancyBytes() + GetMaterialBytes();
+	m_max_uploads = static_cast<uint32_t>(std::max<VkDeviceSize>(m_upload_budget / brick_bytes, 1));
+
+	// Room for the occupancy and materials of each brick, followed by up to two page table entries per upload (the new brick and the one it evicts)
+	VkDeviceSize staging_size = m_max_uploads * brick_bytes + m_max_uploads * 2 * sizeof(uint32_t);
+	m_retirement_queue->Retire(m_staging_buffers);
+
+	for (size_t i = 0; i < m_staging_buffers.size(); i++) {
+		void* data;
+		m_staging_buffers[i] = VWrap::Buffer::CreateMapped(m_allocator,
+			staging_size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			data);
+		m_staging_data[i] = static_cast<uint8_t*>(data);
+	}
+}
+
+void BrickPool::Touch(uint32_t slot) {
+	m_slot_last_used[slot] = m_frame_counter;
+	m_lru.splice(m_lru.begin(), m_lru, m_lru_positions[slot]);
+}
+
+uint32_t BrickPool::FillRegion(glm::uvec3 min, glm::uvec3 max, uint8_t value, std::vector<glm::uvec3>* changed_bricks) {
+	// Streamed bricks are read-only: the host only holds the ones in flight
+	if (m_streamer)
+		return 0;
+
+	uint32_t size = m_octree->GetSize();
+	if (min.x >= size || min.y >= size || min.z >= size)
+		return 0;
+	max = glm::min(max, glm::uvec3(size - 1));
+
+	// Only the bricks overlapping the box are visited, so the cost follows the edit, not the volume
+	uint32_t changed = 0;
+	glm::uvec3 brick_min = min / m_brick_size;
+	glm::uvec3 brick_max = max / m_brick_size;
+	for (uint32_t bz = brick_min.z; bz <= brick_max.z; bz++)
+	for (uint32_t by = brick_min.y; by <= brick_max.y; by++)
+	for (uint32_t bx = brick_min.x; bx <= brick_max.x; bx++) {
+		glm::uvec3 coord(bx, by, bz);
+		uint32_t brick;
+		if (!m_octree->FindBrick(coord, brick))
+			continue;
+
+		glm::uvec3 lo = glm::max(min, coord * m_brick_size) - coord * m_brick_size;
+		glm::uvec3 hi = glm::min(max, coord * m_brick_size + (m_brick_size - 1)) - coord * m_brick_size;
+
+		const uint8_t* voxels = m_octree->GetBrick(brick);
+		bool dirty = false;
+		for (uint32_t z = lo.z; z <= hi.z && !dirty; z++)
+		for (uint32_t y = lo.y; y <= hi.y && !dirty; y++) {
+			const uint8_t* row = voxels + (z * m_brick_size + y) * m_brick_size;
+			for (uint32_t x = lo.x; x <= hi.x; x++)
+				dirty |= row[x] != value;
+		}
+		if (!dirty)
+			continue;
+
+		// In a DAG the brick may be shared with other leaves, which must keep their voxels, so this leaf is given its own copy
+		m_octree->UnshareBrick(coord, brick);
+		uint8_t* edited = m_octree->GetBrick(brick);
+		for (uint32_t z = lo.z; z <= hi.z; z++)
+		for (uint32_t y = lo.y; y <= hi.y; y++)
+			memset(edited + (z * m_brick_size + y) * m_brick_size + lo.x, value, hi.x - lo.x + 1);
+
+		MarkDirty(brick);
+		changed++;
+		if (changed_bricks)
+			changed_bricks->push_back(coord);
+	}
+
+	// Copied bricks start out non-resident, and are paged in when the tracer next touches them
+	if (m_octree->GetBrickCount() > m_brick_count) {
+		m_brick_count = m_octree->GetBrickCount();
+		m_requested.resize(m_brick_count, false);
+		m_dirty.resize(m_brick_count, false);
+		m_page_table.resize(m_brick_count, NON_RESIDENT);
+		CreateBrickBuffers();
+	}
+	return changed;
+}
+
+void BrickPool::MarkDirty(uint32_t brick) {
+	// Bricks that are not resident pick up the edit when they are next paged in
+	if (m_page_table[brick] == NON_RESIDENT || m_dirty[brick])
+		return;
+	m_dirty[brick] = true;
+	m_dirty_bricks.push_back(brick);
+}
+
+void BrickPool::CmdUpdate(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame) {
+	m_frame_counter++;
+	m_stats.hits = 0;
+	m_stats.misses = 0;
+	m_stats.evictions = 0;
+	m_stats.edits = 0;
+	m_stats.stream_bytes = 0;
+
+	// Consume the bricks the tracer touched the last time this frame ran
+	std::vector<uint32_t> misses;
+	uint32_t* feedback = m_feedback_data[frame];
+	for (uint32_t brick = 0; brick < m_brick_count; brick++) {
+		if (feedback[brick] == 0) continue;
+		feedback[brick] = 0;
+
+		uint32_t slot = m_page_table[brick];
+		if (slot != NON_RESIDENT) {
+			Touch(slot);
+			m_stats.hits++;
+		}
+		else {
+			m_stats.misses++;
+			if (m_streamer) {
+				misses.push_back(brick);
+			}
+			else if (!m_requested[brick]) {
+				m_requested[brick] = true;
+				m_requests.push_back(brick);
+			}
+		}
+	}
+
+	// Stage the requested bricks, taking slots from the back of the LRU list
+	VkDeviceSize occupancy_bytes = GetOccupancyBytes();
+	VkDeviceSize material_bytes = GetMaterialBytes();
+	VkDeviceSize materials_offset = m_max_uploads * occupancy_bytes;
+	VkDeviceSize entries_offset = materials_offset + m_max_uploads * material_bytes;
+	uint32_t* staged_entries = reinterpret_cast<uint32_t*>(m_staging_data[frame] + entries_offset);
+
+	std::vector<VkBufferCopy> occupancy_copies;
+	std::vector<VkBufferCopy> material_copies;
+	std::vector<VkBufferCopy> page_table_copies;
+
+	auto stage_page_table_entry = [&](uint32_t brick) {
+		uint32_t index = static_cast<uint32_t>(page_table_copies.size());
+		staged_entries[index] = m_page_table[brick];
+
+		VkBufferCopy copy{};
+		copy.srcOffset = entries_offset + index * sizeof(uint32_t);
+		copy.dstOffset = brick * sizeof(uint32_t);
+		copy.size = sizeof(uint32_t);
+		page_table_copies.push_back(copy);
+	};
+
+	// Stages a brick's occupancy and voxels in the next staging slot and records their copies into the given pool slot.
+	// The occupancy is packed from the voxels unless it is already given.
+	auto stage_brick = [&](const uint8_t* voxels, const uint32_t* occupancy, uint32_t slot) {
+		uint32_t upload = static_cast<uint32_t>(occupancy_copies.size());
+		uint32_t* staged_occupancy = reinterpret_cast<uint32_t*>(m_staging_data[frame] + upload * occupancy_bytes);
+		if (occupancy)
+			memcpy(staged_occupancy, occupancy, occupancy_bytes);
+		else
+			PackOccupancy(voxels, m_brick_size, staged_occupancy);
+
+		VkBufferCopy copy{};
+		copy.srcOffset = upload * occupancy_bytes;
+		copy.dstOffset = slot * occupancy_bytes;
+		copy.size = occupancy_bytes;
+		occupancy_copies.push_back(copy);
+
+		if (m_use_materials) {
+			memcpy(m_staging_data[frame] + materials_offset + upload * material_bytes, voxels, material_bytes);
+
+			copy.srcOffset = materials_offset + upload * material_bytes;
+			copy.dstOffset = slot * material_bytes;
+			copy.size = material_bytes;
+			material_copies.push_back(copy);
+		}
+	};
+
+	// Re-upload edited bricks in place. Ones evicted since their edit are simply dropped, as they are re-read from the octree when paged in.
+	while (!m_dirty_bricks.empty() && occupancy_copies.size() < m_max_uploads) {
+		uint32_t brick = m_dirty_bricks.front();
+		m_dirty_bricks.pop_front();
+		m_dirty[brick] = false;
+
+		uint32_t slot = m_page_table[brick];
+		if (slot == NON_RESIDENT)
+			continue;
+
+		stage_brick(m_octree->GetBrick(brick), nullptr, slot);
+		m_stats.edits++;
+	}
+
+	// Takes the least recently used slot for a new brick, evicting the brick it holds. Fails if every slot was touched this frame,
+	// since the frame still needs them.
+	auto allocate_slot = [&](uint32_t& slot) {
+		slot = m_lru.back();
+		if (m_slot_last_used[slot] == m_frame_counter)
+			return false;
+
+		uint32_t evicted = m_slot_bricks[slot];
+		if (evicted != NON_RESIDENT) {
+			m_page_table[evicted] = NON_RESIDENT;
+			stage_page_table_entry(evicted);
+			if (m_streamer)
+				m_streamer->Evict(evicted);
+			m_stats.evictions++;
+		}
+		else {
+			m_stats.resident++;
+		}
+		return true;
+	};
+
+	auto map_brick = [&](uint32_t brick, uint32_t slot) {
+		m_slot_bricks[slot] = brick;
+		m_page_table[brick] = slot;
+		stage_page_table_entry(brick);
+		Touch(slot);
+	};
+
+	if (m_streamer) {
+		// Streamed bricks arrive already packed, as workers finish reading them
+		m_streamer->Update(misses);
+
+		std::vector<StreamedBrick> streamed;
+		m_streamer->TakeReady(m_max_uploads - occupancy_copies.size(), streamed);
+		for (const StreamedBrick& brick : streamed) {
+			uint32_t slot;
+			if (!allocate_slot(slot)) {
+				m_streamer->Evict(brick.brick);
+				continue;
+			}
+			stage_brick(brick.voxels.data(), brick.occupancy.data(), slot);
+			map_brick(brick.brick, slot);
+			m_stats.stream_bytes += static_cast<uint32_t>(occupancy_bytes + material_bytes);
+		}
+
+		BrickStreamerStats stream_stats = m_streamer->GetStats();
+		m_stats.stream_queue = stream_stats.queued + stream_stats.ready;
+	}
+
+	uint32_t slot;
+	while (!m_requests.empty() && occupancy_copies.size() < m_max_uploads && allocate_slot(slot)) {
+		uint32_t brick = m_requests.front();
+		m_requests.pop_front();
+		m_requested[brick] = false;
+
+		stage_brick(m_octree->GetBrick(brick), nullptr, slot);
+		map_brick(brick, slot);
+	}
+
+	if (occupancy_copies.empty() && page_table_copies.empty())
+		return;
+
+	// Earlier frames may still be reading the slots and entries being replaced, from the fragment or compute tracer.
+	// A single global barrier covers the occupancy, material and page table buffers.
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(command_buffer->Get(),
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+
+	if (!occupancy_copies.empty())
+		vkCmdCopyBuffer(command_buffer->Get(), m_staging_buffers[frame]->Get(), m_occupancy_buffer->Get(), static_cast<uint32_t>(occupancy_copies.size()), occupancy_copies.data());
+	if (!material_copies.empty())
+		vkCmdCopyBuffer(command_buffer->Get(), m_staging_buffers[frame]->Get(), m_material_buffer->Get(), static_cast<uint32_t>(material_copies.size()), material_copies.data());
+	if (!page_table_copies.empty())
+		vkCmdCopyBuffer(command_buffer->Get(), m_staging_buffers[frame]->Get(), m_page_table_buffer->Get(), static_cast<uint32_t>(page_table_copies.size()), page_table_copies.data());
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(command_buffer->Get(),
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+}
@@ -0,0 +1,297 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include "Device.h"
+#include "Allocator.h"
+#include "Buffer.h"
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+
+#include "UploadService.h"
+#include "RetirementQueue.h"
+
+#include "Octree.h"
+#include "BrickStreamer.h"
+
+#include <memory>
+#include <vector>
+#include <list>
+#include <deque>
+#include <algorithm>
+
+/// <summary>
+/// Counters describing the brick pool's residency over one frame.
+/// </summary>
+struct BrickPoolStats {
+
+	/// <summary> Bricks touched by the tracer that were resident. </summary>
+	uint32_t hits;
+
+	/// <summary> Bricks touched by the tracer that were not resident. </summary>
+	uint32_t misses;
+
+	/// <summary> Resident bricks evicted to make room for requested ones. </summary>
+	uint32_t evictions;
+
+	/// <summary> Bricks resident at the end of the frame. </summary>
+	uint32_t resident;
+
+	/// <summary> Resident bricks re-uploaded because their voxels were edited. </summary>
+	uint32_t edits;
+
+	/// <summary> Bricks queued in the streamer, waiting to be read or uploaded. </summary>
+	uint32_t stream_queue;
+
+	/// <summary> Bytes of streamed bricks uploaded in the frame. </summary>
+	uint32_t stream_bytes;
+};
+
+/// <summary>
+/// A fixed-size pool of brick slots, plus a page table that maps octree bricks to slots.
+/// Each slot stores the brick's occupancy at 1 bit per voxel, packed into uint words in x-major voxel order,
+/// followed by a pyramid of coarser occupancy levels (a bit per 2^3, 4^3, ... voxel block, down to 2^3 cells) that lets the tracer skip empty space.
+/// Voxel values (materials) live in a separate, optional stream of 1 byte per voxel.
+/// The tracer reports which bricks it touched through a feedback buffer; missing bricks are uploaded each frame,
+/// evicting the least recently used slots once the pool is full. VRAM use is bounded by the pool size, not the octree.
+/// Voxels can be edited in place; only the resident bricks an edit touched are re-uploaded, batched with the frame's other uploads.
+/// </summary>
+class BrickPool
+{
+private:
+
+	// DEVICE RESOURCES
+	std::shared_ptr<VWrap::Device> m_device;
+	std::shared_ptr<VWrap::Allocator> m_allocator;
+	std::shared_ptr<VWrap::CommandPool> m_command_pool;
+	std::shared_ptr<UploadService> m_upload_service;
+
+	/// <summary> Holds the buffers replaced by a new octree until the frames still reading them have finished. </summary>
+	std::shared_ptr<VWrap::RetirementQueue> m_retirement_queue;
+
+	/// <summary> The packed occupancy bits of every slot. </summary>
+	std::shared_ptr<VWrap::Buffer> m_occupancy_buffer;
+
+	/// <summary> The voxel values of every slot, 1 byte per voxel. A single placeholder word if materials are disabled. </summary>
+	std::shared_ptr<VWrap::Buffer> m_material_buffer;
+
+	/// <summary> The number of voxels the pool can hold. Fixed for the lifetime of the pool. </summary>
+	size_t m_capacity_voxels = 0;
+
+	/// <summary> Whether the material stream is stored and uploaded. </summary>
+	bool m_use_materials = false;
+
+	/// <summary> The width of a brick, in voxels. </summary>
+	uint32_t m_brick_size = 0;
+
+	/// <summary> The number of brick slots. </summary>
+	uint32_t m_capacity = 0;
+
+	/// <summary> The number of occupancy levels per slot, including the full-resolution one. </summary>
+	uint32_t m_level_count = 0;
+
+	/// <summary> The number of occupancy words per slot, across all levels. </summary>
+	uint32_t m_slot_words = 0;
+
+	/// <summary> The octree whose bricks are paged in. When streaming, holds only the nodes. </summary>
+	std::shared_ptr<Octree> m_octree;
+
+	/// <summary> The number of bricks in the octree. </summary>
+	uint32_t m_brick_count = 0;
+
+	/// <summary> Reads bricks from disk when set, in place of the octree's bricks. </summary>
+	std::shared_ptr<BrickStreamer> m_streamer;
+
+	/// <summary> Whether every brick of the octree is pinned to the slot matching its index. </summary>
+	bool m_pinned = false;
+
+	// PAGE TABLE
+	/// <summary> Maps each brick of the octree to its slot, or NON_RESIDENT. Read by the tracer. </summary>
+	std::shared_ptr<VWrap::Buffer> m_page_table_buffer;
+
+	/// <summary> The host copy of the page table. </summary>
+	std::vector<uint32_t> m_page_table;
+
+	/// <summary> The brick held by each slot, or NON_RESIDENT if the slot is free. </summary>
+	std::vector<uint32_t> m_slot_bricks;
+
+	/// <summary> The frame in which each slot was last touched. </summary>
+	std::vector<uint64_t> m_slot_last_used;
+
+	/// <summary> Every slot, most recently used first. Free slots sit at the back. </summary>
+	std::list<uint32_t> m_lru;
+
+	/// <summary> The position of each slot in m_lru. </summary>
+	std::vector<std::list<uint32_t>::iterator> m_lru_positions;
+
+	// REQUESTS
+	/// <summary> Bricks that were touched while not resident, in the order they were first requested. </summary>
+	std::deque<uint32_t> m_requests;
+
+	/// <summary> Whether each brick is currently in m_requests. </summary>
+	std::vector<bool> m_requested;
+
+	// EDITS
+	/// <summary> Bricks whose voxels changed since they were last uploaded, in the order they were first edited. </summary>
+	std::deque<uint32_t> m_dirty_bricks;
+
+	/// <summary> Whether each brick is currently in m_dirty_bricks. </summary>
+	std::vector<bool> m_dirty;
+
+	// PER-FRAME RESOURCES
+	/// <summary> One flag per brick, set by the tracer when it touches the brick. One host-visible buffer per frame in flight. </summary>
+	std::vector<std::shared_ptr<VWrap::Buffer>> m_feedback_buffers;
+	std::vector<uint32_t*> m_feedback_data;
+
+	/// <summary> Persistently mapped staging memory for brick and page table uploads. One buffer per frame in flight. </summary>
+	std::vector<std::shared_ptr<VWrap::Buffer>> m_staging_buffers;
+	std::vector<uint8_t*> m_staging_data;
+
+	/// <summary> The maximum number of bytes of brick data uploaded per frame. </summary>
+	VkDeviceSize m_upload_budget = 0;
+
+	/// <summary> The maximum number of bricks uploaded per frame. </summary>
+	uint32_t m_max_uploads = 0;
+
+	/// <summary> Incremented once per update, used to timestamp slot use. </summary>
+	uint64_t m_frame_counter = 0;
+
+	/// <summary> The counters of the most recent update. </summary>
+	BrickPoolStats m_stats{};
+
+	/// <summary>
+	/// Evicts everything and sizes the pool's resources for the given octree.
+	/// </summary>
+	void Reset(std::shared_ptr<Octree> octree, uint32_t brick_count, bool pinned);
+
+	/// <summary>
+	/// Creates the occupancy and material buffers for the current brick size.
+	/// </summary>
+	void CreateSlotBuffers();
+
+	/// <summary>
+	/// Creates the page table and feedback buffers for the current octree, uploading the host copy of the page table.
+	/// </summary>
+	void CreateBrickBuffers();
+
+	/// <summary>
+	/// Creates the per-frame staging buffers for the current brick size.
+	/// </summary>
+	void CreateStagingBuffers();
+
+	/// <summary>
+	/// Marks a slot as used in the current frame, moving it to the front of the LRU list.
+	/// </summary>
+	void Touch(uint32_t slot);
+
+	/// <summary> Gets the size of one slot's occupancy, in bytes. </summary>
+	VkDeviceSize GetOccupancyBytes() const { return (VkDeviceSize)m_slot_words * sizeof(uint32_t); }
+
+	/// <summary> Gets the size of one slot's materials, in bytes. </summary>
+	VkDeviceSize GetMaterialBytes() const { return m_use_materials ? (VkDeviceSize)m_brick_size * m_brick_size * m_brick_size : 0; }
+
+public:
+
+	/// <summary> Page table value for bricks that are not in the pool. </summary>
+	static constexpr uint32_t NON_RESIDENT = 0xFFFFFFFFu;
+
+	/// <summary>
+	/// Creates a brick pool that holds up to the given number of voxels.
+	/// </summary>
+	/// <param name="upload_service"> Uploads the page table on the transfer queue. </param>
+	/// <param name="retirement_queue"> Holds replaced buffers until the frames in flight are done with them. </param>
+	/// <param name="capacity_voxels"> The number of voxels the pool can hold, across all slots. </param>
+	/// <param name="upload_budget"> The maximum number of bytes of brick data uploaded per frame. </param>
+	/// <param name="use_materials"> Whether to store voxel values alongside occupancy. </param>
+	/// <param name="num_frames"> The number of frames in flight. </param>
+	static std::shared_ptr<BrickPool> Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::CommandPool> command_pool, std::shared_ptr<UploadService> upload_service, std::shared_ptr<VWrap::RetirementQueue> retirement_queue, size_t capacity_voxels, VkDeviceSize upload_budget, bool use_materials, uint32_t num_frames);
+
+	/// <summary>
+	/// Gets the number of occupancy levels of a brick: one per power of two from brick_size down to 2.
+	/// </summary>
+	static uint32_t GetLevelCount(uint32_t brick_size);
+
+	/// <summary>
+	/// Gets the number of words holding one occupancy level of the given width. Each level starts on a word boundary.
+	/// </summary>
+	static uint32_t GetLevelWords(uint32_t side) { return (side * side * side + 31) / 32; }
+
+	/// <summary>
+	/// Packs a brick's voxels into occupancy words, 1 bit per non-empty voxel, followed by its coarser levels.
+	/// A cell of a coarser level is set if any of the 2^3 cells it covers in the level below is set.
+	/// </summary>
+	/// <param name="words"> Receives GetLevelWords summed over all levels of the brick. </param>
+	static void PackOccupancy(const uint8_t* voxels, uint32_t brick_size, uint32_t* words);
+
+	/// <summary>
+	/// Pages bricks from a new octree, evicting everything. Recreates the page table and feedback buffers,
+	/// and the slot buffers only if the brick size changed. The replaced buffers are retired until the frames in flight have finished with them.
+	/// </summary>
+	/// <param name="pinned"> If set, brick i is made resident in slot i and never uploaded or evicted, so the slots can be written
+	/// directly on the GPU instead. The octree must not have more bricks than the pool has slots. </param>
+	void SetOctree(std::shared_ptr<Octree> octree, bool pinned = false);
+
+	/// <summary>
+	/// Pages bricks from a streamer instead of from an octree in memory, evicting everything. The streamer's octree holds only the nodes,
+	/// and bricks are requested from it as the tracer misses them. Edits are not supported. Retires the replaced buffers as SetOctree does.
+	/// </summary>
+	void SetStreamer(std::shared_ptr<BrickStreamer> streamer);
+
+	/// <summary>
+	/// Sets every voxel in the box from min to max, inclusive, to the given value. A value of 0 clears them.
+	/// The octree's structure is fixed, so voxels in octants that have no brick are left empty. In a DAG, an edited brick that other leaves share
+	/// is first copied (see Octree::UnshareBrick), which adds nodes and bricks to the octree and recreates the page table and feedback buffers.
+	/// </summary>
+	/// <param name="changed_bricks"> If set, receives the coordinates of the bricks that changed. </param>
+	/// <returns> The number of bricks that changed. </returns>
+	uint32_t FillRegion(glm::uvec3 min, glm::uvec3 max, uint8_t value, std::vector<glm::uvec3>* changed_bricks = nullptr);
+
+	/// <summary> Sets a single voxel. See FillRegion. </summary>
+	uint32_t SetVoxel(glm::uvec3 voxel, uint8_t value) { return FillRegion(voxel, voxel, value); }
+
+	/// <summary> Clears every voxel in the box from min to max, inclusive. See FillRegion. </summary>
+	uint32_t ClearRegion(glm::uvec3 min, glm::uvec3 max) { return FillRegion(min, max, 0); }
+
+	/// <summary>
+	/// Marks a brick whose voxels were changed in the octree, so its resident copy is re-uploaded by the next updates.
+	/// </summary>
+	void MarkDirty(uint32_t brick);
+
+	/// <summary>
+	/// Reads the feedback the given frame wrote the last time it ran, and records the uploads of edited and missing bricks to the command buffer.
+	/// Edited bricks are uploaded first; both share the per-frame upload budget.
+	/// Must be called after the frame's fence has been waited on, and outside of a render pass.
+	/// </summary>
+	void CmdUpdate(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame);
+
+	/// <summary> Gets the occupancy buffer. </summary>
+	std::shared_ptr<VWrap::Buffer> GetOccupancyBuffer() const { return m_occupancy_buffer; }
+
+	/// <summary> Gets the material buffer. </summary>
+	std::shared_ptr<VWrap::Buffer> GetMaterialBuffer() const { return m_material_buffer; }
+
+	/// <summary> Gets the width of a brick, in voxels. </summary>
+	uint32_t GetBrickSize() const { return m_brick_size; }
+
+	/// <summary> Whether the material stream is stored. </summary>
+	bool UsesMaterials() const { return m_use_materials; }
+
+	/// <summary> Gets the number of occupancy levels per slot. </summary>
+	uint32_t GetLevelCount() const { return m_level_count; }
+
+	/// <summary> Gets the number of occupancy words per slot, across all levels. </summary>
+	uint32_t GetSlotWords() const { return m_slot_words; }
+
+	/// <summary> Gets the total device memory used by the slots, in bytes. </summary>
+	VkDeviceSize GetPoolBytes() const { return m_capacity * (GetOccupancyBytes() + GetMaterialBytes()); }
+
+	/// <summary> Gets the page table buffer. </summary>
+	std::shared_ptr<VWrap::Buffer> GetPageTableBuffer() const { return m_page_table_buffer; }
+
+	/// <summary> Gets the feedback buffer for the given frame. </summary>
+	std::shared_ptr<VWrap::Buffer> GetFeedbackBuffer(uint32_t frame) const { return m_feedback_buffers[frame]; }
+
+	/// <summary> Gets the number of brick slots. </summary>
+	uint32_t GetCapacity() const { return m_capacity; }
+
+	/// <summary> Gets the counters of the most recent update. </summary>
+	BrickPoolStats GetStats() const { return m_stats; }
+};
@@ -0,0 +1,189 @@
+#include "BrickStreamer.h"
+#include "BrickPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::shared_ptr<BrickStreamer> BrickStreamer::Create(std::shared_ptr<OctreeFile> file, uint32_t thread_count, size_t max_ready) {
+	auto ret = std::make_shared<BrickStreamer>();
+	ret->m_file = file;
+	ret->m_max_ready = std::max<size_t>(max_ready, 1);
+
+	const OctreeFileHeader& header = file->GetHeader();
+	size_t brick_voxels = (size_t)header.brick_size * header.brick_size * header.brick_size;
+	ret->m_brick_count = static_cast<uint32_t>(header.brick_bytes / brick_voxels);
+	ret->m_states.assign(ret->m_brick_count, BrickState::IDLE);
+
+	// Nodes are small next to the bricks they index, so they are loaded whole
+	const OctreeNode* nodes = file->GetNodes();
+	ret->m_octree = Octree::CreateFromData(header.brick_size, header.depth, std::vector<OctreeNode>(nodes, nodes + header.node_count), {});
+
+	for (uint32_t i = 0; i < std::max(thread_count, 1u); i++)
+		ret->m_workers.emplace_back(&BrickStreamer::WorkerLoop, ret.get());
+
+	return ret;
+}
+
+BrickStreamer::~BrickStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+void BrickStreamer::WorkerLoop() {
+	const OctreeFileHeader& header = m_file->GetHeader();
+	uint32_t brick_size = header.brick_size;
+	size_t brick_voxels = (size_t)brick_size * brick_size * brick_size;
+
+	uint32_t occupancy_words = 0;
+	for (uint32_t level = 0; level < BrickPool::GetLevelCount(brick_size); level++)
+		occupancy_words += BrickPool::GetLevelWords(brick_size >> level);
+
+	while (true) {
+		uint32_t brick;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [&] { return m_stopping || (!m_pending.empty() && m_ready.size() + m_loading < m_max_ready); });
+			if (m_stopping)
+				return;
+
+			std::pop_heap(m_pending.begin(), m_pending.end());
+			brick = m_pending.back().brick;
+			m_pending.pop_back();
+			m_states[brick] = BrickState::LOADING;
+			m_loading++;
+		}
+
+		// Reading the mapping is what pulls the brick from disk
+		StreamedBrick streamed;
+		streamed.brick = brick;
+		const uint8_t* source = m_file->GetBricks() + (size_t)brick * brick_voxels;
+		streamed.voxels.assign(source, source + brick_voxels);
+		streamed.occupancy.resize(occupancy_words);
+		BrickPool::PackOccupancy(streamed.voxels.data(), brick_size, streamed.occupancy.data());
+		m_bytes_read.fetch_add(brick_voxels, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loading--;
+		m_states[brick] = BrickState::READY;
+		m_ready.push_back(std::move(streamed));
+	}
+}
+
+void BrickStreamer::SetCamera(glm::vec3 position, glm::vec3 forward, glm::vec3 velocity) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_camera_position = position;
+	m_camera_forward = forward;
+	m_camera_velocity = velocity;
+}
+
+void BrickStreamer::CollectPrefetches(std::vector<Request>& requests) const {
+	const auto& nodes = m_octree->GetNodes();
+	if (nodes.empty())
+		return;
+
+	glm::vec3 eye = m_camera_position + m_camera_velocity * PREFETCH_LOOKAHEAD;
+
+	struct Cell {
+		uint32_t node;
+		glm::vec3 min;
+		float size;
+	};
+	std::vector<Cell> stack = { { 0, glm::vec3(0.0f), 1.0f } };
+
+	while (!stack.empty()) {
+		Cell cell = stack.back();
+		stack.pop_back();
+
+		// The angle the cell subtends from the predicted eye, using the distance to its nearest point
+		glm::vec3 center = cell.min + cell.size * 0.5f;
+		glm::vec3 outside = glm::max(glm::abs(eye - center) - cell.size * 0.5f, glm::vec3(0.0f));
+		float distance = std::max(glm::length(outside), 1e-6f);
+		float projected = cell.size / distance;
+		if (distance > cell.size && glm::dot(center - eye, m_camera_forward) < 0.0f)
+			projected *= PREFETCH_BEHIND_WEIGHT;
+		if (projected < PREFETCH_MIN_SIZE)
+			continue;
+
+		const OctreeNode& node = nodes[cell.node];
+		if (node.header & Octree::LEAF_FLAG) {
+			uint32_t brick = static_cast<uint32_t>(node.data);
+			if (m_states[brick] == BrickState::IDLE)
+				requests.push_back({ projected, brick });
+			continue;
+		}
+
+		float half = cell.size * 0.5f;
+		uint32_t child = cell.node + node.data;
+		for (uint32_t octant = 0; octant < 8; octant++) {
+			if ((node.header & (1u << octant)) == 0)
+				continue;
+			glm::vec3 offset = glm::vec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1) * half;
+			stack.push_back({ child++, cell.min + offset, half });
+		}
+	}
+
+	// Keep only the largest prefetches
+	if (requests.size() > MAX_PREFETCHES) {
+		std::nth_element(requests.begin(), requests.begin() + MAX_PREFETCHES, requests.end(),
+			[](const Request& a, const Request& b) { return a.priority > b.priority; });
+		requests.resize(MAX_PREFETCHES);
+	}
+}
+
+void BrickStreamer::Update(const std::vector<uint32_t>& misses) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Drop the previous frame's requests that no worker has picked up yet
+	for (const Request& request : m_pending)
+		m_states[request.brick] = BrickState::IDLE;
+	m_pending.clear();
+
+	for (uint32_t brick : misses) {
+		if (m_states[brick] == BrickState::IDLE) {
+			m_pending.push_back({ VISIBLE_PRIORITY, brick });
+			m_states[brick] = BrickState::QUEUED;
+		}
+	}
+
+	// In a DAG, the walk can reach the same brick through several leaves
+	std::vector<Request> prefetches;
+	CollectPrefetches(prefetches);
+	for (const Request& request : prefetches) {
+		if (m_states[request.brick] == BrickState::IDLE) {
+			m_pending.push_back(request);
+			m_states[request.brick] = BrickState::QUEUED;
+		}
+	}
+
+	std::make_heap(m_pending.begin(), m_pending.end());
+	m_condition.notify_all();
+}
+
+void BrickStreamer::TakeReady(size_t max_count, std::vector<StreamedBrick>& bricks) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	size_t count = std::min(max_count, m_ready.size());
+	for (size_t i = 0; i < count; i++) {
+		m_states[m_ready[i].brick] = BrickState::RESIDENT;
+		bricks.push_back(std::move(m_ready[i]));
+	}
+	m_ready.erase(m_ready.begin(), m_ready.begin() + count);
+
+	if (count > 0)
+		m_condition.notify_all();
+}
+
+void BrickStreamer::Evict(uint32_t brick) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_states[brick] = BrickState::IDLE;
+}
+
+BrickStreamerStats BrickStreamer::GetStats() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return { static_cast<uint32_t>(m_pending.size()) + m_loading, static_cast<uint32_t>(m_ready.size()), m_bytes_read.load(std::memory_order_relaxed) };
+}
@@ -0,0 +1,179 @@
+#pragma once
+#include "Octree.h"
+#include "OctreeFile.h"
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+/// <summary>
+/// A brick read from disk and packed by a streaming worker, ready to be copied into the brick pool.
+/// </summary>
+struct StreamedBrick {
+
+	/// <summary> The index of the brick in the octree. </summary>
+	uint32_t brick;
+
+	/// <summary> The packed occupancy levels, as written by BrickPool::PackOccupancy. </summary>
+	std::vector<uint32_t> occupancy;
+
+	/// <summary> The voxel values, brick_size^3 bytes. </summary>
+	std::vector<uint8_t> voxels;
+};
+
+/// <summary>
+/// Counters describing the streamer's queues.
+/// </summary>
+struct BrickStreamerStats {
+
+	/// <summary> Bricks waiting to be read, or being read by a worker. </summary>
+	uint32_t queued;
+
+	/// <summary> Bricks read and packed, waiting for the brick pool to upload them. </summary>
+	uint32_t ready;
+
+	/// <summary> The total number of brick bytes read from disk. </summary>
+	uint64_t bytes_read;
+};
+
+/// <summary>
+/// Streams bricks from a memory-mapped octree file into the brick pool, so scenes need not fit in RAM or VRAM.
+/// Only the node section is loaded up front. Bricks are read from the mapping and packed on worker threads, in order of priority:
+/// first the bricks the tracer touched while they were missing, then bricks around where the camera will be, largest projected size first.
+/// The queue is rebuilt every frame, so requests for bricks the camera has moved away from are dropped before they are read.
+/// </summary>
+class BrickStreamer
+{
+private:
+
+	/// <summary> The state of each brick. A brick is in at most one queue at a time. </summary>
+	enum class BrickState : uint8_t {
+		IDLE, QUEUED, LOADING, READY, RESIDENT
+	};
+
+	/// <summary> A queued read, ordered by priority. </summary>
+	struct Request {
+		float priority;
+		uint32_t brick;
+		bool operator<(const Request& other) const { return priority < other.priority; }
+	};
+
+	/// <summary> The mapped file bricks are read from. </summary>
+	std::shared_ptr<OctreeFile> m_file;
+
+	/// <summary> The octree's nodes, with no bricks. Traced directly and walked to pick prefetch candidates. </summary>
+	std::shared_ptr<Octree> m_octree;
+
+	/// <summary> The number of bricks in the file. </summary>
+	uint32_t m_brick_count = 0;
+
+	// CAMERA
+	/// <summary> The camera's position, view direction and velocity, in octree space where the octree spans [0, 1]. </summary>
+	glm::vec3 m_camera_position = glm::vec3(0.0f);
+	glm::vec3 m_camera_forward = glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 m_camera_velocity = glm::vec3(0.0f);
+
+	// QUEUES
+	/// <summary> Guards every member below, except the byte counter. </summary>
+	std::mutex m_mutex;
+
+	/// <summary> Signalled when requests are queued, a ready slot frees up, or the workers must stop. </summary>
+	std::condition_variable m_condition;
+
+	/// <summary> The state of each brick. </summary>
+	std::vector<BrickState> m_states;
+
+	/// <summary> Pending reads, as a max-heap on priority. </summary>
+	std::vector<Request> m_pending;
+
+	/// <summary> The number of bricks currently being read by workers. </summary>
+	uint32_t m_loading = 0;
+
+	/// <summary> Bricks read and packed, in the order they finished. </summary>
+	std::vector<StreamedBrick> m_ready;
+
+	/// <summary> The maximum number of ready bricks held in RAM. Workers wait while the pool catches up. </summary>
+	size_t m_max_ready = 0;
+
+	/// <summary> Set to stop the workers. </summary>
+	bool m_stopping = false;
+
+	/// <summary> The total number of brick bytes read from disk. </summary>
+	std::atomic<uint64_t> m_bytes_read = 0;
+
+	std::vector<std::thread> m_workers;
+
+	/// <summary>
+	/// Reads and packs the highest priority pending brick, until stopped.
+	/// </summary>
+	void WorkerLoop();
+
+	/// <summary>
+	/// Walks the octree from the root, collecting unrequested bricks near the predicted camera position.
+	/// Subtrees whose projected size falls below the threshold are skipped whole.
+	/// </summary>
+	void CollectPrefetches(std::vector<Request>& requests) const;
+
+public:
+
+	/// <summary> The priority given to bricks the tracer touched while they were missing, above any prefetch. </summary>
+	static constexpr float VISIBLE_PRIORITY = 1e6f;
+
+	/// <summary> How far ahead of the camera prefetching looks, in seconds of its current velocity. </summary>
+	static constexpr float PREFETCH_LOOKAHEAD = 0.5f;
+
+	/// <summary> The smallest projected size, in radians, a brick must have to be prefetched. </summary>
+	static constexpr float PREFETCH_MIN_SIZE = 0.05f;
+
+	/// <summary> The weight applied to the projected size of subtrees behind the camera. </summary>
+	static constexpr float PREFETCH_BEHIND_WEIGHT = 0.25f;
+
+	/// <summary> The maximum number of prefetches queued per frame. </summary>
+	static constexpr size_t MAX_PREFETCHES = 1024;
+
+	/// <summary>
+	/// Creates a streamer for a mapped octree file, and starts its workers.
+	/// </summary>
+	/// <param name="thread_count"> The number of worker threads. </param>
+	/// <param name="max_ready"> The maximum number of read bricks held in RAM before the pool uploads them. </param>
+	static std::shared_ptr<BrickStreamer> Create(std::shared_ptr<OctreeFile> file, uint32_t thread_count, size_t max_ready);
+
+	~BrickStreamer();
+
+	/// <summary>
+	/// Sets the camera used to prioritize prefetches, in octree space where the octree spans [0, 1].
+	/// </summary>
+	void SetCamera(glm::vec3 position, glm::vec3 forward, glm::vec3 velocity);
+
+	/// <summary>
+	/// Replaces the pending reads with the given missing bricks, followed by prefetches around the predicted camera position.
+	/// Bricks that are already being read, ready or resident are skipped.
+	/// </summary>
+	void Update(const std::vector<uint32_t>& misses);
+
+	/// <summary>
+	/// Takes up to max_count read bricks, and marks them resident.
+	/// </summary>
+	void TakeReady(size_t max_count, std::vector<StreamedBrick>& bricks);
+
+	/// <summary>
+	/// Marks a brick as no longer resident, so it can be requested again.
+	/// </summary>
+	void Evict(uint32_t brick);
+
+	/// <summary> Gets the octree's nodes, with no bricks. </summary>
+	std::shared_ptr<Octree> GetOctree() const { return m_octree; }
+
+	/// <summary> Gets the number of bricks in the file. </summary>
+	uint32_t GetBrickCount() const { return m_brick_count; }
+
+	/// <summary> Gets the current queue lengths and the bytes read so far. </summary>
+	BrickStreamerStats GetStats();
+};
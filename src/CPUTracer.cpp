@@ -0,0 +1,668 @@
+#include "CPUTracer.h"
+#include "OctreeTracer.h"
+
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <bit>
+
+using namespace simd;
+
+namespace {
+
+	/// <summary> The width and height of a packet, in pixels. </summary>
+	constexpr uint32_t PACKET_WIDTH = 4;
+	constexpr uint32_t PACKET_HEIGHT = 2;
+	static_assert(PACKET_WIDTH * PACKET_HEIGHT == LANES);
+	static_assert(CPUTracer::TILE_SIZE % PACKET_WIDTH == 0 && CPUTracer::TILE_SIZE % PACKET_HEIGHT == 0);
+
+	/// <summary> The deepest octree the packet walk supports. Bounds its stack. </summary>
+	constexpr uint32_t MAX_DEPTH = 24;
+
+	/// <summary> The accumulated coverage at which prefiltered cells stop a ray, as in shader_tracer.frag. </summary>
+	constexpr float LOD_OPAQUE = 0.95f;
+
+	/// <summary> The number of frames averaged for each thread count by RunBenchmark, after one warm-up frame. </summary>
+	constexpr uint32_t BENCHMARK_FRAMES = 5;
+
+	/// <summary>
+	/// The background of rays that miss, as in missColor in shader_tracer.frag: sky overhead, fading to the horizon, then darkening below it.
+	/// </summary>
+	glm::vec3 MissColor(glm::vec3 direction) {
+		const glm::vec3 sky = glm::vec3(0.529f, 0.808f, 0.922f);
+		const glm::vec3 horizon = glm::vec3(0.8f, 0.9f, 1.0f);
+
+		float theta = std::acos(std::clamp(direction.z, -1.0f, 1.0f)) / std::asin(1.0f);
+		if (theta < 1.0f)
+			return sky * (1.0f - theta) + horizon * theta;
+		return horizon * (2.0f - theta);
+	}
+
+	/// <summary>
+	/// Encodes linear values in [0, 1] to sRGB bytes, as the swapchain does for the GPU tracer. Indexed by the value times the table's size minus one.
+	/// </summary>
+	const std::array<uint8_t, 4096>& GetSRGBTable() {
+		static const std::array<uint8_t, 4096> table = [] {
+			std::array<uint8_t, 4096> ret{};
+			for (size_t i = 0; i < ret.size(); i++) {
+				float linear = static_cast<float>(i) / (ret.size() - 1);
+				float encoded = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+				ret[i] = static_cast<uint8_t>(encoded * 255.0f + 0.5f);
+			}
+			return ret;
+		}();
+		return table;
+	}
+
+	/// <summary>
+	/// Computes the CRC-32 of PNG chunks.
+	/// </summary>
+	uint32_t CRC32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		static const std::array<uint32_t, 256> table = [] {
+			std::array<uint32_t, 256> ret{};
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				ret[i] = c;
+			}
+			return ret;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void AppendBigEndian(std::vector<uint8_t>& bytes, uint32_t value) {
+		for (int shift = 24; shift >= 0; shift -= 8)
+			bytes.push_back(static_cast<uint8_t>(value >> shift));
+	}
+}
+
+/// <summary>
+/// The state of the eight rays of a packet, one lane each. Masks are all-ones in the lanes they select.
+/// </summary>
+struct CPUTracer::Packet {
+
+	/// <summary> The rays' directions, with zero components nudged as in the shader, and their reciprocals. </summary>
+	Float8 direction[3];
+	Float8 inv_direction[3];
+
+	/// <summary> Where each ray enters the octree. </summary>
+	Float8 start;
+
+	/// <summary> Lanes that have finished: hit a voxel, became opaque, or ran out of steps. </summary>
+	Float8 done;
+
+	/// <summary> Lanes that hit a voxel at full detail, with the voxel's brick, index in the brick, and the faces it was entered through. </summary>
+	Float8 hit;
+	Int8 hit_brick;
+	Int8 hit_voxel;
+	Float8 hit_face[3];
+
+	/// <summary> Lanes whose prefiltered cells became opaque. </summary>
+	Float8 opaque;
+
+	/// <summary> The prefiltered colour blended so far, premultiplied, and its coverage. </summary>
+	Float8 lod[4];
+
+	Int8 steps;
+
+	/// <summary>
+	/// Counts a step for the given lanes. Lanes out of steps are finished with a miss, as in the shader, and dropped from the mask.
+	/// </summary>
+	Float8 Step(Float8 lanes) {
+		steps = steps - AsInt(lanes);
+		Float8 exhausted = And(lanes, LessSigned(SplatInt(STEP_BUDGET - 1), steps));
+		done = Or(done, exhausted);
+		return AndNot(lanes, exhausted);
+	}
+
+	/// <summary>
+	/// Blends a prefiltered cell behind what the given lanes have passed through so far, as blendLOD in the shader.
+	/// Lanes that become opaque are finished.
+	/// </summary>
+	void BlendLOD(Float8 lanes, uint32_t word, float coverage, const Float8 face[3]) {
+		Float8 transmitted = (Splat(1.0f) - lod[3]) * Splat(coverage);
+		for (int channel = 0; channel < 3; channel++) {
+			float color = ((word >> (8 * channel)) & 0xFF) / 255.0f;
+			Float8 shaded = Select(face[channel], Splat(color * 0.9f), Splat(color));
+			lod[channel] = Select(lanes, lod[channel] + transmitted * shaded, lod[channel]);
+		}
+		lod[3] = Select(lanes, lod[3] + transmitted, lod[3]);
+
+		Float8 now_opaque = And(lanes, LessEqual(Splat(LOD_OPAQUE), lod[3]));
+		opaque = Or(opaque, now_opaque);
+		done = Or(done, now_opaque);
+	}
+};
+
+std::shared_ptr<CPUTracer> CPUTracer::Create(std::shared_ptr<Octree> octree, uint32_t width, uint32_t height, uint32_t thread_count) {
+	if (octree->GetDepth() > MAX_DEPTH)
+		throw std::invalid_argument("The CPU tracer supports octrees up to " + std::to_string(MAX_DEPTH) + " levels deep!");
+
+	auto ret = std::make_shared<CPUTracer>();
+	ret->m_octree = octree;
+	ret->m_width = width;
+	ret->m_height = height;
+	ret->m_pixels.assign((size_t)width * height, 0);
+
+	// Bricks are packed exactly as the brick pool packs them for the shader
+	uint32_t brick_size = octree->GetBrickSize();
+	for (uint32_t level = 0; level < BrickPool::GetLevelCount(brick_size); level++) {
+		ret->m_level_offsets.push_back(ret->m_brick_words);
+		ret->m_brick_words += BrickPool::GetLevelWords(brick_size >> level);
+	}
+	ret->m_occupancy.resize((size_t)octree->GetBrickCount() * ret->m_brick_words);
+	for (uint32_t brick = 0; brick < octree->GetBrickCount(); brick++)
+		BrickPool::PackOccupancy(octree->GetBrick(brick), brick_size, ret->m_occupancy.data() + (size_t)brick * ret->m_brick_words);
+
+	ret->m_lod = octree->BuildLOD(MATERIAL_PALETTE);
+
+	if (thread_count == 0)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+	ret->m_tile_queues = std::vector<TileQueue>(thread_count);
+	for (uint32_t i = 0; i + 1 < thread_count; i++)
+		ret->m_workers.emplace_back(&CPUTracer::WorkerLoop, ret.get(), i);
+
+	return ret;
+}
+
+CPUTracer::~CPUTracer() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_frame_started.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+void CPUTracer::WorkerLoop(uint32_t index) {
+	uint64_t seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_frame_started.wait(lock, [&] { return m_stopping || m_frame != seen; });
+			if (m_stopping)
+				return;
+			seen = m_frame;
+			if (index >= m_frame_workers)
+				continue;
+		}
+		TraceTiles(index + 1);
+	}
+}
+
+void CPUTracer::Render(std::shared_ptr<Camera> camera, uint32_t thread_count, CPUTracerStats* stats) {
+	auto start = std::chrono::steady_clock::now();
+
+	// The same rays and footprint as OctreeTracer::CmdDraw
+	m_ndc_to_world = camera->GetNDCtoWorldMatrix();
+	m_camera_position = camera->GetPosition();
+	m_origin = (m_camera_position - m_octree_location) / m_octree_scale;
+	float pixel_angle = 2.0f * std::tan(glm::radians(camera->GetFovy()) * 0.5f) / static_cast<float>(m_height);
+	m_lod_footprint = USE_VOXEL_LOD ? pixel_angle * LOD_PIXEL_THRESHOLD : 0.0f;
+
+	// Taking a tile is what hands a worker the frame, so the counters are reset before the queues are filled.
+	// Each thread taking part gets a contiguous run of tiles, so its packets stay close together on screen.
+	m_total_steps = 0;
+	m_finished_tiles = 0;
+
+	uint32_t threads = thread_count == 0 ? GetMaxThreadCount() : std::min(thread_count, GetMaxThreadCount());
+	uint32_t tile_count = GetTileCount();
+	for (uint32_t queue = 0; queue < threads; queue++) {
+		std::lock_guard<std::mutex> lock(m_tile_queues[queue].mutex);
+		uint32_t begin = static_cast<uint32_t>((uint64_t)tile_count * queue / threads);
+		uint32_t end = static_cast<uint32_t>((uint64_t)tile_count * (queue + 1) / threads);
+		for (uint32_t tile = begin; tile < end; tile++)
+			m_tile_queues[queue].tiles.push_back(tile);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_frame++;
+		m_frame_workers = threads - 1;
+	}
+	m_frame_started.notify_all();
+
+	TraceTiles(0);
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_frame_finished.wait(lock, [&] { return m_finished_tiles == tile_count; });
+	}
+
+	if (stats) {
+		stats->thread_count = threads;
+		stats->ray_count = m_width * m_height;
+		stats->total_steps = m_total_steps;
+		stats->render_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+bool CPUTracer::TakeTile(uint32_t queue, uint32_t& tile) {
+	{
+		TileQueue& own = m_tile_queues[queue];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tiles.empty()) {
+			tile = own.tiles.front();
+			own.tiles.pop_front();
+			return true;
+		}
+	}
+
+	// Tiles are only added between frames, so once every queue has been seen empty the frame has none left to take
+	uint32_t queue_count = static_cast<uint32_t>(m_tile_queues.size());
+	for (uint32_t i = 1; i < queue_count; i++) {
+		TileQueue& victim = m_tile_queues[(queue + i) % queue_count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tiles.empty()) {
+			tile = victim.tiles.back();
+			victim.tiles.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void CPUTracer::TraceTiles(uint32_t queue) {
+	uint32_t tile_count = GetTileCount();
+	uint32_t tile;
+	while (TakeTile(queue, tile)) {
+		TraceTile(tile);
+		if (m_finished_tiles.fetch_add(1) + 1 == tile_count) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_frame_finished.notify_all();
+		}
+	}
+}
+
+void CPUTracer::TraceTile(uint32_t tile) {
+	uint32_t tiles_x = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+	uint32_t tile_x = (tile % tiles_x) * TILE_SIZE;
+	uint32_t tile_y = (tile / tiles_x) * TILE_SIZE;
+
+	const auto& srgb = GetSRGBTable();
+	const glm::mat4& m = m_ndc_to_world;
+	uint64_t tile_steps = 0;
+
+	for (uint32_t packet_y = tile_y; packet_y < std::min(tile_y + TILE_SIZE, m_height); packet_y += PACKET_HEIGHT) {
+		for (uint32_t packet_x = tile_x; packet_x < std::min(tile_x + TILE_SIZE, m_width); packet_x += PACKET_WIDTH) {
+
+			// Pixel centres in NDC, as the full-screen quad interpolates them
+			float ndc[2][LANES];
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				ndc[0][lane] = (packet_x + lane % PACKET_WIDTH + 0.5f) * 2.0f / m_width - 1.0f;
+				ndc[1][lane] = (packet_y + lane / PACKET_WIDTH + 0.5f) * 2.0f / m_height - 1.0f;
+			}
+			Float8 x = Load(ndc[0]), y = Load(ndc[1]);
+
+			Float8 w = Splat(m[0][3]) * x + Splat(m[1][3]) * y + Splat(m[3][3]);
+			Float8 world[3], length_squared = Splat(0.0f);
+			for (int a = 0; a < 3; a++) {
+				world[a] = (Splat(m[0][a]) * x + Splat(m[1][a]) * y + Splat(m[3][a])) / w - Splat(m_camera_position[a]);
+				length_squared = length_squared + world[a] * world[a];
+			}
+
+			Packet packet{};
+			Float8 inv_length = Splat(1.0f) / Sqrt(length_squared);
+			Float8 direction[3];
+			Float8 t_entry = Splat(-std::numeric_limits<float>::infinity()), t_exit = Splat(std::numeric_limits<float>::infinity());
+			for (int a = 0; a < 3; a++) {
+				direction[a] = world[a] * inv_length;
+				packet.direction[a] = Select(Less(Abs(direction[a]), Splat(1e-7f)), Splat(1e-7f), direction[a]);
+				packet.inv_direction[a] = Splat(1.0f) / packet.direction[a];
+
+				Float8 t0 = (Splat(0.0f) - Splat(m_origin[a])) * packet.inv_direction[a];
+				Float8 t1 = (Splat(1.0f) - Splat(m_origin[a])) * packet.inv_direction[a];
+				t_entry = Max(t_entry, Min(t0, t1));
+				t_exit = Min(t_exit, Max(t0, t1));
+			}
+			packet.start = Max(t_entry, Splat(0.0f));
+			Float8 entered = And(LessEqual(t_entry, t_exit), LessEqual(Splat(0.0f), t_exit));
+
+			// Walk once for every combination of direction signs in the packet, almost always just one
+			uint32_t lanes = MoveMask(entered);
+			uint32_t negative[3];
+			for (int a = 0; a < 3; a++)
+				negative[a] = MoveMask(Less(packet.inv_direction[a], Splat(0.0f)));
+			while (lanes != 0) {
+				uint32_t first = std::countr_zero(lanes);
+				uint32_t signs = ((negative[0] >> first) & 1) | (((negative[1] >> first) & 1) << 1) | (((negative[2] >> first) & 1) << 2);
+				uint32_t group = lanes;
+				for (int a = 0; a < 3; a++)
+					group &= (signs >> a) & 1 ? negative[a] : ~negative[a];
+				TracePacket(packet, group, signs);
+				lanes &= ~group;
+			}
+
+			// Shade as the shader's main does
+			float lod[4][LANES], directions[3][LANES], faces[3][LANES];
+			uint32_t steps[LANES], hit_bricks[LANES], hit_voxels[LANES];
+			for (int c = 0; c < 4; c++)
+				Store(lod[c], packet.lod[c]);
+			for (int a = 0; a < 3; a++) {
+				Store(directions[a], direction[a]);
+				Store(faces[a], packet.hit_face[a]);
+			}
+			StoreInt(steps, packet.steps);
+			StoreInt(hit_bricks, packet.hit_brick);
+			StoreInt(hit_voxels, packet.hit_voxel);
+			uint32_t hits = MoveMask(packet.hit), opaque = MoveMask(packet.opaque);
+
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				uint32_t pixel_x = packet_x + lane % PACKET_WIDTH, pixel_y = packet_y + lane / PACKET_WIDTH;
+				if (pixel_x >= m_width || pixel_y >= m_height)
+					continue;
+
+				glm::vec3 background;
+				if ((hits >> lane) & 1) {
+					uint8_t value = m_octree->GetBrick(hit_bricks[lane])[hit_voxels[lane]];
+					glm::vec3 face = glm::vec3(faces[0][lane] != 0.0f, faces[1][lane] != 0.0f, faces[2][lane] != 0.0f);
+					background = MATERIAL_PALETTE[value % MATERIAL_PALETTE.size()] * (glm::vec3(1.0f) - face * 0.1f);
+				}
+				else if ((opaque >> lane) & 1) {
+					background = glm::vec3(lod[0][lane], lod[1][lane], lod[2][lane]) / lod[3][lane];
+				}
+				else {
+					background = MissColor(glm::vec3(directions[0][lane], directions[1][lane], directions[2][lane]));
+				}
+
+				glm::vec3 color = glm::vec3(lod[0][lane], lod[1][lane], lod[2][lane]) + (1.0f - lod[3][lane]) * background - glm::vec3(steps[lane] / 250.0f);
+				glm::uvec3 encoded = glm::uvec3(glm::clamp(color, 0.0f, 1.0f) * static_cast<float>(srgb.size() - 1) + 0.5f);
+				m_pixels[(size_t)pixel_y * m_width + pixel_x] = srgb[encoded.r] | (srgb[encoded.g] << 8) | (srgb[encoded.b] << 16) | (0xFFu << 24);
+				tile_steps += steps[lane];
+			}
+		}
+	}
+
+	m_total_steps.fetch_add(tile_steps, std::memory_order_relaxed);
+}
+
+void CPUTracer::TracePacket(Packet& packet, uint32_t lanes, uint32_t negative) const {
+	struct Cell {
+		uint32_t node;
+		glm::vec3 min;
+		float size;
+		uint32_t lanes;
+	};
+
+	// Every level pops one cell and pushes at most eight
+	std::array<Cell, 7 * MAX_DEPTH + 8> stack;
+	uint32_t stack_size = 0;
+	stack[stack_size++] = { 0, glm::vec3(0.0f), 1.0f, lanes };
+
+	const auto& nodes = m_octree->GetNodes();
+	Float8 origin[3] = { Splat(m_origin.x), Splat(m_origin.y), Splat(m_origin.z) };
+
+	while (stack_size > 0) {
+		Cell cell = stack[--stack_size];
+		Float8 active = AndNot(FromBits(cell.lanes), packet.done);
+		if (!Any(active))
+			continue;
+
+		// Which planes of the cell are near and which far is the same for every lane
+		Float8 t_near[3];
+		Float8 t_enter = Splat(-std::numeric_limits<float>::infinity()), t_exit = Splat(std::numeric_limits<float>::infinity());
+		for (int a = 0; a < 3; a++) {
+			bool positive = ((negative >> a) & 1) == 0;
+			float near_plane = positive ? cell.min[a] : cell.min[a] + cell.size;
+			float far_plane = positive ? cell.min[a] + cell.size : cell.min[a];
+			t_near[a] = (Splat(near_plane) - origin[a]) * packet.inv_direction[a];
+			t_enter = Max(t_enter, t_near[a]);
+			t_exit = Min(t_exit, (Splat(far_plane) - origin[a]) * packet.inv_direction[a]);
+		}
+		Float8 start = Max(t_enter, packet.start);
+		active = packet.Step(And(active, Less(start, t_exit)));
+		if (!Any(active))
+			continue;
+
+		Float8 face[3];
+		for (int a = 0; a < 3; a++)
+			face[a] = Equal(t_near[a], t_enter);
+
+		// Lanes for which the cell is narrower than a pixel stop here
+		uint32_t lod = m_lod_footprint > 0.0f ? m_lod[cell.node] : 0u;
+		if (lod != 0) {
+			Float8 cut = And(active, LessEqual(Splat(cell.size), start * Splat(m_lod_footprint)));
+			if (Any(cut)) {
+				packet.BlendLOD(cut, lod, (lod >> 24) / 255.0f, face);
+				active = AndNot(active, cut);
+				if (!Any(active))
+					continue;
+			}
+		}
+
+		const OctreeNode& node = nodes[cell.node];
+		if (node.header & Octree::LEAF_FLAG) {
+			TraceBrick(packet, cell.node, cell.min, cell.size, negative, active, start, face);
+			continue;
+		}
+
+		// Children are pushed back to front, so they pop front to back. Flipping the octant index on the axes the rays point down
+		// gives an order in which no ray can reach a child before one that comes earlier.
+		uint32_t active_lanes = MoveMask(active);
+		uint32_t child_mask = node.header & Octree::CHILD_MASK;
+		float half = cell.size * 0.5f;
+		for (int i = 7; i >= 0; i--) {
+			uint32_t octant = static_cast<uint32_t>(i) ^ negative;
+			if ((child_mask & (1u << octant)) == 0)
+				continue;
+
+			uint32_t child = cell.node + node.data + std::popcount(child_mask & ((1u << octant) - 1));
+			glm::vec3 child_min = cell.min + glm::vec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1) * half;
+			stack[stack_size++] = { child, child_min, half, active_lanes };
+		}
+	}
+}
+
+void CPUTracer::TraceBrick(Packet& packet, uint32_t node, glm::vec3 cell_min, float cell_size, uint32_t negative, Float8 lanes, Float8 start, const Float8 face_in[3]) const {
+	uint32_t brick = static_cast<uint32_t>(m_octree->GetNodes()[node].data);
+	const uint32_t* words = m_occupancy.data() + (size_t)brick * m_brick_words;
+	int32_t brick_size = static_cast<int32_t>(m_octree->GetBrickSize());
+	int32_t top_level = static_cast<int32_t>(m_level_offsets.size()) - 1;
+	float voxel_size = cell_size / brick_size;
+
+	Float8 origin[3] = { Splat(m_origin.x), Splat(m_origin.y), Splat(m_origin.z) };
+	Float8 face[3] = { face_in[0], face_in[1], face_in[2] };
+	Float8 t = start;
+	Int8 coord[3];
+	for (int a = 0; a < 3; a++) {
+		Int8 voxel = FloorToInt((origin[a] + packet.direction[a] * t - Splat(cell_min[a])) / Splat(voxel_size));
+		coord[a] = MinSigned(MaxSigned(voxel, SplatInt(0)), SplatInt(brick_size - 1));
+	}
+
+	// Refinement stops at the coarsest level whose cells are narrower than the pixel footprint where the ray enters the brick
+	uint32_t lod = m_lod_footprint > 0.0f ? m_lod[node] : 0u;
+	Int8 min_level = SplatInt(0);
+	if (lod != 0) {
+		Float8 footprint = start * Splat(m_lod_footprint);
+		for (int32_t level = 1; level <= top_level; level++)
+			min_level = min_level - AsInt(LessEqual(Splat(voxel_size * (1 << level)), footprint));
+	}
+
+	Int8 level = SplatInt(top_level);
+	Float8 inside = lanes;
+	while (true) {
+		inside = packet.Step(inside);
+		if (!Any(inside))
+			return;
+
+		Int8 cell[3];
+		for (int a = 0; a < 3; a++)
+			cell[a] = ShiftRight(coord[a], level);
+		Int8 side = ShiftRight(SplatInt(brick_size), level);
+		Int8 index = Select(inside, (cell[2] * side + cell[1]) * side + cell[0], SplatInt(0));
+		Int8 word = Gather(words, Gather(m_level_offsets.data(), level) + (index >> 5));
+		Float8 occupied = And(inside, Equal(ShiftRight(word, index & SplatInt(31)) & SplatInt(1), SplatInt(1)));
+
+		Float8 hit = AndNot(occupied, LessSigned(min_level, level));
+		if (Any(hit)) {
+			Float8 fine = And(hit, Equal(level, SplatInt(0)));
+			packet.hit = Or(packet.hit, fine);
+			packet.done = Or(packet.done, fine);
+			packet.hit_brick = Select(fine, SplatInt(brick), packet.hit_brick);
+			packet.hit_voxel = Select(fine, (coord[2] * SplatInt(brick_size) + coord[1]) * SplatInt(brick_size) + coord[0], packet.hit_voxel);
+			for (int a = 0; a < 3; a++)
+				packet.hit_face[a] = Select(fine, face[a], packet.hit_face[a]);
+
+			// Coarse brick cells are solid by construction, and take the brick's average colour
+			Float8 coarse = AndNot(hit, fine);
+			if (Any(coarse))
+				packet.BlendLOD(coarse, lod, 1.0f, face);
+			inside = AndNot(inside, hit);
+		}
+
+		// Occupied cells above the stopping level are refined
+		level = level + AsInt(AndNot(occupied, hit));
+
+		// Empty cells are skipped by jumping to their exit, as in traceBrick
+		Float8 empty = AndNot(inside, occupied);
+		if (!Any(empty))
+			continue;
+
+		Int8 width = ShiftLeft(SplatInt(1), level);
+		Float8 size = ToFloat(width) * Splat(voxel_size);
+		Int8 cell_lo[3], cell_hi[3];
+		Float8 t_far[3];
+		Float8 t_exit = Splat(std::numeric_limits<float>::infinity());
+		for (int a = 0; a < 3; a++) {
+			bool positive = ((negative >> a) & 1) == 0;
+			cell_lo[a] = ShiftLeft(cell[a], level);
+			cell_hi[a] = cell_lo[a] + width - SplatInt(1);
+			Float8 plane = Splat(cell_min[a]) + ToFloat(cell_lo[a]) * Splat(voxel_size);
+			if (positive)
+				plane = plane + size;
+			t_far[a] = (plane - origin[a]) * packet.inv_direction[a];
+			t_exit = Min(t_exit, t_far[a]);
+		}
+
+		Float8 leaving = Splat(0.0f);
+		Int8 next[3];
+		Float8 exit_face[3];
+		for (int a = 0; a < 3; a++) {
+			bool positive = ((negative >> a) & 1) == 0;
+			exit_face[a] = Equal(t_far[a], t_exit);
+			Int8 voxel = FloorToInt((origin[a] + packet.direction[a] * t_exit - Splat(cell_min[a])) / Splat(voxel_size));
+			Int8 within = MinSigned(MaxSigned(voxel, cell_lo[a]), cell_hi[a]);
+			Int8 across = positive ? cell_hi[a] + SplatInt(1) : cell_lo[a] - SplatInt(1);
+			next[a] = Select(exit_face[a], across, within);
+			leaving = Or(leaving, Or(LessSigned(next[a], SplatInt(0)), LessSigned(SplatInt(brick_size - 1), next[a])));
+		}
+
+		Float8 moving = AndNot(empty, leaving);
+		for (int a = 0; a < 3; a++) {
+			face[a] = Select(empty, exit_face[a], face[a]);
+			coord[a] = Select(moving, next[a], coord[a]);
+		}
+		t = Select(moving, t_exit, t);
+
+		// The next cell may be empty at a coarser level again
+		level = Select(moving, MinSigned(level + SplatInt(1), SplatInt(top_level)), level);
+		inside = AndNot(inside, And(empty, leaving));
+	}
+}
+
+uint32_t CPUTracer::GetTileCount() const {
+	return ((m_width + TILE_SIZE - 1) / TILE_SIZE) * ((m_height + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+void CPUTracer::WritePNG(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to open " + path + " for writing!");
+
+	// Each scanline starts with filter type 0, none
+	std::vector<uint8_t> scanlines;
+	scanlines.reserve(((size_t)m_width * 4 + 1) * m_height);
+	for (uint32_t y = 0; y < m_height; y++) {
+		scanlines.push_back(0);
+		for (uint32_t x = 0; x < m_width; x++) {
+			uint32_t pixel = m_pixels[(size_t)y * m_width + x];
+			for (int shift = 0; shift < 32; shift += 8)
+				scanlines.push_back(static_cast<uint8_t>(pixel >> shift));
+		}
+	}
+
+	// A zlib stream of stored deflate blocks, which need no compressor
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	const size_t MAX_BLOCK = 65535;
+	for (size_t offset = 0; offset < scanlines.size() || offset == 0; offset += MAX_BLOCK) {
+		uint16_t length = static_cast<uint16_t>(std::min(MAX_BLOCK, scanlines.size() - offset));
+		zlib.push_back(offset + length >= scanlines.size() ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(length));
+		zlib.push_back(static_cast<uint8_t>(length >> 8));
+		zlib.push_back(static_cast<uint8_t>(~length));
+		zlib.push_back(static_cast<uint8_t>(~length >> 8));
+		zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+		if (scanlines.empty())
+			break;
+	}
+	uint32_t a = 1, b = 0;
+	for (uint8_t byte : scanlines) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	AppendBigEndian(zlib, (b << 16) | a);
+
+	auto write_chunk = [&](const char* type, const std::vector<uint8_t>& data) {
+		std::vector<uint8_t> chunk;
+		AppendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		AppendBigEndian(chunk, CRC32(chunk.data() + 4, chunk.size() - 4));
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	};
+
+	// 8-bit RGBA, no interlacing
+	std::vector<uint8_t> header;
+	AppendBigEndian(header, m_width);
+	AppendBigEndian(header, m_height);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+	write_chunk("IHDR", header);
+	write_chunk("IDAT", zlib);
+	write_chunk("IEND", {});
+
+	if (!file)
+		throw std::runtime_error("Failed to write " + path + "!");
+}
+
+void CPUTracer::RunBenchmark(std::shared_ptr<Octree> octree) {
+	const uint32_t width = 1280, height = 720;
+	auto camera = Camera::Create(45.0f, (float)width / (float)height, 0.1f, 10.0f);
+	auto tracer = Create(octree, width, height);
+	printf("Tracing %u^3 octree at %ux%u on the CPU, %u frames per thread count\n", octree->GetSize(), width, height, BENCHMARK_FRAMES);
+
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t count = 1; count < tracer->GetMaxThreadCount(); count *= 2)
+		thread_counts.push_back(count);
+	thread_counts.push_back(tracer->GetMaxThreadCount());
+
+	float single_ms = 0.0f;
+	for (uint32_t count : thread_counts) {
+		tracer->Render(camera, count);
+
+		CPUTracerStats stats{};
+		float total_ms = 0.0f;
+		for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+			tracer->Render(camera, count, &stats);
+			total_ms += stats.render_ms;
+		}
+		stats.render_ms = total_ms / BENCHMARK_FRAMES;
+		if (count == 1)
+			single_ms = stats.render_ms;
+
+		printf("%3u threads | %8.2f ms/frame | %6.1f fps | %7.2f M rays/s | %6.1f steps/ray | %5.2fx\n",
+			stats.thread_count, stats.render_ms, 1000.0f / stats.render_ms, stats.GetRaysPerSecond() / 1e6f,
+			stats.GetAverageSteps(), single_ms / stats.render_ms);
+	}
+}
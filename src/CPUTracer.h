@@ -0,0 +1,205 @@
+#pragma once
+#include "Octree.h"
+#include "Camera.h"
+#include "SIMD.h"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Timings and counts of a single CPUTracer::Render call.
+/// </summary>
+struct CPUTracerStats {
+
+	/// <summary> The number of threads that traced tiles, including the calling thread. </summary>
+	uint32_t thread_count;
+
+	/// <summary> The number of rays traced, one per pixel. </summary>
+	uint32_t ray_count;
+
+	/// <summary> The total number of traversal steps taken by all rays. </summary>
+	uint64_t total_steps;
+
+	/// <summary> Time spent rendering the frame, in milliseconds. </summary>
+	float render_ms;
+
+	/// <summary> Gets the number of rays traced per second. </summary>
+	float GetRaysPerSecond() const { return ray_count / (render_ms / 1000.0f); }
+
+	/// <summary> Gets the average number of traversal steps per ray. </summary>
+	float GetAverageSteps() const { return ray_count == 0 ? 0.0f : (float)total_steps / (float)ray_count; }
+};
+
+/// <summary>
+/// Renders an octree on the CPU, for machines with no GPU. Produces the same image as shader_tracer.frag: the same rays from
+/// Camera::GetNDCtoWorldMatrix, the same brick occupancy levels, materials and level of detail, and the same shading.
+/// Rays are traced in packets of 4x2 pixels, eight lanes wide (see SIMD.h). A packet walks the octree together, front to back in the
+/// order its shared direction signs give, and descends into a child if any of its rays still needs it; inside a brick, each lane runs
+/// its own hierarchical DDA in lockstep. Packets whose rays straddle an axis are split by sign and each part walked on its own.
+/// The screen is split into tiles, dealt out in contiguous runs to a deque per thread of a persistent pool. Each thread takes tiles from the
+/// front of its own deque, and once it is empty steals from the back of the others', so neighbouring tiles stay on one thread until the work runs out.
+/// </summary>
+class CPUTracer
+{
+private:
+
+	/// <summary> A walk down the octree shared by the rays of a packet. </summary>
+	struct Packet;
+
+	// SCENE
+	/// <summary> The octree being traced. </summary>
+	std::shared_ptr<Octree> m_octree;
+
+	/// <summary> The packed occupancy levels of every brick, laid out as in the brick pool. </summary>
+	std::vector<uint32_t> m_occupancy;
+
+	/// <summary> The number of occupancy words per brick, and the word at which each level starts within them. </summary>
+	uint32_t m_brick_words = 0;
+	std::vector<uint32_t> m_level_offsets;
+
+	/// <summary> The prefiltered colour and coverage of every node. See Octree::BuildLOD. </summary>
+	std::vector<uint32_t> m_lod;
+
+	/// <summary> The world-space position of the octree's minimum corner, and its world-space width. Match OctreeTracer. </summary>
+	glm::vec3 m_octree_location = glm::vec3(-1.0f);
+	float m_octree_scale = 2.0f;
+
+	// IMAGE
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+
+	/// <summary> The rendered image, one RGBA8 word per pixel with red in the low byte, top row first. </summary>
+	std::vector<uint32_t> m_pixels;
+
+	// FRAME
+	/// <summary> The camera of the frame being rendered. Rays start at its position in world space, and are traced from m_origin, the same point in octree space where the octree spans [0, 1]. </summary>
+	glm::mat4 m_ndc_to_world = glm::mat4(1.0f);
+	glm::vec3 m_camera_position = glm::vec3(0.0f);
+	glm::vec3 m_origin = glm::vec3(0.0f);
+
+	/// <summary> The width of a pixel's footprint per unit of ray distance, times the LOD threshold. 0 disables level of detail. </summary>
+	float m_lod_footprint = 0.0f;
+
+	/// <summary> The tiles left to trace by one thread, taken from the front by their owner and from the back by thieves. </summary>
+	struct TileQueue {
+		std::mutex mutex;
+		std::deque<uint32_t> tiles;
+	};
+
+	/// <summary> One queue per thread: the calling thread's first, then one per worker. </summary>
+	std::vector<TileQueue> m_tile_queues;
+
+	/// <summary> The number of tiles finished. </summary>
+	std::atomic<uint32_t> m_finished_tiles = 0;
+
+	/// <summary> The steps taken by all rays of the frame so far. </summary>
+	std::atomic<uint64_t> m_total_steps = 0;
+
+	// WORKERS
+	/// <summary> Guards the frame counter, the number of workers taking part, and the stop flag. </summary>
+	std::mutex m_mutex;
+
+	/// <summary> Signalled when a frame starts or the workers must stop. </summary>
+	std::condition_variable m_frame_started;
+
+	/// <summary> Signalled when the last tile of a frame is finished. </summary>
+	std::condition_variable m_frame_finished;
+
+	/// <summary> Incremented for every frame, so workers can tell a new frame from a spurious wake-up. </summary>
+	uint64_t m_frame = 0;
+
+	/// <summary> The number of workers that take part in the current frame, besides the calling thread. </summary>
+	uint32_t m_frame_workers = 0;
+
+	bool m_stopping = false;
+	std::vector<std::thread> m_workers;
+
+	/// <summary>
+	/// Waits for frames and traces their tiles, until stopped. Workers past the frame's worker count sit the frame out.
+	/// </summary>
+	void WorkerLoop(uint32_t index);
+
+	/// <summary>
+	/// Takes tiles from the given queue, then steals from the others, tracing each until every queue is empty.
+	/// </summary>
+	void TraceTiles(uint32_t queue);
+
+	/// <summary>
+	/// Takes the next tile from the front of the given queue, or steals one from the back of another.
+	/// </summary>
+	/// <returns> False if every queue is empty. </returns>
+	bool TakeTile(uint32_t queue, uint32_t& tile);
+
+	/// <summary>
+	/// Traces every packet of a tile into the image.
+	/// </summary>
+	void TraceTile(uint32_t tile);
+
+	/// <summary>
+	/// Walks the octree with the rays of a packet that share a set of direction signs.
+	/// </summary>
+	/// <param name="lanes"> One bit per lane taking part. </param>
+	/// <param name="negative"> One bit per axis, set if the lanes' rays point down that axis. </param>
+	void TracePacket(Packet& packet, uint32_t lanes, uint32_t negative) const;
+
+	/// <summary>
+	/// Runs the hierarchical DDA of shader_tracer.frag through one brick for the given lanes, which enter it at their start distances.
+	/// </summary>
+	/// <param name="lanes"> The mask of lanes entering the brick. </param>
+	/// <param name="face"> The faces each lane enters the brick through, one mask per axis. </param>
+	void TraceBrick(Packet& packet, uint32_t node, glm::vec3 cell_min, float cell_size, uint32_t negative, simd::Float8 lanes, simd::Float8 start, const simd::Float8 face[3]) const;
+
+	/// <summary> Gets the number of tiles covering the image. </summary>
+	uint32_t GetTileCount() const;
+
+public:
+
+	/// <summary> The width and height of a tile, in pixels. A multiple of the packet size. </summary>
+	static constexpr uint32_t TILE_SIZE = 16;
+
+	/// <summary> The maximum number of traversal steps a single ray may take, as in OctreeTracer. </summary>
+	static constexpr uint32_t STEP_BUDGET = 1000;
+
+	/// <summary>
+	/// Creates a tracer for an octree, and starts its worker threads.
+	/// </summary>
+	/// <param name="thread_count"> The most threads a frame may use, including the calling thread. 0 uses every hardware thread. </param>
+	static std::shared_ptr<CPUTracer> Create(std::shared_ptr<Octree> octree, uint32_t width, uint32_t height, uint32_t thread_count = 0);
+
+	~CPUTracer();
+
+	/// <summary>
+	/// Renders a frame into the image.
+	/// </summary>
+	/// <param name="thread_count"> The number of threads to render with, including the calling thread. 0 uses all of them. </param>
+	/// <param name="stats"> Receives timings and counts, if not null. </param>
+	void Render(std::shared_ptr<Camera> camera, uint32_t thread_count = 0, CPUTracerStats* stats = nullptr);
+
+	/// <summary>
+	/// Writes the image to a PNG file, uncompressed.
+	/// </summary>
+	void WritePNG(const std::string& path) const;
+
+	/// <summary> Gets the rendered image, one RGBA8 word per pixel with red in the low byte, top row first. </summary>
+	const std::vector<uint32_t>& GetPixels() const { return m_pixels; }
+
+	/// <summary> Gets the most threads a frame can use, including the calling thread. </summary>
+	uint32_t GetMaxThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+	/// <summary>
+	/// Renders an octree at 1280x720 from the startup camera with 1, 2, 4... threads up to every hardware thread,
+	/// and prints the frame time, rays per second and speedup of each to stdout.
+	/// </summary>
+	static void RunBenchmark(std::shared_ptr<Octree> octree);
+};
@@ -53,6 +53,10 @@ public:
 		return glm::inverse(GetProjectionMatrix() * GetViewMatrix());
 	}
 
+	float GetFovy() {
+		return m_fovy;
+	}
+
 	glm::vec3 GetPosition() {
 		return m_position;
 	}
@@ -4,6 +4,7 @@
 #include <vector>
 #include "Device.h"
 #include "CommandBuffer.h"
+#include "BrickPool.h"
 #include <chrono>
 
 class GPUProfiler
@@ -18,17 +19,32 @@ private:
 	float m_fps;
 	uint32_t m_frame_count = 0;
 
+	/// <summary> Brick pool residency counters, recorded per frame in flight. </summary>
+	std::vector<BrickPoolStats> m_brick_pool_counters;
+
+	/// <summary> The stages marked while recording each frame in flight, in order. </summary>
+	std::vector<std::vector<const char*>> m_stage_names;
+
+	/// <summary> The stages whose timestamps each frame's query pool holds, from the last time the frame was recorded. </summary>
+	std::vector<std::vector<const char*>> m_timed_stage_names;
+
 public:
 
+	/// <summary> The most stages a frame can mark. Further marks are ignored. </summary>
+	static constexpr uint32_t MAX_STAGES = 8;
+
 	static std::shared_ptr<GPUProfiler> Create(std::shared_ptr<VWrap::Device> device, uint32_t num_frames) {
 		auto ret = std::make_shared<GPUProfiler>();
 		ret->m_device = device;
 		ret->m_query_pools.resize(num_frames);
+		ret->m_brick_pool_counters.resize(num_frames);
+		ret->m_stage_names.resize(num_frames);
+		ret->m_timed_stage_names.resize(num_frames);
 
 		VkQueryPoolCreateInfo queryPoolInfo = {};
 		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
 		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
-		queryPoolInfo.queryCount = 2;
+		queryPoolInfo.queryCount = 2 + MAX_STAGES;
 
 		for (auto& pool : ret->m_query_pools)
 			vkCreateQueryPool(device->Get(), &queryPoolInfo, nullptr, &pool);
@@ -36,7 +52,7 @@ public:
 		VkPhysicalDeviceProperties deviceProperties;
 		vkGetPhysicalDeviceProperties(device->GetPhysicalDevice()->Get(), &deviceProperties);
 		ret->m_timestamp_period = deviceProperties.limits.timestampPeriod;
-		ret->m_start_time = std::chrono::high_resolution_clock::now();
+		ret->m_start_time = std::chrono::steady_clock::now();
 
 		return ret;
 	}
@@ -44,7 +60,7 @@ public:
 	void CmdBegin(std::shared_ptr<VWrap::CommandBuffer> buffer, uint32_t frame) {
 
 		m_frame_count++;
-		auto current_time = std::chrono::high_resolution_clock::now();
+		auto current_time = std::chrono::steady_clock::now();
 		std::chrono::duration<double, std::milli> elapsed_time = current_time - m_start_time;
 		if (elapsed_time.count() >= 500) {
 			m_fps = m_frame_count * 2.0f;
@@ -52,23 +68,57 @@ public:
 			m_start_time = current_time;
 		}
 
-		vkCmdResetQueryPool(buffer->Get(), m_query_pools[frame], 0, 2);
+		// The frame's fence has been waited on, so its pool holds the stages marked the last time it was recorded
+		m_timed_stage_names[frame] = m_stage_names[frame];
+		m_stage_names[frame].clear();
+
+		vkCmdResetQueryPool(buffer->Get(), m_query_pools[frame], 0, 2 + MAX_STAGES);
 		vkCmdWriteTimestamp(buffer->Get(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_query_pools[frame], 0);
 	}
 
+	/// <summary>
+	/// Marks the end of a stage of the frame, once every command recorded before it has finished. A stage's time runs from the
+	/// previous mark, or from CmdBegin for the first.
+	/// </summary>
+	/// <param name="name"> The stage's display name. Must outlive the profiler. </param>
+	void CmdMarkStage(std::shared_ptr<VWrap::CommandBuffer> buffer, uint32_t frame, const char* name) {
+		auto& names = m_stage_names[frame];
+		if (names.size() >= MAX_STAGES)
+			return;
+
+		vkCmdWriteTimestamp(buffer->Get(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_query_pools[frame], 2 + static_cast<uint32_t>(names.size()));
+		names.push_back(name);
+	}
+
 	void CmdEnd(std::shared_ptr<VWrap::CommandBuffer> buffer, uint32_t frame) {
 		vkCmdWriteTimestamp(buffer->Get(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_query_pools[frame], 1);
 	}
 
+	/// <summary>
+	/// Records the brick pool's residency counters for the given frame, to be reported alongside its timings.
+	/// </summary>
+	void RecordBrickPool(uint32_t frame, const BrickPoolStats& stats) {
+		m_brick_pool_counters[frame] = stats;
+	}
+
+	/// <summary> The GPU time of a stage marked with CmdMarkStage. </summary>
+	struct StageTime {
+		const char* name;
+		float time;
+	};
+
 	struct PerformanceMetrics {
 		float fps, render_time;
+		BrickPoolStats brick_pool;
+		std::vector<StageTime> stages;
 	};
 
 	PerformanceMetrics GetMetrics(uint32_t frame) {
-		uint64_t timestamps[2];
+		const auto& stage_names = m_timed_stage_names[frame];
+		uint64_t timestamps[2 + MAX_STAGES];
 		vkGetQueryPoolResults(m_device->Get(), 
 			m_query_pools[frame], 
-			0, 2, 
+			0, 2 + static_cast<uint32_t>(stage_names.size()), 
 			sizeof(timestamps), 
 			timestamps, sizeof(uint64_t), 
 			VK_QUERY_RESULT_64_BIT);
@@ -76,7 +126,12 @@ public:
 		uint64_t timeTakenNanoseconds = timestamps[1] - timestamps[0];
 		float timeTakenMilliseconds = timeTakenNanoseconds * m_timestamp_period * 1e-6f;
 
-		return PerformanceMetrics(m_fps, timeTakenMilliseconds);
+		PerformanceMetrics metrics{ m_fps, timeTakenMilliseconds, m_brick_pool_counters[frame], {} };
+		for (size_t i = 0; i < stage_names.size(); i++) {
+			uint64_t start = i == 0 ? timestamps[0] : timestamps[1 + i];
+			metrics.stages.push_back({ stage_names[i], (timestamps[2 + i] - start) * m_timestamp_period * 1e-6f });
+		}
+		return metrics;
 	}
 
 	~GPUProfiler() {
@@ -0,0 +1,288 @@
+#include "GPUVoxelizer.h"
+
+std::shared_ptr<GPUVoxelizer> GPUVoxelizer::Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::CommandPool> command_pool, std::shared_ptr<BrickPool> brick_pool, std::shared_ptr<VWrap::Buffer> vertex_buffer, std::shared_ptr<VWrap::Buffer> index_buffer, const std::vector<VWrap::Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t resolution) {
+	uint32_t brick_size = brick_pool->GetBrickSize();
+	uint32_t bricks_per_side = resolution / brick_size;
+	if (bricks_per_side * brick_size != resolution || (bricks_per_side & (bricks_per_side - 1)) != 0) {
+		throw std::invalid_argument("GPU voxelizer resolution must be the brick size times a power of two!");
+	}
+	if ((size_t)bricks_per_side * bricks_per_side * bricks_per_side > brick_pool->GetCapacity()) {
+		throw std::invalid_argument("GPU voxelizer resolution needs more bricks than the brick pool has slots!");
+	}
+
+	auto ret = std::make_shared<GPUVoxelizer>();
+	ret->m_device = device;
+	ret->m_allocator = allocator;
+	ret->m_command_pool = command_pool;
+	ret->m_brick_pool = brick_pool;
+	ret->m_vertex_buffer = vertex_buffer;
+	ret->m_index_buffer = index_buffer;
+	ret->m_resolution = resolution;
+	ret->m_triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+	// The reference voxelizer sees the same triangles as the shader, so both derive the same voxel transform
+	std::vector<glm::vec3> soup((size_t)ret->m_triangle_count * 3);
+	for (size_t i = 0; i < soup.size(); i++)
+		soup[i] = vertices[indices[i]].pos;
+	ret->m_reference = Voxelizer::Create(soup, std::vector<uint8_t>(ret->m_triangle_count, 1));
+	ret->m_reference->GetVoxelTransform(resolution, ret->m_push_constants.mesh_min, ret->m_push_constants.scale);
+	ret->m_push_constants.triangle_count = ret->m_triangle_count;
+
+	ret->CreateDescriptors();
+	ret->CreatePipeline();
+
+	return ret;
+}
+
+void GPUVoxelizer::CreateDescriptors()
+{
+	// Vertices, indices, occupancy and materials, in that order
+	std::vector<VkDescriptorSetLayoutBinding> bindings(4);
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	m_descriptor_set_layout = VWrap::DescriptorSetLayout::Create(m_device, bindings);
+
+	std::vector<VkDescriptorPoolSize> poolSizes(1);
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(bindings.size());
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	m_descriptor_pool = VWrap::DescriptorPool::Create(m_device, poolSizes, 1, 0);
+	m_descriptor_set = VWrap::DescriptorSet::Create(m_descriptor_pool, m_descriptor_set_layout);
+
+	std::array<VkDescriptorBufferInfo, 4> buffer_infos{};
+	buffer_infos[0].buffer = m_vertex_buffer->Get();
+	buffer_infos[1].buffer = m_index_buffer->Get();
+	buffer_infos[2].buffer = m_brick_pool->GetOccupancyBuffer()->Get();
+	buffer_infos[3].buffer = m_brick_pool->GetMaterialBuffer()->Get();
+
+	std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+	for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+		buffer_infos[i].offset = 0;
+		buffer_infos[i].range = VK_WHOLE_SIZE;
+
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].dstBinding = i;
+		descriptorWrites[i].dstSet = m_descriptor_set->Get();
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].pBufferInfo = &buffer_infos[i];
+		descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	}
+
+	vkUpdateDescriptorSets(m_device->Get(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void GPUVoxelizer::CreatePipeline()
+{
+	auto comp_shader_code = VWrap::readFile("../shaders/comp_voxelize.spv");
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+	std::vector<VkPushConstantRange> push_constant_ranges = { pushConstantRange };
+
+	// Must match the constant_ids in shader_voxelize.comp
+	struct SpecializationConstants {
+		int32_t brick_size;
+		int32_t brick_levels;
+		int32_t brick_words;
+		int32_t bricks_per_side;
+		VkBool32 use_materials;
+		int32_t vertex_stride;
+	} specialization_constants;
+	specialization_constants.brick_size = static_cast<int32_t>(m_brick_pool->GetBrickSize());
+	specialization_constants.brick_levels = static_cast<int32_t>(m_brick_pool->GetLevelCount());
+	specialization_constants.brick_words = static_cast<int32_t>(m_brick_pool->GetSlotWords());
+	specialization_constants.bricks_per_side = static_cast<int32_t>(m_resolution / m_brick_pool->GetBrickSize());
+	specialization_constants.use_materials = m_brick_pool->UsesMaterials() ? VK_TRUE : VK_FALSE;
+	specialization_constants.vertex_stride = static_cast<int32_t>(sizeof(VWrap::Vertex) / sizeof(float));
+
+	std::array<VkSpecializationMapEntry, 6> specialization_entries{};
+	specialization_entries[0] = { 0, offsetof(SpecializationConstants, brick_size), sizeof(int32_t) };
+	specialization_entries[1] = { 1, offsetof(SpecializationConstants, brick_levels), sizeof(int32_t) };
+	specialization_entries[2] = { 2, offsetof(SpecializationConstants, brick_words), sizeof(int32_t) };
+	specialization_entries[3] = { 3, offsetof(SpecializationConstants, bricks_per_side), sizeof(int32_t) };
+	specialization_entries[4] = { 4, offsetof(SpecializationConstants, use_materials), sizeof(VkBool32) };
+	specialization_entries[5] = { 5, offsetof(SpecializationConstants, vertex_stride), sizeof(int32_t) };
+
+	VkSpecializationInfo specialization_info{};
+	specialization_info.mapEntryCount = static_cast<uint32_t>(specialization_entries.size());
+	specialization_info.pMapEntries = specialization_entries.data();
+	specialization_info.dataSize = sizeof(SpecializationConstants);
+	specialization_info.pData = &specialization_constants;
+
+	m_pipeline = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, push_constant_ranges, comp_shader_code, &specialization_info);
+}
+
+void GPUVoxelizer::CmdVoxelize(std::shared_ptr<VWrap::CommandBuffer> command_buffer)
+{
+	auto vk_command_buffer = command_buffer->Get();
+
+	// The previous frame's tracer must be done reading the slots before they are cleared
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdFillBuffer(vk_command_buffer, m_brick_pool->GetOccupancyBuffer()->Get(), 0, VK_WHOLE_SIZE, 0);
+	if (m_brick_pool->UsesMaterials())
+		vkCmdFillBuffer(vk_command_buffer, m_brick_pool->GetMaterialBuffer()->Get(), 0, VK_WHOLE_SIZE, 0);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->Get());
+
+	std::array<VkDescriptorSet, 1> descriptorSets = { m_descriptor_set->Get() };
+	vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->GetLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
+
+	vkCmdPushConstants(vk_command_buffer, m_pipeline->GetLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &m_push_constants);
+
+	vkCmdDispatch(vk_command_buffer, (m_triangle_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+uint64_t GPUVoxelizer::Validate()
+{
+	uint32_t brick_size = m_brick_pool->GetBrickSize();
+	uint32_t slot_words = m_brick_pool->GetSlotWords();
+	size_t word_count = (size_t)m_brick_pool->GetCapacity() * slot_words;
+
+	void* data;
+	auto readback_buffer = VWrap::Buffer::CreateMapped(m_allocator,
+		word_count * sizeof(uint32_t),
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		data,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+	auto command_buffer = VWrap::CommandBuffer::Create(m_command_pool);
+	command_buffer->BeginSingle();
+	CmdVoxelize(command_buffer);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer->Get(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	command_buffer->CmdCopyBuffer(m_brick_pool->GetOccupancyBuffer(), readback_buffer, word_count * sizeof(uint32_t));
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer->Get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	command_buffer->EndAndSubmit();
+
+	// Pack the CPU voxelizer's bricks into the slots the shader writes them to. The slot of a brick is its Morton code,
+	// which is the octants on the path from the root to its leaf, most significant first.
+	auto start = std::chrono::steady_clock::now();
+	auto octree = m_reference->Voxelize(m_resolution, brick_size, 0);
+	float cpu_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<uint32_t> expected(word_count, 0);
+	const auto& nodes = octree->GetNodes();
+	std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+	while (!stack.empty()) {
+		auto [index, code] = stack.back();
+		stack.pop_back();
+
+		const OctreeNode& node = nodes[index];
+		if (node.header & Octree::LEAF_FLAG) {
+			BrickPool::PackOccupancy(octree->GetBrick(static_cast<uint32_t>(node.data)), brick_size, expected.data() + (size_t)code * slot_words);
+			continue;
+		}
+
+		uint32_t child = index + node.data;
+		for (uint32_t octant = 0; octant < 8; octant++) {
+			if (node.header & (1u << octant))
+				stack.push_back({ child++, (code << 3) | octant });
+		}
+	}
+
+	const uint32_t* actual = static_cast<const uint32_t*>(data);
+	uint64_t differing_bits = 0;
+	uint64_t set_bits = 0;
+	for (size_t i = 0; i < word_count; i++) {
+		differing_bits += std::popcount(actual[i] ^ expected[i]);
+		set_bits += std::popcount(expected[i]);
+	}
+
+	printf("GPU voxelizer: %u triangles at %u^3, %llu occupancy bits set, %llu differ from the CPU voxelizer (CPU took %.1f ms)\n",
+		m_triangle_count, m_resolution, (unsigned long long)set_bits, (unsigned long long)differing_bits, cpu_ms);
+
+	return differing_bits;
+}
+
+void GPUVoxelizer::RunTests(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::CommandPool> command_pool, std::shared_ptr<UploadService> upload_service, std::shared_ptr<VWrap::RetirementQueue> retirement_queue)
+{
+	struct TestMesh {
+		const char* name;
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+	};
+	std::vector<TestMesh> meshes;
+
+	meshes.push_back({ "Triangle", { { 0.1f, 0.0f, 0.3f }, { 1.0f, 0.4f, 0.0f }, { 0.2f, 1.0f, 0.9f } }, { 0, 1, 2 } });
+	meshes.push_back({ "Tetrahedron", { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ 0, 2, 1, 0, 1, 3, 0, 3, 2, 1, 2, 3 } });
+
+	// The faces of an axis-aligned cube lie on voxel boundaries, where the overlap test is most sensitive to rounding
+	TestMesh cube = { "Cube", {}, {} };
+	for (uint32_t i = 0; i < 8; i++)
+		cube.positions.push_back(glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+	cube.indices = { 0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3 };
+	meshes.push_back(cube);
+
+	TestMesh sphere = { "Sphere", {}, {} };
+	const uint32_t rings = 8, segments = 16;
+	for (uint32_t r = 0; r <= rings; r++) {
+		float theta = glm::pi<float>() * r / rings;
+		for (uint32_t s = 0; s < segments; s++) {
+			float phi = 2.0f * glm::pi<float>() * s / segments;
+			sphere.positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+		}
+	}
+	for (uint32_t r = 0; r < rings; r++) {
+		for (uint32_t s = 0; s < segments; s++) {
+			uint32_t a = r * segments + s, b = r * segments + (s + 1) % segments;
+			sphere.indices.insert(sphere.indices.end(), { a, a + segments, b, b, a + segments, b + segments });
+		}
+	}
+	meshes.push_back(sphere);
+
+	const uint32_t brick_size = 8;
+	for (uint32_t resolution : { 16u, 32u, 64u }) {
+		uint32_t depth = 0;
+		while ((brick_size << depth) < resolution) depth++;
+
+		auto brick_pool = BrickPool::Create(device, allocator, command_pool, upload_service, retirement_queue, (size_t)resolution * resolution * resolution, 1 << 20, false, 1);
+		brick_pool->SetOctree(Octree::CreateComplete(depth, brick_size), true);
+
+		for (const TestMesh& mesh : meshes) {
+			std::vector<VWrap::Vertex> vertices(mesh.positions.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				vertices[i].pos = mesh.positions[i];
+
+			std::shared_ptr<VWrap::Buffer> vertex_buffer, index_buffer;
+			upload_service->UploadBuffer(vertex_buffer, vertices.data(), sizeof(vertices[0]) * vertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+			upload_service->UploadBuffer(index_buffer, mesh.indices.data(), sizeof(mesh.indices[0]) * mesh.indices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+			upload_service->AcquireNow(command_pool);
+
+			printf("%s at %u^3: ", mesh.name, resolution);
+			auto voxelizer = Create(device, allocator, command_pool, brick_pool, vertex_buffer, index_buffer, vertices, mesh.indices, resolution);
+			if (voxelizer->Validate() != 0)
+				throw std::runtime_error(std::string("GPU voxelizer test failed: ") + mesh.name + " differs from the CPU voxelizer");
+		}
+	}
+	printf("GPU voxelizer tests passed\n");
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include "Buffer.h"
+#include "Device.h"
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+#include "DescriptorSet.h"
+#include "DescriptorSetLayout.h"
+#include "DescriptorPool.h"
+#include "Pipeline.h"
+#include "Allocator.h"
+#include "Utils.h"
+
+#include "BrickPool.h"
+#include "UploadService.h"
+#include "Voxelizer.h"
+
+#include <memory>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <bit>
+#include <cstdio>
+#include <cmath>
+#include <string>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+/// <summary>
+/// Voxelizes an indexed triangle mesh on the GPU with a compute shader, writing straight into the slots of a brick pool.
+/// The pool must hold an octree from Octree::CreateComplete, pinned, so that the brick at grid position p lives in the slot given by p's Morton code.
+/// Every triangle is tested against the voxels of its bounds with the same overlap test as the CPU Voxelizer, and sets the voxels and
+/// coarser occupancy cells it touches with atomics. Because the whole grid is rebuilt each time, the mesh may change every frame.
+/// </summary>
+class GPUVoxelizer
+{
+private:
+
+	// DEVICE RESOURCES
+	std::shared_ptr<VWrap::Device> m_device;
+	std::shared_ptr<VWrap::Allocator> m_allocator;
+	std::shared_ptr<VWrap::CommandPool> m_command_pool;
+
+	// DESCRIPTORS
+	std::shared_ptr<VWrap::DescriptorSetLayout> m_descriptor_set_layout;
+	std::shared_ptr<VWrap::DescriptorPool> m_descriptor_pool;
+	std::shared_ptr<VWrap::DescriptorSet> m_descriptor_set;
+
+	// PIPELINE
+	std::shared_ptr<VWrap::Pipeline> m_pipeline;
+
+	/// <summary> The brick pool whose slots are written. </summary>
+	std::shared_ptr<BrickPool> m_brick_pool;
+
+	// MESH
+	/// <summary> The mesh's vertices, laid out as VWrap::Vertex. </summary>
+	std::shared_ptr<VWrap::Buffer> m_vertex_buffer;
+
+	/// <summary> The mesh's indices, three per triangle. </summary>
+	std::shared_ptr<VWrap::Buffer> m_index_buffer;
+
+	/// <summary> The mesh as a triangle soup, used to derive the voxel transform and to build the CPU reference. </summary>
+	std::shared_ptr<Voxelizer> m_reference;
+
+	/// <summary> The number of triangles in the mesh. </summary>
+	uint32_t m_triangle_count = 0;
+
+	/// <summary> The width of the voxel grid, in voxels. </summary>
+	uint32_t m_resolution = 0;
+
+	/// <summary> The push constants of the compute shader. Must match shader_voxelize.comp. </summary>
+	struct PushConstants {
+		glm::vec3 mesh_min;
+		float scale;
+		uint32_t triangle_count;
+	};
+
+	/// <summary> The mesh-to-voxel transform, pushed every dispatch. </summary>
+	PushConstants m_push_constants{};
+
+	void CreateDescriptors();
+
+	void CreatePipeline();
+
+public:
+
+	/// <summary> The number of triangles voxelized by each workgroup. Must match local_size_x in shader_voxelize.comp. </summary>
+	static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+	/// <summary>
+	/// Creates a GPU voxelizer for a mesh that is already on the device.
+	/// </summary>
+	/// <param name="brick_pool"> The pool to write to. Must have a complete octree of resolution / brick_size bricks per side pinned. </param>
+	/// <param name="vertex_buffer"> The vertex buffer, created with storage buffer usage. </param>
+	/// <param name="index_buffer"> The index buffer, created with storage buffer usage. </param>
+	/// <param name="vertices"> The host copy of the vertex buffer. </param>
+	/// <param name="indices"> The host copy of the index buffer. </param>
+	/// <param name="resolution"> The width of the voxel grid, in voxels. </param>
+	static std::shared_ptr<GPUVoxelizer> Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::CommandPool> command_pool, std::shared_ptr<BrickPool> brick_pool, std::shared_ptr<VWrap::Buffer> vertex_buffer, std::shared_ptr<VWrap::Buffer> index_buffer, const std::vector<VWrap::Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t resolution);
+
+	/// <summary>
+	/// Records the commands to clear the brick pool's slots and voxelize the mesh into them. Must be recorded outside of a render pass.
+	/// The writes are made visible to fragment and compute shader reads.
+	/// </summary>
+	void CmdVoxelize(std::shared_ptr<VWrap::CommandBuffer> command_buffer);
+
+	/// <summary>
+	/// Voxelizes the mesh on the GPU, reads the slots back and compares them with the CPU Voxelizer's output, packed the same way.
+	/// Prints the result to stdout. Overwrites every slot of the brick pool, so no frame in flight may be reading it.
+	/// </summary>
+	/// <returns> The number of occupancy bits that differ. </returns>
+	uint64_t Validate();
+
+	/// <summary>
+	/// Voxelizes a few small meshes (a triangle, a tetrahedron, an axis-aligned cube and a sphere) at 16^3, 32^3 and 64^3 on the GPU,
+	/// each into a pinned brick pool of its own, and compares them bit for bit with the CPU Voxelizer. Prints each case to stdout,
+	/// and throws on the first one that differs.
+	/// </summary>
+	/// <param name="command_pool"> A graphics command pool, used for the dispatches and to acquire the uploaded meshes. </param>
+	/// <param name="upload_service"> Uploads the meshes and the brick pools' page tables. </param>
+	/// <param name="retirement_queue"> Handed to the brick pools. </param>
+	static void RunTests(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::CommandPool> command_pool, std::shared_ptr<UploadService> upload_service, std::shared_ptr<VWrap::RetirementQueue> retirement_queue);
+
+	/// <summary> Gets the number of triangles voxelized per dispatch. </summary>
+	uint32_t GetTriangleCount() const { return m_triangle_count; }
+};
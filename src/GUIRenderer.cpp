@@ -21,7 +21,7 @@ std::shared_ptr<GUIRenderer> GUIRenderer::Create(std::shared_ptr<VWrap::Device>
 	return ret;
 }
 
-void GUIRenderer::CmdDraw(std::shared_ptr<VWrap::CommandBuffer> command_buffer, float time, float fps, float& sensitivity, float& speed) {
+void GUIRenderer::CmdDraw(std::shared_ptr<VWrap::CommandBuffer> command_buffer, const GUIMetrics& metrics, GUISettings& settings) {
 
 	//ImGui::ShowDemoWindow();
 	// Variables to manage simulation state and render time
@@ -31,8 +31,87 @@ void GUIRenderer::CmdDraw(std::shared_ptr<VWrap::CommandBuffer> command_buffer,
 	ImGui::Begin("Simulation Control");
 
 	// Display the render time
-	ImGui::Text("Render Time: %.3f ms", time);
-	ImGui::Text("FPS: %.3f ms", fps);
+	ImGui::Text("Render Time: %.3f ms", metrics.performance.render_time);
+	for (const auto& stage : metrics.performance.stages)
+		ImGui::Text("  %s: %.3f ms", stage.name, stage.time);
+	ImGui::Text("FPS: %.3f ms", metrics.performance.fps);
+	ImGui::Text("Steps / Ray: %.2f", metrics.steps_per_ray);
+	ImGui::Text("Reprojected: %.1f%% of rays, %.1f%% found", metrics.reprojected_fraction * 100.0f, metrics.reprojection_success * 100.0f);
+
+	// Brick pool residency
+	const BrickPoolStats& bricks = metrics.performance.brick_pool;
+	ImGui::Text("Bricks Resident: %u", bricks.resident);
+	ImGui::Text("Brick Hits: %u  Misses: %u  Evictions: %u  Edits: %u", bricks.hits, bricks.misses, bricks.evictions, bricks.edits);
+	ImGui::Text("Stream Queue: %u  Streamed: %.2f MiB/frame", bricks.stream_queue, bricks.stream_bytes / (1024.0 * 1024.0));
+
+	// Reference scene selection
+	if (ImGui::BeginCombo("Scene", OctreeTracer::GetSceneName(settings.scene))) {
+		for (int i = 0; i < (int)TracerScene::COUNT; i++) {
+			TracerScene option = static_cast<TracerScene>(i);
+			if (ImGui::Selectable(OctreeTracer::GetSceneName(option), option == settings.scene))
+				settings.scene = option;
+		}
+		ImGui::EndCombo();
+	}
+
+	// Ray dispatch, to compare the fragment, compute and wavefront tracers on the same scene
+	if (ImGui::BeginCombo("Tracer", OctreeTracer::GetPathName(settings.path))) {
+		for (int i = 0; i < (int)TracerPath::COUNT; i++) {
+			TracerPath option = static_cast<TracerPath>(i);
+			if (ImGui::Selectable(OctreeTracer::GetPathName(option), option == settings.path))
+				settings.path = option;
+		}
+		ImGui::EndCombo();
+	}
+
+	// Start the fragment and compute paths' rays from a conservative per-block distance, to compare Steps / Ray with and without
+	ImGui::Checkbox("Beam Prepass", &settings.beam_prepass);
+
+	// Start rays just before the hit the previous frame saw through each pixel; the debug view tints pixels green where the hit was found,
+	// red where it was not and the ray was traced again, and blue where nothing was reprojected
+	ImGui::Checkbox("Temporal Reprojection", &settings.reprojection);
+	ImGui::SameLine();
+	ImGui::Checkbox("Debug View", &settings.reprojection_debug);
+
+	// Trace fewer pixels and stretch them over the screen whenever the GPU time of a frame runs over the target
+	ImGui::Checkbox("Dynamic Resolution", &settings.dynamic_resolution);
+	ImGui::SliderFloat("Target Frame Time", &settings.target_frame_ms, 4.0f, 33.3f, "%.1f ms");
+
+	// Trace a fraction of the pixels with a different sub-pixel jitter every frame, and rebuild the rest from previous frames.
+	// The compute and wavefront paths only; dynamic resolution scales down from the mode's size.
+	if (ImGui::BeginCombo("Upscaling", TemporalUpscaler::GetModeName(settings.upscale_mode))) {
+		for (int i = 0; i < (int)UpscaleMode::COUNT; i++) {
+			UpscaleMode option = static_cast<UpscaleMode>(i);
+			if (ImGui::Selectable(TemporalUpscaler::GetModeName(option), option == settings.upscale_mode))
+				settings.upscale_mode = option;
+		}
+		ImGui::EndCombo();
+	}
+	ImGui::Text("Render Size: %ux%u", metrics.render_extent.width, metrics.render_extent.height);
+
+	// Frames in flight and present mode; fewer frames queued behind each other get input to the screen sooner
+	if (ImGui::BeginCombo("Latency", LatencyController::GetProfileName(settings.latency_profile))) {
+		for (int i = 0; i < (int)LatencyProfile::COUNT; i++) {
+			LatencyProfile option = static_cast<LatencyProfile>(i);
+			if (ImGui::Selectable(LatencyController::GetProfileName(option), option == settings.latency_profile))
+				settings.latency_profile = option;
+		}
+		ImGui::EndCombo();
+	}
+	ImGui::Text("Input Latency: %.1f ms", metrics.input_latency_ms);
+
+	// Scene size before and after DAG compression
+	ImGui::Text("Octree: %u nodes, %u bricks, %.2f MiB (%.1f ms)", metrics.scene_stats.node_count, metrics.scene_stats.brick_count, metrics.scene_stats.bytes / (1024.0 * 1024.0), metrics.scene_stats.build_ms);
+	ImGui::Text("DAG: %u nodes, %u bricks, %.2f MiB (%.1f ms)", metrics.scene_stats.dag_node_count, metrics.scene_stats.dag_brick_count, metrics.scene_stats.dag_bytes / (1024.0 * 1024.0), metrics.scene_stats.dag_build_ms);
+	ImGui::Text("Compression: %.2fx", metrics.scene_stats.dag_bytes == 0 ? 0.0 : (double)metrics.scene_stats.bytes / (double)metrics.scene_stats.dag_bytes);
+
+	// Voxel edits, applied to a cube in front of the camera
+	ImGui::SliderInt("Edit Size", &settings.edit_size, 1, 128);
+	if (ImGui::Button("Carve"))
+		settings.edit = EditAction::CARVE;
+	ImGui::SameLine();
+	if (ImGui::Button("Fill"))
+		settings.edit = EditAction::FILL;
 
 	// Button to pause the simulation
 	if (ImGui::Button("Pause")) {
@@ -50,10 +129,10 @@ void GUIRenderer::CmdDraw(std::shared_ptr<VWrap::CommandBuffer> command_buffer,
 	}
 
 	// Slider for mouse sensitivity
-	ImGui::SliderFloat("Mouse Sensitivity", &sensitivity, 0.01f, 2.0f, "%.3f");
+	ImGui::SliderFloat("Mouse Sensitivity", &settings.sensitivity, 0.01f, 2.0f, "%.3f");
 
 	// Slider for movement speed
-	ImGui::SliderFloat("Movement Speed", &speed, 0.1f, 10.0f, "%.3f");
+	ImGui::SliderFloat("Movement Speed", &settings.speed, 0.1f, 10.0f, "%.3f");
 
 
 	// End the ImGUI window
@@ -8,6 +8,43 @@
 #include "Device.h"
 #include "Queue.h"
 #include "CommandBuffer.h"
+#include "OctreeTracer.h"
+#include "GPUProfiler.h"
+#include "LatencyController.h"
+
+/// <summary>
+/// The settings the GUI shows and edits.
+/// </summary>
+struct GUISettings {
+	float sensitivity = 0.5f;
+	float speed = 5.0f;
+	TracerScene scene = TracerScene::SPHERE;
+	TracerPath path = TracerPath::COMPUTE;
+	bool beam_prepass = true;
+	bool reprojection = true;
+	bool reprojection_debug = false;
+	bool dynamic_resolution = true;
+	float target_frame_ms = 1000.0f / 60.0f;
+	UpscaleMode upscale_mode = UpscaleMode::OFF;
+	LatencyProfile latency_profile = LatencyProfile::BALANCED;
+	int edit_size = 16;
+
+	/// <summary> Set by the Carve and Fill buttons. Reset by the application once the edit is applied. </summary>
+	EditAction edit = EditAction::NONE;
+};
+
+/// <summary>
+/// The measurements of the last frames the GUI displays.
+/// </summary>
+struct GUIMetrics {
+	GPUProfiler::PerformanceMetrics performance;
+	float steps_per_ray = 0.0f;
+	float reprojected_fraction = 0.0f;
+	float reprojection_success = 0.0f;
+	VkExtent2D render_extent{};
+	SceneStats scene_stats{};
+	float input_latency_ms = 0.0f;
+};
 
 /// <summary>
 /// Wrapper for ImGui control. Defines GUI and render it.
@@ -36,7 +73,8 @@ public:
 	/// <summary>
 	/// Records to the command buffer ImGui draw commands.
 	/// </summary>
-	void CmdDraw(std::shared_ptr<VWrap::CommandBuffer> command_buffer, float time, float fps, float& sensitivity, float& speed);
+	/// <param name="settings"> Updated with whatever the user changed this frame. </param>
+	void CmdDraw(std::shared_ptr<VWrap::CommandBuffer> command_buffer, const GUIMetrics& metrics, GUISettings& settings);
 
 	void BeginFrame();
 
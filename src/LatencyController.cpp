@@ -0,0 +1,135 @@
+#include "LatencyController.h"
+
+std::shared_ptr<LatencyController> LatencyController::Create(std::shared_ptr<VWrap::FrameController> frame_controller, LatencyProfile profile)
+{
+	auto ret = std::make_shared<LatencyController>();
+	ret->m_frame_controller = frame_controller;
+	ret->m_timeline = frame_controller->GetFrameTimeline();
+	ret->m_profile = profile;
+	frame_controller->SetFramesInFlight(GetProfileFrames(profile));
+	frame_controller->SetPresentMode(GetProfilePresentMode(profile));
+
+	if (ret->m_timeline)
+		ret->m_worker = std::thread(&LatencyController::WorkerLoop, ret.get());
+
+	return ret;
+}
+
+LatencyController::~LatencyController()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	if (m_worker.joinable())
+		m_worker.join();
+}
+
+const char* LatencyController::GetProfileName(LatencyProfile profile)
+{
+	switch (profile) {
+	case LatencyProfile::THROUGHPUT:
+		return "Throughput (3 frames, FIFO)";
+	case LatencyProfile::BALANCED:
+		return "Balanced (2 frames, Mailbox)";
+	case LatencyProfile::LOW_LATENCY:
+		return "Low Latency (1 frame, Immediate)";
+	default:
+		return "Unknown";
+	}
+}
+
+uint32_t LatencyController::GetProfileFrames(LatencyProfile profile)
+{
+	switch (profile) {
+	case LatencyProfile::THROUGHPUT:
+		return 3;
+	case LatencyProfile::LOW_LATENCY:
+		return 1;
+	default:
+		return 2;
+	}
+}
+
+VkPresentModeKHR LatencyController::GetProfilePresentMode(LatencyProfile profile)
+{
+	switch (profile) {
+	case LatencyProfile::THROUGHPUT:
+		return VK_PRESENT_MODE_FIFO_KHR;
+	case LatencyProfile::LOW_LATENCY:
+		return VK_PRESENT_MODE_IMMEDIATE_KHR;
+	default:
+		return VK_PRESENT_MODE_MAILBOX_KHR;
+	}
+}
+
+void LatencyController::SetProfile(LatencyProfile profile)
+{
+	m_frame_controller->SetFramesInFlight(GetProfileFrames(profile));
+	m_frame_controller->SetPresentMode(GetProfilePresentMode(profile));
+	m_profile = profile;
+
+	// The device is idle, so every pending frame has finished; their latencies belong to the old profile
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pending.clear();
+	m_smoothed_ms = 0.0f;
+}
+
+void LatencyController::RecordInput()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.push_back({ m_frame_controller->GetFrameNumber(), Clock::now() });
+	}
+	m_condition.notify_one();
+}
+
+void LatencyController::Poll()
+{
+	if (m_timeline)
+		return;
+
+	uint64_t completed = m_frame_controller->GetCompletedFrame();
+	Clock::time_point now = Clock::now();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (!m_pending.empty() && m_pending.front().first <= completed)
+		AddSample(now);
+}
+
+float LatencyController::GetLatency()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_smoothed_ms;
+}
+
+void LatencyController::WorkerLoop()
+{
+	while (true) {
+		uint64_t frame;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [&] { return m_stopping || !m_pending.empty(); });
+			if (m_stopping)
+				return;
+			frame = m_pending.front().first;
+		}
+
+		// A frame's value may be waited on before it is submitted; the timeout only bounds how late a stop is seen
+		if (!m_timeline->Wait(frame, WAIT_TIMEOUT))
+			continue;
+		Clock::time_point finished = Clock::now();
+
+		// A profile change may have dropped the frame in the meantime
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_pending.empty() && m_pending.front().first == frame)
+			AddSample(finished);
+	}
+}
+
+void LatencyController::AddSample(Clock::time_point finished)
+{
+	float latency_ms = std::chrono::duration<float, std::chrono::milliseconds::period>(finished - m_pending.front().second).count();
+	m_pending.pop_front();
+	m_smoothed_ms = m_smoothed_ms == 0.0f ? latency_ms : m_smoothed_ms + SMOOTHING * (latency_ms - m_smoothed_ms);
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include "FrameController.h"
+#include "Semaphore.h"
+
+#include <memory>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/// <summary>
+/// How the frame controller trades throughput for responsiveness.
+/// </summary>
+enum class LatencyProfile {
+	THROUGHPUT, BALANCED, LOW_LATENCY, COUNT
+};
+
+/// <summary>
+/// Applies a latency profile to the frame controller, and measures the latency from each frame's input to its image being handed
+/// to presentation. More frames in flight and FIFO presentation keep the GPU busy, at the cost of each frame's input waiting behind
+/// the frames queued before it. The low latency profile also samples input late: the main loop waits for its one frame in flight
+/// before polling input, rather than after.
+/// The latency of a frame runs from its input being polled to the GPU finishing it, after which the present engine may still hold
+/// the image back, as FIFO does until vertical blank. Where timeline semaphores are supported, a worker thread waits on the frame
+/// timeline for each frame in turn, so that the time it finished is seen as it happens; otherwise frames are polled once per frame.
+/// </summary>
+class LatencyController
+{
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	std::shared_ptr<VWrap::FrameController> m_frame_controller;
+
+	/// <summary> The frame controller's timeline, which the worker waits on. Null without timeline semaphores. </summary>
+	std::shared_ptr<VWrap::Semaphore> m_timeline;
+
+	/// <summary> The profile last applied. </summary>
+	LatencyProfile m_profile = LatencyProfile::BALANCED;
+
+	// WORKER
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stopping = false;
+	std::thread m_worker;
+
+	/// <summary> The number of each frame recorded and not yet finished, oldest first, and when its input was polled. </summary>
+	std::deque<std::pair<uint64_t, Clock::time_point>> m_pending;
+
+	/// <summary> The exponential moving average of the latency, in milliseconds. 0 until the first sample. </summary>
+	float m_smoothed_ms = 0.0f;
+
+	/// <summary> The longest the worker blocks on the timeline before checking whether it should stop, in nanoseconds. </summary>
+	static constexpr uint64_t WAIT_TIMEOUT = 50'000'000;
+
+	/// <summary> Waits on the frame timeline for each pending frame in turn, and takes its latency. </summary>
+	void WorkerLoop();
+
+	/// <summary> Takes the latency of the oldest pending frame, which finished at the given time. The mutex must be held. </summary>
+	void AddSample(Clock::time_point finished);
+
+public:
+
+	/// <summary> The weight of each new sample in the smoothed latency. </summary>
+	static constexpr float SMOOTHING = 0.1f;
+
+	/// <summary>
+	/// Creates a controller for the given frame controller, and applies the given profile to it.
+	/// </summary>
+	static std::shared_ptr<LatencyController> Create(std::shared_ptr<VWrap::FrameController> frame_controller, LatencyProfile profile);
+
+	~LatencyController();
+
+	/// <summary> Gets the display name of a profile. </summary>
+	static const char* GetProfileName(LatencyProfile profile);
+
+	/// <summary> Gets the number of frames in flight of a profile. </summary>
+	static uint32_t GetProfileFrames(LatencyProfile profile);
+
+	/// <summary> Gets the present mode a profile prefers. The swapchain falls back to another where the surface lacks it. </summary>
+	static VkPresentModeKHR GetProfilePresentMode(LatencyProfile profile);
+
+	/// <summary>
+	/// Sets the frames in flight and the present mode of the frame controller to those of the profile, and forgets the smoothed
+	/// latency. Waits for the device to idle, so must not be called between acquiring and rendering a frame.
+	/// </summary>
+	void SetProfile(LatencyProfile profile);
+
+	/// <summary> Gets the profile last applied. </summary>
+	LatencyProfile GetProfile() const { return m_profile; }
+
+	/// <summary> Gets whether the main loop should acquire each frame before polling its input. </summary>
+	bool SamplesInputLate() const { return m_profile == LatencyProfile::LOW_LATENCY; }
+
+	/// <summary>
+	/// Records that the input of the frame being recorded was polled now. Called once per frame, before the frame is rendered.
+	/// </summary>
+	void RecordInput();
+
+	/// <summary> Takes the latency of the frames that have finished, without timeline semaphores. Called once per frame. </summary>
+	void Poll();
+
+	/// <summary> Gets the smoothed latency from a frame's input to its image being handed to presentation, in milliseconds. </summary>
+	float GetLatency();
+};
@@ -2,46 +2,18 @@
 
 inline void MeshRasterizer::CreateVertexBuffer() {
 	VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
-
-	auto staging_buffer = VWrap::Buffer::CreateStaging(m_allocator, bufferSize);
-
-	void* data;
-	vmaMapMemory(m_allocator->Get(), staging_buffer->GetAllocation(), &data);
-	memcpy(data, m_vertices.data(), (size_t)bufferSize);
-	vmaUnmapMemory(m_allocator->Get(), staging_buffer->GetAllocation());
-
-	m_vertex_buffer = VWrap::Buffer::Create(m_allocator,
+	m_upload_service->UploadBuffer(m_vertex_buffer,
+		m_vertices.data(),
 		bufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		0);
-
-	auto command_buffer = VWrap::CommandBuffer::Create(m_graphics_pool);
-	command_buffer->BeginSingle();
-	command_buffer->CmdCopyBuffer(staging_buffer, m_vertex_buffer, bufferSize);
-	command_buffer->EndAndSubmit();
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 }
 
 inline void MeshRasterizer::CreateIndexBuffer() {
 	VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
-
-	auto staging_buffer = VWrap::Buffer::CreateStaging(m_allocator, bufferSize);
-
-	void* data;
-	vmaMapMemory(m_allocator->Get(), staging_buffer->GetAllocation(), &data);
-	memcpy(data, m_indices.data(), (size_t)bufferSize);
-	vmaUnmapMemory(m_allocator->Get(), staging_buffer->GetAllocation());
-
-	m_index_buffer = VWrap::Buffer::Create(m_allocator,
+	m_upload_service->UploadBuffer(m_index_buffer,
+		m_indices.data(),
 		bufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		0);
-
-	auto command_buffer = VWrap::CommandBuffer::Create(m_graphics_pool);
-	command_buffer->BeginSingle();
-	command_buffer->CmdCopyBuffer(staging_buffer, m_index_buffer, bufferSize);
-	command_buffer->EndAndSubmit();
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 }
 
 inline void MeshRasterizer::CreateUniformBuffers() {
@@ -135,12 +107,13 @@ inline void MeshRasterizer::LoadModel() {
 	std::cout << "Finished loading" << std::endl;
 }
 
-std::shared_ptr<MeshRasterizer> MeshRasterizer::Create(std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::RenderPass> render_pass, std::shared_ptr<VWrap::CommandPool> graphics_pool, VkExtent2D extent, uint32_t num_frames) {
+std::shared_ptr<MeshRasterizer> MeshRasterizer::Create(std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::RenderPass> render_pass, std::shared_ptr<VWrap::CommandPool> graphics_pool, std::shared_ptr<UploadService> upload_service, VkExtent2D extent, uint32_t num_frames) {
 	auto ret = std::make_shared<MeshRasterizer>();
 	ret->m_device = device;
 	ret->m_allocator = allocator;
 	ret->m_extent = extent;
 	ret->m_graphics_pool = graphics_pool;
+	ret->m_upload_service = upload_service;
 
 	ret->CreateDescriptors(num_frames);
 	ret->CreatePipeline(render_pass);
@@ -16,6 +16,7 @@
 #include "Allocator.h"
 
 #include "Camera.h"
+#include "UploadService.h"
 
 #include "tiny_obj_loader.h"
 #include <unordered_map>
@@ -67,6 +68,7 @@ private:
 	std::shared_ptr<VWrap::Device> m_device;
 	std::shared_ptr<VWrap::CommandPool> m_graphics_pool;
 	std::shared_ptr<VWrap::Allocator> m_allocator;
+	std::shared_ptr<UploadService> m_upload_service;
 
 	// TEXTURES
 	std::shared_ptr<VWrap::ImageView> m_texture_image_view;
@@ -126,11 +128,12 @@ public:
 	/// </summary>
 	/// <param name="device"> The device to create everything. </param>
 	/// <param name="render_pass"> Defines the pipeline. </param>
-	/// <param name="graphics_pool"> The pool to load textures and buffers. Must be transfer and graphics compatible. </param>
+	/// <param name="graphics_pool"> The pool to load textures. Must be transfer and graphics compatible. </param>
+	/// <param name="upload_service"> Uploads the vertex and index buffers on the transfer queue. </param>
 	/// <param name="extent"> The extent of the pipeline. </param>
 	/// <param name="num_frames"> The max number of frames. Defines number of descriptor sets. </param>
 	/// <returns> A pointer to a new MeshRasterizer </returns>
-	static std::shared_ptr<MeshRasterizer> Create(std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::RenderPass> render_pass, std::shared_ptr<VWrap::CommandPool> graphics_pool, VkExtent2D extent, uint32_t num_frames);
+	static std::shared_ptr<MeshRasterizer> Create(std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::RenderPass> render_pass, std::shared_ptr<VWrap::CommandPool> graphics_pool, std::shared_ptr<UploadService> upload_service, VkExtent2D extent, uint32_t num_frames);
 
 	/// <summary>
 	/// Records commands to the command_buffer to draw the model using rasterization.
@@ -153,5 +156,17 @@ public:
 	void Resize(VkExtent2D extent) {
 		m_extent = extent;
 	}
+
+	/// <summary> Gets the vertex buffer. Also usable as a storage buffer. </summary>
+	std::shared_ptr<VWrap::Buffer> GetVertexBuffer() const { return m_vertex_buffer; }
+
+	/// <summary> Gets the index buffer. Also usable as a storage buffer. </summary>
+	std::shared_ptr<VWrap::Buffer> GetIndexBuffer() const { return m_index_buffer; }
+
+	/// <summary> Gets the vertices uploaded to the vertex buffer. </summary>
+	const std::vector<VWrap::Vertex>& GetVertices() const { return m_vertices; }
+
+	/// <summary> Gets the indices uploaded to the index buffer. </summary>
+	const std::vector<uint32_t>& GetIndices() const { return m_indices; }
 };
 
@@ -1 +1,873 @@
 #include "Octree.h"
+#include <unordered_map>
+#include <queue>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <bit>
+#include <sstream>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+	/// <summary>
+	/// Packs a coordinate (each component below 2^21) into a single key.
+	/// </summary>
+	uint64_t CoordKey(glm::uvec3 coord) {
+		return (uint64_t)coord.x | ((uint64_t)coord.y << 21) | ((uint64_t)coord.z << 42);
+	}
+
+	/// <summary>
+	/// Interleaves a coordinate's bits (each component below 2^21), x lowest, so that the low three bits of a cell's code are its octant in its parent.
+	/// </summary>
+	uint64_t MortonCode(glm::uvec3 coord) {
+		auto spread = [](uint64_t v) {
+			v &= 0x1FFFFF;
+			v = (v | (v << 32)) & 0x1F00000000FFFFull;
+			v = (v | (v << 16)) & 0x1F0000FF0000FFull;
+			v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+			v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+			v = (v | (v << 2)) & 0x1249249249249249ull;
+			return v;
+		};
+		return spread(coord.x) | (spread(coord.y) << 1) | (spread(coord.z) << 2);
+	}
+
+	/// <summary>
+	/// 64-bit FNV-1a, used to bucket bricks and subtrees before comparing them exactly.
+	/// </summary>
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	/// <summary>
+	/// Gets the depth of an octree of the given size, validating that the size is the brick size times a power of two.
+	/// </summary>
+	uint32_t ComputeDepth(uint32_t size, uint32_t brick_size) {
+		if (brick_size == 0 || size % brick_size != 0)
+			throw std::invalid_argument("Octree size must be a multiple of the brick size!");
+
+		uint32_t bricks_per_side = size / brick_size;
+		if ((bricks_per_side & (bricks_per_side - 1)) != 0)
+			throw std::invalid_argument("Octree size must be the brick size times a power of two!");
+
+		uint32_t depth = 0;
+		while ((1u << depth) < bricks_per_side) depth++;
+		return depth;
+	}
+}
+
+bool Octree::IsEmpty(const uint8_t* voxels, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		if (voxels[i] != 0) return false;
+	return true;
+}
+
+std::shared_ptr<Octree> Octree::Create(const std::vector<uint8_t>& voxels, uint32_t size, uint32_t brick_size) {
+	uint32_t depth = ComputeDepth(size, brick_size);
+	uint32_t bricks_per_side = size / brick_size;
+
+	if (voxels.size() != (size_t)size * size * size)
+		throw std::invalid_argument("Voxel count does not match octree size!");
+
+	// Cut the grid into bricks, skipping empty ones
+	std::vector<OctreeBrick> bricks;
+	size_t brick_voxels = (size_t)brick_size * brick_size * brick_size;
+	std::vector<uint8_t> scratch(brick_voxels);
+
+	for (uint32_t bz = 0; bz < bricks_per_side; bz++)
+	for (uint32_t by = 0; by < bricks_per_side; by++)
+	for (uint32_t bx = 0; bx < bricks_per_side; bx++) {
+		for (uint32_t z = 0; z < brick_size; z++)
+		for (uint32_t y = 0; y < brick_size; y++) {
+			size_t src = ((size_t)(bz * brick_size + z) * size + (by * brick_size + y)) * size + bx * brick_size;
+			memcpy(&scratch[((size_t)z * brick_size + y) * brick_size], &voxels[src], brick_size);
+		}
+
+		if (IsEmpty(scratch.data(), brick_voxels)) continue;
+		bricks.push_back({ glm::uvec3(bx, by, bz), scratch });
+	}
+
+	return CreateFromBricks(bricks, depth, brick_size);
+}
+
+std::shared_ptr<Octree> Octree::CreateFromBricks(const std::vector<OctreeBrick>& bricks, uint32_t depth, uint32_t brick_size) {
+	if (depth > 20)
+		throw std::invalid_argument("Octree depth must not exceed 20!");
+
+	auto ret = std::make_shared<Octree>();
+	ret->m_brick_size = brick_size;
+	ret->m_depth = depth;
+
+	size_t brick_voxels = ret->GetBrickVoxelCount();
+
+	// Sort the leaves by Morton code. Breadth-first order visits each level in Morton order, so sorting
+	// lays out every level at once, with the children of every node contiguous and in octant order.
+	struct Leaf {
+		uint64_t code;
+		size_t source;
+	};
+	std::vector<Leaf> leaves;
+	leaves.reserve(bricks.size());
+	for (size_t i = 0; i < bricks.size(); i++) {
+		const auto& brick = bricks[i];
+		if (brick.voxels.size() != brick_voxels)
+			throw std::invalid_argument("Brick voxel count does not match brick size!");
+		if (IsEmpty(brick.voxels.data(), brick_voxels)) continue;
+		leaves.push_back({ MortonCode(brick.coord), i });
+	}
+	std::stable_sort(leaves.begin(), leaves.end(), [](const Leaf& a, const Leaf& b) { return a.code < b.code; });
+
+	// Of duplicate coordinates, the last brick wins
+	size_t unique = 0;
+	for (size_t i = 0; i < leaves.size(); i++) {
+		if (unique > 0 && leaves[unique - 1].code == leaves[i].code)
+			leaves[unique - 1] = leaves[i];
+		else
+			leaves[unique++] = leaves[i];
+	}
+	leaves.resize(unique);
+
+	// The occupied cells of every level, from the leaves up to the root, each sorted
+	std::vector<std::vector<uint64_t>> levels(depth + 1);
+	levels[depth].reserve(leaves.size());
+	for (const auto& leaf : leaves)
+		levels[depth].push_back(leaf.code);
+	for (int level = depth - 1; level >= 0; level--) {
+		for (uint64_t code : levels[level + 1]) {
+			if (levels[level].empty() || levels[level].back() != code >> 3)
+				levels[level].push_back(code >> 3);
+		}
+	}
+
+	if (leaves.empty()) {
+		ret->m_nodes.push_back({ 0, 0 });
+		return ret;
+	}
+
+	size_t node_count = 0;
+	for (const auto& level : levels)
+		node_count += level.size();
+	ret->m_nodes.resize(node_count);
+	ret->m_bricks.resize(leaves.size() * brick_voxels);
+
+	// Nodes of each level follow those of the level above; a node's children are the next run of the level below sharing its code
+	size_t level_start = 0;
+	for (uint32_t level = 0; level <= depth; level++) {
+		size_t next_start = level_start + levels[level].size();
+		size_t child = 0;
+		for (size_t position = 0; position < levels[level].size(); position++) {
+			size_t node = level_start + position;
+
+			if (level == depth) {
+				const auto& voxels = bricks[leaves[position].source].voxels;
+				memcpy(ret->m_bricks.data() + position * brick_voxels, voxels.data(), brick_voxels);
+				ret->m_nodes[node] = { LEAF_FLAG, static_cast<int32_t>(position) };
+				continue;
+			}
+
+			uint32_t mask = 0;
+			size_t first_child = next_start + child;
+			const auto& children = levels[level + 1];
+			while (child < children.size() && (children[child] >> 3) == levels[level][position]) {
+				mask |= 1u << (children[child] & 7);
+				child++;
+			}
+
+			ret->m_nodes[node] = { mask, static_cast<int32_t>(first_child - node) };
+		}
+		level_start = next_start;
+	}
+
+	return ret;
+}
+
+std::shared_ptr<Octree> Octree::CreateSphere(uint32_t size, uint32_t brick_size) {
+	std::vector<uint8_t> voxels((size_t)size * size * size);
+
+	glm::vec3 center = glm::vec3(size / 2.0f);
+	float radius = size / 4.0f;
+	for (uint32_t z = 0; z < size; z++)
+	for (uint32_t y = 0; y < size; y++)
+	for (uint32_t x = 0; x < size; x++) {
+		if (glm::distance(glm::vec3(x, y, z), center) < radius)
+			voxels[((size_t)z * size + y) * size + x] = 1;
+	}
+
+	return Create(voxels, size, brick_size);
+}
+
+std::shared_ptr<Octree> Octree::CreateScatteredSpheres(uint32_t size, uint32_t brick_size, uint32_t count, uint32_t seed) {
+	uint32_t depth = ComputeDepth(size, brick_size);
+	size_t brick_voxels = (size_t)brick_size * brick_size * brick_size;
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> radius_dist(size / 128.0f, size / 32.0f);
+	std::uniform_real_distribution<float> unit_dist(0.0f, 1.0f);
+
+	// Rasterize each sphere into only the bricks its bounds touch, so the volume is never stored densely
+	std::unordered_map<uint64_t, OctreeBrick> bricks;
+	for (uint32_t i = 0; i < count; i++) {
+		float radius = radius_dist(rng);
+		glm::vec3 center = glm::vec3(unit_dist(rng), unit_dist(rng), unit_dist(rng)) * (size - 2.0f * radius) + radius;
+
+		glm::uvec3 lo = glm::uvec3(glm::max(glm::floor(center - radius), glm::vec3(0.0f)));
+		glm::uvec3 hi = glm::uvec3(glm::min(glm::ceil(center + radius), glm::vec3((float)size - 1.0f)));
+
+		for (uint32_t z = lo.z; z <= hi.z; z++)
+		for (uint32_t y = lo.y; y <= hi.y; y++)
+		for (uint32_t x = lo.x; x <= hi.x; x++) {
+			if (glm::distance(glm::vec3(x, y, z), center) >= radius) continue;
+
+			glm::uvec3 voxel(x, y, z);
+			glm::uvec3 coord = voxel / brick_size;
+			auto& brick = bricks[CoordKey(coord)];
+			if (brick.voxels.empty()) {
+				brick.coord = coord;
+				brick.voxels.resize(brick_voxels);
+			}
+
+			glm::uvec3 local = voxel % brick_size;
+			brick.voxels[((size_t)local.z * brick_size + local.y) * brick_size + local.x] = static_cast<uint8_t>(1 + i % 7);
+		}
+	}
+
+	std::vector<OctreeBrick> brick_list;
+	brick_list.reserve(bricks.size());
+	for (auto& [key, brick] : bricks)
+		brick_list.push_back(std::move(brick));
+
+	return CreateFromBricks(brick_list, depth, brick_size);
+}
+
+std::shared_ptr<Octree> Octree::CreateCity(uint32_t size, uint32_t brick_size, uint32_t seed) {
+	uint32_t depth = ComputeDepth(size, brick_size);
+	uint32_t bricks_per_side = size / brick_size;
+	size_t brick_voxels = (size_t)brick_size * brick_size * brick_size;
+
+	// Buildings sit on lots that are a whole number of bricks wide, so equal buildings produce equal bricks
+	const uint32_t lot_size = std::max(brick_size * 4, 32u);
+	const uint32_t ground = brick_size;
+	const uint32_t variants = 4;
+	uint32_t lots_per_side = size / lot_size;
+
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<uint32_t> variant_dist(0, variants - 1);
+	std::vector<uint32_t> lot_variants((size_t)lots_per_side * lots_per_side);
+	for (auto& variant : lot_variants)
+		variant = variant_dist(rng);
+
+	uint32_t margin = lot_size / 8;
+	uint32_t max_height = std::min(ground + (variants + 1) * lot_size / 2, size);
+
+	// Returns the voxel value at a position: ground below, then a building with a window pattern cut into its walls
+	auto voxel_at = [&](uint32_t x, uint32_t y, uint32_t z) -> uint8_t {
+		if (z < ground) return 1;
+
+		uint32_t variant = lot_variants[(size_t)(y / lot_size) * lots_per_side + x / lot_size];
+		uint32_t height = ground + (variant + 1) * lot_size / 2;
+		uint32_t lx = x % lot_size, ly = y % lot_size;
+		if (z >= height || lx < margin || ly < margin || lx >= lot_size - margin || ly >= lot_size - margin) return 0;
+
+		bool wall_x = lx == margin || lx == lot_size - margin - 1;
+		bool wall_y = ly == margin || ly == lot_size - margin - 1;
+		bool window = (z % 4 == 2) && ((wall_x && ly % 4 == 2) || (wall_y && lx % 4 == 2));
+		return window ? 0 : static_cast<uint8_t>(2 + variant);
+	};
+
+	std::vector<OctreeBrick> bricks;
+	std::vector<uint8_t> scratch(brick_voxels);
+	for (uint32_t bz = 0; bz * brick_size < max_height; bz++)
+	for (uint32_t by = 0; by < bricks_per_side; by++)
+	for (uint32_t bx = 0; bx < bricks_per_side; bx++) {
+		for (uint32_t z = 0; z < brick_size; z++)
+		for (uint32_t y = 0; y < brick_size; y++)
+		for (uint32_t x = 0; x < brick_size; x++)
+			scratch[((size_t)z * brick_size + y) * brick_size + x] = voxel_at(bx * brick_size + x, by * brick_size + y, bz * brick_size + z);
+
+		if (IsEmpty(scratch.data(), brick_voxels)) continue;
+		bricks.push_back({ glm::uvec3(bx, by, bz), scratch });
+	}
+
+	return CreateFromBricks(bricks, depth, brick_size);
+}
+
+std::shared_ptr<Octree> Octree::CreateComplete(uint32_t depth, uint32_t brick_size) {
+	if (depth > 6)
+		throw std::invalid_argument("Complete octree depth must not exceed 6!");
+
+	auto ret = std::make_shared<Octree>();
+	ret->m_brick_size = brick_size;
+	ret->m_depth = depth;
+
+	// Level l holds 8^l nodes, and the children of the p-th node of a level are nodes 8p to 8p + 7 of the next.
+	// Flattening breadth-first therefore numbers the leaves in Morton order.
+	uint32_t level_start = 0;
+	for (uint32_t level = 0; level <= depth; level++) {
+		uint32_t level_count = 1u << (3 * level);
+		uint32_t next_start = level_start + level_count;
+
+		for (uint32_t position = 0; position < level_count; position++) {
+			uint32_t node = level_start + position;
+			if (level == depth)
+				ret->m_nodes.push_back({ LEAF_FLAG, static_cast<int32_t>(position) });
+			else
+				ret->m_nodes.push_back({ CHILD_MASK, static_cast<int32_t>(next_start + position * 8 - node) });
+		}
+		level_start = next_start;
+	}
+
+	ret->m_bricks.assign(((size_t)1 << (3 * depth)) * ret->GetBrickVoxelCount(), 0);
+	return ret;
+}
+
+std::shared_ptr<Octree> Octree::CreateDAG(std::shared_ptr<Octree> octree) {
+	auto ret = std::make_shared<Octree>();
+	ret->m_brick_size = octree->m_brick_size;
+	ret->m_depth = octree->m_depth;
+
+	size_t brick_voxels = octree->GetBrickVoxelCount();
+	const auto& nodes = octree->m_nodes;
+
+	// Merge identical bricks. Buckets are keyed by hash, and collisions are resolved by comparing the voxels.
+	std::vector<uint32_t> brick_ids(octree->GetBrickCount());
+	std::unordered_map<uint64_t, std::vector<uint32_t>> brick_buckets;
+	for (uint32_t brick = 0; brick < octree->GetBrickCount(); brick++) {
+		const uint8_t* voxels = octree->GetBrick(brick);
+		auto& bucket = brick_buckets[HashBytes(voxels, brick_voxels)];
+
+		auto match = std::find_if(bucket.begin(), bucket.end(), [&](uint32_t id) {
+			return memcmp(ret->GetBrick(id), voxels, brick_voxels) == 0;
+		});
+		if (match != bucket.end()) {
+			brick_ids[brick] = *match;
+			continue;
+		}
+
+		uint32_t id = static_cast<uint32_t>(ret->m_bricks.size() / brick_voxels);
+		ret->m_bricks.insert(ret->m_bricks.end(), voxels, voxels + brick_voxels);
+		bucket.push_back(id);
+		brick_ids[brick] = id;
+	}
+
+	// Assign every node the id of a unique subtree, bottom-up. Nodes are stored breadth-first, so children always follow
+	// their parent and a reverse walk sees them first. A subtree is identified by its header and its children's ids.
+	struct UniqueNode {
+		uint32_t header;
+		std::vector<uint32_t> children;
+	};
+	std::vector<UniqueNode> unique_nodes;
+	std::vector<uint32_t> node_ids(nodes.size());
+	std::unordered_map<uint64_t, std::vector<uint32_t>> node_buckets;
+
+	for (size_t i = nodes.size(); i-- > 0;) {
+		UniqueNode candidate{ nodes[i].header, {} };
+		if (nodes[i].header & LEAF_FLAG) {
+			candidate.children.push_back(brick_ids[nodes[i].data]);
+		}
+		else {
+			uint32_t child_count = static_cast<uint32_t>(std::popcount(nodes[i].header & CHILD_MASK));
+			for (uint32_t c = 0; c < child_count; c++)
+				candidate.children.push_back(node_ids[i + nodes[i].data + c]);
+		}
+
+		uint64_t hash = HashBytes(&candidate.header, sizeof(candidate.header));
+		hash = HashBytes(candidate.children.data(), candidate.children.size() * sizeof(uint32_t), hash);
+		auto& bucket = node_buckets[hash];
+
+		auto match = std::find_if(bucket.begin(), bucket.end(), [&](uint32_t id) {
+			return unique_nodes[id].header == candidate.header && unique_nodes[id].children == candidate.children;
+		});
+		if (match != bucket.end()) {
+			node_ids[i] = *match;
+			continue;
+		}
+
+		uint32_t id = static_cast<uint32_t>(unique_nodes.size());
+		unique_nodes.push_back(std::move(candidate));
+		bucket.push_back(id);
+		node_ids[i] = id;
+	}
+
+	// Flatten breadth-first again, giving each unique subtree a single block of children. A node may still be written
+	// into several parents' blocks, but each copy points to the same shared block.
+	std::vector<int64_t> child_blocks(unique_nodes.size(), -1);
+	struct Pending {
+		uint32_t position;
+		uint32_t id;
+	};
+	std::queue<Pending> queue;
+
+	ret->m_nodes.push_back({ 0, 0 });
+	if (!nodes.empty())
+		queue.push({ 0, node_ids[0] });
+
+	while (!queue.empty()) {
+		Pending current = queue.front();
+		queue.pop();
+
+		const UniqueNode& unique = unique_nodes[current.id];
+		if (unique.header & LEAF_FLAG) {
+			ret->m_nodes[current.position] = { unique.header, static_cast<int32_t>(unique.children[0]) };
+			continue;
+		}
+
+		if (child_blocks[current.id] < 0) {
+			child_blocks[current.id] = static_cast<int64_t>(ret->m_nodes.size());
+			for (uint32_t child : unique.children) {
+				queue.push({ static_cast<uint32_t>(ret->m_nodes.size()), child });
+				ret->m_nodes.push_back({ 0, 0 });
+			}
+		}
+
+		ret->m_nodes[current.position] = { unique.header, static_cast<int32_t>(child_blocks[current.id] - current.position) };
+	}
+
+	return ret;
+}
+
+bool Octree::FindBrick(glm::uvec3 coord, uint32_t& brick) const {
+	if (m_nodes.empty())
+		return false;
+
+	uint32_t index = 0;
+	for (uint32_t level = m_depth; level > 0; level--) {
+		const OctreeNode& node = m_nodes[index];
+		if (node.header & LEAF_FLAG)
+			break;
+
+		glm::uvec3 upper = (coord >> (level - 1)) & 1u;
+		uint32_t octant = upper.x | (upper.y << 1) | (upper.z << 2);
+		uint32_t child_mask = node.header & CHILD_MASK;
+		if ((child_mask & (1u << octant)) == 0)
+			return false;
+
+		index = index + node.data + std::popcount(child_mask & ((1u << octant) - 1));
+	}
+
+	if ((m_nodes[index].header & LEAF_FLAG) == 0)
+		return false;
+	brick = static_cast<uint32_t>(m_nodes[index].data);
+	return true;
+}
+
+bool Octree::FindPath(glm::uvec3 coord, std::vector<uint32_t>& path) const {
+	path.clear();
+	if (m_nodes.empty())
+		return false;
+
+	uint32_t index = 0;
+	path.push_back(index);
+	for (uint32_t level = m_depth; level > 0; level--) {
+		const OctreeNode& node = m_nodes[index];
+		if (node.header & LEAF_FLAG)
+			break;
+
+		glm::uvec3 upper = (coord >> (level - 1)) & 1u;
+		uint32_t octant = upper.x | (upper.y << 1) | (upper.z << 2);
+		uint32_t child_mask = node.header & CHILD_MASK;
+		if ((child_mask & (1u << octant)) == 0)
+			return false;
+
+		index = index + node.data + std::popcount(child_mask & ((1u << octant) - 1));
+		path.push_back(index);
+	}
+
+	return (m_nodes[index].header & LEAF_FLAG) != 0;
+}
+
+bool Octree::UnshareBrick(glm::uvec3 coord, uint32_t& brick) {
+	if (m_nodes.empty())
+		return false;
+
+	if (m_child_refs.empty()) {
+		m_child_refs.assign(m_nodes.size(), 0);
+		m_brick_refs.assign(GetBrickCount(), 0);
+		for (size_t i = 0; i < m_nodes.size(); i++) {
+			if (m_nodes[i].header & LEAF_FLAG)
+				m_brick_refs[m_nodes[i].data]++;
+			else if (m_nodes[i].header & CHILD_MASK)
+				m_child_refs[i + m_nodes[i].data]++;
+		}
+	}
+
+	// Walk down from the root, which no other node shares, giving each node on the path its own children wherever they are shared
+	uint32_t index = 0;
+	for (uint32_t level = m_depth; level > 0; level--) {
+		if (m_nodes[index].header & LEAF_FLAG)
+			break;
+
+		glm::uvec3 upper = (coord >> (level - 1)) & 1u;
+		uint32_t octant = upper.x | (upper.y << 1) | (upper.z << 2);
+		uint32_t child_mask = m_nodes[index].header & CHILD_MASK;
+		if ((child_mask & (1u << octant)) == 0)
+			return false;
+
+		uint32_t block = index + m_nodes[index].data;
+		if (m_child_refs[block] > 1) {
+			// The copied children point to the same grandchildren and bricks as the originals
+			uint32_t copy = static_cast<uint32_t>(m_nodes.size());
+			uint32_t child_count = static_cast<uint32_t>(std::popcount(child_mask));
+			for (uint32_t c = 0; c < child_count; c++) {
+				OctreeNode child = m_nodes[block + c];
+				if (child.header & LEAF_FLAG)
+					m_brick_refs[child.data]++;
+				else if (child.header & CHILD_MASK) {
+					m_child_refs[block + c + child.data]++;
+					child.data += static_cast<int32_t>(block) - static_cast<int32_t>(copy);
+				}
+				m_nodes.push_back(child);
+				m_child_refs.push_back(0);
+			}
+
+			m_child_refs[block]--;
+			m_child_refs[copy] = 1;
+			m_nodes[index].data = static_cast<int32_t>(copy - index);
+			block = copy;
+		}
+
+		index = block + std::popcount(child_mask & ((1u << octant) - 1));
+	}
+
+	if ((m_nodes[index].header & LEAF_FLAG) == 0)
+		return false;
+
+	brick = static_cast<uint32_t>(m_nodes[index].data);
+	if (m_brick_refs[brick] > 1) {
+		uint32_t copy = GetBrickCount();
+		size_t brick_voxels = GetBrickVoxelCount();
+		m_bricks.resize(m_bricks.size() + brick_voxels);
+		memcpy(GetBrick(copy), GetBrick(brick), brick_voxels);
+
+		m_brick_refs[brick]--;
+		m_brick_refs.push_back(1);
+		m_nodes[index].data = static_cast<int32_t>(copy);
+		brick = copy;
+	}
+	return true;
+}
+
+std::vector<uint32_t> Octree::GetBottomUpOrder() const {
+	// Every leaf lies at the same depth, so a breadth-first walk meets each level after the one above,
+	// and reversed it meets every child before any node that points to it
+	std::vector<uint32_t> order;
+	std::vector<bool> visited(m_nodes.size(), false);
+	if (!m_nodes.empty()) {
+		order.push_back(0);
+		visited[0] = true;
+	}
+
+	for (size_t i = 0; i < order.size(); i++) {
+		const OctreeNode& node = m_nodes[order[i]];
+		if (node.header & LEAF_FLAG)
+			continue;
+
+		uint32_t child_count = static_cast<uint32_t>(std::popcount(node.header & CHILD_MASK));
+		for (uint32_t c = 0; c < child_count; c++) {
+			uint32_t child = order[i] + node.data + c;
+			if (visited[child])
+				continue;
+			visited[child] = true;
+			order.push_back(child);
+		}
+	}
+
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+std::vector<uint32_t> Octree::BuildLOD(const std::vector<glm::vec3>& palette) const {
+	OctreeLOD lod;
+	BuildLOD(palette, lod);
+	return std::move(lod.words);
+}
+
+void Octree::BuildLOD(const std::vector<glm::vec3>& palette, OctreeLOD& lod) const {
+	lod.words.assign(m_nodes.size(), 0);
+	lod.filters.clear();
+	if (m_bricks.empty() || palette.empty())
+		return;
+	lod.filters.resize(m_nodes.size());
+
+	// Copies appended by UnshareBrick may precede their children, so the walk follows the tree rather than the array
+	std::vector<uint8_t> columns((size_t)3 * m_brick_size * m_brick_size);
+	for (uint32_t i : GetBottomUpOrder())
+		FilterNode(i, palette, lod, columns);
+}
+
+void Octree::UpdateLOD(const std::vector<glm::vec3>& palette, const std::vector<glm::uvec3>& bricks, OctreeLOD& lod, std::vector<uint32_t>& nodes) const {
+	nodes.clear();
+	uint32_t old_count = static_cast<uint32_t>(lod.words.size());
+	lod.words.resize(m_nodes.size(), 0);
+	if (m_bricks.empty() || palette.empty())
+		return;
+	lod.filters.resize(m_nodes.size());
+
+	std::vector<uint8_t> columns((size_t)3 * m_brick_size * m_brick_size);
+
+	// UnshareBrick appends the copies of each level after those of the level above, so filtering them in reverse meets
+	// every child before its parent. Their other children are originals, whose filters are already known.
+	for (uint32_t i = static_cast<uint32_t>(m_nodes.size()); i-- > old_count;) {
+		FilterNode(i, palette, lod, columns);
+		nodes.push_back(i);
+	}
+
+	// The nodes on the edited paths, deepest level first
+	std::vector<std::vector<uint32_t>> levels(m_depth + 1);
+	std::vector<uint32_t> path;
+	for (glm::uvec3 coord : bricks) {
+		if (!FindPath(coord, path))
+			continue;
+		for (size_t level = 0; level < path.size(); level++)
+			levels[level].push_back(path[level]);
+	}
+
+	for (size_t level = levels.size(); level-- > 0;) {
+		std::sort(levels[level].begin(), levels[level].end());
+		levels[level].erase(std::unique(levels[level].begin(), levels[level].end()), levels[level].end());
+		for (uint32_t i : levels[level]) {
+			uint32_t word = lod.words[i];
+			FilterNode(i, palette, lod, columns);
+			if (lod.words[i] != word && i < old_count)
+				nodes.push_back(i);
+		}
+	}
+
+	std::sort(nodes.begin(), nodes.end());
+}
+
+void Octree::FilterNode(uint32_t index, const std::vector<glm::vec3>& palette, OctreeLOD& lod, std::vector<uint8_t>& columns) const {
+	const OctreeNode& node = m_nodes[index];
+	OctreeLOD::Filter filter;
+	uint32_t bs = m_brick_size;
+
+	if (node.header & LEAF_FLAG) {
+		const uint8_t* voxels = GetBrick(static_cast<uint32_t>(node.data));
+		std::fill(columns.begin(), columns.end(), 0);
+		uint8_t* column[3] = { columns.data(), columns.data() + bs * bs, columns.data() + 2 * bs * bs };
+
+		for (uint32_t z = 0; z < bs; z++) {
+			for (uint32_t y = 0; y < bs; y++) {
+				for (uint32_t x = 0; x < bs; x++) {
+					uint8_t value = voxels[(z * bs + y) * bs + x];
+					if (value == 0)
+						continue;
+					filter.color_sum += palette[value % palette.size()];
+					filter.count++;
+					column[0][z * bs + y] = 1;
+					column[1][z * bs + x] = 1;
+					column[2][y * bs + x] = 1;
+				}
+			}
+		}
+
+		for (uint32_t axis = 0; axis < 3; axis++)
+			filter.projected[axis] = static_cast<float>(std::count(column[axis], column[axis] + bs * bs, 1)) / (bs * bs);
+	}
+	else {
+		OctreeLOD::Filter children[8];
+		uint32_t child_mask = node.header & CHILD_MASK;
+		uint32_t child = static_cast<uint32_t>(index + node.data);
+		for (uint32_t octant = 0; octant < 8; octant++) {
+			if (child_mask & (1u << octant))
+				children[octant] = lod.filters[child++];
+			filter.color_sum += children[octant].color_sum;
+			filter.count += children[octant].count;
+		}
+
+		// Each axis sees four columns of two children. Surfaces continue from one child into the next, so the two usually
+		// cover the same part of the column, and the column is taken to be covered as much as the more covered child.
+		for (uint32_t axis = 0; axis < 3; axis++) {
+			uint32_t bit = 1u << axis;
+			float covered = 0.0f;
+			for (uint32_t octant = 0; octant < 8; octant++) {
+				if (octant & bit)
+					continue;
+				covered += std::max(children[octant].projected[axis], children[octant | bit].projected[axis]);
+			}
+			filter.projected[axis] = covered / 4.0f;
+		}
+	}
+
+	lod.filters[index] = filter;
+	lod.words[index] = 0;
+	if (filter.count == 0)
+		return;
+
+	glm::uvec3 color = glm::uvec3(glm::clamp(filter.color_sum / static_cast<float>(filter.count), 0.0f, 1.0f) * 255.0f + 0.5f);
+	float coverage = std::max(std::max(filter.projected.x, filter.projected.y), filter.projected.z);
+	uint32_t alpha = std::clamp(static_cast<uint32_t>(std::ceil(coverage * 255.0f)), 1u, 255u);
+	lod.words[index] = color.r | (color.g << 8) | (color.b << 16) | (alpha << 24);
+}
+
+std::shared_ptr<Octree> Octree::CreateFromData(uint32_t brick_size, uint32_t depth, std::vector<OctreeNode> nodes, std::vector<uint8_t> bricks) {
+	auto ret = std::make_shared<Octree>();
+	ret->m_brick_size = brick_size;
+	ret->m_depth = depth;
+	ret->m_nodes = std::move(nodes);
+	ret->m_bricks = std::move(bricks);
+	return ret;
+}
+
+OctreeFileHeader Octree::GetFileHeader() const {
+	OctreeFileHeader header{};
+	header.magic = OctreeFileHeader::MAGIC;
+	header.version = OctreeFileHeader::VERSION;
+	header.brick_size = m_brick_size;
+	header.depth = m_depth;
+	header.node_count = m_nodes.size();
+	header.brick_bytes = m_bricks.size();
+	header.node_offset = OctreeFileHeader::AlignSection(sizeof(OctreeFileHeader));
+	header.brick_offset = OctreeFileHeader::AlignSection(header.node_offset + GetNodeBytes());
+	header.file_size = header.brick_offset + GetBrickBytes();
+	return header;
+}
+
+bool OctreeFileHeader::IsValid(uint64_t size) const {
+	return magic == MAGIC && version == VERSION
+		&& node_offset % SECTION_ALIGNMENT == 0 && brick_offset % SECTION_ALIGNMENT == 0
+		&& node_offset >= sizeof(OctreeFileHeader) && brick_offset >= node_offset + node_count * sizeof(OctreeNode)
+		&& file_size == brick_offset + brick_bytes && file_size <= size;
+}
+
+void Octree::Write(std::ostream& stream) const {
+	OctreeFileHeader header = GetFileHeader();
+
+	// Sections are zero-padded up to their aligned offsets
+	std::vector<char> padding(OctreeFileHeader::SECTION_ALIGNMENT, 0);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(padding.data(), header.node_offset - sizeof(header));
+	stream.write(reinterpret_cast<const char*>(m_nodes.data()), GetNodeBytes());
+	stream.write(padding.data(), header.brick_offset - header.node_offset - GetNodeBytes());
+	stream.write(reinterpret_cast<const char*>(m_bricks.data()), GetBrickBytes());
+
+	if (!stream) {
+		throw std::runtime_error("Failed to write octree!");
+	}
+}
+
+std::shared_ptr<Octree> Octree::Read(std::istream& stream) {
+	OctreeFileHeader header{};
+	stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!stream || !header.IsValid(header.file_size)) {
+		throw std::runtime_error("Invalid octree file!");
+	}
+
+	auto ret = std::make_shared<Octree>();
+	ret->m_brick_size = header.brick_size;
+	ret->m_depth = header.depth;
+	ret->m_nodes.resize(header.node_count);
+	ret->m_bricks.resize(header.brick_bytes);
+
+	stream.ignore(header.node_offset - sizeof(header));
+	stream.read(reinterpret_cast<char*>(ret->m_nodes.data()), ret->GetNodeBytes());
+	stream.ignore(header.brick_offset - header.node_offset - ret->GetNodeBytes());
+	stream.read(reinterpret_cast<char*>(ret->m_bricks.data()), ret->GetBrickBytes());
+	if (!stream) {
+		throw std::runtime_error("Truncated octree file!");
+	}
+
+	return ret;
+}
+
+void Octree::RunTests() {
+	const uint32_t size = 16;
+	const uint32_t brick_size = 4;
+	const size_t voxel_count = (size_t)size * size * size;
+	auto index = [&](uint32_t x, uint32_t y, uint32_t z) { return ((size_t)z * size + y) * size + x; };
+
+	std::vector<uint8_t> empty(voxel_count, 0);
+	std::vector<uint8_t> full(voxel_count, 1);
+	std::vector<uint8_t> single(voxel_count, 0);
+	single[index(5, 9, 13)] = 3;
+	std::vector<uint8_t> checkerboard(voxel_count);
+	for (uint32_t z = 0; z < size; z++)
+	for (uint32_t y = 0; y < size; y++)
+	for (uint32_t x = 0; x < size; x++)
+		checkerboard[index(x, y, z)] = (x + y + z) & 1;
+
+	// A 16^3 grid of 4^3 bricks has depth 2: 1 root, 8 inner nodes and 64 leaves when every brick is occupied.
+	// A DAG of the checkerboard keeps one brick, one block of 8 leaves, and the root's block of 8 nodes all pointing to it.
+	struct Case {
+		const char* name;
+		std::shared_ptr<Octree> octree;
+		uint32_t node_count;
+		uint32_t brick_count;
+	};
+	auto checkerboard_octree = Create(checkerboard, size, brick_size);
+	std::vector<Case> cases = {
+		{ "empty", Create(empty, size, brick_size), 1, 0 },
+		{ "full", Create(full, size, brick_size), 73, 64 },
+		{ "single voxel", Create(single, size, brick_size), 3, 1 },
+		{ "checkerboard", checkerboard_octree, 73, 64 },
+		{ "checkerboard DAG", CreateDAG(checkerboard_octree), 17, 1 },
+	};
+
+	auto check = [](bool passed, const std::string& name, const char* what) {
+		if (!passed)
+			throw std::runtime_error("Octree test \"" + name + "\" failed: " + what);
+	};
+
+	size_t brick_voxels = (size_t)brick_size * brick_size * brick_size;
+	for (const auto& test : cases) {
+		const Octree& octree = *test.octree;
+		check(octree.GetNodeCount() == test.node_count, test.name, "node count");
+		check(octree.GetBrickCount() == test.brick_count, test.name, "brick count");
+		check(octree.GetNodeBytes() == test.node_count * sizeof(OctreeNode), test.name, "node bytes");
+		check(octree.GetBrickBytes() == test.brick_count * brick_voxels, test.name, "brick bytes");
+		check(octree.GetDepth() == 2 && octree.GetSize() == size, test.name, "depth");
+
+		std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+		octree.Write(stream);
+		check(stream.str().size() == octree.GetFileHeader().file_size, test.name, "file size");
+		auto read = Read(stream);
+		check(read->GetBrickSize() == brick_size && read->GetDepth() == octree.GetDepth(), test.name, "round trip header");
+		check(read->GetNodeCount() == octree.GetNodeCount() && read->GetBricks() == octree.GetBricks(), test.name, "round trip data");
+		check(memcmp(read->GetNodes().data(), octree.GetNodes().data(), octree.GetNodeBytes()) == 0, test.name, "round trip nodes");
+
+		printf("%-18s %3u nodes, %2u bricks, %5zu node bytes, %5zu brick bytes: passed\n",
+			test.name, octree.GetNodeCount(), octree.GetBrickCount(), octree.GetNodeBytes(), octree.GetBrickBytes());
+	}
+
+	// The single voxel's brick must be found at its coordinate, and hold the voxel at its offset within the brick
+	const Octree& single_octree = *cases[2].octree;
+	uint32_t brick;
+	check(single_octree.FindBrick(glm::uvec3(1, 2, 3), brick), "single voxel", "brick lookup");
+	check(single_octree.GetBrick(brick)[(1 * brick_size + 1) * brick_size + 1] == 3, "single voxel", "voxel value");
+	check(!single_octree.FindBrick(glm::uvec3(0, 0, 0), brick), "single voxel", "empty brick lookup");
+
+	// Editing one brick of the DAG copies the leaf block and the brick it shares, and leaves every other brick as it was
+	std::vector<glm::vec3> palette = { glm::vec3(1.0f), glm::vec3(0.5f), glm::vec3(0.25f) };
+	auto dag = CreateDAG(checkerboard_octree);
+	OctreeLOD lod;
+	dag->BuildLOD(palette, lod);
+	check(dag->UnshareBrick(glm::uvec3(1, 2, 3), brick), "DAG edit", "unshare");
+	dag->GetBrick(brick)[0] = 5;
+	check(dag->GetNodeCount() == 25 && dag->GetBrickCount() == 2, "DAG edit", "copied nodes and bricks");
+	checkerboard[index(4, 8, 12)] = 5;
+	auto edited = Create(checkerboard, size, brick_size);
+	for (uint32_t bz = 0; bz < size / brick_size; bz++)
+	for (uint32_t by = 0; by < size / brick_size; by++)
+	for (uint32_t bx = 0; bx < size / brick_size; bx++) {
+		uint32_t dag_brick, tree_brick;
+		glm::uvec3 coord(bx, by, bz);
+		check(dag->FindBrick(coord, dag_brick) && edited->FindBrick(coord, tree_brick), "DAG edit", "brick lookup");
+		check(memcmp(dag->GetBrick(dag_brick), edited->GetBrick(tree_brick), brick_voxels) == 0, "DAG edit", "brick voxels");
+	}
+	check(dag->BuildLOD(palette)[0] == edited->BuildLOD(palette)[0], "DAG edit", "root level of detail");
+
+	// Refiltering the edited path and the copies gives the same words as filtering everything again
+	std::vector<uint32_t> updated;
+	dag->UpdateLOD(palette, { glm::uvec3(1, 2, 3) }, lod, updated);
+	check(lod.words == dag->BuildLOD(palette), "DAG edit", "updated level of detail");
+	check(!updated.empty() && updated.size() < dag->GetNodeCount(), "DAG edit", "updated nodes");
+	printf("%-18s %3u nodes, %2u bricks after editing one brick: passed\n", "DAG edit", dag->GetNodeCount(), dag->GetBrickCount());
+}
@@ -1,13 +1,299 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <cstdint>
+#include <iostream>
 
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+/// <summary>
+/// A single node of the flattened octree, laid out exactly as the tracer reads it from its storage buffer.
+/// The children of a node are stored contiguously, in octant order, and only non-empty octants are stored.
+/// In a DAG, several nodes may point to the same block of children.
+/// An octant index is (x | y << 1 | z << 2), where x, y and z are 0 for the lower half of the node and 1 for the upper half.
+/// </summary>
+struct OctreeNode {
+
+	/// <summary> Bits 0-7: the mask of non-empty child octants. Bit 8: set if this node is a leaf. </summary>
+	uint32_t header;
+
+	/// <summary> For leaves, the index of the node's brick. Otherwise, the signed offset from this node to its first child. </summary>
+	int32_t data;
+};
+
+/// <summary>
+/// The header of an octree file. The node and brick sections follow at SECTION_ALIGNMENT-aligned offsets, stored exactly as in memory,
+/// so a file can be memory-mapped and its sections copied or uploaded as they are, with no per-node parsing.
+/// </summary>
+struct OctreeFileHeader {
+
+	/// <summary> Identifies the format. "SSVO" in little-endian. </summary>
+	static constexpr uint32_t MAGIC = 0x4F565353;
+
+	/// <summary> Version 1 stored the sections unaligned, directly after the header. </summary>
+	static constexpr uint32_t VERSION = 2;
+
+	/// <summary> The alignment of each section within the file. A multiple of the page size on every supported platform. </summary>
+	static constexpr uint64_t SECTION_ALIGNMENT = 64 * 1024;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t brick_size;
+	uint32_t depth;
+	uint64_t node_count;
+	uint64_t brick_bytes;
+	uint64_t node_offset;
+	uint64_t brick_offset;
+	uint64_t file_size;
+
+	/// <summary> Rounds an offset up to the next section boundary. </summary>
+	static uint64_t AlignSection(uint64_t offset) { return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT; }
+
+	/// <summary> Checks the magic and version, and that the sections are aligned and lie within a file of the given size. </summary>
+	bool IsValid(uint64_t size) const;
+};
+
+/// <summary>
+/// A cube of brick_size^3 voxels at a given brick coordinate. Used as input when building an octree.
+/// </summary>
+struct OctreeBrick {
+
+	/// <summary> The coordinate of the brick, in units of bricks. </summary>
+	glm::uvec3 coord;
+
+	/// <summary> The voxels of the brick, x-major. A value of 0 is empty. </summary>
+	std::vector<uint8_t> voxels;
+};
+
+/// <summary>
+/// The prefiltered level of detail of an octree (see Octree::BuildLOD), with what each node contributes to its parent's,
+/// kept so that an edit can refilter only the nodes above the bricks it changed.
+/// </summary>
+struct OctreeLOD {
+
+	/// <summary>
+	/// What a node contributes to its parent: the sum of its voxels' colours, their number,
+	/// and the fraction of the node covered by its voxels when projected along each axis.
+	/// </summary>
+	struct Filter {
+		glm::vec3 color_sum = glm::vec3(0.0f);
+		uint64_t count = 0;
+		glm::vec3 projected = glm::vec3(0.0f);
+	};
+
+	/// <summary> The filter of every node. </summary>
+	std::vector<Filter> filters;
+
+	/// <summary> The word of every node, as returned by Octree::BuildLOD. </summary>
+	std::vector<uint32_t> words;
+};
+
+/// <summary>
+/// A sparse voxel octree, stored as a contiguous, pointer-free array of nodes whose leaves reference dense bricks of voxels.
+/// The node array can be uploaded as-is to a storage buffer.
+/// The same layout also holds sparse voxel DAGs, where identical subtrees and bricks are stored once and shared (see CreateDAG).
+/// </summary>
 class Octree
 {
 private:
 
+	/// <summary> The flattened nodes, in breadth-first order, followed by any copies appended by UnshareBrick. The root is node 0. </summary>
+	std::vector<OctreeNode> m_nodes;
+
+	/// <summary> The voxels of all bricks, brick_size^3 bytes per brick, in the order they are referenced by leaves. </summary>
+	std::vector<uint8_t> m_bricks;
+
+	/// <summary> The width of a brick, in voxels. </summary>
+	uint32_t m_brick_size = 0;
+
+	/// <summary> The number of levels below the root. Leaves live at this depth. </summary>
+	uint32_t m_depth = 0;
+
+	/// <summary> The number of nodes whose first child is each node, and of leaves referencing each brick. Counted by the first UnshareBrick. </summary>
+	std::vector<uint32_t> m_child_refs;
+	std::vector<uint32_t> m_brick_refs;
+
+	/// <summary>
+	/// Whether every voxel in the given range is empty.
+	/// </summary>
+	static bool IsEmpty(const uint8_t* voxels, size_t count);
+
+	/// <summary>
+	/// Gets every node reachable from the root once, children before their parents.
+	/// </summary>
+	std::vector<uint32_t> GetBottomUpOrder() const;
+
+	/// <summary>
+	/// Filters one node from its brick, or from the filters of its children, and sets its level-of-detail word.
+	/// </summary>
+	/// <param name="columns"> Scratch space of 3 * brick_size^2 bytes. </param>
+	void FilterNode(uint32_t index, const std::vector<glm::vec3>& palette, OctreeLOD& lod, std::vector<uint8_t>& columns) const;
+
 public:
 
-	static std::shared_ptr<Octree> CreateOctree(int brick_size);
-};
+	/// <summary> Set in OctreeNode::header if the node is a leaf. </summary>
+	static constexpr uint32_t LEAF_FLAG = 1u << 8;
+
+	/// <summary> Masks the child octants in OctreeNode::header. </summary>
+	static constexpr uint32_t CHILD_MASK = 0xFFu;
 
+	/// <summary>
+	/// Builds an octree from a dense cube of voxels.
+	/// </summary>
+	/// <param name="voxels"> The voxels, x-major. A value of 0 is empty. </param>
+	/// <param name="size"> The width of the cube. Must be brick_size times a power of two. </param>
+	/// <param name="brick_size"> The width of the bricks stored in the leaves. </param>
+	static std::shared_ptr<Octree> Create(const std::vector<uint8_t>& voxels, uint32_t size, uint32_t brick_size);
+
+	/// <summary>
+	/// Builds an octree from a sparse set of bricks. Empty bricks are skipped.
+	/// </summary>
+	/// <param name="bricks"> The bricks. Coordinates must be below 2^depth, and unique. </param>
+	/// <param name="depth"> The number of levels below the root. </param>
+	/// <param name="brick_size"> The width of each brick. </param>
+	static std::shared_ptr<Octree> CreateFromBricks(const std::vector<OctreeBrick>& bricks, uint32_t depth, uint32_t brick_size);
+
+	/// <summary>
+	/// Builds a test scene: a sphere centered in a cube of the given size, with a radius of a quarter of the size.
+	/// </summary>
+	static std::shared_ptr<Octree> CreateSphere(uint32_t size, uint32_t brick_size);
+
+	/// <summary>
+	/// Builds a sparse test scene: randomly placed spheres with radii between 1/128 and 1/32 of the size.
+	/// Each sphere gets a voxel value between 1 and 7, so materials can be told apart.
+	/// Only the bricks touched by a sphere are ever allocated, so large sizes are cheap.
+	/// </summary>
+	static std::shared_ptr<Octree> CreateScatteredSpheres(uint32_t size, uint32_t brick_size, uint32_t count, uint32_t seed);
+
+	/// <summary>
+	/// Builds a reference scene with repeated structure: a ground slab covered by a grid of buildings, each one of a few variants.
+	/// </summary>
+	static std::shared_ptr<Octree> CreateCity(uint32_t size, uint32_t brick_size, uint32_t seed);
+
+	/// <summary>
+	/// Builds a complete octree, where every node has all eight children and every brick is empty.
+	/// Brick i sits at the brick coordinate whose Morton code (x in bit 0, y in bit 1, z in bit 2) is i.
+	/// Used as the structure for voxels that are written directly on the GPU.
+	/// </summary>
+	static std::shared_ptr<Octree> CreateComplete(uint32_t depth, uint32_t brick_size);
+
+	/// <summary>
+	/// Compresses an octree into a sparse voxel DAG. Identical bricks are merged, then identical subtrees are merged bottom-up,
+	/// so that every distinct subtree is stored once. The result traces exactly like the input.
+	/// </summary>
+	static std::shared_ptr<Octree> CreateDAG(std::shared_ptr<Octree> octree);
+
+	/// <summary>
+	/// Builds an octree from already-flattened nodes and bricks, such as the sections of a mapped octree file. Both are taken as they are.
+	/// </summary>
+	static std::shared_ptr<Octree> CreateFromData(uint32_t brick_size, uint32_t depth, std::vector<OctreeNode> nodes, std::vector<uint8_t> bricks);
+
+	/// <summary>
+	/// Reads an octree written by Write.
+	/// </summary>
+	static std::shared_ptr<Octree> Read(std::istream& stream);
+
+	/// <summary>
+	/// Writes the octree to the stream as binary: the header from GetFileHeader, then the node and brick sections at their aligned offsets.
+	/// </summary>
+	void Write(std::ostream& stream) const;
+
+	/// <summary>
+	/// Gets the header Write stores for this octree, including the section layout.
+	/// </summary>
+	OctreeFileHeader GetFileHeader() const;
+
+	/// <summary>
+	/// Builds octrees from empty, full, single-voxel and checkerboard grids, checks their node and brick counts and sizes,
+	/// round-trips each through Write and Read, and checks that editing a brick of a DAG leaves the bricks it shared unchanged.
+	/// Prints each case to stdout, and throws on the first that fails.
+	/// </summary>
+	static void RunTests();
+
+	/// <summary> Gets the flattened node array. </summary>
+	const std::vector<OctreeNode>& GetNodes() const { return m_nodes; }
+
+	/// <summary> Gets the voxels of all bricks, brick_size^3 bytes per brick. </summary>
+	const std::vector<uint8_t>& GetBricks() const { return m_bricks; }
+
+	/// <summary> Gets the voxels of the brick at the given index. </summary>
+	const uint8_t* GetBrick(uint32_t index) const { return m_bricks.data() + (size_t)index * GetBrickVoxelCount(); }
+
+	/// <summary> Gets the voxels of the brick at the given index for editing. In a DAG, the brick may be shared by several leaves; see UnshareBrick. </summary>
+	uint8_t* GetBrick(uint32_t index) { return m_bricks.data() + (size_t)index * GetBrickVoxelCount(); }
+
+	/// <summary>
+	/// Finds the brick at the given brick coordinate by walking down from the root.
+	/// </summary>
+	/// <param name="brick"> Receives the brick index, if found. </param>
+	/// <returns> False if the coordinate lies in an empty octant, which has no brick. </returns>
+	bool FindBrick(glm::uvec3 coord, uint32_t& brick) const;
+
+	/// <summary>
+	/// Finds the nodes from the root down to the leaf at the given brick coordinate.
+	/// </summary>
+	/// <param name="path"> Receives the nodes, root first, if found. </param>
+	/// <returns> False if the coordinate lies in an empty octant, which has no brick. </returns>
+	bool FindPath(glm::uvec3 coord, std::vector<uint32_t>& path) const;
+
+	/// <summary>
+	/// Finds the brick at the given brick coordinate like FindBrick, first making sure that no other leaf shares it, so that it can be
+	/// edited in place. Along the path from the root, every block of children shared with other nodes is copied, as is the brick if it
+	/// is shared, and only this path is repointed to the copies, which are appended to the node and brick arrays. A tree shares
+	/// nothing, so nothing is copied.
+	/// </summary>
+	/// <param name="brick"> Receives the brick index, if found. </param>
+	/// <returns> False if the coordinate lies in an empty octant, which has no brick. </returns>
+	bool UnshareBrick(glm::uvec3 coord, uint32_t& brick);
+
+	/// <summary>
+	/// Prefilters every node for level-of-detail tracing, giving one word per node: the average colour of the voxels below it in bits 0-23,
+	/// as RGB8, and their coverage in bits 24-31. Coverage is the largest fraction of the node's cross-section that its voxels cover
+	/// along any axis, so a thin floor or wall covers its node fully even though it fills little of its volume.
+	/// Nodes with no voxels, or with no brick data at all, such as those of a streamed octree, get 0.
+	/// </summary>
+	/// <param name="palette"> The colour of each voxel value, indexed by the value modulo the palette's size. </param>
+	std::vector<uint32_t> BuildLOD(const std::vector<glm::vec3>& palette) const;
+
+	/// <summary>
+	/// Prefilters every node as above, keeping the filter of each node for UpdateLOD.
+	/// </summary>
+	void BuildLOD(const std::vector<glm::vec3>& palette, OctreeLOD& lod) const;
+
+	/// <summary>
+	/// Refilters the leaves at the given brick coordinates and their ancestors after their voxels were edited, and filters the nodes
+	/// UnshareBrick appended since the level of detail was built. Every other node keeps its word. The leaves must not be shared,
+	/// so that their ancestors are the nodes on their paths.
+	/// </summary>
+	/// <param name="nodes"> Receives the nodes whose words changed or were added, ascending. </param>
+	void UpdateLOD(const std::vector<glm::vec3>& palette, const std::vector<glm::uvec3>& bricks, OctreeLOD& lod, std::vector<uint32_t>& nodes) const;
+
+	/// <summary> Gets the number of nodes. </summary>
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_nodes.size()); }
+
+	/// <summary> Gets the number of bricks. </summary>
+	uint32_t GetBrickCount() const { return static_cast<uint32_t>(m_bricks.size() / GetBrickVoxelCount()); }
+
+	/// <summary> Gets the size of the node array in bytes. </summary>
+	size_t GetNodeBytes() const { return m_nodes.size() * sizeof(OctreeNode); }
+
+	/// <summary> Gets the size of the brick data in bytes. </summary>
+	size_t GetBrickBytes() const { return m_bricks.size(); }
+
+	/// <summary> Gets the total size of the nodes and bricks in bytes. </summary>
+	size_t GetTotalBytes() const { return GetNodeBytes() + GetBrickBytes(); }
+
+	/// <summary> Gets the width of a brick, in voxels. </summary>
+	uint32_t GetBrickSize() const { return m_brick_size; }
+
+	/// <summary> Gets the number of voxels in one brick. </summary>
+	size_t GetBrickVoxelCount() const { return (size_t)m_brick_size * m_brick_size * m_brick_size; }
+
+	/// <summary> Gets the number of levels below the root. </summary>
+	uint32_t GetDepth() const { return m_depth; }
+
+	/// <summary> Gets the width of the whole octree, in voxels. </summary>
+	uint32_t GetSize() const { return m_brick_size << m_depth; }
+};
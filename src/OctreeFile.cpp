@@ -0,0 +1,176 @@
+#include "OctreeFile.h"
+
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	/// <summary>
+	/// The number of bytes copied between progress updates of a streamed load.
+	/// </summary>
+	const uint64_t STREAM_CHUNK_BYTES = 4 * 1024 * 1024;
+
+	/// <summary>
+	/// Appends a mapped section to a vector one chunk at a time, reporting progress after every chunk.
+	/// Reserving first and appending avoids zero-filling the destination before it is overwritten.
+	/// </summary>
+	template<typename T>
+	std::vector<T> CopySection(const T* data, uint64_t count, std::atomic<uint64_t>* bytes_loaded) {
+		std::vector<T> ret;
+		ret.reserve(count);
+		uint64_t chunk_count = std::max<uint64_t>(STREAM_CHUNK_BYTES / sizeof(T), 1);
+		for (uint64_t chunk = 0; chunk < count; chunk += chunk_count) {
+			uint64_t end = std::min(chunk + chunk_count, count);
+			ret.insert(ret.end(), data + chunk, data + end);
+			if (bytes_loaded)
+				bytes_loaded->fetch_add((end - chunk) * sizeof(T), std::memory_order_relaxed);
+		}
+		return ret;
+	}
+}
+
+std::shared_ptr<OctreeFile> OctreeFile::Open(const std::string& path) {
+	auto ret = std::make_shared<OctreeFile>();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open octree file " + path + "!");
+	}
+	ret->m_file_handle = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(OctreeFileHeader)) {
+		throw std::runtime_error("Invalid octree file " + path + "!");
+	}
+	ret->m_size = static_cast<uint64_t>(size.QuadPart);
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		throw std::runtime_error("Failed to map octree file " + path + "!");
+	}
+	ret->m_mapping_handle = mapping;
+
+	ret->m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (ret->m_data == nullptr) {
+		throw std::runtime_error("Failed to map octree file " + path + "!");
+	}
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		throw std::runtime_error("Failed to open octree file " + path + "!");
+	}
+	ret->m_file_descriptor = file;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(OctreeFileHeader)) {
+		throw std::runtime_error("Invalid octree file " + path + "!");
+	}
+	ret->m_size = static_cast<uint64_t>(info.st_size);
+
+	void* data = mmap(nullptr, ret->m_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (data == MAP_FAILED) {
+		throw std::runtime_error("Failed to map octree file " + path + "!");
+	}
+	madvise(data, ret->m_size, MADV_SEQUENTIAL);
+	ret->m_data = static_cast<const uint8_t*>(data);
+#endif
+
+	memcpy(&ret->m_header, ret->m_data, sizeof(OctreeFileHeader));
+	if (!ret->m_header.IsValid(ret->m_size)) {
+		throw std::runtime_error("Invalid octree file " + path + "!");
+	}
+
+	return ret;
+}
+
+OctreeFile::~OctreeFile() {
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping_handle)
+		CloseHandle(m_mapping_handle);
+	if (m_file_handle)
+		CloseHandle(m_file_handle);
+#else
+	if (m_data)
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	if (m_file_descriptor >= 0)
+		close(m_file_descriptor);
+#endif
+}
+
+void OctreeFile::Write(const std::string& path, const Octree& octree) {
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream) {
+		throw std::runtime_error("Failed to create octree file " + path + "!");
+	}
+	octree.Write(stream);
+}
+
+std::shared_ptr<Octree> OctreeFile::Load(std::atomic<uint64_t>* bytes_loaded) const {
+	return Octree::CreateFromData(m_header.brick_size, m_header.depth,
+		CopySection(GetNodes(), m_header.node_count, bytes_loaded),
+		CopySection(GetBricks(), m_header.brick_bytes, bytes_loaded));
+}
+
+std::future<std::shared_ptr<Octree>> OctreeFile::LoadAsync(const std::string& path, std::atomic<uint64_t>* bytes_loaded) {
+	return std::async(std::launch::async, [path, bytes_loaded]() {
+		return Open(path)->Load(bytes_loaded);
+	});
+}
+
+void OctreeFile::RunBenchmark(uint32_t size) {
+	auto path = (std::filesystem::temp_directory_path() / "octree_benchmark.svo").string();
+
+	auto start = std::chrono::steady_clock::now();
+	auto octree = Octree::CreateCity(size, 8, 1337);
+	float build_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	Write(path, *octree);
+	uint64_t file_bytes = octree->GetFileHeader().file_size;
+	printf("City (%u^3): %u nodes, %u bricks, %.1f MiB file\n", size, octree->GetNodeCount(), octree->GetBrickCount(), file_bytes / (1024.0 * 1024.0));
+
+	auto report = [&](const char* name, float ms, std::shared_ptr<Octree> loaded) {
+		bool identical = loaded->GetNodeBytes() == octree->GetNodeBytes() && loaded->GetBricks() == octree->GetBricks()
+			&& memcmp(loaded->GetNodes().data(), octree->GetNodes().data(), octree->GetNodeBytes()) == 0;
+		printf("  %-16s %10.1f ms %10.1f MiB/s %s\n", name, ms, file_bytes / (1024.0 * 1024.0) / (ms / 1000.0), identical ? "" : "MISMATCH");
+	};
+	printf("  %-16s %10.1f ms\n", "Rebuild", build_ms);
+
+	// Files are read back-to-back, so these mostly measure loads from the OS file cache
+	start = std::chrono::steady_clock::now();
+	std::ifstream stream(path, std::ios::binary);
+	auto streamed = Octree::Read(stream);
+	report("Stream read", std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count(), streamed);
+	stream.close();
+	streamed = nullptr;
+
+	start = std::chrono::steady_clock::now();
+	auto mapped = Open(path)->Load();
+	report("Mapped load", std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count(), mapped);
+	mapped = nullptr;
+
+	std::atomic<uint64_t> bytes_loaded = 0;
+	start = std::chrono::steady_clock::now();
+	auto future = LoadAsync(path, &bytes_loaded);
+	auto streamed_async = future.get();
+	report("Worker load", std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count(), streamed_async);
+
+	std::filesystem::remove(path);
+}
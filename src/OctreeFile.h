@@ -0,0 +1,76 @@
+#pragma once
+#include "Octree.h"
+
+#include <memory>
+#include <string>
+#include <future>
+#include <atomic>
+#include <cstdint>
+
+/// <summary>
+/// A read-only memory mapping of an octree file written by Octree::Write.
+/// The node and brick sections are used in place: they can be copied into an Octree or straight into mapped staging memory
+/// with a single memcpy each, so loading is bound by I/O rather than by deserialization.
+/// </summary>
+class OctreeFile
+{
+private:
+
+	/// <summary> The start of the mapping, which covers the whole file. </summary>
+	const uint8_t* m_data = nullptr;
+
+	/// <summary> The size of the file, in bytes. </summary>
+	uint64_t m_size = 0;
+
+	/// <summary> The validated header at the start of the file. </summary>
+	OctreeFileHeader m_header{};
+
+	// PLATFORM HANDLES
+	void* m_file_handle = nullptr;
+	void* m_mapping_handle = nullptr;
+	int m_file_descriptor = -1;
+
+public:
+
+	/// <summary>
+	/// Maps an octree file and validates its header.
+	/// </summary>
+	static std::shared_ptr<OctreeFile> Open(const std::string& path);
+
+	/// <summary>
+	/// Writes an octree to a file in the mappable format.
+	/// </summary>
+	static void Write(const std::string& path, const Octree& octree);
+
+	/// <summary>
+	/// Maps an octree file on a worker thread and streams its node and brick sections into a new octree there, front to back.
+	/// </summary>
+	/// <param name="bytes_loaded"> If not null, receives the number of section bytes copied so far. Must outlive the load. </param>
+	static std::future<std::shared_ptr<Octree>> LoadAsync(const std::string& path, std::atomic<uint64_t>* bytes_loaded = nullptr);
+
+	/// <summary>
+	/// Builds the City reference scene at the given size, writes it to a temporary file, and prints to stdout the time taken to
+	/// rebuild it, read it through a stream, and load it through a mapping, synchronously and on a worker thread.
+	/// </summary>
+	static void RunBenchmark(uint32_t size);
+
+	~OctreeFile();
+
+	/// <summary>
+	/// Copies the sections into a new octree, front to back, in chunks of a few MiB.
+	/// </summary>
+	/// <param name="bytes_loaded"> If not null, incremented by the number of bytes copied after every chunk. </param>
+	std::shared_ptr<Octree> Load(std::atomic<uint64_t>* bytes_loaded = nullptr) const;
+
+	/// <summary> Gets the header of the file. </summary>
+	const OctreeFileHeader& GetHeader() const { return m_header; }
+
+	/// <summary> Gets the mapped node section. </summary>
+	const OctreeNode* GetNodes() const { return reinterpret_cast<const OctreeNode*>(m_data + m_header.node_offset); }
+
+	/// <summary> Gets the mapped brick section. </summary>
+	const uint8_t* GetBricks() const { return m_data + m_header.brick_offset; }
+
+	/// <summary> Gets the size of the mapped file, in bytes. </summary>
+	uint64_t GetSize() const { return m_size; }
+};
@@ -1,49 +1,403 @@
 #include "OctreeTracer.h"
 
-std::shared_ptr<OctreeTracer> OctreeTracer::Create(std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::RenderPass> render_pass, std::shared_ptr<VWrap::CommandPool> graphics_pool, VkExtent2D extent, uint32_t num_frames) {
+std::shared_ptr<OctreeTracer> OctreeTracer::Create(std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::RenderPass> render_pass, std::shared_ptr<VWrap::CommandPool> graphics_pool, std::shared_ptr<UploadService> upload_service, std::shared_ptr<VWrap::RetirementQueue> retirement_queue, VkExtent2D extent, uint32_t num_frames) {
 	auto ret = std::make_shared<OctreeTracer>();
 	ret->m_device = device;
 	ret->m_allocator = allocator;
 	ret->m_extent = extent;
 	ret->m_graphics_pool = graphics_pool;
+	ret->m_upload_service = upload_service;
+	ret->m_retirement_queue = retirement_queue;
+	ret->m_render_pass = render_pass;
 
 	ret->CreateDescriptors(num_frames);
-	ret->CreatePipeline(render_pass);
+	ret->CreateStatsBuffers(num_frames);
+	ret->CreateReprojectionBuffers(num_frames);
+	ret->m_brick_pool = BrickPool::Create(device, allocator, graphics_pool, upload_service, retirement_queue, BRICK_POOL_VOXELS, BRICK_UPLOAD_BUDGET, BRICK_POOL_MATERIALS, num_frames);
+	ret->CreateTracedImage();
+	ret->CreateBeamBuffer();
+	ret->CreateHistoryBuffers();
+	ret->CreateUpscaler();
 
-	ret->m_sampler = VWrap::Sampler::Create(device);
-	VWrap::CommandBuffer::CreateAndFillBrickTexture(graphics_pool, allocator, ret->m_brick_texture, 32);
-	ret->m_brick_texture_view = VWrap::ImageView::Create(device, ret->m_brick_texture);
-
-	ret->WriteDescriptors();
+	ret->SetScene(TracerScene::SPHERE);
 
 	return ret;
 }
 
+const char* OctreeTracer::GetSceneName(TracerScene scene)
+{
+	switch (scene) {
+	case TracerScene::SINGLE_BRICK:
+		return "Single Brick (32^3)";
+	case TracerScene::SPHERE:
+		return "Sphere (256^3)";
+	case TracerScene::SCATTERED_SPHERES:
+		return "Scattered Spheres (512^3)";
+	case TracerScene::CITY:
+		return "City (512^3)";
+	case TracerScene::MESH:
+		return "Mesh (512^3)";
+	case TracerScene::GPU_MESH:
+		return "Mesh (GPU, 256^3)";
+	case TracerScene::STREAMED:
+		return "City (streamed, 2048^3)";
+	case TracerScene::TERRAIN:
+		return "Terrain (procedural, 1024^3)";
+	default:
+		return "Unknown";
+	}
+}
+
+const char* OctreeTracer::GetPathName(TracerPath path)
+{
+	switch (path) {
+	case TracerPath::FRAGMENT:
+		return "Fragment";
+	case TracerPath::COMPUTE:
+		return "Compute (8x8 tiles)";
+	case TracerPath::WAVEFRONT:
+		return "Wavefront (shadows + AO)";
+	default:
+		return "Unknown";
+	}
+}
+
+void OctreeTracer::SetPath(TracerPath path)
+{
+	if (path == m_path)
+		return;
+
+	m_path = path;
+	CreateWavefront();
+	CreateUpscaler();
+}
+
+void OctreeTracer::SetUpscaleMode(UpscaleMode mode)
+{
+	if (mode == m_upscale_mode)
+		return;
+
+	m_upscale_mode = mode;
+	CreateUpscaler();
+}
+
+void OctreeTracer::CreateUpscaler()
+{
+	// The history images are the size of the screen, so they only exist while they are used
+	m_retirement_queue->Retire(m_upscaler);
+	m_upscaler = nullptr;
+	if (m_upscale_mode == UpscaleMode::OFF || m_path == TracerPath::FRAGMENT)
+		return;
+
+	m_upscaler = TemporalUpscaler::Create(m_device, m_allocator, m_graphics_pool, m_traced_image, m_traced_image_view, m_extent,
+		static_cast<uint32_t>(m_stats_buffers.size()));
+}
+
+void OctreeTracer::CreateWavefront()
+{
+	// The queues scale with the screen, so they only exist while they are used
+	m_retirement_queue->Retire(m_wavefront);
+	m_wavefront = nullptr;
+	if (m_path != TracerPath::WAVEFRONT || !m_octree)
+		return;
+
+	m_wavefront = WavefrontTracer::Create(m_device, m_allocator, m_brick_pool, m_octree, m_step_budget, m_stats_buffers,
+		m_traced_image, m_traced_image_view, m_node_buffer, m_lod_buffer, m_extent);
+}
+
+VkExtent2D OctreeTracer::GetRenderExtent() const
+{
+	if (m_path == TracerPath::FRAGMENT)
+		return m_extent;
+
+	float scale = m_upscaler ? m_render_scale * TemporalUpscaler::GetModeScale(m_upscale_mode) : m_render_scale;
+	VkExtent2D extent;
+	extent.width = std::clamp(static_cast<uint32_t>(std::lround(m_extent.width * scale)), 1u, m_extent.width);
+	extent.height = std::clamp(static_cast<uint32_t>(std::lround(m_extent.height * scale)), 1u, m_extent.height);
+	return extent;
+}
+
+void OctreeTracer::SetScene(TracerScene scene)
+{
+	m_retirement_queue->Retire(m_gpu_voxelizer);
+	m_gpu_voxelizer = nullptr;
+	m_streamer = nullptr;
+	if (scene == TracerScene::GPU_MESH) {
+		SetGPUMeshScene();
+		m_scene = scene;
+		return;
+	}
+	if (scene == TracerScene::STREAMED) {
+		SetStreamedScene();
+		m_scene = scene;
+		return;
+	}
+
+	LoadOctree(BuildScene(scene, m_scene_stats));
+	m_scene = scene;
+}
+
+std::shared_ptr<Octree> OctreeTracer::BuildScene(TracerScene scene, SceneStats& stats)
+{
+	auto build_start = std::chrono::steady_clock::now();
+
+	std::shared_ptr<Octree> octree;
+	switch (scene) {
+	case TracerScene::SINGLE_BRICK:
+		octree = Octree::CreateSphere(32, 32);
+		break;
+	case TracerScene::SPHERE:
+		octree = Octree::CreateSphere(256, 8);
+		break;
+	case TracerScene::SCATTERED_SPHERES:
+		octree = Octree::CreateScatteredSpheres(512, 8, 128, 1337);
+		break;
+	case TracerScene::CITY:
+		octree = Octree::CreateCity(512, 8, 1337);
+		break;
+	case TracerScene::MESH:
+		octree = Voxelizer::CreateFromOBJ(VOXELIZER_MODEL_PATH)->Voxelize(VOXELIZER_RESOLUTION, 8, 0);
+		break;
+	case TracerScene::TERRAIN:
+		octree = ProceduralGenerator::Create(1337)->Generate(1024, 8);
+		break;
+	case TracerScene::GPU_MESH:
+	case TracerScene::STREAMED:
+		throw std::invalid_argument("The GPU Mesh and Streamed scenes are not built in memory!");
+	default:
+		throw std::invalid_argument("Unknown tracer scene!");
+	}
+
+	auto dag_start = std::chrono::steady_clock::now();
+	auto dag = USE_OCTREE_DAG ? Octree::CreateDAG(octree) : octree;
+	auto dag_end = std::chrono::steady_clock::now();
+
+	stats.node_count = octree->GetNodeCount();
+	stats.brick_count = octree->GetBrickCount();
+	stats.bytes = octree->GetTotalBytes();
+	stats.build_ms = std::chrono::duration<float, std::milli>(dag_start - build_start).count();
+	stats.dag_node_count = dag->GetNodeCount();
+	stats.dag_brick_count = dag->GetBrickCount();
+	stats.dag_bytes = dag->GetTotalBytes();
+	stats.dag_build_ms = std::chrono::duration<float, std::milli>(dag_end - dag_start).count();
+
+	return dag;
+}
+
+void OctreeTracer::SetGPUMeshScene()
+{
+	if (!m_mesh)
+		throw std::runtime_error("The GPU Mesh scene needs a mesh!");
+
+	// The structure is a complete octree whose bricks are pinned, so every slot is always mapped and the voxelizer only rewrites voxels
+	auto build_start = std::chrono::steady_clock::now();
+	uint32_t brick_size = 8;
+	uint32_t depth = 0;
+	while ((brick_size << depth) < GPU_VOXELIZER_RESOLUTION) depth++;
+	auto octree = Octree::CreateComplete(depth, brick_size);
+	auto build_end = std::chrono::steady_clock::now();
+
+	m_scene_stats.node_count = m_scene_stats.dag_node_count = octree->GetNodeCount();
+	m_scene_stats.brick_count = m_scene_stats.dag_brick_count = octree->GetBrickCount();
+	m_scene_stats.bytes = m_scene_stats.dag_bytes = octree->GetTotalBytes();
+	m_scene_stats.build_ms = std::chrono::duration<float, std::milli>(build_end - build_start).count();
+	m_scene_stats.dag_build_ms = 0.0f;
+
+	LoadOctree(octree, true);
+
+	m_gpu_voxelizer = GPUVoxelizer::Create(m_device, m_allocator, m_graphics_pool, m_brick_pool,
+		m_mesh->GetVertexBuffer(), m_mesh->GetIndexBuffer(), m_mesh->GetVertices(), m_mesh->GetIndices(), GPU_VOXELIZER_RESOLUTION);
+
+	// The validation pass reads the mesh and the page table before any frame has acquired them
+	if (VALIDATE_GPU_VOXELIZER) {
+		m_upload_service->AcquireNow(m_graphics_pool);
+		m_gpu_voxelizer->Validate();
+	}
+}
+
+void OctreeTracer::SetStreamedScene()
+{
+	auto build_start = std::chrono::steady_clock::now();
+	if (!std::filesystem::exists(STREAMING_SCENE_PATH))
+		OctreeFile::Write(STREAMING_SCENE_PATH, *Octree::CreateCity(STREAMING_SCENE_SIZE, 8, 1337));
+
+	// Leave a core for the render thread
+	uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	auto file = OctreeFile::Open(STREAMING_SCENE_PATH);
+	auto streamer = BrickStreamer::Create(file, thread_count, STREAMING_MAX_READY);
+	auto build_end = std::chrono::steady_clock::now();
+
+	// Only the nodes are resident; the file's size stands in for the octree's
+	const OctreeFileHeader& header = file->GetHeader();
+	m_scene_stats.node_count = m_scene_stats.dag_node_count = static_cast<uint32_t>(header.node_count);
+	m_scene_stats.brick_count = m_scene_stats.dag_brick_count = streamer->GetBrickCount();
+	m_scene_stats.bytes = m_scene_stats.dag_bytes = static_cast<size_t>(header.file_size);
+	m_scene_stats.build_ms = std::chrono::duration<float, std::milli>(build_end - build_start).count();
+	m_scene_stats.dag_build_ms = 0.0f;
+
+	LoadStreamer(streamer);
+}
+
+void OctreeTracer::LoadStreamer(std::shared_ptr<BrickStreamer> streamer)
+{
+	m_octree = streamer->GetOctree();
+	m_streamer = streamer;
+
+	CreateNodeBuffer();
+	m_octree->BuildLOD(MATERIAL_PALETTE, m_lod);
+	CreateLODBuffer();
+	m_brick_pool->SetStreamer(streamer);
+	m_upload_service->Flush();
+	m_lod_update_pending = false;
+	m_lod_update_nodes.clear();
+
+	CreatePipeline(m_render_pass);
+	WriteDescriptors();
+	CreateWavefront();
+	m_history_valid = false;
+	if (m_upscaler)
+		m_upscaler->Invalidate();
+}
+
+void OctreeTracer::UpdateCamera(std::shared_ptr<Camera> camera, glm::vec3 velocity)
+{
+	if (!m_streamer)
+		return;
+
+	// World space to octree space, where the octree spans [0, 1]
+	m_streamer->SetCamera((camera->GetPosition() - m_octree_location) / m_octree_scale, camera->GetForward(), velocity / m_octree_scale);
+}
+
+void OctreeTracer::LoadOctree(std::shared_ptr<Octree> octree, bool pinned)
+{
+	m_octree = octree;
+	m_streamer = nullptr;
+
+	CreateNodeBuffer();
+	m_octree->BuildLOD(MATERIAL_PALETTE, m_lod);
+	CreateLODBuffer();
+	m_brick_pool->SetOctree(octree, pinned);
+
+	// The copies run on the transfer queue while the pipeline is built; the next frame waits for them
+	m_upload_service->Flush();
+	m_lod_update_pending = false;
+	m_lod_update_nodes.clear();
+
+	// Brick size and depth are specialization constants, so the pipeline follows the octree
+	CreatePipeline(m_render_pass);
+	WriteDescriptors();
+	CreateWavefront();
+	m_history_valid = false;
+	if (m_upscaler)
+		m_upscaler->Invalidate();
+}
+
 void OctreeTracer::CreateDescriptors(int max_sets)
 {
-	VkDescriptorSetLayoutBinding sampled_image_binding{};
-	sampled_image_binding.binding = 0;
-	sampled_image_binding.descriptorCount = 1;
-	sampled_image_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	sampled_image_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	VkDescriptorSetLayoutBinding occupancy_binding{};
+	occupancy_binding.binding = 0;
+	occupancy_binding.descriptorCount = 1;
+	occupancy_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	occupancy_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
-	std::vector<VkDescriptorSetLayoutBinding> bindings = { sampled_image_binding };
-	m_descriptor_set_layout = VWrap::DescriptorSetLayout::Create(m_device, bindings);
+	VkDescriptorSetLayoutBinding node_buffer_binding{};
+	node_buffer_binding.binding = 1;
+	node_buffer_binding.descriptorCount = 1;
+	node_buffer_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	node_buffer_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
-	std::vector<VkDescriptorPoolSize> poolSizes(1);
-	poolSizes[0].descriptorCount = max_sets;
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	VkDescriptorSetLayoutBinding stats_buffer_binding{};
+	stats_buffer_binding.binding = 2;
+	stats_buffer_binding.descriptorCount = 1;
+	stats_buffer_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	stats_buffer_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
-	m_descriptor_pool = VWrap::DescriptorPool::Create(m_device, poolSizes, max_sets, 0);
+	VkDescriptorSetLayoutBinding page_table_binding{};
+	page_table_binding.binding = 3;
+	page_table_binding.descriptorCount = 1;
+	page_table_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	page_table_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
-	std::vector<std::shared_ptr<VWrap::DescriptorSetLayout>> layouts(static_cast<size_t>(max_sets), m_descriptor_set_layout);
-	m_descriptor_sets = VWrap::DescriptorSet::CreateMany(m_descriptor_pool, layouts);
+	VkDescriptorSetLayoutBinding feedback_binding{};
+	feedback_binding.binding = 4;
+	feedback_binding.descriptorCount = 1;
+	feedback_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	feedback_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding material_binding{};
+	material_binding.binding = 5;
+	material_binding.descriptorCount = 1;
+	material_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	material_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding lod_binding{};
+	lod_binding.binding = 6;
+	lod_binding.descriptorCount = 1;
+	lod_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lod_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// Written by the compute path and read back by the composite pass
+	VkDescriptorSetLayoutBinding traced_image_binding{};
+	traced_image_binding.binding = 7;
+	traced_image_binding.descriptorCount = 1;
+	traced_image_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	traced_image_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// Written by the beam prepass and read by the fragment and compute paths
+	VkDescriptorSetLayoutBinding beam_binding{};
+	beam_binding.binding = 8;
+	beam_binding.descriptorCount = 1;
+	beam_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	beam_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// Written by the fragment and compute paths and read by the next frame's reprojection
+	VkDescriptorSetLayoutBinding history_binding{};
+	history_binding.binding = 9;
+	history_binding.descriptorCount = 1;
+	history_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	history_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// Written by the reprojection and read by the fragment and compute paths
+	VkDescriptorSetLayoutBinding prediction_binding{};
+	prediction_binding.binding = 10;
+	prediction_binding.descriptorCount = 1;
+	prediction_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	prediction_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding reprojection_binding{};
+	reprojection_binding.binding = 11;
+	reprojection_binding.descriptorCount = 1;
+	reprojection_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	reprojection_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	std::vector<VkDescriptorSetLayoutBinding> bindings = { occupancy_binding, node_buffer_binding, stats_buffer_binding, page_table_binding, feedback_binding, material_binding, lod_binding, traced_image_binding, beam_binding, history_binding, prediction_binding, reprojection_binding };
+	m_descriptor_set_layout = VWrap::DescriptorSetLayout::Create(m_device, bindings);
+
+	// The sets themselves are allocated by each WriteDescriptors
+	m_descriptor_pool_sizes.resize(2);
+	m_descriptor_pool_sizes[0].descriptorCount = max_sets * static_cast<uint32_t>(bindings.size() - 1);
+	m_descriptor_pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	m_descriptor_pool_sizes[1].descriptorCount = max_sets;
+	m_descriptor_pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	m_descriptor_set_count = static_cast<uint32_t>(max_sets);
 }
 
 void OctreeTracer::CreatePipeline(std::shared_ptr<VWrap::RenderPass> render_pass)
 {
 	auto vert_shader_code = VWrap::readFile("../shaders/vert_tracer.spv");
 	auto frag_shader_code = VWrap::readFile("../shaders/frag_tracer.spv");
+	auto comp_shader_code = VWrap::readFile("../shaders/comp_tracer.spv");
+	auto composite_shader_code = VWrap::readFile("../shaders/frag_composite.spv");
+	auto beam_shader_code = VWrap::readFile("../shaders/comp_beam.spv");
+	auto reproject_shader_code = VWrap::readFile("../shaders/comp_reproject.spv");
+
+	// Frames in flight may still be running the old pipelines
+	m_retirement_queue->Retire(m_pipeline);
+	m_retirement_queue->Retire(m_compute_pipeline);
+	m_retirement_queue->Retire(m_beam_pipeline);
+	for (const auto& pipeline : m_reproject_pipelines)
+		m_retirement_queue->Retire(pipeline);
+	m_retirement_queue->Retire(m_composite_pipeline);
 
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
@@ -78,7 +432,7 @@ void OctreeTracer::CreatePipeline(std::shared_ptr<VWrap::RenderPass> render_pass
 	rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
 
 	VkPushConstantRange pushConstantRange = {};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // Specify the shader stages that will use the push constants
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // Only the fragment shader reads them; the compute pipelines declare their own range
 	pushConstantRange.offset = 0; // Offset of the push constants in bytes
 	pushConstantRange.size = sizeof(VWrap::PushConstantBlock); // Size of the push constant block
 	std::vector<VkPushConstantRange> push_constant_ranges = { pushConstantRange };
@@ -95,6 +449,36 @@ void OctreeTracer::CreatePipeline(std::shared_ptr<VWrap::RenderPass> render_pass
 	depthStencil.front = {}; // Optional
 	depthStencil.back = {}; // Optional
 
+	// Must match the constant_ids in tracer.glsl
+	struct SpecializationConstants {
+		int32_t brick_size;
+		int32_t max_depth;
+		int32_t step_budget;
+		VkBool32 use_materials;
+		int32_t brick_levels;
+		int32_t brick_words;
+	} specialization_constants;
+	specialization_constants.brick_size = static_cast<int32_t>(m_octree->GetBrickSize());
+	specialization_constants.max_depth = static_cast<int32_t>(std::max(m_octree->GetDepth(), 1u));
+	specialization_constants.step_budget = static_cast<int32_t>(m_step_budget);
+	specialization_constants.use_materials = m_brick_pool->UsesMaterials() ? VK_TRUE : VK_FALSE;
+	specialization_constants.brick_levels = static_cast<int32_t>(m_brick_pool->GetLevelCount());
+	specialization_constants.brick_words = static_cast<int32_t>(m_brick_pool->GetSlotWords());
+
+	std::array<VkSpecializationMapEntry, 6> specialization_entries{};
+	specialization_entries[0] = { 0, offsetof(SpecializationConstants, brick_size), sizeof(int32_t) };
+	specialization_entries[1] = { 1, offsetof(SpecializationConstants, max_depth), sizeof(int32_t) };
+	specialization_entries[2] = { 2, offsetof(SpecializationConstants, step_budget), sizeof(int32_t) };
+	specialization_entries[3] = { 3, offsetof(SpecializationConstants, use_materials), sizeof(VkBool32) };
+	specialization_entries[4] = { 4, offsetof(SpecializationConstants, brick_levels), sizeof(int32_t) };
+	specialization_entries[5] = { 5, offsetof(SpecializationConstants, brick_words), sizeof(int32_t) };
+
+	VkSpecializationInfo specialization_info{};
+	specialization_info.mapEntryCount = static_cast<uint32_t>(specialization_entries.size());
+	specialization_info.pMapEntries = specialization_entries.data();
+	specialization_info.dataSize = sizeof(SpecializationConstants);
+	specialization_info.pData = &specialization_constants;
+
 	VWrap::PipelineCreateInfo create_info{};
 	create_info.extent = m_extent;
 	create_info.render_pass = render_pass;
@@ -106,41 +490,623 @@ void OctreeTracer::CreatePipeline(std::shared_ptr<VWrap::RenderPass> render_pass
 	create_info.depth_stencil = depthStencil;
 	create_info.push_constant_ranges = push_constant_ranges;
 	create_info.subpass = 0;
+	create_info.fragment_specialization = &specialization_info;
 
 	m_pipeline = VWrap::Pipeline::Create(m_device, create_info, vert_shader_code, frag_shader_code);
+
+	// The compute path runs the same traversal with the same constants
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	std::vector<VkPushConstantRange> compute_push_constant_ranges = { pushConstantRange };
+	m_compute_pipeline = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, compute_push_constant_ranges, comp_shader_code, &specialization_info);
+	m_beam_pipeline = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, compute_push_constant_ranges, beam_shader_code, &specialization_info);
+
+	// The reprojection's passes differ only in constant 6, which picks whether they merge distances or write voxels
+	struct ReprojectSpecializationConstants {
+		SpecializationConstants tracer;
+		VkBool32 write_voxels;
+	} reproject_constants;
+	reproject_constants.tracer = specialization_constants;
+
+	std::array<VkSpecializationMapEntry, 7> reproject_entries{};
+	std::copy(specialization_entries.begin(), specialization_entries.end(), reproject_entries.begin());
+	reproject_entries[6] = { 6, offsetof(ReprojectSpecializationConstants, write_voxels), sizeof(VkBool32) };
+
+	VkSpecializationInfo reproject_specialization{};
+	reproject_specialization.mapEntryCount = static_cast<uint32_t>(reproject_entries.size());
+	reproject_specialization.pMapEntries = reproject_entries.data();
+	reproject_specialization.dataSize = sizeof(ReprojectSpecializationConstants);
+	reproject_specialization.pData = &reproject_constants;
+
+	for (uint32_t pass = 0; pass < 2; pass++) {
+		reproject_constants.write_voxels = pass == 1 ? VK_TRUE : VK_FALSE;
+		m_reproject_pipelines[pass] = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, compute_push_constant_ranges, reproject_shader_code, &reproject_specialization);
+	}
+
+	// The composite pass only reads the traced image, and the size traced into it
+	VkPushConstantRange compositePushConstantRange = {};
+	compositePushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	compositePushConstantRange.offset = 0;
+	compositePushConstantRange.size = sizeof(glm::ivec2);
+	create_info.push_constant_ranges = { compositePushConstantRange };
+	create_info.fragment_specialization = nullptr;
+	m_composite_pipeline = VWrap::Pipeline::Create(m_device, create_info, vert_shader_code, composite_shader_code);
+}
+
+void OctreeTracer::CreateTracedImage()
+{
+	// Half floats keep the dark end of the linear colours; the render pass encodes them to sRGB on the way out
+	VWrap::ImageCreateInfo info{};
+	info.width = m_extent.width;
+	info.height = m_extent.height;
+	info.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	info.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	info.mip_levels = 1;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.image_type = VK_IMAGE_TYPE_2D;
+
+	// The transition is left to the next frame, so that a resize does not wait on the graphics queue
+	m_retirement_queue->Retire(m_traced_image_view);
+	m_retirement_queue->Retire(m_traced_image);
+	m_traced_image = VWrap::Image::Create(m_allocator, info);
+	m_traced_image_view = VWrap::ImageView::Create(m_device, m_traced_image);
+	m_traced_image_undefined = true;
+}
+
+void OctreeTracer::CreateBeamBuffer()
+{
+	uint32_t columns = (m_extent.width + BEAM_BLOCK_SIZE - 1) / BEAM_BLOCK_SIZE;
+	uint32_t rows = (m_extent.height + BEAM_BLOCK_SIZE - 1) / BEAM_BLOCK_SIZE;
+	m_retirement_queue->Retire(m_beam_buffer);
+	m_beam_buffer = VWrap::Buffer::Create(m_allocator,
+		(VkDeviceSize)columns * rows * sizeof(float),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+}
+
+void OctreeTracer::CreateHistoryBuffers()
+{
+	VkDeviceSize pixels = (VkDeviceSize)m_extent.width * m_extent.height;
+
+	m_retirement_queue->Retire(m_history_buffer);
+	m_retirement_queue->Retire(m_prediction_buffer);
+
+	// A hit record and a prediction are both a distance and a voxel
+	m_history_buffer = VWrap::Buffer::Create(m_allocator,
+		2 * pixels * 2 * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+	m_prediction_buffer = VWrap::Buffer::Create(m_allocator,
+		pixels * 2 * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+	m_history_valid = false;
+}
+
+void OctreeTracer::CreateReprojectionBuffers(uint32_t num_frames)
+{
+	m_reprojection_buffers.resize(num_frames);
+	m_reprojection_data.resize(num_frames);
+
+	for (uint32_t i = 0; i < num_frames; i++) {
+		void* data;
+		m_reprojection_buffers[i] = VWrap::Buffer::CreateMapped(m_allocator,
+			sizeof(ReprojectionParams),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			data);
+		m_reprojection_data[i] = static_cast<ReprojectionParams*>(data);
+		*m_reprojection_data[i] = {};
+	}
+}
+
+void OctreeTracer::Resize(VkExtent2D extent)
+{
+	m_extent = extent;
+	CreateTracedImage();
+	CreateBeamBuffer();
+	CreateHistoryBuffers();
+	WriteDescriptors();
+	CreateWavefront();
+	CreateUpscaler();
+}
+
+void OctreeTracer::CreateNodeBuffer()
+{
+	m_retirement_queue->Retire(m_node_buffer);
+	m_upload_service->UploadBuffer(m_node_buffer,
+		m_octree->GetNodes().data(),
+		m_octree->GetNodeBytes(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+}
+
+void OctreeTracer::CreateLODBuffer()
+{
+	m_retirement_queue->Retire(m_lod_buffer);
+	m_upload_service->UploadBuffer(m_lod_buffer,
+		m_lod.words.data(),
+		m_lod.words.size() * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+}
+
+void OctreeTracer::CreateStatsBuffers(uint32_t num_frames)
+{
+	m_stats_buffers.resize(num_frames);
+	m_stats_data.resize(num_frames);
+
+	for (uint32_t i = 0; i < num_frames; i++) {
+		void* data;
+		m_stats_buffers[i] = VWrap::Buffer::CreateMapped(m_allocator,
+			sizeof(TraversalStats),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			data);
+		m_stats_data[i] = static_cast<TraversalStats*>(data);
+		*m_stats_data[i] = {};
+	}
 }
 
 void OctreeTracer::WriteDescriptors()
 {
+	m_retirement_queue->Retire(m_descriptor_sets);
+	m_retirement_queue->Retire(m_descriptor_pool);
+	m_descriptor_pool = VWrap::DescriptorPool::Create(m_device, m_descriptor_pool_sizes, m_descriptor_set_count, 0);
+	std::vector<std::shared_ptr<VWrap::DescriptorSetLayout>> layouts(m_descriptor_set_count, m_descriptor_set_layout);
+	m_descriptor_sets = VWrap::DescriptorSet::CreateMany(m_descriptor_pool, layouts);
+
 	for (size_t i = 0; i < m_descriptor_sets.size(); i++) {
 
-		VkDescriptorImageInfo image_info{};
-		image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		image_info.imageView = m_brick_texture_view->Get();
-		image_info.sampler = m_sampler->Get();
+		VkDescriptorBufferInfo occupancy_info{};
+		occupancy_info.buffer = m_brick_pool->GetOccupancyBuffer()->Get();
+		occupancy_info.offset = 0;
+		occupancy_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo node_buffer_info{};
+		node_buffer_info.buffer = m_node_buffer->Get();
+		node_buffer_info.offset = 0;
+		node_buffer_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo stats_buffer_info{};
+		stats_buffer_info.buffer = m_stats_buffers[i]->Get();
+		stats_buffer_info.offset = 0;
+		stats_buffer_info.range = sizeof(TraversalStats);
+
+		VkDescriptorBufferInfo page_table_info{};
+		page_table_info.buffer = m_brick_pool->GetPageTableBuffer()->Get();
+		page_table_info.offset = 0;
+		page_table_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo feedback_info{};
+		feedback_info.buffer = m_brick_pool->GetFeedbackBuffer(static_cast<uint32_t>(i))->Get();
+		feedback_info.offset = 0;
+		feedback_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo material_info{};
+		material_info.buffer = m_brick_pool->GetMaterialBuffer()->Get();
+		material_info.offset = 0;
+		material_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo lod_info{};
+		lod_info.buffer = m_lod_buffer->Get();
+		lod_info.offset = 0;
+		lod_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorImageInfo traced_image_info{};
+		traced_image_info.imageView = m_traced_image_view->Get();
+		traced_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorBufferInfo beam_info{};
+		beam_info.buffer = m_beam_buffer->Get();
+		beam_info.offset = 0;
+		beam_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo history_info{};
+		history_info.buffer = m_history_buffer->Get();
+		history_info.offset = 0;
+		history_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo prediction_info{};
+		prediction_info.buffer = m_prediction_buffer->Get();
+		prediction_info.offset = 0;
+		prediction_info.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo reprojection_info{};
+		reprojection_info.buffer = m_reprojection_buffers[i]->Get();
+		reprojection_info.offset = 0;
+		reprojection_info.range = sizeof(ReprojectionParams);
 
 		// array of descriptor writes:
-		std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+		std::array<VkWriteDescriptorSet, 12> descriptorWrites{};
 
 		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[0].descriptorCount = 1;
 		descriptorWrites[0].dstBinding = 0;
 		descriptorWrites[0].dstSet = m_descriptor_sets[i]->Get();
 		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].pImageInfo = &image_info;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[0].pBufferInfo = &occupancy_info;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[1].dstArrayElement = 0;
+		descriptorWrites[1].pBufferInfo = &node_buffer_info;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[2].descriptorCount = 1;
+		descriptorWrites[2].dstBinding = 2;
+		descriptorWrites[2].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[2].dstArrayElement = 0;
+		descriptorWrites[2].pBufferInfo = &stats_buffer_info;
+		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[3].descriptorCount = 1;
+		descriptorWrites[3].dstBinding = 3;
+		descriptorWrites[3].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[3].dstArrayElement = 0;
+		descriptorWrites[3].pBufferInfo = &page_table_info;
+		descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[4].descriptorCount = 1;
+		descriptorWrites[4].dstBinding = 4;
+		descriptorWrites[4].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[4].dstArrayElement = 0;
+		descriptorWrites[4].pBufferInfo = &feedback_info;
+		descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[5].descriptorCount = 1;
+		descriptorWrites[5].dstBinding = 5;
+		descriptorWrites[5].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[5].dstArrayElement = 0;
+		descriptorWrites[5].pBufferInfo = &material_info;
+		descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[6].descriptorCount = 1;
+		descriptorWrites[6].dstBinding = 6;
+		descriptorWrites[6].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[6].dstArrayElement = 0;
+		descriptorWrites[6].pBufferInfo = &lod_info;
+		descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[7].descriptorCount = 1;
+		descriptorWrites[7].dstBinding = 7;
+		descriptorWrites[7].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[7].dstArrayElement = 0;
+		descriptorWrites[7].pImageInfo = &traced_image_info;
+		descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+		descriptorWrites[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[8].descriptorCount = 1;
+		descriptorWrites[8].dstBinding = 8;
+		descriptorWrites[8].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[8].dstArrayElement = 0;
+		descriptorWrites[8].pBufferInfo = &beam_info;
+		descriptorWrites[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[9].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[9].descriptorCount = 1;
+		descriptorWrites[9].dstBinding = 9;
+		descriptorWrites[9].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[9].dstArrayElement = 0;
+		descriptorWrites[9].pBufferInfo = &history_info;
+		descriptorWrites[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[10].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[10].descriptorCount = 1;
+		descriptorWrites[10].dstBinding = 10;
+		descriptorWrites[10].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[10].dstArrayElement = 0;
+		descriptorWrites[10].pBufferInfo = &prediction_info;
+		descriptorWrites[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		descriptorWrites[11].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[11].descriptorCount = 1;
+		descriptorWrites[11].dstBinding = 11;
+		descriptorWrites[11].dstSet = m_descriptor_sets[i]->Get();
+		descriptorWrites[11].dstArrayElement = 0;
+		descriptorWrites[11].pBufferInfo = &reprojection_info;
+		descriptorWrites[11].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 
 		vkUpdateDescriptorSets(m_device->Get(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
 }
 
+void OctreeTracer::CmdUpdate(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame)
+{
+	if (m_traced_image_undefined) {
+		command_buffer->CmdTransitionImageLayout(m_traced_image, m_traced_image->GetFormat(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		m_traced_image_undefined = false;
+	}
+
+	m_brick_pool->CmdUpdate(command_buffer, frame);
+
+	if (m_lod_update_pending) {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(command_buffer->Get(), VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		// One region per run of consecutive nodes; the staged words are packed in node order
+		std::vector<VkBufferCopy> regions;
+		for (size_t i = 0; i < m_lod_update_nodes.size(); i++) {
+			if (i > 0 && m_lod_update_nodes[i] == m_lod_update_nodes[i - 1] + 1) {
+				regions.back().size += sizeof(uint32_t);
+				continue;
+			}
+			VkBufferCopy region{};
+			region.srcOffset = m_lod_update.offset + i * sizeof(uint32_t);
+			region.dstOffset = (VkDeviceSize)m_lod_update_nodes[i] * sizeof(uint32_t);
+			region.size = sizeof(uint32_t);
+			regions.push_back(region);
+		}
+		vkCmdCopyBuffer(command_buffer->Get(), m_lod_update.buffer->Get(), m_lod_buffer->Get(), static_cast<uint32_t>(regions.size()), regions.data());
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(command_buffer->Get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		m_lod_update_pending = false;
+		m_lod_update_nodes.clear();
+	}
+
+	if (m_gpu_voxelizer)
+		m_gpu_voxelizer->CmdVoxelize(command_buffer);
+}
+
+uint32_t OctreeTracer::FillBox(glm::vec3 center, uint32_t size, uint8_t value)
+{
+	// World space to voxels of the octree
+	int32_t voxels = static_cast<int32_t>(m_octree->GetSize());
+	glm::vec3 voxel_center = (center - m_octree_location) / m_octree_scale * static_cast<float>(voxels);
+	glm::ivec3 lo = glm::ivec3(glm::floor(voxel_center - size * 0.5f + 0.5f));
+	glm::ivec3 hi = lo + static_cast<int32_t>(size) - 1;
+	if (glm::any(glm::lessThan(hi, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(lo, glm::ivec3(voxels))))
+		return 0;
+
+	uint32_t node_count = m_octree->GetNodeCount();
+	auto page_table = m_brick_pool->GetPageTableBuffer();
+	std::vector<glm::uvec3> changed_bricks;
+	uint32_t changed = m_brick_pool->FillRegion(glm::uvec3(glm::max(lo, glm::ivec3(0))), glm::uvec3(hi), value, &changed_bricks);
+	if (changed == 0)
+		return 0;
+
+	// Filled voxels may now stand in front of the recorded hits
+	m_history_valid = false;
+
+	// Only the edited leaves, their ancestors and the nodes copied out of a DAG are refiltered
+	std::vector<uint32_t> nodes;
+	m_octree->UpdateLOD(MATERIAL_PALETTE, changed_bricks, m_lod, nodes);
+
+	// Editing a DAG may have copied shared nodes and bricks, which repoints existing nodes and grows the node array and the
+	// brick pool's page table. The node and LOD buffers are replaced, and everything reading them or the page table rebound.
+	if (m_octree->GetNodeCount() != node_count || m_brick_pool->GetPageTableBuffer() != page_table) {
+		CreateNodeBuffer();
+		CreateLODBuffer();
+		m_lod_update_pending = false;
+		m_lod_update_nodes.clear();
+		WriteDescriptors();
+		CreateWavefront();
+		return changed;
+	}
+
+	if (!USE_VOXEL_LOD || nodes.empty())
+		return changed;
+
+	// An earlier edit's words may not have been copied yet, so they are staged again along with these
+	if (m_lod_update_pending) {
+		std::vector<uint32_t> merged;
+		std::set_union(nodes.begin(), nodes.end(), m_lod_update_nodes.begin(), m_lod_update_nodes.end(), std::back_inserter(merged));
+		nodes = std::move(merged);
+	}
+
+	// The next frame copies the new words over the old ones, after the frames still reading them. Only when the ring
+	// is too full does the buffer have to be replaced, with the old one retired and everything reading it rebound.
+	m_lod_update_pending = m_upload_service->GetStagingRing()->Allocate(nodes.size() * sizeof(uint32_t), m_lod_update);
+	if (m_lod_update_pending) {
+		uint32_t* words = static_cast<uint32_t*>(m_lod_update.data);
+		for (size_t i = 0; i < nodes.size(); i++)
+			words[i] = m_lod.words[nodes[i]];
+		m_lod_update_nodes = std::move(nodes);
+	}
+	else {
+		m_lod_update_nodes.clear();
+		CreateLODBuffer();
+		WriteDescriptors();
+		CreateWavefront();
+	}
+	return changed;
+}
+
+VWrap::PushConstantBlock OctreeTracer::GetPushConstants(std::shared_ptr<Camera> camera) const
+{
+	VWrap::PushConstantBlock PCB;
+	PCB.NDCtoWorld = GetJitteredNDCtoWorld(camera);
+	PCB.cameraPos = camera->GetPosition();
+	PCB.octreeScale = m_octree_scale;
+	PCB.octreeLocation = m_octree_location;
+
+	// The width of a pixel, per unit of distance along a ray through the centre of the screen. 0 disables level of detail.
+	// Scaled-down pixels are wider, so the tracer stops descending sooner.
+	VkExtent2D render_extent = GetRenderExtent();
+	float pixel_angle = 2.0f * std::tan(glm::radians(camera->GetFovy()) * 0.5f) / static_cast<float>(render_extent.height);
+	PCB.lodFootprint = USE_VOXEL_LOD ? pixel_angle * LOD_PIXEL_THRESHOLD : 0.0f;
+	PCB.renderSize = glm::ivec2(render_extent.width, render_extent.height);
+
+	// The wavefront path ignores the beam prepass; its primary rays start where they enter the octree
+	bool use_beam = m_use_beam_prepass && m_path != TracerPath::WAVEFRONT;
+	PCB.beamColumns = use_beam ? static_cast<int32_t>((render_extent.width + BEAM_BLOCK_SIZE - 1) / BEAM_BLOCK_SIZE) : 0;
+	return PCB;
+}
+
+glm::mat4 OctreeTracer::GetJitteredNDCtoWorld(std::shared_ptr<Camera> camera) const
+{
+	// Moving every sample by the jitter is the same as moving the screen under it by the opposite
+	VkExtent2D render_extent = GetRenderExtent();
+	glm::vec2 offset = 2.0f * m_jitter / glm::vec2(render_extent.width, render_extent.height);
+	return camera->GetNDCtoWorldMatrix() * glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f));
+}
+
+void OctreeTracer::CmdReproject(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, std::shared_ptr<Camera> camera)
+{
+	ReprojectionParams& params = *m_reprojection_data[frame];
+	if (!m_use_reprojection) {
+		params.mode = REPROJECTION_OFF;
+		params.debug_view = 0;
+		m_history_valid = false;
+		return;
+	}
+
+	// The halves of the history are sized for the full extent, whatever the render size
+	uint32_t pixels = m_extent.width * m_extent.height;
+	VkExtent2D render_extent = GetRenderExtent();
+	// The hits are rebuilt from and projected through the rays as they were traced, jitter and all
+	glm::mat4 ndc_to_world = GetJitteredNDCtoWorld(camera);
+	params.previous_ndc_to_world = m_previous_ndc_to_world;
+	params.world_to_ndc = glm::inverse(ndc_to_world);
+	params.previous_camera_position = m_previous_camera_position;
+	params.pixel_angle = 2.0f * std::tan(glm::radians(camera->GetFovy()) * 0.5f) / static_cast<float>(render_extent.height);
+	params.history_read = (1 - m_history_half) * pixels;
+	params.history_write = m_history_half * pixels;
+	params.mode = m_history_valid ? REPROJECTION_ON : REPROJECTION_RECORD;
+	params.debug_view = m_reprojection_debug ? 1 : 0;
+	params.previous_size = glm::ivec2(m_previous_render_extent.width, m_previous_render_extent.height);
+
+	// This frame's hits become the next frame's history
+	bool reproject = m_history_valid;
+	m_history_half = 1 - m_history_half;
+	m_previous_ndc_to_world = ndc_to_world;
+	m_previous_camera_position = camera->GetPosition();
+	m_previous_render_extent = render_extent;
+	m_history_valid = true;
+	if (!reproject)
+		return;
+
+	auto vk_command_buffer = command_buffer->Get();
+	VWrap::PushConstantBlock PCB = GetPushConstants(camera);
+
+	// The previous frame's rays must be done recording their hits and reading the predictions before they are rebuilt
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdFillBuffer(vk_command_buffer, m_prediction_buffer->Get(), 0, VK_WHOLE_SIZE, 0xFFFFFFFF);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	std::array<VkDescriptorSet, 1> descriptorSets = { m_descriptor_sets[frame]->Get() };
+	for (uint32_t pass = 0; pass < 2; pass++) {
+		vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reproject_pipelines[pass]->Get());
+		vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reproject_pipelines[pass]->GetLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
+		vkCmdPushConstants(vk_command_buffer, m_reproject_pipelines[pass]->GetLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VWrap::PushConstantBlock), &PCB);
+		vkCmdDispatch(vk_command_buffer, (params.previous_size.x + REPROJECT_TILE_SIZE - 1) / REPROJECT_TILE_SIZE, (params.previous_size.y + REPROJECT_TILE_SIZE - 1) / REPROJECT_TILE_SIZE, 1);
+
+		// The voxels are written once every distance is final, and the rays read both
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+}
+
+void OctreeTracer::CmdTrace(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, std::shared_ptr<Camera> camera, std::shared_ptr<GPUProfiler> profiler)
+{
+	// This frame's fence has been waited on, so the GPU is done with its counters
+	m_last_stats = *m_stats_data[frame];
+	*m_stats_data[frame] = {};
+
+	m_jitter = m_upscaler ? m_upscaler->NextJitter() : glm::vec2(0.0f);
+
+	if (m_path == TracerPath::WAVEFRONT) {
+		// The wavefront path records no hits, so the history is stale once it is left
+		m_history_valid = false;
+		m_wavefront->CmdTrace(command_buffer, frame, GetPushConstants(camera), profiler);
+		if (m_upscaler)
+			m_upscaler->CmdResolve(command_buffer, frame, camera, GetRenderExtent());
+		return;
+	}
+
+	auto vk_command_buffer = command_buffer->Get();
+	VWrap::PushConstantBlock PCB = GetPushConstants(camera);
+
+	CmdReproject(command_buffer, frame, camera);
+
+	if (m_use_beam_prepass) {
+		// The previous frame's rays must be done reading the distances before they are overwritten
+		VkMemoryBarrier beam_barrier{};
+		beam_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		beam_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		beam_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &beam_barrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_beam_pipeline->Get());
+
+		std::array<VkDescriptorSet, 1> beamDescriptorSets = { m_descriptor_sets[frame]->Get() };
+		vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_beam_pipeline->GetLayout(), 0, 1, beamDescriptorSets.data(), 0, nullptr);
+		vkCmdPushConstants(vk_command_buffer, m_beam_pipeline->GetLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VWrap::PushConstantBlock), &PCB);
+
+		uint32_t beam_count = static_cast<uint32_t>(PCB.beamColumns) * ((static_cast<uint32_t>(PCB.renderSize.y) + BEAM_BLOCK_SIZE - 1) / BEAM_BLOCK_SIZE);
+		vkCmdDispatch(vk_command_buffer, (beam_count + BEAM_WORKGROUP_SIZE - 1) / BEAM_WORKGROUP_SIZE, 1, 1);
+
+		beam_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		beam_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &beam_barrier, 0, nullptr, 0, nullptr);
+	}
+
+	if (m_path != TracerPath::COMPUTE)
+		return;
+
+	// The previous frame's composite must be done reading the image before it is overwritten
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = m_traced_image->Get();
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compute_pipeline->Get());
+
+	std::array<VkDescriptorSet, 1> descriptorSets = { m_descriptor_sets[frame]->Get() };
+	vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compute_pipeline->GetLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
+
+	vkCmdPushConstants(vk_command_buffer, m_compute_pipeline->GetLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VWrap::PushConstantBlock), &PCB);
+
+	vkCmdDispatch(vk_command_buffer, (static_cast<uint32_t>(PCB.renderSize.x) + TRACE_TILE_SIZE - 1) / TRACE_TILE_SIZE, (static_cast<uint32_t>(PCB.renderSize.y) + TRACE_TILE_SIZE - 1) / TRACE_TILE_SIZE, 1);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	if (m_upscaler)
+		m_upscaler->CmdResolve(command_buffer, frame, camera, GetRenderExtent());
+}
+
 void OctreeTracer::CmdDraw(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, std::shared_ptr<Camera> camera)
 {
 	auto vk_command_buffer = command_buffer->Get();
-	vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->Get());
+	auto pipeline = m_path == TracerPath::FRAGMENT ? m_pipeline : m_composite_pipeline;
+	vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->Get());
 
 	std::array<VkDescriptorSet, 1> descriptorSets = { m_descriptor_sets[frame]->Get() };
-	vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->GetLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
+	vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->GetLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
 
 
 	VkViewport viewport{};
@@ -159,19 +1125,25 @@ void OctreeTracer::CmdDraw(std::shared_ptr<VWrap::CommandBuffer> command_buffer,
 
 	vkCmdSetScissor(vk_command_buffer, 0, 1, &scissor);
 
-	VWrap::PushConstantBlock PCB;
-	PCB.NDCtoWorld = camera->GetNDCtoWorldMatrix();
-	PCB.cameraPos = camera->GetPosition();
+	if (m_path == TracerPath::FRAGMENT) {
+		VWrap::PushConstantBlock PCB = GetPushConstants(camera);
 
-	// Populate pushConstants with the necessary data
-	vkCmdPushConstants(
-		vk_command_buffer,
-		m_pipeline->GetLayout(), // The pipeline layout used for the push constants
-		VK_SHADER_STAGE_FRAGMENT_BIT, // Shader stage the push constants will be used in
-		0, // Offset of the push constants to update
-		sizeof(VWrap::PushConstantBlock), // Size of the push constants to update
-		&PCB // Pointer to the data to copy
-	);
+		// Populate pushConstants with the necessary data
+		vkCmdPushConstants(
+			vk_command_buffer,
+			m_pipeline->GetLayout(), // The pipeline layout used for the push constants
+			VK_SHADER_STAGE_FRAGMENT_BIT, // Shader stage the push constants will be used in
+			0, // Offset of the push constants to update
+			sizeof(VWrap::PushConstantBlock), // Size of the push constants to update
+			&PCB // Pointer to the data to copy
+		);
+	}
+	else {
+		// The upscaler leaves a full-size frame in the traced image
+		VkExtent2D render_extent = m_upscaler ? m_extent : GetRenderExtent();
+		glm::ivec2 render_size(render_extent.width, render_extent.height);
+		vkCmdPushConstants(vk_command_buffer, m_composite_pipeline->GetLayout(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::ivec2), &render_size);
+	}
 
 	vkCmdDraw(vk_command_buffer, 4, 1, 0, 0);
-}
+}
\ No newline at end of file
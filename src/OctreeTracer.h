@@ -11,19 +11,143 @@
 #include "Framebuffer.h"
 #include "Pipeline.h"
 #include "Allocator.h"
-#include "Sampler.h"
+#include "Image.h"
+#include "ImageView.h"
+#include "RetirementQueue.h"
 
 #include "Camera.h"
+#include "Octree.h"
+#include "BrickPool.h"
+#include "BrickStreamer.h"
+#include "OctreeFile.h"
+#include "Voxelizer.h"
+#include "ProceduralGenerator.h"
+#include "GPUVoxelizer.h"
+#include "MeshRasterizer.h"
+#include "WavefrontTracer.h"
+#include "TemporalUpscaler.h"
+#include "GPUProfiler.h"
 
 #include "tiny_obj_loader.h"
 #include <unordered_map>
 #include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <filesystem>
+#include <thread>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+/// <summary>
+/// The number of voxels the brick pool can hold. Bounds the VRAM used by bricks regardless of scene size.
+/// </summary>
+const size_t BRICK_POOL_VOXELS = 256 * 256 * 256;
+
+/// <summary>
+/// Whether the brick pool stores voxel values alongside occupancy, so the tracer can shade by material.
+/// Occupancy alone costs 1 bit per voxel; materials add another byte.
+/// </summary>
+const bool BRICK_POOL_MATERIALS = true;
+
+/// <summary>
+/// The maximum number of bytes of brick data uploaded to the brick pool per frame.
+/// </summary>
+const VkDeviceSize BRICK_UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+/// <summary>
+/// The mesh voxelized for the Mesh reference scene, and the resolution it is voxelized at.
+/// </summary>
+const std::string VOXELIZER_MODEL_PATH = "../models/viking_room.obj";
+const uint32_t VOXELIZER_RESOLUTION = 512;
+
+/// <summary>
+/// The resolution the GPU Mesh scene is voxelized at every frame. Its bricks must all fit in the brick pool at once.
+/// </summary>
+const uint32_t GPU_VOXELIZER_RESOLUTION = 256;
+
+/// <summary>
+/// Whether the GPU voxelizer's output is read back and compared with the CPU voxelizer when the GPU Mesh scene is loaded.
+/// Voxelizing the mesh on the CPU takes far longer than loading the scene; "--test-gpu-voxelizer" checks small meshes instead.
+/// </summary>
+const bool VALIDATE_GPU_VOXELIZER = false;
+
+/// <summary>
+/// The octree file the Streamed scene pages bricks from, and the size of the City scene written to it when it does not exist.
+/// </summary>
+const std::string STREAMING_SCENE_PATH = "../models/city_2048.svo";
+const uint32_t STREAMING_SCENE_SIZE = 2048;
+
+/// <summary>
+/// The maximum number of streamed bricks read ahead of the brick pool and held in RAM.
+/// </summary>
+const size_t STREAMING_MAX_READY = 4096;
+
+/// <summary>
+/// Whether reference scenes are compressed into a sparse voxel DAG before they are traced.
+/// </summary>
+const bool USE_OCTREE_DAG = true;
+
+/// <summary>
+/// The colour of each voxel value, indexed by the value modulo 8. Must match the palette in shaders/tracer.glsl; the CPU tracer shades with it too.
+/// </summary>
+const std::vector<glm::vec3> MATERIAL_PALETTE = {
+	glm::vec3(1.0f), glm::vec3(1.0f), glm::vec3(0.85f, 0.33f, 0.31f), glm::vec3(0.36f, 0.72f, 0.36f),
+	glm::vec3(0.26f, 0.55f, 0.79f), glm::vec3(0.94f, 0.76f, 0.29f), glm::vec3(0.6f, 0.4f, 0.75f), glm::vec3(0.3f, 0.75f, 0.75f)
+};
+
+/// <summary>
+/// Whether the tracer stops descending once a cell's projected footprint falls below LOD_PIXEL_THRESHOLD pixels,
+/// and shades it with its prefiltered colour and coverage instead.
+/// </summary>
+const bool USE_VOXEL_LOD = true;
+const float LOD_PIXEL_THRESHOLD = 1.0f;
+
+/// <summary>
+/// How far in front of the camera, in world units, GUI edits are centred.
+/// </summary>
+const float EDIT_DISTANCE = 0.5f;
+
+/// <summary>
+/// A voxel edit requested from the GUI.
+/// </summary>
+enum class EditAction {
+	NONE, CARVE, FILL
+};
+
+/// <summary>
+/// The reference scenes the tracer can load. Used to compare traversal cost between scenes of different sparsity.
+/// </summary>
+enum class TracerScene {
+	SINGLE_BRICK, SPHERE, SCATTERED_SPHERES, CITY, MESH, GPU_MESH, STREAMED, TERRAIN, COUNT
+};
+
+/// <summary>
+/// How the tracer's rays are dispatched. The fragment path traces in the render pass, one full-screen quad; the compute path
+/// traces 8x8 tiles into a storage image before the render pass and composites it; the wavefront path traces in stages through
+/// ray queues, adding shadow and ambient occlusion rays, into the same image. All run the same traversal, from tracer.glsl.
+/// </summary>
+enum class TracerPath {
+	FRAGMENT, COMPUTE, WAVEFRONT, COUNT
+};
+
+/// <summary>
+/// The size and build cost of the loaded scene, before and after DAG compression.
+/// </summary>
+struct SceneStats {
+	uint32_t node_count;
+	uint32_t brick_count;
+	size_t bytes;
+	float build_ms;
+
+	uint32_t dag_node_count;
+	uint32_t dag_brick_count;
+	size_t dag_bytes;
+	float dag_build_ms;
+};
+
 class OctreeTracer
 {
 private:
@@ -33,47 +157,418 @@ private:
 	std::shared_ptr<VWrap::Device> m_device;
 	std::shared_ptr<VWrap::CommandPool> m_graphics_pool;
 	std::shared_ptr<VWrap::Allocator> m_allocator;
+	std::shared_ptr<UploadService> m_upload_service;
+
+	/// <summary> Holds the resources replaced by resizes and scene, path and mode changes until the frames in flight are done with them. </summary>
+	std::shared_ptr<VWrap::RetirementQueue> m_retirement_queue;
 
 	// DESCRIPTORS
 	std::shared_ptr<VWrap::DescriptorSetLayout> m_descriptor_set_layout;
 	std::shared_ptr<VWrap::DescriptorPool> m_descriptor_pool;
 	std::vector<std::shared_ptr<VWrap::DescriptorSet>> m_descriptor_sets;
 
+	/// <summary> The sizes of each pool the descriptor sets are allocated from, and the number of sets, one per frame in flight. </summary>
+	std::vector<VkDescriptorPoolSize> m_descriptor_pool_sizes;
+	uint32_t m_descriptor_set_count = 0;
+
 	// PIPELINE
 	std::shared_ptr<VWrap::Pipeline> m_pipeline;
+	std::shared_ptr<VWrap::RenderPass> m_render_pass;
 	VkExtent2D m_extent;
 
-	// BRICK TEXTURE
-	std::shared_ptr<VWrap::Image> m_brick_texture;
-	std::shared_ptr<VWrap::ImageView> m_brick_texture_view;
-	std::shared_ptr<VWrap::Sampler> m_sampler;
+	// COMPUTE PATH
+	/// <summary> Traces tiles into the traced image. </summary>
+	std::shared_ptr<VWrap::Pipeline> m_compute_pipeline;
+
+	/// <summary> Copies the traced image into the render pass, one texel per pixel. </summary>
+	std::shared_ptr<VWrap::Pipeline> m_composite_pipeline;
+
+	/// <summary> The compute path's output, the size of the swapchain, kept in the general layout. </summary>
+	std::shared_ptr<VWrap::Image> m_traced_image;
+	std::shared_ptr<VWrap::ImageView> m_traced_image_view;
+
+	/// <summary> Whether the traced image is still in the undefined layout, until the next frame's CmdUpdate moves it to the general layout. </summary>
+	bool m_traced_image_undefined = false;
+
+	/// <summary> How rays are dispatched. </summary>
+	TracerPath m_path = TracerPath::COMPUTE;
+
+	/// <summary> The scale of each side of the compute and wavefront paths' render size, relative to the extent. </summary>
+	float m_render_scale = 1.0f;
+
+	// BEAM PREPASS
+	/// <summary> Traces one cone per block of pixels, before the fragment and compute paths, to find where their rays can start. </summary>
+	std::shared_ptr<VWrap::Pipeline> m_beam_pipeline;
+
+	/// <summary> The distance each block's rays start from, one float per block, row by row. </summary>
+	std::shared_ptr<VWrap::Buffer> m_beam_buffer;
 
+	/// <summary> Whether the beam prepass runs. Otherwise rays start where they enter the octree. </summary>
+	bool m_use_beam_prepass = true;
+
+	// TEMPORAL REPROJECTION
+	/// <summary> Laid out as the ReprojectionParams block in reproject.glsl. </summary>
+	struct ReprojectionParams {
+		glm::mat4 previous_ndc_to_world;
+		glm::mat4 world_to_ndc;
+		glm::vec3 previous_camera_position;
+		float pixel_angle;
+		uint32_t history_read;
+		uint32_t history_write;
+		uint32_t mode;
+		uint32_t debug_view;
+		glm::ivec2 previous_size;
+	};
+
+	/// <summary> Must match the modes in reproject.glsl. </summary>
+	static constexpr uint32_t REPROJECTION_OFF = 0;
+	static constexpr uint32_t REPROJECTION_RECORD = 1;
+	static constexpr uint32_t REPROJECTION_ON = 2;
+
+	/// <summary> Carry the previous frame's hits into this frame's pixels: the first merges their distances, the second fills in their voxels. </summary>
+	std::array<std::shared_ptr<VWrap::Pipeline>, 2> m_reproject_pipelines;
+
+	/// <summary> Each pixel's hit distance and voxel for the last two frames, in two halves that swap every frame. </summary>
+	std::shared_ptr<VWrap::Buffer> m_history_buffer;
+
+	/// <summary> The previous frame's nearest hit landing in each pixel, rebuilt every frame. </summary>
+	std::shared_ptr<VWrap::Buffer> m_prediction_buffer;
+
+	/// <summary> One persistently mapped parameter buffer per frame in flight. </summary>
+	std::vector<std::shared_ptr<VWrap::Buffer>> m_reprojection_buffers;
+	std::vector<ReprojectionParams*> m_reprojection_data;
+
+	/// <summary> Whether the fragment and compute paths start their rays from the previous frame's hits. </summary>
+	bool m_use_reprojection = true;
+
+	/// <summary> Whether pixels are tinted by how their rays started. </summary>
+	bool m_reprojection_debug = false;
+
+	/// <summary> Whether the last frame recorded its hits for the current camera, octree and extent. </summary>
+	bool m_history_valid = false;
+
+	/// <summary> The half of the history the next frame writes. </summary>
+	uint32_t m_history_half = 0;
+
+	/// <summary> The camera the last recorded hits were traced from. </summary>
+	glm::mat4 m_previous_ndc_to_world = glm::mat4(1.0f);
+	glm::vec3 m_previous_camera_position = glm::vec3(0.0f);
+	VkExtent2D m_previous_render_extent{};
+
+	// TEMPORAL UPSCALING
+	/// <summary> Rebuilds the full-resolution frame from the compute and wavefront paths' jittered traces. Null unless a mode is selected for one of them. </summary>
+	std::shared_ptr<TemporalUpscaler> m_upscaler;
+
+	/// <summary> How much of the screen the upscaler traces. </summary>
+	UpscaleMode m_upscale_mode = UpscaleMode::OFF;
+
+	/// <summary> Where in its render pixel each of the current frame's samples is traced. 0 unless upscaling. </summary>
+	glm::vec2 m_jitter = glm::vec2(0.0f);
+
+	// WAVEFRONT PATH
+	/// <summary> The wavefront path's stages and queues, which trace into the traced image. Null unless the wavefront path is selected. </summary>
+	std::shared_ptr<WavefrontTracer> m_wavefront;
+
+	/// <summary> The maximum number of traversal steps a single ray may take. </summary>
+	uint32_t m_step_budget = 1000;
+
+	// BRICKS
+	/// <summary> Holds the resident bricks and maps the octree's bricks to them. </summary>
+	std::shared_ptr<BrickPool> m_brick_pool;
+
+	// GPU VOXELIZATION
+	/// <summary> The rasterizer whose mesh is voxelized for the GPU Mesh scene. </summary>
+	std::shared_ptr<MeshRasterizer> m_mesh;
+
+	/// <summary> Re-voxelizes the mesh into the brick pool every frame while the GPU Mesh scene is loaded. Null otherwise. </summary>
+	std::shared_ptr<GPUVoxelizer> m_gpu_voxelizer;
+
+	// STREAMING
+	/// <summary> Reads bricks from disk while the Streamed scene is loaded. Null otherwise. </summary>
+	std::shared_ptr<BrickStreamer> m_streamer;
+
+	// OCTREE
+	/// <summary> The octree being traced. </summary>
+	std::shared_ptr<Octree> m_octree;
+
+	/// <summary> The flattened octree nodes, bound as a storage buffer. </summary>
+	std::shared_ptr<VWrap::Buffer> m_node_buffer;
+
+	/// <summary> The prefiltered colour and coverage of every node, parallel to the node buffer. See Octree::BuildLOD. </summary>
+	std::shared_ptr<VWrap::Buffer> m_lod_buffer;
+
+	/// <summary> The host copy of the LOD buffer, with the filters that edits refilter from. </summary>
+	OctreeLOD m_lod;
+
+	/// <summary> The words of the nodes edits changed, staged for the next frame to copy over the old ones. </summary>
+	StagingAllocation m_lod_update;
+	bool m_lod_update_pending = false;
+
+	/// <summary> The nodes whose words are staged in m_lod_update, ascending. </summary>
+	std::vector<uint32_t> m_lod_update_nodes;
+
+	/// <summary> The world-space position of the octree's minimum corner. </summary>
+	glm::vec3 m_octree_location = glm::vec3(-1.0f);
+
+	/// <summary> The world-space width of the octree. </summary>
+	float m_octree_scale = 2.0f;
+
+	/// <summary> The currently loaded reference scene. </summary>
+	TracerScene m_scene = TracerScene::COUNT;
+
+	/// <summary> The size and build cost of the currently loaded reference scene. </summary>
+	SceneStats m_scene_stats{};
+
+	// TRAVERSAL STATISTICS
+	/// <summary> Traversal counters accumulated by the fragment shader, laid out as in the shader's storage buffer. </summary>
+	struct TraversalStats {
+		uint32_t total_steps;
+		uint32_t total_rays;
+		uint32_t reprojected_rays;
+		uint32_t reprojection_hits;
+	};
+
+	/// <summary> One persistently mapped counter buffer per frame in flight. </summary>
+	std::vector<std::shared_ptr<VWrap::Buffer>> m_stats_buffers;
+	std::vector<TraversalStats*> m_stats_data;
+
+	/// <summary> The counters of the most recently completed frame. </summary>
+	TraversalStats m_last_stats{};
 
 	// CLASS FUNCTIONS ---------------------------------------------------------------------------------------
 
+	/// <summary>
+	/// Gets the push constants of both tracer paths for the given camera.
+	/// </summary>
+	VWrap::PushConstantBlock GetPushConstants(std::shared_ptr<Camera> camera) const;
+
+	/// <summary>
+	/// Gets the camera's NDC to world matrix, offset by the current frame's jitter so that each pixel's ray passes through its sample.
+	/// </summary>
+	glm::mat4 GetJitteredNDCtoWorld(std::shared_ptr<Camera> camera) const;
 
 public:
 
 
-	static std::shared_ptr<OctreeTracer> Create(std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::RenderPass> render_pass, std::shared_ptr<VWrap::CommandPool> graphics_pool, VkExtent2D extent, uint32_t num_frames);
+	static std::shared_ptr<OctreeTracer> Create(std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::RenderPass> render_pass, std::shared_ptr<VWrap::CommandPool> graphics_pool, std::shared_ptr<UploadService> upload_service, std::shared_ptr<VWrap::RetirementQueue> retirement_queue, VkExtent2D extent, uint32_t num_frames);
 
 	void CreateDescriptors(int max_sets);
 
+	/// <summary>
+	/// Creates the fragment tracer, compute tracer and composite pipelines. The octree's brick size and depth are specialization constants.
+	/// </summary>
 	void CreatePipeline(std::shared_ptr<VWrap::RenderPass> render_pass);
 
+	/// <summary>
+	/// Creates the compute path's storage image at the current extent. The next frame's CmdUpdate moves it to the general layout.
+	/// </summary>
+	void CreateTracedImage();
+
+	/// <summary>
+	/// Creates the beam prepass's distance buffer, one float per block of the current extent.
+	/// </summary>
+	void CreateBeamBuffer();
+
+	/// <summary>
+	/// Creates the reprojection's history and prediction buffers for the current extent. The history starts out stale.
+	/// </summary>
+	void CreateHistoryBuffers();
+
+	/// <summary>
+	/// Creates one host-visible reprojection parameter buffer for each frame in flight.
+	/// </summary>
+	void CreateReprojectionBuffers(uint32_t num_frames);
+
+	/// <summary>
+	/// Records the passes that carry the previous frame's hits into this frame's pixels, and fills in this frame's parameters.
+	/// </summary>
+	void CmdReproject(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, std::shared_ptr<Camera> camera);
+
+	/// <summary>
+	/// Creates the wavefront path's stages and queues for the current octree and extent if it is selected, or frees them if not.
+	/// The old ones are retired until the frames in flight that dispatch them have finished.
+	/// </summary>
+	void CreateWavefront();
+
+	/// <summary>
+	/// Creates the temporal upscaler for the current extent if a mode is selected and the path traces into the traced image, or frees it
+	/// if not. The old upscaler is retired until the frames in flight that use it have finished.
+	/// </summary>
+	void CreateUpscaler();
+
+	/// <summary>
+	/// Uploads the octree's node array to a device-local storage buffer.
+	/// </summary>
+	void CreateNodeBuffer();
+
+	/// <summary>
+	/// Uploads the level-of-detail words in m_lod to a new device-local storage buffer, retiring the old one.
+	/// </summary>
+	void CreateLODBuffer();
+
+	/// <summary>
+	/// Creates one host-visible traversal counter buffer for each frame in flight.
+	/// </summary>
+	void CreateStatsBuffers(uint32_t num_frames);
+
+	/// <summary>
+	/// Replaces the traced octree, rebuilding every resource that depends on it. Called between frames; the replaced buffers,
+	/// pipelines and descriptor sets are retired until the frames in flight still reading them have finished.
+	/// </summary>
+	/// <param name="pinned"> Whether the octree's bricks are pinned in the brick pool and written on the GPU rather than uploaded. </param>
+	void LoadOctree(std::shared_ptr<Octree> octree, bool pinned = false);
+
+	/// <summary>
+	/// Replaces the traced octree with the nodes of a streamer, whose bricks are read from disk as they are needed. Retires the
+	/// replaced resources as LoadOctree does.
+	/// </summary>
+	void LoadStreamer(std::shared_ptr<BrickStreamer> streamer);
+
+	/// <summary>
+	/// Sets the rasterizer whose vertex and index buffers the GPU Mesh scene voxelizes.
+	/// </summary>
+	void SetMesh(std::shared_ptr<MeshRasterizer> mesh) { m_mesh = mesh; }
+
+	/// <summary>
+	/// Builds and loads one of the reference scenes between frames. See LoadOctree.
+	/// </summary>
+	void SetScene(TracerScene scene);
+
+	/// <summary>
+	/// Builds one of the reference scenes that are traced from memory, compressed into a DAG if USE_OCTREE_DAG is set.
+	/// Needs no device, so the CPU tracer can render the same scenes.
+	/// </summary>
+	/// <param name="stats"> Receives the size and build cost of the scene. </param>
+	static std::shared_ptr<Octree> BuildScene(TracerScene scene, SceneStats& stats);
+
+	/// <summary>
+	/// Loads the GPU Mesh scene: a complete octree pinned in the brick pool, filled by the GPU voxelizer every frame.
+	/// </summary>
+	void SetGPUMeshScene();
+
+	/// <summary>
+	/// Loads the Streamed scene: a City octree too large for the brick pool, paged in from a file. Writes the file first if it does not exist.
+	/// </summary>
+	void SetStreamedScene();
+
+	/// <summary>
+	/// Passes the camera's position, direction and world-space velocity to the streamer, if one is loaded, to prioritize prefetches.
+	/// </summary>
+	void UpdateCamera(std::shared_ptr<Camera> camera, glm::vec3 velocity);
+
+	/// <summary> Gets the currently loaded reference scene. </summary>
+	TracerScene GetScene() const { return m_scene; }
+
+	/// <summary> Gets the size and build cost of the currently loaded reference scene. </summary>
+	const SceneStats& GetSceneStats() const { return m_scene_stats; }
+
+	/// <summary> Gets the display name of a reference scene. </summary>
+	static const char* GetSceneName(TracerScene scene);
+
+	/// <summary>
+	/// Sets how rays are dispatched. Takes effect from the next recorded frame. Switching to or from the wavefront path creates
+	/// or frees its queues; freed ones are retired until the frames in flight that use them have finished.
+	/// </summary>
+	void SetPath(TracerPath path);
+
+	/// <summary> Gets how rays are dispatched. </summary>
+	TracerPath GetPath() const { return m_path; }
+
+	/// <summary> Gets the display name of a tracer path. </summary>
+	static const char* GetPathName(TracerPath path);
+
+	/// <summary>
+	/// Sets the scale of each side of the compute and wavefront paths' render size, in (0, 1]. They trace the top left of the traced image
+	/// at that size, and the composite stretches it over the screen. The fragment path always traces at full size.
+	/// When upscaling, the scale applies on top of the upscale mode's.
+	/// </summary>
+	void SetRenderScale(float scale) { m_render_scale = std::clamp(scale, 0.0f, 1.0f); }
+
+	/// <summary>
+	/// Sets how much of the screen the compute and wavefront paths trace, the temporal upscaler rebuilding the rest. The fragment path
+	/// is never upscaled. Changing the mode creates or frees the upscaler's history, retiring the old one until the frames in flight
+	/// that read it have finished.
+	/// </summary>
+	void SetUpscaleMode(UpscaleMode mode);
+
+	/// <summary> Gets how much of the screen the temporal upscaler traces. </summary>
+	UpscaleMode GetUpscaleMode() const { return m_upscale_mode; }
+
+	/// <summary> Gets the number of pixels traced along each side for the current path and render scale. </summary>
+	VkExtent2D GetRenderExtent() const;
+
+	/// <summary> Sets whether the fragment and compute paths start their rays from the beam prepass's distances. </summary>
+	void SetBeamPrepass(bool enabled) { m_use_beam_prepass = enabled; }
+
+	/// <summary> Gets whether the beam prepass runs. </summary>
+	bool UsesBeamPrepass() const { return m_use_beam_prepass; }
+
+	/// <summary>
+	/// Sets whether the fragment and compute paths start their rays just before the hit the previous frame saw through each pixel,
+	/// and whether the debug view tints each pixel by how its ray started: green if the reprojected hit was found, red if it was not
+	/// and the ray was traced again, blue if no hit was reprojected into the pixel.
+	/// </summary>
+	void SetReprojection(bool enabled, bool debug_view) { m_use_reprojection = enabled; m_reprojection_debug = debug_view; }
+
+	/// <summary> Gets the fraction of rays that started from a reprojected hit, over the most recently completed frame. </summary>
+	float GetReprojectedFraction() const {
+		return m_last_stats.total_rays == 0 ? 0.0f : (float)m_last_stats.reprojected_rays / (float)m_last_stats.total_rays;
+	}
+
+	/// <summary> Gets the fraction of reprojected rays whose check found the predicted surface, over the most recently completed frame. </summary>
+	float GetReprojectionSuccessRate() const {
+		return m_last_stats.reprojected_rays == 0 ? 0.0f : (float)m_last_stats.reprojection_hits / (float)m_last_stats.reprojected_rays;
+	}
+
+	/// <summary>
+	/// Gets the average number of traversal steps per ray that entered the octree, over the most recently completed frame.
+	/// </summary>
+	float GetAverageSteps() const {
+		return m_last_stats.total_rays == 0 ? 0.0f : (float)m_last_stats.total_steps / (float)m_last_stats.total_rays;
+	}
+
 	/// <summary>
 /// Creates one uniform buffer for each frame in flight and maps them to host memory.
 /// </summary>
 	void CreateUniformBuffers();
 
 	/// <summary>
-	/// Updates the descriptor sets with the uniform buffers and image sampler.
+	/// Allocates new descriptor sets and writes the octree, brick pool and counter buffers to them. Frames in flight may still
+	/// have the old sets bound, so they are retired rather than rewritten.
 	/// </summary>
 	void WriteDescriptors();
 
 
 	/// <summary>
-	/// Records commands to the command_buffer to draw the model using rasterization.
+	/// Records the brick pool's uploads for this frame, the LOD buffer's update after an edit, and the GPU voxelizer's dispatch if the
+	/// GPU Mesh scene is loaded.
+	/// Must be recorded outside of the render pass.
+	/// </summary>
+	void CmdUpdate(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame);
+
+	/// <summary>
+	/// Sets every voxel in a cube centred on a world-space point to the given value, 0 to clear. See BrickPool::FillRegion.
+	/// If any brick changed, the level-of-detail words of its leaf and their ancestors are refiltered, and only those are copied by the next frame.
+	/// Editing a brick that a DAG shares copies it first, so the node and level-of-detail buffers are replaced.
+	/// </summary>
+	/// <param name="size"> The width of the cube, in voxels. </param>
+	/// <returns> The number of bricks that changed. </returns>
+	uint32_t FillBox(glm::vec3 center, uint32_t size, uint8_t value);
+
+	/// <summary> Gets the brick pool's counters for the most recent frame. </summary>
+	BrickPoolStats GetBrickPoolStats() const { return m_brick_pool->GetStats(); }
+
+	/// <summary>
+	/// Records the compute or wavefront path's dispatches, if one is selected, tracing the frame into the traced image.
+	/// The fragment and compute paths are preceded by the reprojection of the previous frame's hits and the beam prepass, if they are enabled,
+	/// and the compute and wavefront paths are followed by the temporal upscaler's resolve, if a mode is selected.
+	/// Must be recorded outside of the render pass, after CmdUpdate and before CmdDraw.
+	/// </summary>
+	/// <param name="profiler"> Receives the GPU time of each wavefront stage. </param>
+	void CmdTrace(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, std::shared_ptr<Camera> camera, std::shared_ptr<GPUProfiler> profiler);
+
+	/// <summary>
+	/// Records commands to the command_buffer to draw the traced octree: the fragment tracer, or the compute path's composite.
 	/// </summary>
 	/// <param name="command_buffer"> The command buffer to record to. </param>
 	/// <param name="frame"> Which frame-in-flight's resources to use. </param>
@@ -87,11 +582,22 @@ public:
 	void UpdateUniformBuffer(uint32_t frame, std::shared_ptr<Camera> camera);
 
 	/// <summary>
-	/// Updates the extent of the pipeline.
+	/// Updates the extent of the pipeline, and recreates the traced image to match. The old images and buffers are retired until
+	/// the frames in flight that use them have finished.
 	/// </summary>
 	/// <param name="extent"> The new extent. </param>
-	void Resize(VkExtent2D extent) {
-		m_extent = extent;
-	}
+	void Resize(VkExtent2D extent);
+
+	/// <summary> The width and height of the tiles traced by each compute workgroup. Must match shader_tracer.comp. </summary>
+	static constexpr uint32_t TRACE_TILE_SIZE = 8;
+
+	/// <summary> The width and height of the blocks of pixels that share a beam. Must match beam.glsl. </summary>
+	static constexpr uint32_t BEAM_BLOCK_SIZE = 8;
+
+	/// <summary> The number of beams traced per workgroup. Must match local_size_x in shader_beam.comp. </summary>
+	static constexpr uint32_t BEAM_WORKGROUP_SIZE = 64;
+
+	/// <summary> The width and height of the pixel tiles reprojected by each workgroup. Must match shader_reproject.comp. </summary>
+	static constexpr uint32_t REPROJECT_TILE_SIZE = 8;
 };
 
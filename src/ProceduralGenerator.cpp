@@ -0,0 +1,513 @@
+#include "ProceduralGenerator.h"
+#include "SIMD.h"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <cstdio>
+#include <cmath>
+#include <bit>
+
+using namespace simd;
+
+namespace {
+
+	/// <summary> The quintic fade curve. Its derivative peaks at 1.875, which bounds how fast the noise can change. </summary>
+	inline Float8 Fade(Float8 t) { return t * t * t * (t * (t * Splat(6.0f) - Splat(15.0f)) + Splat(10.0f)); }
+
+	/// <summary>
+	/// Hashes lattice coordinates to a value in [-1, 1].
+	/// </summary>
+	inline Float8 LatticeValue(Int8 x, Int8 y, Int8 z, uint32_t seed) {
+		Int8 h = x * SplatInt(0x8da6b343u) ^ y * SplatInt(0xd8163841u) ^ z * SplatInt(0xcb1ab31fu) ^ SplatInt(seed);
+		h = (h ^ (h >> 16)) * SplatInt(0x7feb352du);
+		h = (h ^ (h >> 15)) * SplatInt(0x846ca68bu);
+		h = h ^ (h >> 16);
+		return ToFloat(h >> 8) * Splat(2.0f / 16777216.0f) - Splat(1.0f);
+	}
+
+	/// <summary>
+	/// 2D value noise in [-1, 1], with lattice points one unit apart. Its gradient is at most 3.75 * sqrt(2).
+	/// </summary>
+	Float8 ValueNoise(Float8 x, Float8 y, uint32_t seed) {
+		Int8 ix = FloorToInt(x), iy = FloorToInt(y);
+		Float8 tx = Fade(x - ToFloat(ix)), ty = Fade(y - ToFloat(iy));
+		Int8 one = SplatInt(1), zero = SplatInt(0);
+
+		Float8 bottom = Lerp(LatticeValue(ix, iy, zero, seed), LatticeValue(ix + one, iy, zero, seed), tx);
+		Float8 top = Lerp(LatticeValue(ix, iy + one, zero, seed), LatticeValue(ix + one, iy + one, zero, seed), tx);
+		return Lerp(bottom, top, ty);
+	}
+
+	/// <summary>
+	/// 3D value noise in [-1, 1], with lattice points one unit apart.
+	/// </summary>
+	Float8 ValueNoise(Float8 x, Float8 y, Float8 z, uint32_t seed) {
+		Int8 ix = FloorToInt(x), iy = FloorToInt(y), iz = FloorToInt(z);
+		Float8 tx = Fade(x - ToFloat(ix)), ty = Fade(y - ToFloat(iy)), tz = Fade(z - ToFloat(iz));
+		Int8 one = SplatInt(1);
+
+		Float8 layers[2];
+		for (int k = 0; k < 2; k++) {
+			Int8 lz = k == 0 ? iz : iz + one;
+			Float8 bottom = Lerp(LatticeValue(ix, iy, lz, seed), LatticeValue(ix + one, iy, lz, seed), tx);
+			Float8 top = Lerp(LatticeValue(ix, iy + one, lz, seed), LatticeValue(ix + one, iy + one, lz, seed), tx);
+			layers[k] = Lerp(bottom, top, ty);
+		}
+		return Lerp(layers[0], layers[1], tz);
+	}
+
+	/// <summary>
+	/// Terrain height at normalized positions, as a fraction of the world's height.
+	/// </summary>
+	Float8 TerrainHeight(Float8 x, Float8 y, uint32_t seed) {
+		Float8 sum = Splat(0.0f);
+		float amplitude = 1.0f, frequency = ProceduralGenerator::TERRAIN_FREQUENCY, total = 0.0f;
+		for (uint32_t octave = 0; octave < ProceduralGenerator::TERRAIN_OCTAVES; octave++) {
+			sum = sum + ValueNoise(x * Splat(frequency), y * Splat(frequency), seed + octave) * Splat(amplitude);
+			total += amplitude;
+			amplitude *= 0.5f;
+			frequency *= 2.0f;
+		}
+		return Splat(ProceduralGenerator::TERRAIN_HEIGHT) + sum * Splat(ProceduralGenerator::TERRAIN_RELIEF / total);
+	}
+
+	/// <summary>
+	/// Whether a tunnel can pass through a box, given in normalized coordinates.
+	/// Within a lattice cell, value noise is multilinear in the faded coordinates, and the fade is monotonic, so over a box inside one cell
+	/// the noise is bounded by its values at the box's corners. The box is split at cell boundaries and each part's corners evaluated together.
+	/// </summary>
+	bool CavesMayCross(glm::vec3 min, glm::vec3 max, uint32_t seed) {
+		glm::vec3 lo = min * ProceduralGenerator::CAVE_FREQUENCY, hi = max * ProceduralGenerator::CAVE_FREQUENCY;
+		glm::ivec3 first = glm::ivec3(glm::floor(lo)), last = glm::ivec3(glm::floor(hi));
+
+		float nearest[2] = { 1.0f, 1.0f };
+		float corners[3][LANES], values[LANES];
+		for (int32_t cz = first.z; cz <= last.z; cz++)
+		for (int32_t cy = first.y; cy <= last.y; cy++)
+		for (int32_t cx = first.x; cx <= last.x; cx++) {
+			glm::vec3 cell = glm::vec3(cx, cy, cz);
+			glm::vec3 part_lo = glm::max(lo, cell), part_hi = glm::min(hi, cell + 1.0f);
+			for (uint32_t corner = 0; corner < LANES; corner++) {
+				corners[0][corner] = corner & 1 ? part_hi.x : part_lo.x;
+				corners[1][corner] = corner & 2 ? part_hi.y : part_lo.y;
+				corners[2][corner] = corner & 4 ? part_hi.z : part_lo.z;
+			}
+
+			for (int k = 0; k < 2; k++) {
+				Store(values, ValueNoise(Load(corners[0]), Load(corners[1]), Load(corners[2]), seed + 1000 * (k + 1)));
+				float value_min = *std::min_element(values, values + LANES), value_max = *std::max_element(values, values + LANES);
+				float closest = value_min <= 0.0f && value_max >= 0.0f ? 0.0f : std::min(std::abs(value_min), std::abs(value_max));
+				nearest[k] = std::min(nearest[k], closest);
+			}
+		}
+
+		return nearest[0] < ProceduralGenerator::CAVE_WIDTH && nearest[1] < ProceduralGenerator::CAVE_WIDTH;
+	}
+
+	/// <summary>
+	/// Evaluates the two noises whose zero sets intersect along the cave tunnels, over a padded brick, x-major.
+	/// Cave features are several bricks wide, so a brick spans only a few lattice points per axis. Value noise is separable into per-axis
+	/// weights of those points, so rather than hashing eight corners per voxel, the lattice values are hashed once and contracted one axis at a time.
+	/// </summary>
+	/// <param name="min"> The normalized position of the padded brick's first voxel centre. </param>
+	/// <param name="step"> The normalized width of a voxel. </param>
+	void CaveNoise(glm::vec3 min, float step, int32_t padded, uint32_t seed, float* a, float* b) {
+		// Per axis: the first lattice point, the number of points, and each point's weight at each voxel
+		int32_t lo[3], count[3];
+		std::vector<float> weights[3];
+		for (int axis = 0; axis < 3; axis++) {
+			float first = min[axis] * ProceduralGenerator::CAVE_FREQUENCY;
+			float last = (min[axis] + step * (padded - 1)) * ProceduralGenerator::CAVE_FREQUENCY;
+			lo[axis] = static_cast<int32_t>(std::floor(first));
+			count[axis] = static_cast<int32_t>(std::floor(last)) - lo[axis] + 2;
+			weights[axis].assign((size_t)count[axis] * padded, 0.0f);
+			for (int32_t i = 0; i < padded; i++) {
+				float t = (min[axis] + step * i) * ProceduralGenerator::CAVE_FREQUENCY;
+				float cell = std::floor(t);
+				float f = t - cell;
+				float fade = f * f * f * (f * (f * 6.0f - 15.0f) + 10.0f);
+				int32_t point = static_cast<int32_t>(cell) - lo[axis];
+				weights[axis][(size_t)point * padded + i] = 1.0f - fade;
+				weights[axis][(size_t)(point + 1) * padded + i] = fade;
+			}
+		}
+
+		float lattice[LANES];
+		std::vector<float> by_x((size_t)count[2] * count[1] * padded), by_xy((size_t)count[2] * padded * padded);
+		for (int k = 0; k < 2; k++) {
+			float* out = k == 0 ? a : b;
+			std::fill(by_x.begin(), by_x.end(), 0.0f);
+			std::fill(by_xy.begin(), by_xy.end(), 0.0f);
+
+			for (int32_t z = 0; z < count[2]; z++)
+			for (int32_t y = 0; y < count[1]; y++)
+			for (int32_t x = 0; x < count[0]; x++) {
+				Store(lattice, LatticeValue(SplatInt(lo[0] + x), SplatInt(lo[1] + y), SplatInt(lo[2] + z), seed + 1000 * (k + 1)));
+				float* row = &by_x[((size_t)z * count[1] + y) * padded];
+				const float* weight = &weights[0][(size_t)x * padded];
+				for (int32_t i = 0; i < padded; i++)
+					row[i] += lattice[0] * weight[i];
+			}
+
+			for (int32_t z = 0; z < count[2]; z++)
+			for (int32_t y = 0; y < count[1]; y++)
+			for (int32_t j = 0; j < padded; j++) {
+				float weight = weights[1][(size_t)y * padded + j];
+				if (weight == 0.0f) continue;
+				const float* row = &by_x[((size_t)z * count[1] + y) * padded];
+				float* plane = &by_xy[((size_t)z * padded + j) * padded];
+				for (int32_t i = 0; i < padded; i++)
+					plane[i] += row[i] * weight;
+			}
+
+			std::fill(out, out + (size_t)padded * padded * padded, 0.0f);
+			for (int32_t z = 0; z < count[2]; z++)
+			for (int32_t k2 = 0; k2 < padded; k2++) {
+				float weight = weights[2][(size_t)z * padded + k2];
+				if (weight == 0.0f) continue;
+				const float* slice = &by_xy[(size_t)z * padded * padded];
+				float* target = out + (size_t)k2 * padded * padded;
+				for (int32_t i = 0; i < padded * padded; i++)
+					target[i] += slice[i] * weight;
+			}
+		}
+	}
+
+	inline Float8 Length(Float8 x, Float8 y) { return Sqrt(x * x + y * y); }
+	inline Float8 Length(Float8 x, Float8 y, Float8 z) { return Sqrt(x * x + y * y + z * z); }
+
+	/// <summary>
+	/// Runs function(thread_index) on thread_count threads, including the calling one, and waits for all of them.
+	/// </summary>
+	template<typename Function>
+	void RunOnThreads(uint32_t thread_count, Function function) {
+		std::vector<std::thread> threads;
+		for (uint32_t t = 1; t < thread_count; t++)
+			threads.emplace_back(function, t);
+		function(0u);
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	float MillisecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+glm::vec3 ProceduralGenerator::Primitive::GetExtent() const {
+	switch (type) {
+	case Type::SPHERE:
+		return glm::vec3(size.x);
+	case Type::BOX:
+		return size;
+	case Type::TORUS:
+		return glm::vec3(size.x + size.y, size.x + size.y, size.y);
+	default:
+		return glm::vec3(0.0f);
+	}
+}
+
+std::shared_ptr<ProceduralGenerator> ProceduralGenerator::Create(uint32_t seed, uint32_t primitive_count) {
+	auto ret = std::make_shared<ProceduralGenerator>();
+	ret->m_seed = seed;
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position_dist(0.05f, 0.95f);
+	std::uniform_real_distribution<float> radius_dist(0.005f, 0.02f);
+	std::uniform_real_distribution<float> aspect_dist(0.5f, 1.5f);
+	const uint8_t values[] = { 2, 4, 6, 7 };
+
+	// Primitives rest on the terrain: spheres and boxes sink a little into it, and tori lie flat on it
+	for (uint32_t i = 0; i < primitive_count; i++) {
+		Primitive primitive{};
+		primitive.type = static_cast<Primitive::Type>(i % 3);
+		float radius = radius_dist(rng);
+		glm::vec2 position(position_dist(rng), position_dist(rng));
+
+		float lift = 0.0f;
+		switch (primitive.type) {
+		case Primitive::Type::SPHERE:
+			primitive.size = glm::vec3(radius);
+			lift = radius * 0.7f;
+			break;
+		case Primitive::Type::BOX:
+			primitive.size = radius * glm::vec3(aspect_dist(rng), aspect_dist(rng), aspect_dist(rng));
+			lift = primitive.size.z * 0.8f;
+			break;
+		case Primitive::Type::TORUS:
+			primitive.size = glm::vec3(radius, radius * 0.3f, 0.0f);
+			lift = primitive.size.y;
+			break;
+		}
+
+		primitive.center = glm::vec3(position, ret->GetTerrainHeight(position) + lift);
+		primitive.value = values[i % 4];
+		ret->m_primitives.push_back(primitive);
+	}
+
+	return ret;
+}
+
+float ProceduralGenerator::GetTerrainHeight(glm::vec2 position) const {
+	float heights[LANES];
+	Store(heights, TerrainHeight(Splat(position.x), Splat(position.y), m_seed));
+	return heights[0];
+}
+
+std::shared_ptr<Octree> ProceduralGenerator::Generate(uint32_t size, uint32_t brick_size, uint32_t thread_count, ProceduralStats* stats) const {
+	if (brick_size == 0 || size % brick_size != 0)
+		throw std::invalid_argument("Procedural world size must be a multiple of the brick size!");
+
+	int32_t bricks_per_side = static_cast<int32_t>(size / brick_size);
+	if ((bricks_per_side & (bricks_per_side - 1)) != 0)
+		throw std::invalid_argument("Procedural world size must be the brick size times a power of two!");
+
+	uint32_t depth = 0;
+	while ((1 << depth) < bricks_per_side) depth++;
+
+	if (thread_count == 0)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+	auto generate_start = std::chrono::steady_clock::now();
+
+	// Bricks are evaluated with a one voxel border, so every voxel's neighbours are known when the surface is extracted.
+	// The padded brick and its columns are laid out flat and rounded up to whole batches, so every batch is eight voxels whatever the brick size.
+	int32_t brick = static_cast<int32_t>(brick_size);
+	int32_t padded = brick + 2;
+	uint32_t column_batches = (padded * padded + LANES - 1) / LANES;
+	uint32_t voxel_batches = (padded * padded * padded + LANES - 1) / LANES;
+
+	std::vector<float> column_x(column_batches * LANES), column_y(column_batches * LANES);
+	for (int32_t i = 0; i < padded * padded; i++) {
+		column_x[i] = static_cast<float>(i % padded);
+		column_y[i] = static_cast<float>(i / padded);
+	}
+
+	std::vector<float> voxel_x(voxel_batches * LANES), voxel_y(voxel_batches * LANES), voxel_z(voxel_batches * LANES);
+	std::vector<uint32_t> voxel_column(voxel_batches * LANES);
+	for (int32_t i = 0; i < padded * padded * padded; i++) {
+		voxel_x[i] = static_cast<float>(i % padded);
+		voxel_y[i] = static_cast<float>((i / padded) % padded);
+		voxel_z[i] = static_cast<float>(i / (padded * padded));
+		voxel_column[i] = i % (padded * padded);
+	}
+
+	// Everything below is in voxels, with voxel centres at half-integers
+	float voxels = static_cast<float>(size);
+	float inv_size = 1.0f / voxels;
+	float cave_depth = CAVE_DEPTH * voxels;
+
+	struct PrimitiveBounds {
+		glm::vec3 min, max;
+	};
+	std::vector<PrimitiveBounds> primitive_bounds;
+	for (const auto& primitive : m_primitives)
+		primitive_bounds.push_back({ (primitive.center - primitive.GetExtent()) * voxels, (primitive.center + primitive.GetExtent()) * voxels });
+
+	size_t brick_voxels = (size_t)brick_size * brick_size * brick_size;
+	size_t column_count = (size_t)bricks_per_side * bricks_per_side;
+	std::atomic<size_t> next_column{ 0 };
+	std::vector<std::vector<OctreeBrick>> thread_bricks(thread_count);
+	std::vector<uint64_t> thread_evaluated(thread_count);
+
+	// Threads take one column of bricks at a time, so the column's heights and primitives are found once for all its bricks
+	RunOnThreads(thread_count, [&](uint32_t thread) {
+		std::vector<float> heights(column_batches * LANES);
+		std::vector<float> solid(voxel_batches * LANES), values(voxel_batches * LANES);
+		std::vector<float> cave_a(voxel_batches * LANES), cave_b(voxel_batches * LANES);
+		std::vector<uint8_t> brick_voxels_out(brick_voxels);
+		std::vector<uint32_t> column_primitives, brick_primitives;
+		float gathered[LANES];
+
+		for (size_t column = next_column++; column < column_count; column = next_column++) {
+			glm::ivec2 origin = glm::ivec2(static_cast<int32_t>(column % bricks_per_side), static_cast<int32_t>(column / bricks_per_side)) * brick - 1;
+
+			float min_height = voxels, max_height = 0.0f;
+			for (uint32_t batch = 0; batch < column_batches; batch++) {
+				Float8 x = (Load(&column_x[batch * LANES]) + Splat(origin.x + 0.5f)) * Splat(inv_size);
+				Float8 y = (Load(&column_y[batch * LANES]) + Splat(origin.y + 0.5f)) * Splat(inv_size);
+				Store(&heights[batch * LANES], TerrainHeight(x, y, m_seed) * Splat(voxels));
+			}
+			for (int32_t i = 0; i < padded * padded; i++) {
+				min_height = std::min(min_height, heights[i]);
+				max_height = std::max(max_height, heights[i]);
+			}
+
+			// Columns on the world's sides show their cut faces, which are solid all the way down
+			bool edge = origin.x < 0 || origin.y < 0 || origin.x + padded > static_cast<int32_t>(size) || origin.y + padded > static_cast<int32_t>(size);
+
+			float low = edge ? 0.0f : min_height - cave_depth;
+			float high = max_height;
+			column_primitives.clear();
+			for (uint32_t i = 0; i < primitive_bounds.size(); i++) {
+				const auto& bounds = primitive_bounds[i];
+				if (bounds.max.x < origin.x || bounds.min.x > origin.x + padded || bounds.max.y < origin.y || bounds.min.y > origin.y + padded)
+					continue;
+				column_primitives.push_back(i);
+				low = std::min(low, bounds.min.z);
+				high = std::max(high, bounds.max.z);
+			}
+
+			int32_t first_brick = std::max(static_cast<int32_t>(std::floor(low / brick)) - 1, 0);
+			int32_t last_brick = std::min(static_cast<int32_t>(std::floor(high / brick)) + 1, bricks_per_side - 1);
+
+			for (int32_t bz = first_brick; bz <= last_brick; bz++) {
+				// The centres of the padded brick's lowest and highest voxels
+				float bottom = bz * brick - 0.5f;
+				float top = bottom + padded - 1;
+
+				// Terrain alone leaves a surface only where some padded voxel is above it and some below
+				bool terrain = bottom < max_height && (top >= min_height || edge);
+
+				// Caves can only be carved within reach of the surface
+				bool caves = false;
+				if (top > min_height - cave_depth && bottom < max_height) {
+					glm::vec3 min = glm::vec3(origin.x + 0.5f, origin.y + 0.5f, bottom);
+					caves = CavesMayCross(min * inv_size, (min + static_cast<float>(padded - 1)) * inv_size, m_seed);
+				}
+				if (caves)
+					CaveNoise(glm::vec3(origin.x + 0.5f, origin.y + 0.5f, bottom) * inv_size, inv_size, padded, m_seed, cave_a.data(), cave_b.data());
+
+				brick_primitives.clear();
+				for (uint32_t i : column_primitives)
+					if (primitive_bounds[i].max.z >= bottom && primitive_bounds[i].min.z <= top)
+						brick_primitives.push_back(i);
+
+				if (!terrain && !caves && brick_primitives.empty())
+					continue;
+
+				thread_evaluated[thread]++;
+				for (uint32_t batch = 0; batch < voxel_batches; batch++) {
+					Float8 x = Load(&voxel_x[batch * LANES]) + Splat(origin.x + 0.5f);
+					Float8 y = Load(&voxel_y[batch * LANES]) + Splat(origin.y + 0.5f);
+					Float8 z = Load(&voxel_z[batch * LANES]) + Splat(bottom);
+
+					for (uint32_t lane = 0; lane < LANES; lane++)
+						gathered[lane] = heights[voxel_column[batch * LANES + lane]];
+					Float8 height = Load(gathered);
+					Float8 depth = height - z;
+
+					Float8 is_solid = Less(z, height);
+					Float8 value = Select(Less(depth, Splat(GRASS_DEPTH)), Splat(3.0f), Select(Less(depth, Splat(SOIL_DEPTH)), Splat(5.0f), Splat(1.0f)));
+
+					Float8 nx = x * Splat(inv_size), ny = y * Splat(inv_size), nz = z * Splat(inv_size);
+					// Only solid voxels within reach of the surface can be carved
+					if (caves && Any(And(is_solid, Less(depth, Splat(cave_depth))))) {
+						Float8 a = Load(&cave_a[batch * LANES]), b = Load(&cave_b[batch * LANES]);
+						Float8 width = Splat(CAVE_WIDTH) - depth * Splat(CAVE_WIDTH / cave_depth);
+						is_solid = AndNot(is_solid, And(Less(Abs(a), width), Less(Abs(b), width)));
+					}
+
+					for (uint32_t i : brick_primitives) {
+						const Primitive& primitive = m_primitives[i];
+						Float8 px = nx - Splat(primitive.center.x), py = ny - Splat(primitive.center.y), pz = nz - Splat(primitive.center.z);
+						Float8 distance;
+						switch (primitive.type) {
+						case Primitive::Type::SPHERE:
+							distance = Length(px, py, pz) - Splat(primitive.size.x);
+							break;
+						case Primitive::Type::BOX: {
+							Float8 qx = Abs(px) - Splat(primitive.size.x), qy = Abs(py) - Splat(primitive.size.y), qz = Abs(pz) - Splat(primitive.size.z);
+							Float8 zero = Splat(0.0f);
+							distance = Length(Max(qx, zero), Max(qy, zero), Max(qz, zero)) + Min(Max(qx, Max(qy, qz)), zero);
+							break;
+						}
+						case Primitive::Type::TORUS:
+							distance = Length(Length(px, py) - Splat(primitive.size.x), pz) - Splat(primitive.size.y);
+							break;
+						}
+
+						Float8 inside = Less(distance, Splat(0.0f));
+						is_solid = Or(is_solid, inside);
+						value = Select(inside, Splat(primitive.value), value);
+					}
+
+					// Beyond the world's sides is empty
+					if (edge) {
+						Float8 bound = Splat(voxels);
+						Float8 outside = Or(Or(Less(x, Splat(0.0f)), Less(y, Splat(0.0f))), Or(Less(bound, x), Less(bound, y)));
+						is_solid = AndNot(is_solid, outside);
+					}
+
+					Store(&solid[batch * LANES], is_solid);
+					Store(&values[batch * LANES], value);
+				}
+
+				// Keep the solid voxels with an empty neighbour, a row at a time
+				bool occupied = false;
+				for (int32_t z = 0; z < brick; z++)
+				for (int32_t y = 0; y < brick; y++) {
+					int32_t row = ((z + 1) * padded + y + 1) * padded + 1;
+					uint8_t* out = &brick_voxels_out[((size_t)z * brick + y) * brick];
+					int32_t x = 0;
+					for (; x + static_cast<int32_t>(LANES) <= brick; x += LANES) {
+						const float* center = &solid[row + x];
+						Float8 enclosed = And(And(Load(center - 1), Load(center + 1)), And(Load(center - padded), Load(center + padded)));
+						enclosed = And(enclosed, And(Load(center - padded * padded), Load(center + padded * padded)));
+						Float8 surface = AndNot(Load(center), enclosed);
+						occupied |= Any(surface);
+
+						Store(gathered, And(surface, Load(&values[row + x])));
+						for (uint32_t lane = 0; lane < LANES; lane++)
+							out[x + lane] = static_cast<uint8_t>(gathered[lane]);
+					}
+					for (; x < brick; x++) {
+						auto is_set = [&](int32_t i) { return std::bit_cast<uint32_t>(solid[i]) != 0; };
+						int32_t i = row + x;
+						bool surface = is_set(i) && !(is_set(i - 1) && is_set(i + 1) && is_set(i - padded) && is_set(i + padded)
+							&& is_set(i - padded * padded) && is_set(i + padded * padded));
+						out[x] = surface ? static_cast<uint8_t>(values[i]) : 0;
+						occupied |= surface;
+					}
+				}
+
+				if (occupied)
+					thread_bricks[thread].push_back({ glm::uvec3(glm::ivec3(origin + 1, bz * brick) / brick), brick_voxels_out });
+			}
+		}
+	});
+
+	std::vector<OctreeBrick> bricks;
+	uint64_t evaluated = 0;
+	for (uint32_t thread = 0; thread < thread_count; thread++) {
+		std::move(thread_bricks[thread].begin(), thread_bricks[thread].end(), std::back_inserter(bricks));
+		evaluated += thread_evaluated[thread];
+	}
+	thread_bricks.clear();
+
+	float generate_ms = MillisecondsSince(generate_start);
+	auto build_start = std::chrono::steady_clock::now();
+
+	auto octree = Octree::CreateFromBricks(bricks, depth, brick_size);
+
+	if (stats) {
+		stats->thread_count = thread_count;
+		stats->evaluated_count = evaluated;
+		stats->brick_count = static_cast<uint32_t>(bricks.size());
+		stats->generate_ms = generate_ms;
+		stats->build_ms = MillisecondsSince(build_start);
+	}
+
+	return octree;
+}
+
+void ProceduralGenerator::RunBenchmark(uint32_t size, uint32_t brick_size) {
+	auto generator = Create(1337);
+	printf("Generating terrain at %u^3, %u^3 bricks\n", size, brick_size);
+
+	uint32_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (uint32_t count : { max_threads, 1u }) {
+		ProceduralStats stats{};
+		auto octree = generator->Generate(size, brick_size, count, &stats);
+		printf("%3u threads | generate %9.1f ms | build %8.1f ms | %10.0f bricks/s | %llu evaluated | %u bricks | %.1f MiB\n",
+			stats.thread_count, stats.generate_ms, stats.build_ms, stats.GetBricksPerSecond(),
+			(unsigned long long)stats.evaluated_count, stats.brick_count, octree->GetTotalBytes() / (1024.0 * 1024.0));
+		if (max_threads == 1)
+			break;
+	}
+}
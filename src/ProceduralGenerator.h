@@ -0,0 +1,125 @@
+#pragma once
+#include "Octree.h"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Timings and counts of a single ProceduralGenerator::Generate call.
+/// </summary>
+struct ProceduralStats {
+
+	/// <summary> The number of worker threads used. </summary>
+	uint32_t thread_count;
+
+	/// <summary> The number of bricks whose voxels were evaluated, after culling. </summary>
+	uint64_t evaluated_count;
+
+	/// <summary> The number of non-empty bricks produced. </summary>
+	uint32_t brick_count;
+
+	/// <summary> Time spent evaluating bricks, in milliseconds. </summary>
+	float generate_ms;
+
+	/// <summary> Time spent building the octree from the bricks, in milliseconds. </summary>
+	float build_ms;
+
+	/// <summary> Gets the brick throughput of the evaluation pass, counting culled bricks as free. </summary>
+	float GetBricksPerSecond() const { return evaluated_count / (generate_ms / 1000.0f); }
+};
+
+/// <summary>
+/// Generates terrain worlds for load testing: a noise heightfield, carved by tunnel caves, with SDF spheres, boxes and tori scattered over it.
+/// The world is defined in normalized coordinates, so every size shows the same scene at a different resolution.
+/// Work is split across threads by columns of bricks. A column's heights are evaluated once, and bricks that lie wholly above the terrain
+/// or wholly inside it, with no cave or primitive nearby, are culled without evaluating their voxels. The rest are evaluated with SSE,
+/// eight voxels at a time.
+/// Only surface voxels are kept: solid voxels with an empty neighbour. Buried voxels can never be hit by a ray, and dropping them is what keeps
+/// large worlds small. Voxels below the world count as solid, so its underside is left open.
+/// </summary>
+class ProceduralGenerator
+{
+private:
+
+	/// <summary>
+	/// A signed distance primitive, in normalized coordinates.
+	/// </summary>
+	struct Primitive {
+		enum class Type : uint32_t { SPHERE, BOX, TORUS };
+		Type type;
+
+		glm::vec3 center;
+
+		/// <summary> The radius of a sphere, the half extents of a box, or the major and minor radii of a torus around z. </summary>
+		glm::vec3 size;
+
+		/// <summary> The voxel value written inside the primitive. </summary>
+		uint8_t value;
+
+		/// <summary> Gets the half extents of the primitive's bounds. </summary>
+		glm::vec3 GetExtent() const;
+	};
+
+	/// <summary> Seeds the terrain and cave noise. </summary>
+	uint32_t m_seed = 0;
+
+	/// <summary> The scattered primitives, resting on the terrain. </summary>
+	std::vector<Primitive> m_primitives;
+
+public:
+
+	/// <summary> The mean height of the terrain, as a fraction of the world's height. </summary>
+	static constexpr float TERRAIN_HEIGHT = 0.3f;
+
+	/// <summary> How far the terrain rises and falls around its mean height, as a fraction of the world's height. </summary>
+	static constexpr float TERRAIN_RELIEF = 0.15f;
+
+	/// <summary> The number of features of the coarsest terrain octave across the world. </summary>
+	static constexpr float TERRAIN_FREQUENCY = 4.0f;
+
+	/// <summary> The number of noise octaves summed for the terrain. Each doubles the frequency and halves the amplitude. </summary>
+	static constexpr uint32_t TERRAIN_OCTAVES = 6;
+
+	/// <summary> The number of cave features across the world. </summary>
+	static constexpr float CAVE_FREQUENCY = 24.0f;
+
+	/// <summary> How close to zero both cave noises must be for a voxel to be carved. Tunnels narrow with depth and close at CAVE_DEPTH. </summary>
+	static constexpr float CAVE_WIDTH = 0.12f;
+
+	/// <summary> How far below the surface caves reach, as a fraction of the world's height. </summary>
+	static constexpr float CAVE_DEPTH = 0.05f;
+
+	/// <summary> The depths, in voxels, at which grass gives way to soil, and soil to rock. </summary>
+	static constexpr float GRASS_DEPTH = 2.0f;
+	static constexpr float SOIL_DEPTH = 8.0f;
+
+	/// <summary>
+	/// Creates a generator and scatters primitives over its terrain.
+	/// </summary>
+	/// <param name="primitive_count"> The number of SDF primitives to scatter. </param>
+	static std::shared_ptr<ProceduralGenerator> Create(uint32_t seed, uint32_t primitive_count = 128);
+
+	/// <summary>
+	/// Evaluates the world into an octree.
+	/// </summary>
+	/// <param name="size"> The width of the octree, in voxels. Must be brick_size times a power of two. </param>
+	/// <param name="brick_size"> The width of the octree's bricks. </param>
+	/// <param name="thread_count"> The number of worker threads. 0 uses every hardware thread. </param>
+	/// <param name="stats"> Receives timings and counts, if not null. </param>
+	std::shared_ptr<Octree> Generate(uint32_t size, uint32_t brick_size, uint32_t thread_count = 0, ProceduralStats* stats = nullptr) const;
+
+	/// <summary>
+	/// Gets the terrain height at a normalized position, as a fraction of the world's height.
+	/// </summary>
+	float GetTerrainHeight(glm::vec2 position) const;
+
+	/// <summary>
+	/// Generates a world of the given size with every hardware thread, and with one thread, and prints the timings and brick counts to stdout.
+	/// </summary>
+	static void RunBenchmark(uint32_t size, uint32_t brick_size);
+};
@@ -0,0 +1,60 @@
+#include "ResolutionController.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+std::shared_ptr<ResolutionController> ResolutionController::Create(float target_ms, float min_scale, float max_scale)
+{
+	if (min_scale <= 0.0f || max_scale < min_scale)
+		throw std::invalid_argument("The render scale range must be positive and not empty!");
+
+	auto ret = std::make_shared<ResolutionController>();
+	ret->m_target_ms = target_ms;
+	ret->m_min_scale = min_scale;
+	ret->m_max_scale = max_scale;
+	ret->m_scale = max_scale;
+	ret->m_cooldown = COOLDOWN_FRAMES;
+	return ret;
+}
+
+float ResolutionController::Update(float gpu_ms)
+{
+	// Frames recorded before the last change, or before the first frame finished, say nothing about the current scale
+	if (m_cooldown > 0) {
+		m_cooldown--;
+		return m_scale;
+	}
+	if (!std::isfinite(gpu_ms) || gpu_ms <= 0.0f)
+		return m_scale;
+
+	m_smoothed_ms = m_smoothed_ms == 0.0f ? gpu_ms : m_smoothed_ms + (gpu_ms - m_smoothed_ms) * SMOOTHING;
+
+	// Inside the band the scale holds, so noise around the target never moves it
+	if (m_smoothed_ms <= m_target_ms && m_smoothed_ms >= m_target_ms * HEADROOM)
+		return m_scale;
+
+	// The cost of tracing follows the pixel count, the square of the scale. Aim for the middle of the band.
+	float goal_ms = m_target_ms * (1.0f + HEADROOM) * 0.5f;
+	float scale = m_scale * std::sqrt(goal_ms / m_smoothed_ms);
+	scale = std::clamp(scale, m_scale - MAX_STEP, m_scale + MAX_STEP);
+	scale = std::clamp(scale, m_min_scale, m_max_scale);
+
+	if (std::abs(scale - m_scale) < MIN_STEP && scale != m_min_scale && scale != m_max_scale)
+		return m_scale;
+
+	// Start smoothing afresh once the frames at the new scale come in
+	if (scale != m_scale) {
+		m_cooldown = COOLDOWN_FRAMES;
+		m_smoothed_ms = 0.0f;
+	}
+	m_scale = scale;
+	return m_scale;
+}
+
+void ResolutionController::Reset()
+{
+	m_scale = m_max_scale;
+	m_smoothed_ms = 0.0f;
+	m_cooldown = COOLDOWN_FRAMES;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+
+/// <summary>
+/// Picks the tracer's render scale each frame so that the GPU time of a frame stays at a target. The time is smoothed first, and the
+/// scale only moves once it leaves a band below the target, so a frame that hovers near the target does not flicker between resolutions.
+/// The timings come from frames that were recorded a few frames ago, so after every change the controller drops the samples of the frames
+/// still in flight, and starts smoothing again from the first sample at the new scale.
+/// </summary>
+class ResolutionController
+{
+private:
+
+	/// <summary> The GPU time to keep a frame at, in milliseconds. </summary>
+	float m_target_ms = 16.0f;
+
+	/// <summary> The smallest and largest scale of each side of the render target. </summary>
+	float m_min_scale = 0.5f;
+	float m_max_scale = 1.0f;
+
+	/// <summary> The current scale of each side of the render target. </summary>
+	float m_scale = 1.0f;
+
+	/// <summary> The exponential moving average of the frame's GPU time. 0 until the first sample. </summary>
+	float m_smoothed_ms = 0.0f;
+
+	/// <summary> The number of samples left to ignore, as their frames were recorded at an older scale. </summary>
+	uint32_t m_cooldown = 0;
+
+public:
+
+	/// <summary> The weight of each new sample in the smoothed time. </summary>
+	static constexpr float SMOOTHING = 0.2f;
+
+	/// <summary> The scale only rises once the smoothed time falls below this fraction of the target, and only falls once it passes the target. </summary>
+	static constexpr float HEADROOM = 0.85f;
+
+	/// <summary> The largest change of the scale per step, and the smallest worth making. </summary>
+	static constexpr float MAX_STEP = 0.1f;
+	static constexpr float MIN_STEP = 0.02f;
+
+	/// <summary> The number of samples to wait after a change, covering the frames in flight that were recorded at the old scale. </summary>
+	static constexpr uint32_t COOLDOWN_FRAMES = 4;
+
+	/// <summary>
+	/// Creates a controller at the largest scale.
+	/// </summary>
+	/// <param name="min_scale"> The smallest scale of each side of the render target, greater than 0. </param>
+	/// <param name="max_scale"> The largest scale of each side of the render target, at least min_scale. </param>
+	static std::shared_ptr<ResolutionController> Create(float target_ms, float min_scale, float max_scale);
+
+	/// <summary>
+	/// Feeds the GPU time of a completed frame and returns the scale to render the next one at.
+	/// </summary>
+	float Update(float gpu_ms);
+
+	/// <summary> Sets the GPU time to keep a frame at, in milliseconds. </summary>
+	void SetTarget(float target_ms) { m_target_ms = target_ms; }
+
+	/// <summary> Returns to the largest scale, and forgets the smoothed time. </summary>
+	void Reset();
+
+	/// <summary> Gets the current scale of each side of the render target. </summary>
+	float GetScale() const { return m_scale; }
+
+	/// <summary> Gets the smoothed GPU time of a frame, in milliseconds. </summary>
+	float GetSmoothedTime() const { return m_smoothed_ms; }
+};
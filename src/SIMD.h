@@ -0,0 +1,257 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <bit>
+
+#if defined(__AVX2__)
+#define SIMD_AVX2
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__SSE2__)
+#define SIMD_SSE2
+#include <immintrin.h>
+#endif
+
+/// <summary>
+/// Eight floats or integers, operated on together. With AVX2 each is one register, with SSE2 a pair of registers, and otherwise a plain loop,
+/// so code written against these types runs everywhere and only gets faster where the instructions exist.
+/// Comparisons return all-ones or all-zero lanes, as the instructions do, so masks combine with And, Or and Select on every path.
+/// Integers are unsigned, except where a function says otherwise.
+/// </summary>
+namespace simd {
+
+	/// <summary>
+	/// The number of lanes.
+	/// </summary>
+	constexpr uint32_t LANES = 8;
+
+#if defined(SIMD_AVX2)
+	struct Float8 { __m256 v; };
+	struct Int8 { __m256i v; };
+
+#define LANE_OP(type, name, intrinsic) \
+	inline type name(type a, type b) { return { intrinsic(a.v, b.v) }; }
+
+	LANE_OP(Float8, operator+, _mm256_add_ps)
+	LANE_OP(Float8, operator-, _mm256_sub_ps)
+	LANE_OP(Float8, operator*, _mm256_mul_ps)
+	LANE_OP(Float8, operator/, _mm256_div_ps)
+	LANE_OP(Float8, Min, _mm256_min_ps)
+	LANE_OP(Float8, Max, _mm256_max_ps)
+	LANE_OP(Float8, And, _mm256_and_ps)
+	LANE_OP(Float8, Or, _mm256_or_ps)
+	LANE_OP(Int8, operator+, _mm256_add_epi32)
+	LANE_OP(Int8, operator-, _mm256_sub_epi32)
+	LANE_OP(Int8, operator*, _mm256_mullo_epi32)
+	LANE_OP(Int8, operator^, _mm256_xor_si256)
+	LANE_OP(Int8, operator&, _mm256_and_si256)
+	LANE_OP(Int8, operator|, _mm256_or_si256)
+	LANE_OP(Int8, ShiftLeft, _mm256_sllv_epi32)
+	LANE_OP(Int8, ShiftRight, _mm256_srlv_epi32)
+	LANE_OP(Int8, MinSigned, _mm256_min_epi32)
+	LANE_OP(Int8, MaxSigned, _mm256_max_epi32)
+#undef LANE_OP
+
+	inline Float8 Less(Float8 a, Float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+	inline Float8 LessEqual(Float8 a, Float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+	inline Float8 Equal(Float8 a, Float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+	inline Float8 Equal(Int8 a, Int8 b) { return { _mm256_castsi256_ps(_mm256_cmpeq_epi32(a.v, b.v)) }; }
+	inline Float8 LessSigned(Int8 a, Int8 b) { return { _mm256_castsi256_ps(_mm256_cmpgt_epi32(b.v, a.v)) }; }
+
+	inline Float8 Splat(float a) { return { _mm256_set1_ps(a) }; }
+	inline Int8 SplatInt(uint32_t a) { return { _mm256_set1_epi32(static_cast<int32_t>(a)) }; }
+	inline Float8 Load(const float* data) { return { _mm256_loadu_ps(data) }; }
+	inline Int8 LoadInt(const uint32_t* data) { return { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)) }; }
+	inline void Store(float* data, Float8 a) { _mm256_storeu_ps(data, a.v); }
+	inline void StoreInt(uint32_t* data, Int8 a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), a.v); }
+
+	/// <summary> a and not b. </summary>
+	inline Float8 AndNot(Float8 a, Float8 b) { return { _mm256_andnot_ps(b.v, a.v) }; }
+	inline Float8 Select(Float8 mask, Float8 a, Float8 b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+	inline Int8 Select(Float8 mask, Int8 a, Int8 b) { return { _mm256_blendv_epi8(b.v, a.v, _mm256_castps_si256(mask.v)) }; }
+	inline Float8 Abs(Float8 a) { return AndNot(a, Splat(-0.0f)); }
+	inline Float8 Sqrt(Float8 a) { return { _mm256_sqrt_ps(a.v) }; }
+	inline Float8 ToFloat(Int8 a) { return { _mm256_cvtepi32_ps(a.v) }; }
+	inline Int8 FloorToInt(Float8 a) { return { _mm256_cvttps_epi32(_mm256_floor_ps(a.v)) }; }
+	inline Int8 operator>>(Int8 a, int shift) { return { _mm256_srli_epi32(a.v, shift) }; }
+	inline Int8 operator<<(Int8 a, int shift) { return { _mm256_slli_epi32(a.v, shift) }; }
+	inline Int8 AsInt(Float8 a) { return { _mm256_castps_si256(a.v) }; }
+	inline Float8 AsFloat(Int8 a) { return { _mm256_castsi256_ps(a.v) }; }
+
+	/// <summary> Gets one bit per lane, set where the mask lane is set. </summary>
+	inline uint32_t MoveMask(Float8 mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask.v)); }
+	inline bool Any(Float8 mask) { return _mm256_movemask_ps(mask.v) != 0; }
+
+	/// <summary> Loads base[index] for every lane. </summary>
+	inline Int8 Gather(const uint32_t* base, Int8 index) { return { _mm256_i32gather_epi32(reinterpret_cast<const int*>(base), index.v, 4) }; }
+#elif defined(SIMD_SSE2)
+	struct Float8 { __m128 v[2]; };
+	struct Int8 { __m128i v[2]; };
+
+#define LANE_OP(type, name, intrinsic) \
+	inline type name(type a, type b) { return { intrinsic(a.v[0], b.v[0]), intrinsic(a.v[1], b.v[1]) }; }
+
+	LANE_OP(Float8, operator+, _mm_add_ps)
+	LANE_OP(Float8, operator-, _mm_sub_ps)
+	LANE_OP(Float8, operator*, _mm_mul_ps)
+	LANE_OP(Float8, operator/, _mm_div_ps)
+	LANE_OP(Float8, Min, _mm_min_ps)
+	LANE_OP(Float8, Max, _mm_max_ps)
+	LANE_OP(Float8, Less, _mm_cmplt_ps)
+	LANE_OP(Float8, LessEqual, _mm_cmple_ps)
+	LANE_OP(Float8, Equal, _mm_cmpeq_ps)
+	LANE_OP(Float8, And, _mm_and_ps)
+	LANE_OP(Float8, Or, _mm_or_ps)
+	LANE_OP(Int8, operator+, _mm_add_epi32)
+	LANE_OP(Int8, operator-, _mm_sub_epi32)
+	LANE_OP(Int8, operator^, _mm_xor_si128)
+	LANE_OP(Int8, operator&, _mm_and_si128)
+	LANE_OP(Int8, operator|, _mm_or_si128)
+#undef LANE_OP
+
+	inline Float8 Equal(Int8 a, Int8 b) { return { _mm_castsi128_ps(_mm_cmpeq_epi32(a.v[0], b.v[0])), _mm_castsi128_ps(_mm_cmpeq_epi32(a.v[1], b.v[1])) }; }
+	inline Float8 LessSigned(Int8 a, Int8 b) { return { _mm_castsi128_ps(_mm_cmplt_epi32(a.v[0], b.v[0])), _mm_castsi128_ps(_mm_cmplt_epi32(a.v[1], b.v[1])) }; }
+
+	inline Float8 Splat(float a) { __m128 v = _mm_set1_ps(a); return { v, v }; }
+	inline Int8 SplatInt(uint32_t a) { __m128i v = _mm_set1_epi32(static_cast<int32_t>(a)); return { v, v }; }
+	inline Float8 Load(const float* data) { return { _mm_loadu_ps(data), _mm_loadu_ps(data + 4) }; }
+	inline Int8 LoadInt(const uint32_t* data) { return { _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 4)) }; }
+	inline void Store(float* data, Float8 a) { _mm_storeu_ps(data, a.v[0]); _mm_storeu_ps(data + 4, a.v[1]); }
+	inline void StoreInt(uint32_t* data, Int8 a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), a.v[0]); _mm_storeu_si128(reinterpret_cast<__m128i*>(data + 4), a.v[1]); }
+
+	/// <summary> a and not b. </summary>
+	inline Float8 AndNot(Float8 a, Float8 b) { return { _mm_andnot_ps(b.v[0], a.v[0]), _mm_andnot_ps(b.v[1], a.v[1]) }; }
+	inline Float8 Select(Float8 mask, Float8 a, Float8 b) { return Or(And(mask, a), AndNot(b, mask)); }
+	inline Int8 AsInt(Float8 a) { return { _mm_castps_si128(a.v[0]), _mm_castps_si128(a.v[1]) }; }
+	inline Float8 AsFloat(Int8 a) { return { _mm_castsi128_ps(a.v[0]), _mm_castsi128_ps(a.v[1]) }; }
+	inline Int8 Select(Float8 mask, Int8 a, Int8 b) { return AsInt(Select(mask, AsFloat(a), AsFloat(b))); }
+	inline Int8 MinSigned(Int8 a, Int8 b) { return Select(LessSigned(a, b), a, b); }
+	inline Int8 MaxSigned(Int8 a, Int8 b) { return Select(LessSigned(a, b), b, a); }
+	inline Float8 Abs(Float8 a) { return AndNot(a, Splat(-0.0f)); }
+	inline Float8 Sqrt(Float8 a) { return { _mm_sqrt_ps(a.v[0]), _mm_sqrt_ps(a.v[1]) }; }
+	inline Float8 ToFloat(Int8 a) { return { _mm_cvtepi32_ps(a.v[0]), _mm_cvtepi32_ps(a.v[1]) }; }
+	inline Int8 operator>>(Int8 a, int shift) { return { _mm_srli_epi32(a.v[0], shift), _mm_srli_epi32(a.v[1], shift) }; }
+	inline Int8 operator<<(Int8 a, int shift) { return { _mm_slli_epi32(a.v[0], shift), _mm_slli_epi32(a.v[1], shift) }; }
+
+	/// <summary> Gets one bit per lane, set where the mask lane is set. </summary>
+	inline uint32_t MoveMask(Float8 mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask.v[0]) | (_mm_movemask_ps(mask.v[1]) << 4)); }
+	inline bool Any(Float8 mask) { return _mm_movemask_ps(_mm_or_ps(mask.v[0], mask.v[1])) != 0; }
+
+	/// <summary> Rounds down to an integer. SSE2 only truncates, so lanes that truncated upwards are stepped down. </summary>
+	inline Int8 FloorToInt(Float8 a) {
+		Int8 ret;
+		for (int i = 0; i < 2; i++) {
+			__m128i truncated = _mm_cvttps_epi32(a.v[i]);
+			__m128 above = _mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), a.v[i]);
+			ret.v[i] = _mm_add_epi32(truncated, _mm_castps_si128(above));
+		}
+		return ret;
+	}
+
+	/// <summary> The low 32 bits of each product. SSE2 has no 32-bit multiply, so the even and odd lanes are multiplied to 64 bits and interleaved. </summary>
+	inline Int8 operator*(Int8 a, Int8 b) {
+		Int8 ret;
+		for (int i = 0; i < 2; i++) {
+			__m128i even = _mm_mul_epu32(a.v[i], b.v[i]);
+			__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.v[i], 32), _mm_srli_epi64(b.v[i], 32));
+			ret.v[i] = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		}
+		return ret;
+	}
+
+	// SSE2 has no per-lane shifts or gathers, so these go through memory a lane at a time
+	inline Int8 ShiftLeft(Int8 a, Int8 shift) {
+		alignas(16) uint32_t values[LANES], shifts[LANES];
+		StoreInt(values, a);
+		StoreInt(shifts, shift);
+		for (uint32_t i = 0; i < LANES; i++) values[i] <<= shifts[i];
+		return LoadInt(values);
+	}
+	inline Int8 ShiftRight(Int8 a, Int8 shift) {
+		alignas(16) uint32_t values[LANES], shifts[LANES];
+		StoreInt(values, a);
+		StoreInt(shifts, shift);
+		for (uint32_t i = 0; i < LANES; i++) values[i] >>= shifts[i];
+		return LoadInt(values);
+	}
+
+	/// <summary> Loads base[index] for every lane. </summary>
+	inline Int8 Gather(const uint32_t* base, Int8 index) {
+		alignas(16) uint32_t indices[LANES];
+		StoreInt(indices, index);
+		for (uint32_t i = 0; i < LANES; i++) indices[i] = base[indices[i]];
+		return LoadInt(indices);
+	}
+#else
+	struct Float8 { float v[LANES]; };
+	struct Int8 { uint32_t v[LANES]; };
+
+#define LANE_OP(type, name, expression) \
+	inline type name(type a, type b) { type r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = expression; return r; }
+#define MASK_OP(type, name, expression) \
+	inline Float8 name(type a, type b) { Float8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = MaskLane(expression); return r; }
+
+	inline float MaskLane(bool value) { return std::bit_cast<float>(value ? ~0u : 0u); }
+	inline uint32_t Bits(float value) { return std::bit_cast<uint32_t>(value); }
+
+	LANE_OP(Float8, operator+, a.v[i] + b.v[i])
+	LANE_OP(Float8, operator-, a.v[i] - b.v[i])
+	LANE_OP(Float8, operator*, a.v[i] * b.v[i])
+	LANE_OP(Float8, operator/, a.v[i] / b.v[i])
+	LANE_OP(Float8, Min, std::min(a.v[i], b.v[i]))
+	LANE_OP(Float8, Max, std::max(a.v[i], b.v[i]))
+	LANE_OP(Float8, And, std::bit_cast<float>(Bits(a.v[i]) & Bits(b.v[i])))
+	LANE_OP(Float8, Or, std::bit_cast<float>(Bits(a.v[i]) | Bits(b.v[i])))
+	LANE_OP(Float8, AndNot, std::bit_cast<float>(Bits(a.v[i]) & ~Bits(b.v[i])))
+	LANE_OP(Int8, operator+, a.v[i] + b.v[i])
+	LANE_OP(Int8, operator-, a.v[i] - b.v[i])
+	LANE_OP(Int8, operator*, a.v[i] * b.v[i])
+	LANE_OP(Int8, operator^, a.v[i] ^ b.v[i])
+	LANE_OP(Int8, operator&, a.v[i] & b.v[i])
+	LANE_OP(Int8, operator|, a.v[i] | b.v[i])
+	LANE_OP(Int8, ShiftLeft, a.v[i] << b.v[i])
+	LANE_OP(Int8, ShiftRight, a.v[i] >> b.v[i])
+	LANE_OP(Int8, MinSigned, static_cast<uint32_t>(std::min(static_cast<int32_t>(a.v[i]), static_cast<int32_t>(b.v[i]))))
+	LANE_OP(Int8, MaxSigned, static_cast<uint32_t>(std::max(static_cast<int32_t>(a.v[i]), static_cast<int32_t>(b.v[i]))))
+	MASK_OP(Float8, Less, a.v[i] < b.v[i])
+	MASK_OP(Float8, LessEqual, a.v[i] <= b.v[i])
+	MASK_OP(Float8, Equal, a.v[i] == b.v[i])
+	MASK_OP(Int8, Equal, a.v[i] == b.v[i])
+	MASK_OP(Int8, LessSigned, static_cast<int32_t>(a.v[i]) < static_cast<int32_t>(b.v[i]))
+#undef LANE_OP
+#undef MASK_OP
+
+	inline Float8 Splat(float a) { Float8 r; std::fill(r.v, r.v + LANES, a); return r; }
+	inline Int8 SplatInt(uint32_t a) { Int8 r; std::fill(r.v, r.v + LANES, a); return r; }
+	inline Float8 Load(const float* data) { Float8 r; std::copy(data, data + LANES, r.v); return r; }
+	inline Int8 LoadInt(const uint32_t* data) { Int8 r; std::copy(data, data + LANES, r.v); return r; }
+	inline void Store(float* data, Float8 a) { std::copy(a.v, a.v + LANES, data); }
+	inline void StoreInt(uint32_t* data, Int8 a) { std::copy(a.v, a.v + LANES, data); }
+	inline Int8 AsInt(Float8 a) { Int8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = Bits(a.v[i]); return r; }
+	inline Float8 AsFloat(Int8 a) { Float8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = std::bit_cast<float>(a.v[i]); return r; }
+	inline Float8 Select(Float8 mask, Float8 a, Float8 b) { return Or(And(mask, a), AndNot(b, mask)); }
+	inline Int8 Select(Float8 mask, Int8 a, Int8 b) { return AsInt(Select(mask, AsFloat(a), AsFloat(b))); }
+	inline Float8 Abs(Float8 a) { Float8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = std::abs(a.v[i]); return r; }
+	inline Float8 Sqrt(Float8 a) { Float8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = std::sqrt(a.v[i]); return r; }
+	inline Float8 ToFloat(Int8 a) { Float8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = static_cast<float>(static_cast<int32_t>(a.v[i])); return r; }
+	inline Int8 operator>>(Int8 a, int shift) { Int8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = a.v[i] >> shift; return r; }
+	inline Int8 operator<<(Int8 a, int shift) { Int8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = a.v[i] << shift; return r; }
+	inline Int8 FloorToInt(Float8 a) { Int8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = static_cast<uint32_t>(static_cast<int32_t>(std::floor(a.v[i]))); return r; }
+
+	/// <summary> Gets one bit per lane, set where the mask lane is set. </summary>
+	inline uint32_t MoveMask(Float8 mask) { uint32_t r = 0; for (uint32_t i = 0; i < LANES; i++) r |= (Bits(mask.v[i]) >> 31) << i; return r; }
+	inline bool Any(Float8 mask) { return MoveMask(mask) != 0; }
+
+	/// <summary> Loads base[index] for every lane. </summary>
+	inline Int8 Gather(const uint32_t* base, Int8 index) { Int8 r; for (uint32_t i = 0; i < LANES; i++) r.v[i] = base[index.v[i]]; return r; }
+#endif
+
+	/// <summary> Expands one bit per lane, as returned by MoveMask, into a mask. </summary>
+	inline Float8 FromBits(uint32_t bits) {
+		static constexpr uint32_t lane_bits[LANES] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+		Int8 lanes = LoadInt(lane_bits);
+		return Equal(SplatInt(bits) & lanes, lanes);
+	}
+
+	inline Float8 Lerp(Float8 a, Float8 b, Float8 t) { return a + (b - a) * t; }
+}
@@ -0,0 +1,153 @@
+#include "StagingRing.h"
+#include <random>
+#include <string>
+#include <stdexcept>
+#include <cstdio>
+
+std::shared_ptr<StagingRing> StagingRing::Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, VkDeviceSize size) {
+	auto ret = std::make_shared<StagingRing>();
+	ret->m_size = size;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device->GetPhysicalDevice()->Get(), &properties);
+	ret->m_alignment = std::max({ properties.limits.optimalBufferCopyOffsetAlignment, properties.limits.minUniformBufferOffsetAlignment, (VkDeviceSize)4 });
+
+	void* data;
+	ret->m_buffer = VWrap::Buffer::CreateMapped(allocator,
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		data);
+	ret->m_data = static_cast<uint8_t*>(data);
+
+	return ret;
+}
+
+bool StagingRing::Allocate(VkDeviceSize size, StagingAllocation& allocation, VkDeviceSize alignment)
+{
+	// Offsets are aligned within the buffer, which need not be a multiple of the alignment
+	alignment = std::max(alignment, m_alignment);
+	uint64_t offset = m_head % m_size;
+	uint64_t start = m_head + (offset + alignment - 1) / alignment * alignment - offset;
+
+	// A region never straddles the end of the buffer; skip to the start instead
+	if (start % m_size + size > m_size || start / m_size != m_head / m_size)
+		start = (m_head / m_size + 1) * m_size;
+
+	if (size > m_size || start + size - m_tail > m_size) {
+		m_overflows++;
+		return false;
+	}
+
+	m_head = start + size;
+	allocation.buffer = m_buffer;
+	allocation.offset = static_cast<VkDeviceSize>(start % m_size);
+	allocation.size = size;
+	allocation.data = m_data + allocation.offset;
+	return true;
+}
+
+bool StagingRing::Stage(const void* data, VkDeviceSize size, StagingAllocation& allocation)
+{
+	if (!Allocate(size, allocation))
+		return false;
+	memcpy(allocation.data, data, static_cast<size_t>(size));
+	return true;
+}
+
+void StagingRing::Reclaim(uint64_t completed_frame)
+{
+	// Frames finish in order, so a frame's end is past every region of the frames before it
+	while (!m_frame_ends.empty() && m_frame_ends.front().first <= completed_frame) {
+		m_tail = m_frame_ends.front().second;
+		m_frame_ends.pop_front();
+	}
+}
+
+void StagingRing::EndFrame(uint64_t frame)
+{
+	m_frame_ends.push_back({ frame, m_head });
+}
+
+void StagingRing::RunTests()
+{
+	struct Config {
+		VkDeviceSize size;
+		VkDeviceSize alignment;
+		uint32_t frames_in_flight;
+	};
+	// Sizes that are not a multiple of the alignment exercise the padding at the end of the buffer
+	const Config configs[] = {
+		{ 4096, 4, 1 },
+		{ 65536, 256, 2 },
+		{ 65536 + 12, 64, 3 },
+		{ 1000003, 256, 3 },
+	};
+	const uint32_t frame_count = 100000;
+
+	auto check = [](bool passed, const char* what) {
+		if (!passed)
+			throw std::runtime_error(std::string("Staging ring test failed: ") + what);
+	};
+
+	for (const Config& config : configs) {
+		std::vector<uint8_t> memory(config.size);
+		auto ring = std::make_shared<StagingRing>();
+		ring->m_size = config.size;
+		ring->m_alignment = config.alignment;
+		ring->m_data = memory.data();
+
+		std::mt19937 rng(1234);
+		std::uniform_int_distribution<uint32_t> count_dist(0, 8);
+		std::uniform_int_distribution<uint32_t> size_dist(1, 100);
+
+		// The regions of every frame not yet reclaimed, as [offset, offset + size)
+		std::deque<std::pair<uint64_t, std::vector<std::pair<VkDeviceSize, VkDeviceSize>>>> live;
+		uint64_t allocations = 0, failures = 0;
+
+		for (uint64_t frame = 1; frame <= frame_count; frame++) {
+			live.push_back({ frame, {} });
+			uint32_t count = count_dist(rng);
+			for (uint32_t i = 0; i < count; i++) {
+				// Mostly small uploads, with the occasional one near or past the ring's size
+				uint32_t roll = size_dist(rng);
+				VkDeviceSize size = roll <= 90 ? 1 + rng() % (config.size / 64)
+					: roll <= 99 ? 1 + rng() % (config.size / 4)
+					: 1 + rng() % (config.size + config.size / 2);
+				VkDeviceSize alignment = rng() % 4 == 0 ? config.alignment << (rng() % 3) : 0;
+
+				bool empty = std::all_of(live.begin(), live.end(), [](const auto& f) { return f.second.empty(); });
+				StagingAllocation allocation;
+				if (!ring->Allocate(size, allocation, alignment)) {
+					// An empty ring has room for anything up to half its size, whatever the alignment padding
+					check(!empty || size + std::max(alignment, config.alignment) > config.size / 2, "allocation refused by an empty ring");
+					failures++;
+					continue;
+				}
+				allocations++;
+
+				VkDeviceSize offset = allocation.offset;
+				check(offset % std::max(alignment, config.alignment) == 0, "misaligned offset");
+				check(allocation.size == size && offset + size <= config.size, "region outside the ring");
+				check(allocation.data == memory.data() + offset, "mapped pointer does not match the offset");
+				for (const auto& f : live)
+					for (const auto& region : f.second)
+						check(offset + size <= region.first || region.first + region.second <= offset, "overlapping live regions");
+				live.back().second.push_back({ offset, size });
+			}
+
+			ring->EndFrame(frame);
+			if (frame > config.frames_in_flight) {
+				uint64_t completed = frame - config.frames_in_flight;
+				ring->Reclaim(completed);
+				while (!live.empty() && live.front().first <= completed)
+					live.pop_front();
+			}
+		}
+
+		check(ring->GetOverflows() == failures, "overflow count");
+		printf("%8llu bytes, %3llu alignment, %u in flight: %llu allocations, %llu refused: passed\n",
+			(unsigned long long)config.size, (unsigned long long)config.alignment, config.frames_in_flight,
+			(unsigned long long)allocations, (unsigned long long)failures);
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include "Device.h"
+#include "Allocator.h"
+#include "Buffer.h"
+
+#include <memory>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+
+/// <summary>
+/// A region of the staging ring, valid until the frame it was allocated for has finished on the GPU.
+/// </summary>
+struct StagingAllocation {
+	std::shared_ptr<VWrap::Buffer> buffer;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+
+	/// <summary> Where the region is mapped. Writes are visible to the device without flushing. </summary>
+	void* data = nullptr;
+};
+
+/// <summary>
+/// One persistently mapped, host-coherent buffer that small uploads are staged in, so that they cost no allocation and no mapping.
+/// Allocations bump a head pointer through the buffer and wrap around to its start. Each frame owns the regions allocated since
+/// the frame before it ended, which are reclaimed together once the frame controller reports the frame finished.
+/// Uploads made between frames belong to the frame recorded next, so whatever consumes them must do so in that frame.
+/// </summary>
+class StagingRing
+{
+private:
+
+	std::shared_ptr<VWrap::Buffer> m_buffer;
+	uint8_t* m_data = nullptr;
+	VkDeviceSize m_size = 0;
+
+	/// <summary> The alignment of every allocation: the device's copy and uniform offset alignments, whichever is larger. </summary>
+	VkDeviceSize m_alignment = 1;
+
+	/// <summary>
+	/// The ends of the allocated and the oldest live region, counted in bytes since creation so that they never wrap.
+	/// The live regions lie between them.
+	/// </summary>
+	uint64_t m_head = 0;
+	uint64_t m_tail = 0;
+
+	/// <summary> The number of each ended frame not yet reclaimed, oldest first, and the head when it ended. </summary>
+	std::deque<std::pair<uint64_t, uint64_t>> m_frame_ends;
+
+	/// <summary> Allocations that did not fit since creation, which the callers staged some other way. </summary>
+	uint32_t m_overflows = 0;
+
+public:
+
+	/// <summary>
+	/// Creates a ring of the given number of bytes, usable as a transfer source and as uniform or storage buffer ranges.
+	/// </summary>
+	static std::shared_ptr<StagingRing> Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, VkDeviceSize size);
+
+	/// <summary>
+	/// Allocates a region of the given size for the current frame, aligned to the ring's alignment or a larger power of two.
+	/// </summary>
+	/// <returns> False if the live regions leave no room, in which case the caller must stage the data itself. </returns>
+	bool Allocate(VkDeviceSize size, StagingAllocation& allocation, VkDeviceSize alignment = 0);
+
+	/// <summary> Allocates a region and copies the given data into it. </summary>
+	bool Stage(const void* data, VkDeviceSize size, StagingAllocation& allocation);
+
+	/// <summary>
+	/// Reclaims the regions of every frame up to the given one, which the GPU has finished. See FrameController::GetCompletedFrame.
+	/// </summary>
+	void Reclaim(uint64_t completed_frame);
+
+	/// <summary>
+	/// Ends the regions of the frame with the given number, once it is recorded and before it is submitted. Later allocations
+	/// belong to the next frame.
+	/// </summary>
+	void EndFrame(uint64_t frame);
+
+	/// <summary> Gets the number of bytes in live regions, including alignment padding. </summary>
+	VkDeviceSize GetUsedBytes() const { return static_cast<VkDeviceSize>(m_head - m_tail); }
+
+	/// <summary> Gets the total size of the ring. </summary>
+	VkDeviceSize GetSize() const { return m_size; }
+
+	/// <summary> Gets the number of allocations that did not fit. </summary>
+	uint32_t GetOverflows() const { return m_overflows; }
+
+	/// <summary>
+	/// Drives rings of a few sizes and alignments, backed by host memory rather than a device buffer, through 100,000 frames of
+	/// randomly sized allocations with up to 3 frames in flight. Checks that every region is aligned and inside the ring, and that
+	/// no two live regions overlap. Prints each configuration to stdout, and throws on the first failure.
+	/// </summary>
+	static void RunTests();
+};
@@ -0,0 +1,228 @@
+#include "TemporalUpscaler.h"
+
+std::shared_ptr<TemporalUpscaler> TemporalUpscaler::Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::CommandPool> graphics_pool, std::shared_ptr<VWrap::Image> traced_image, std::shared_ptr<VWrap::ImageView> traced_image_view, VkExtent2D extent, uint32_t num_frames) {
+	auto ret = std::make_shared<TemporalUpscaler>();
+	ret->m_device = device;
+	ret->m_allocator = allocator;
+	ret->m_graphics_pool = graphics_pool;
+	ret->m_traced_image = traced_image;
+	ret->m_traced_image_view = traced_image_view;
+	ret->m_extent = extent;
+
+	ret->CreateImages();
+	ret->CreateDescriptors(num_frames);
+	ret->CreatePipeline();
+	ret->WriteDescriptors();
+
+	return ret;
+}
+
+const char* TemporalUpscaler::GetModeName(UpscaleMode mode)
+{
+	switch (mode) {
+	case UpscaleMode::OFF:
+		return "Off";
+	case UpscaleMode::QUALITY:
+		return "Quality (50% of pixels)";
+	case UpscaleMode::BALANCED:
+		return "Balanced (36% of pixels)";
+	case UpscaleMode::PERFORMANCE:
+		return "Performance (25% of pixels)";
+	default:
+		return "Unknown";
+	}
+}
+
+float TemporalUpscaler::GetModeScale(UpscaleMode mode)
+{
+	switch (mode) {
+	case UpscaleMode::QUALITY:
+		return 0.71f;
+	case UpscaleMode::BALANCED:
+		return 0.6f;
+	case UpscaleMode::PERFORMANCE:
+		return 0.5f;
+	default:
+		return 1.0f;
+	}
+}
+
+void TemporalUpscaler::CreateImages()
+{
+	VWrap::ImageCreateInfo info{};
+	info.width = m_extent.width;
+	info.height = m_extent.height;
+	info.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	info.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	info.mip_levels = 1;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.image_type = VK_IMAGE_TYPE_2D;
+
+	// The transitions are recorded by the first resolve, so that creating the upscaler does not wait on the graphics queue
+	for (uint32_t i = 0; i < 2; i++) {
+		m_history_images[i] = VWrap::Image::Create(m_allocator, info);
+		m_history_image_views[i] = VWrap::ImageView::Create(m_device, m_history_images[i]);
+	}
+	m_history_undefined = true;
+	m_history_valid = false;
+}
+
+void TemporalUpscaler::CreateDescriptors(uint32_t num_frames)
+{
+	// The traced image, the history read and the history written, then the parameters
+	std::vector<VkDescriptorSetLayoutBinding> bindings(4);
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = i == 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	m_descriptor_set_layout = VWrap::DescriptorSetLayout::Create(m_device, bindings);
+
+	uint32_t max_sets = 2 * num_frames;
+	std::vector<VkDescriptorPoolSize> poolSizes(2);
+	poolSizes[0].descriptorCount = max_sets * 3;
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = max_sets;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	m_descriptor_pool = VWrap::DescriptorPool::Create(m_device, poolSizes, max_sets, 0);
+
+	std::vector<std::shared_ptr<VWrap::DescriptorSetLayout>> layouts(max_sets, m_descriptor_set_layout);
+	m_descriptor_sets = VWrap::DescriptorSet::CreateMany(m_descriptor_pool, layouts);
+
+	m_param_buffers.resize(num_frames);
+	m_param_data.resize(num_frames);
+	for (uint32_t i = 0; i < num_frames; i++) {
+		void* data;
+		m_param_buffers[i] = VWrap::Buffer::CreateMapped(m_allocator,
+			sizeof(UpscaleParams),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			data);
+		m_param_data[i] = static_cast<UpscaleParams*>(data);
+		*m_param_data[i] = {};
+	}
+}
+
+void TemporalUpscaler::WriteDescriptors()
+{
+	for (size_t i = 0; i < m_descriptor_sets.size(); i++) {
+		uint32_t frame = static_cast<uint32_t>(i / 2);
+		uint32_t written = static_cast<uint32_t>(i % 2);
+
+		std::array<VkDescriptorImageInfo, 3> image_infos{};
+		image_infos[0].imageView = m_traced_image_view->Get();
+		image_infos[1].imageView = m_history_image_views[1 - written]->Get();
+		image_infos[2].imageView = m_history_image_views[written]->Get();
+		for (auto& image_info : image_infos)
+			image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorBufferInfo param_info{};
+		param_info.buffer = m_param_buffers[frame]->Get();
+		param_info.offset = 0;
+		param_info.range = VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+		for (uint32_t j = 0; j < descriptorWrites.size(); j++) {
+			descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[j].descriptorCount = 1;
+			descriptorWrites[j].dstBinding = j;
+			descriptorWrites[j].dstSet = m_descriptor_sets[i]->Get();
+			descriptorWrites[j].dstArrayElement = 0;
+			if (j == 3) {
+				descriptorWrites[j].pBufferInfo = &param_info;
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			}
+			else {
+				descriptorWrites[j].pImageInfo = &image_infos[j];
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			}
+		}
+
+		vkUpdateDescriptorSets(m_device->Get(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void TemporalUpscaler::CreatePipeline()
+{
+	auto shader_code = VWrap::readFile("../shaders/comp_upscale.spv");
+	m_pipeline = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, {}, shader_code);
+}
+
+glm::vec2 TemporalUpscaler::NextJitter()
+{
+	// The Halton sequence in bases 2 and 3 covers the pixel evenly at every length, so a moving camera that only keeps a few
+	// frames of history still sees spread-out samples
+	m_jitter_index = (m_jitter_index + 1) % JITTER_PHASES;
+	uint32_t index = m_jitter_index + 1;
+	glm::vec2 halton(0.0f);
+	for (uint32_t axis = 0; axis < 2; axis++) {
+		uint32_t base = axis + 2;
+		float fraction = 1.0f;
+		for (uint32_t i = index; i > 0; i /= base) {
+			fraction /= static_cast<float>(base);
+			halton[axis] += fraction * static_cast<float>(i % base);
+		}
+	}
+	m_jitter = halton - 0.5f;
+	return m_jitter;
+}
+
+void TemporalUpscaler::CmdResolve(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, std::shared_ptr<Camera> camera, VkExtent2D render_extent)
+{
+	// Motion is measured from the unjittered cameras, as the history is unjittered
+	glm::mat4 ndc_to_world = camera->GetNDCtoWorldMatrix();
+	glm::vec3 camera_position = camera->GetPosition();
+
+	UpscaleParams& params = *m_param_data[frame];
+	params.ndc_to_camera = glm::translate(glm::mat4(1.0f), -camera_position) * ndc_to_world;
+	params.camera_to_previous = glm::inverse(m_previous_ndc_to_world) * glm::translate(glm::mat4(1.0f), camera_position);
+	params.jitter = m_jitter;
+	params.render_size = glm::ivec2(render_extent.width, render_extent.height);
+	params.history_valid = m_history_valid ? 1 : 0;
+
+	uint32_t written = m_history_index;
+	m_history_index = 1 - m_history_index;
+	m_previous_ndc_to_world = ndc_to_world;
+	m_history_valid = true;
+
+	auto vk_command_buffer = command_buffer->Get();
+
+	if (m_history_undefined) {
+		for (const auto& image : m_history_images)
+			command_buffer->CmdTransitionImageLayout(image, image->GetFormat(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		m_history_undefined = false;
+	}
+
+	// The trace must be done writing, and the previous frame's resolve and copy done with the history it wrote and the one now written
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->Get());
+
+	std::array<VkDescriptorSet, 1> descriptorSets = { m_descriptor_sets[frame * 2 + written]->Get() };
+	vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->GetLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
+
+	vkCmdDispatch(vk_command_buffer, (m_extent.width + TILE_SIZE - 1) / TILE_SIZE, (m_extent.height + TILE_SIZE - 1) / TILE_SIZE, 1);
+
+	// The resolve must be done reading the trace before the reconstruction is copied over it
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	VkImageCopy region{};
+	region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.extent = { m_extent.width, m_extent.height, 1 };
+	vkCmdCopyImage(vk_command_buffer, m_history_images[written]->Get(), VK_IMAGE_LAYOUT_GENERAL, m_traced_image->Get(), VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include "Buffer.h"
+#include "Device.h"
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+#include "DescriptorSet.h"
+#include "DescriptorSetLayout.h"
+#include "DescriptorPool.h"
+#include "Pipeline.h"
+#include "Allocator.h"
+#include "Image.h"
+#include "ImageView.h"
+#include "Utils.h"
+
+#include "Camera.h"
+
+#include <memory>
+#include <vector>
+#include <array>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+/// <summary>
+/// How much of the screen the temporal upscaler traces. Each mode is a scale of each side of the render size; the rest of the
+/// detail is rebuilt from previous frames.
+/// </summary>
+enum class UpscaleMode {
+	OFF, QUALITY, BALANCED, PERFORMANCE, COUNT
+};
+
+/// <summary>
+/// Rebuilds the full-resolution frame from a trace at reduced resolution. Every frame the tracer's samples are jittered to a
+/// different sub-pixel offset, and the resolve pass blends them into a full-resolution history, carried along by the camera's motion
+/// through each pixel's hit distance and clamped to the colours of the samples around it so that it does not ghost. Over
+/// JITTER_PHASES frames a still camera sees every pixel covered, so a quarter of the rays give close to native quality.
+/// The reconstruction is copied back over the traced image, which the tracer then composites at full size.
+/// </summary>
+class TemporalUpscaler
+{
+private:
+
+	// DEVICE RESOURCES
+	std::shared_ptr<VWrap::Device> m_device;
+	std::shared_ptr<VWrap::Allocator> m_allocator;
+	std::shared_ptr<VWrap::CommandPool> m_graphics_pool;
+
+	// DESCRIPTORS
+	std::shared_ptr<VWrap::DescriptorSetLayout> m_descriptor_set_layout;
+	std::shared_ptr<VWrap::DescriptorPool> m_descriptor_pool;
+
+	/// <summary> Two per frame in flight, at frame * 2 + the history image written. </summary>
+	std::vector<std::shared_ptr<VWrap::DescriptorSet>> m_descriptor_sets;
+
+	// PIPELINE
+	std::shared_ptr<VWrap::Pipeline> m_pipeline;
+
+	// IMAGES
+	/// <summary> The tracer's image: read at the render size, and overwritten with the reconstruction. Kept in the general layout. </summary>
+	std::shared_ptr<VWrap::Image> m_traced_image;
+	std::shared_ptr<VWrap::ImageView> m_traced_image_view;
+
+	/// <summary> The last two reconstructions, at the full extent. Each frame reads one and writes the other. </summary>
+	std::array<std::shared_ptr<VWrap::Image>, 2> m_history_images;
+	std::array<std::shared_ptr<VWrap::ImageView>, 2> m_history_image_views;
+
+	VkExtent2D m_extent{};
+
+	// PARAMETERS
+	/// <summary> Laid out as the UpscaleParams block in shader_upscale.comp. </summary>
+	struct UpscaleParams {
+		glm::mat4 ndc_to_camera;
+		glm::mat4 camera_to_previous;
+		glm::vec2 jitter;
+		glm::ivec2 render_size;
+		uint32_t history_valid;
+		uint32_t padding[3];
+	};
+
+	/// <summary> One persistently mapped parameter buffer per frame in flight. </summary>
+	std::vector<std::shared_ptr<VWrap::Buffer>> m_param_buffers;
+	std::vector<UpscaleParams*> m_param_data;
+
+	// HISTORY
+	/// <summary> The history image the next frame writes. </summary>
+	uint32_t m_history_index = 0;
+
+	/// <summary> Whether the history image the next frame reads holds a reconstruction of the current scene. </summary>
+	bool m_history_valid = false;
+
+	/// <summary> Whether the history images are still in the undefined layout, until the first resolve moves them to the general layout. </summary>
+	bool m_history_undefined = true;
+
+	/// <summary> The unjittered camera the last reconstruction was seen from. </summary>
+	glm::mat4 m_previous_ndc_to_world = glm::mat4(1.0f);
+
+	/// <summary> The frame's position in the jitter sequence, and its offset. </summary>
+	uint32_t m_jitter_index = 0;
+	glm::vec2 m_jitter = glm::vec2(0.0f);
+
+	void CreateImages();
+
+	void CreateDescriptors(uint32_t num_frames);
+
+	void CreatePipeline();
+
+	void WriteDescriptors();
+
+public:
+
+	/// <summary> The length of the jitter sequence, after which every sample offset repeats. </summary>
+	static constexpr uint32_t JITTER_PHASES = 8;
+
+	/// <summary> The width and height of the pixel tiles resolved by each workgroup. Must match shader_upscale.comp. </summary>
+	static constexpr uint32_t TILE_SIZE = 8;
+
+	/// <summary>
+	/// Creates the history images at the given extent, and the resolve pass that reads and overwrites the traced image.
+	/// </summary>
+	/// <param name="traced_image"> The tracer's storage image, in the general layout, the size of extent. Must allow transfers to it. </param>
+	static std::shared_ptr<TemporalUpscaler> Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<VWrap::CommandPool> graphics_pool, std::shared_ptr<VWrap::Image> traced_image, std::shared_ptr<VWrap::ImageView> traced_image_view, VkExtent2D extent, uint32_t num_frames);
+
+	/// <summary> Gets the display name of a mode. </summary>
+	static const char* GetModeName(UpscaleMode mode);
+
+	/// <summary> Gets the scale of each side of the render size a mode traces at. 1 when off. </summary>
+	static float GetModeScale(UpscaleMode mode);
+
+	/// <summary>
+	/// Steps to the next offset of the jitter sequence, and returns it: where in its render pixel each of this frame's samples is
+	/// traced, from -0.5 to 0.5. Called once per frame, before the frame's rays are set up.
+	/// </summary>
+	glm::vec2 NextJitter();
+
+	/// <summary> Gets the current frame's jitter. </summary>
+	glm::vec2 GetJitter() const { return m_jitter; }
+
+	/// <summary>
+	/// Records the resolve pass and the copy of its result over the traced image, which must hold this frame's trace at render_extent.
+	/// Must be recorded outside of the render pass, after the trace and before the composite.
+	/// </summary>
+	void CmdResolve(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, std::shared_ptr<Camera> camera, VkExtent2D render_extent);
+
+	/// <summary> Discards the history, for when the scene it shows has been replaced. </summary>
+	void Invalidate() { m_history_valid = false; }
+};
@@ -0,0 +1,243 @@
+#include "UploadService.h"
+
+std::shared_ptr<UploadService> UploadService::Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<StagingRing> staging_ring, std::shared_ptr<VWrap::CommandPool> transfer_pool, std::shared_ptr<VWrap::Queue> graphics_queue) {
+	auto ret = std::make_shared<UploadService>();
+	ret->m_device = device;
+	ret->m_allocator = allocator;
+	ret->m_staging_ring = staging_ring;
+	ret->m_transfer_pool = transfer_pool;
+	ret->m_graphics_queue = graphics_queue;
+
+	if (device->SupportsTimelineSemaphores())
+		ret->m_timeline = VWrap::Semaphore::CreateTimeline(device, 0);
+
+	return ret;
+}
+
+void UploadService::GetOwnershipFamilies(uint32_t& src_family, uint32_t& dst_family) const
+{
+	src_family = m_transfer_pool->GetQueue()->GetQueueFamilyIndex();
+	dst_family = m_graphics_queue->GetQueueFamilyIndex();
+	if (src_family == dst_family)
+		src_family = dst_family = VK_QUEUE_FAMILY_IGNORED;
+}
+
+UploadTicket UploadService::UploadBuffer(std::shared_ptr<VWrap::Buffer>& dst_buffer, const void* data, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	if (!m_open_batch) {
+		m_open_batch = std::make_unique<Batch>();
+		m_open_batch->ticket = m_next_ticket++;
+		m_open_batch->command_buffer = VWrap::CommandBuffer::Create(m_transfer_pool);
+		m_open_batch->command_buffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	}
+
+	// Scene loads can outgrow the ring, and get a mapped buffer of their own
+	StagingAllocation staging;
+	if (!m_staging_ring->Stage(data, size, staging)) {
+		void* mapped;
+		staging.buffer = VWrap::Buffer::CreateMapped(m_allocator,
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			mapped);
+		staging.offset = 0;
+		memcpy(mapped, data, static_cast<size_t>(size));
+		m_open_batch->staging_buffers.push_back(staging.buffer);
+	}
+
+	dst_buffer = VWrap::Buffer::CreateExclusive(m_allocator,
+		size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	auto command_buffer = m_open_batch->command_buffer;
+	VkBufferCopy region{};
+	region.srcOffset = staging.offset;
+	region.dstOffset = 0;
+	region.size = size;
+	vkCmdCopyBuffer(command_buffer->Get(), staging.buffer->Get(), dst_buffer->Get(), 1, &region);
+
+	// Release the buffer to the graphics family. The matching acquire is recorded by CmdAcquire.
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	GetOwnershipFamilies(barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex);
+	barrier.buffer = dst_buffer->Get();
+	barrier.offset = 0;
+	barrier.size = size;
+	vkCmdPipelineBarrier(command_buffer->Get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	m_open_batch->buffers.push_back({ dst_buffer, size });
+	return m_open_batch->ticket;
+}
+
+void UploadService::Flush()
+{
+	if (!m_open_batch)
+		return;
+
+	Batch& batch = *m_open_batch;
+	if (vkEndCommandBuffer(batch.command_buffer->Get()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record upload command buffer!");
+	}
+
+	VkCommandBuffer command_buffer = batch.command_buffer->Get();
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &command_buffer;
+
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &batch.ticket;
+
+	VkFence fence = VK_NULL_HANDLE;
+	if (m_timeline) {
+		timeline = m_timeline->Get();
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timeline;
+	}
+	else {
+		batch.fence = VWrap::Fence::Create(m_device, false);
+		fence = batch.fence->Get();
+	}
+
+	if (vkQueueSubmit(m_transfer_pool->GetQueue()->Get(), 1, &submitInfo, fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit to transfer queue!");
+	}
+
+	m_batches.push_back(std::move(batch));
+	m_open_batch.reset();
+}
+
+bool UploadService::IsDone(const Batch& batch) const
+{
+	return m_timeline ? m_timeline->GetValue() >= batch.ticket : batch.fence->IsSignaled();
+}
+
+void UploadService::WaitDone(const Batch& batch) const
+{
+	if (m_timeline)
+		m_timeline->Wait(batch.ticket);
+	else
+		batch.fence->Wait();
+}
+
+bool UploadService::IsComplete(UploadTicket ticket)
+{
+	if (m_open_batch && m_open_batch->ticket <= ticket)
+		Flush();
+
+	// Collected batches are done, and batches complete in order
+	for (const auto& batch : m_batches) {
+		if (batch.ticket >= ticket)
+			return IsDone(batch);
+	}
+	return true;
+}
+
+void UploadService::Wait(UploadTicket ticket)
+{
+	if (m_open_batch && m_open_batch->ticket <= ticket)
+		Flush();
+
+	for (const auto& batch : m_batches) {
+		if (batch.ticket >= ticket) {
+			WaitDone(batch);
+			return;
+		}
+	}
+}
+
+std::vector<VWrap::SemaphoreWait> UploadService::CmdAcquire(std::shared_ptr<VWrap::CommandBuffer> command_buffer)
+{
+	Flush();
+
+	std::vector<VkBufferMemoryBarrier> barriers;
+	UploadTicket wait_ticket = 0;
+	for (auto& batch : m_batches) {
+		if (batch.acquired)
+			continue;
+
+		// Without a timeline the submission cannot wait on the copies, so the host does. Waiting on a value already reached is
+		// free, and keeps the release ordered before the acquire.
+		if (m_timeline)
+			wait_ticket = batch.ticket;
+		else
+			WaitDone(batch);
+
+		for (const auto& pending : batch.buffers) {
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = ACQUIRE_ACCESS;
+			GetOwnershipFamilies(barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex);
+			barrier.buffer = pending.buffer->Get();
+			barrier.offset = 0;
+			barrier.size = pending.size;
+			barriers.push_back(barrier);
+		}
+		batch.acquired = true;
+	}
+
+	if (barriers.empty())
+		return {};
+
+	// The semaphore wait blocks the same stages the barrier waits on, which chains the copies before the acquire
+	vkCmdPipelineBarrier(command_buffer->Get(), ACQUIRE_STAGES, ACQUIRE_STAGES, 0,
+		0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+	if (wait_ticket == 0)
+		return {};
+	return { VWrap::SemaphoreWait{ m_timeline, wait_ticket, ACQUIRE_STAGES } };
+}
+
+void UploadService::AcquireNow(std::shared_ptr<VWrap::CommandPool> graphics_pool)
+{
+	auto command_buffer = VWrap::CommandBuffer::Create(graphics_pool);
+	command_buffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	auto waits = CmdAcquire(command_buffer);
+	if (vkEndCommandBuffer(command_buffer->Get()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record upload acquire command buffer!");
+	}
+
+	std::vector<VkSemaphore> semaphores;
+	std::vector<uint64_t> values;
+	std::vector<VkPipelineStageFlags> stages;
+	for (const auto& wait : waits) {
+		semaphores.push_back(wait.semaphore->Get());
+		values.push_back(wait.value);
+		stages.push_back(wait.stage);
+	}
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(values.size());
+	timelineInfo.pWaitSemaphoreValues = values.data();
+
+	VkCommandBuffer handle = command_buffer->Get();
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = waits.empty() ? nullptr : &timelineInfo;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(semaphores.size());
+	submitInfo.pWaitSemaphores = semaphores.data();
+	submitInfo.pWaitDstStageMask = stages.data();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &handle;
+
+	if (vkQueueSubmit(graphics_pool->GetQueue()->Get(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit to graphics queue!");
+	}
+	vkQueueWaitIdle(graphics_pool->GetQueue()->Get());
+}
+
+void UploadService::Collect()
+{
+	// Staging buffers and command buffers are only used by the transfer queue, so a batch can go once its copies are done
+	while (!m_batches.empty() && m_batches.front().acquired && IsDone(m_batches.front()))
+		m_batches.pop_front();
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include "Device.h"
+#include "Allocator.h"
+#include "Buffer.h"
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+#include "Semaphore.h"
+#include "Fence.h"
+#include "Queue.h"
+#include "FrameController.h"
+
+#include "StagingRing.h"
+
+#include <memory>
+#include <vector>
+#include <deque>
+
+/// <summary>
+/// Identifies a batch of uploads. Tickets increase with each batch, so a later ticket completes no earlier than an earlier one.
+/// </summary>
+using UploadTicket = uint64_t;
+
+/// <summary>
+/// Uploads buffers on the dedicated transfer queue, so that loading a scene does not stall the graphics queue behind each copy.
+/// Uploads are recorded into an open batch, which is submitted by Flush and signals the service's timeline semaphore with its ticket.
+/// The destination buffers are owned by one queue family at a time: each batch releases them from the transfer family, and
+/// the first frame recorded after it acquires them on the graphics family, waiting on the timeline only before the stages that
+/// read them. Without timeline semaphores each batch signals a fence instead, which the frame waits on from the host.
+/// Data is staged in the staging ring when it fits, and in a buffer of its own otherwise. Either way the batch must be acquired by
+/// the frame recorded next, which is what reclaims the ring's regions.
+/// Images are still uploaded on the graphics queue, since their mipmaps are built with blits.
+/// Not thread safe; used from the render thread.
+/// </summary>
+class UploadService
+{
+private:
+
+	// DEVICE RESOURCES
+	std::shared_ptr<VWrap::Device> m_device;
+	std::shared_ptr<VWrap::Allocator> m_allocator;
+	std::shared_ptr<VWrap::CommandPool> m_transfer_pool;
+	std::shared_ptr<VWrap::Queue> m_graphics_queue;
+	std::shared_ptr<StagingRing> m_staging_ring;
+
+	/// <summary> Signalled with each batch's ticket once its copies are done. Null without timeline semaphores. </summary>
+	std::shared_ptr<VWrap::Semaphore> m_timeline;
+
+	/// <summary> A buffer copied to by a batch, and handed from the transfer family to the graphics family. </summary>
+	struct PendingBuffer {
+		std::shared_ptr<VWrap::Buffer> buffer;
+		VkDeviceSize size;
+	};
+
+	/// <summary> The uploads submitted together, and what must live until they are done. </summary>
+	struct Batch {
+		UploadTicket ticket;
+		std::shared_ptr<VWrap::CommandBuffer> command_buffer;
+		/// <summary> The staging buffers of uploads too large for the ring. </summary>
+		std::vector<std::shared_ptr<VWrap::Buffer>> staging_buffers;
+		std::vector<PendingBuffer> buffers;
+
+		/// <summary> Signalled with the batch, when there is no timeline. </summary>
+		std::shared_ptr<VWrap::Fence> fence;
+
+		/// <summary> Whether the graphics queue's acquire barriers for the batch have been recorded. </summary>
+		bool acquired = false;
+	};
+
+	/// <summary> The batch being recorded, if any upload was made since the last flush. </summary>
+	std::unique_ptr<Batch> m_open_batch;
+
+	/// <summary> Submitted batches, oldest first, until they are done and acquired. </summary>
+	std::deque<Batch> m_batches;
+
+	/// <summary> The ticket of the next batch. Starts at 1, so that the timeline's initial value of 0 precedes every batch. </summary>
+	UploadTicket m_next_ticket = 1;
+
+	/// <summary> The stages that read uploaded buffers, which wait on their batches and follow the acquire barriers. </summary>
+	static constexpr VkPipelineStageFlags ACQUIRE_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	static constexpr VkAccessFlags ACQUIRE_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	/// <summary> Gets whether a submitted batch's copies are done. </summary>
+	bool IsDone(const Batch& batch) const;
+
+	/// <summary> Waits on the host until a submitted batch's copies are done. </summary>
+	void WaitDone(const Batch& batch) const;
+
+	/// <summary> Gets the queue family indices of a hand-over, ignored when both queues are of the same family. </summary>
+	void GetOwnershipFamilies(uint32_t& src_family, uint32_t& dst_family) const;
+
+public:
+
+	/// <summary>
+	/// Creates a service that records uploads into command buffers from transfer_pool, for use on graphics_queue, staging them
+	/// in staging_ring where they fit.
+	/// </summary>
+	static std::shared_ptr<UploadService> Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<StagingRing> staging_ring, std::shared_ptr<VWrap::CommandPool> transfer_pool, std::shared_ptr<VWrap::Queue> graphics_queue);
+
+	/// <summary>
+	/// Creates a device-local buffer at the dst_buffer handle with the given usage, and records the upload of the given data to it
+	/// into the open batch. The data is copied before returning. The buffer must not be used until a frame recorded after the next
+	/// flush, or AcquireNow, has acquired it.
+	/// </summary>
+	/// <returns> The ticket of the batch the upload belongs to. </returns>
+	UploadTicket UploadBuffer(std::shared_ptr<VWrap::Buffer>& dst_buffer, const void* data, VkDeviceSize size, VkBufferUsageFlags usage);
+
+	/// <summary>
+	/// Submits the open batch to the transfer queue, so that its copies run while the caller carries on. Does nothing if no upload
+	/// was made since the last flush.
+	/// </summary>
+	void Flush();
+
+	/// <summary> Gets whether the copies of the given ticket's batch are done. Flushes the batch if it is still open. </summary>
+	bool IsComplete(UploadTicket ticket);
+
+	/// <summary> Waits on the host until the copies of the given ticket's batch are done. Flushes the batch if it is still open. </summary>
+	void Wait(UploadTicket ticket);
+
+	/// <summary>
+	/// Flushes, and records the graphics queue's acquire barriers for every batch not yet acquired. Must be recorded before any
+	/// command that reads the uploaded buffers.
+	/// </summary>
+	/// <returns> The waits the submission of command_buffer needs, empty if it needs none. </returns>
+	std::vector<VWrap::SemaphoreWait> CmdAcquire(std::shared_ptr<VWrap::CommandBuffer> command_buffer);
+
+	/// <summary>
+	/// Acquires every batch on the graphics queue with a single-time command buffer from graphics_pool, and waits for it. For
+	/// loading paths that submit their own work reading the uploaded buffers before the next frame.
+	/// </summary>
+	void AcquireNow(std::shared_ptr<VWrap::CommandPool> graphics_pool);
+
+	/// <summary> Frees the staging buffers and command buffers of batches that are done and acquired. Called once per frame. </summary>
+	void Collect();
+
+	/// <summary> Gets the ring that small uploads are staged in, for data that frames copy on the graphics queue themselves. </summary>
+	std::shared_ptr<StagingRing> GetStagingRing() const { return m_staging_ring; }
+
+	/// <summary> Gets the number of batches submitted and not yet collected. </summary>
+	size_t GetPendingBatches() const { return m_batches.size(); }
+};
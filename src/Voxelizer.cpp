@@ -0,0 +1,376 @@
+#include "Voxelizer.h"
+#include "tiny_obj_loader.h"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <cstdio>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define VOXELIZER_SSE
+#include <immintrin.h>
+#endif
+
+namespace {
+
+	/// <summary>
+	/// The per-triangle constants of the triangle/box overlap test for boxes of a fixed width.
+	/// A box overlaps the triangle if it straddles the triangle's plane and overlaps its projections onto the xy, yz and zx planes,
+	/// which is equivalent to the full separating axis test. Each projection test is one edge function per triangle edge.
+	/// </summary>
+	struct TriangleSetup {
+		glm::vec3 normal;
+		float plane_near, plane_far;
+
+		glm::vec2 normal_xy[3], normal_yz[3], normal_zx[3];
+		float offset_xy[3], offset_yz[3], offset_zx[3];
+
+		glm::vec3 min, max;
+
+		/// <summary>
+		/// Computes the constants for boxes of the given width. Returns false for degenerate triangles, which cover no volume.
+		/// </summary>
+		bool Setup(const glm::vec3* v, float width) {
+			min = glm::min(v[0], glm::min(v[1], v[2]));
+			max = glm::max(v[0], glm::max(v[1], v[2]));
+
+			normal = glm::cross(v[1] - v[0], v[2] - v[0]);
+			if (normal == glm::vec3(0.0f)) return false;
+
+			// The box corners furthest along and against the normal
+			glm::vec3 critical = glm::vec3(normal.x > 0.0f ? width : 0.0f, normal.y > 0.0f ? width : 0.0f, normal.z > 0.0f ? width : 0.0f);
+			plane_near = glm::dot(normal, critical - v[0]);
+			plane_far = glm::dot(normal, (glm::vec3(width) - critical) - v[0]);
+
+			float sign_x = normal.x >= 0.0f ? 1.0f : -1.0f;
+			float sign_y = normal.y >= 0.0f ? 1.0f : -1.0f;
+			float sign_z = normal.z >= 0.0f ? 1.0f : -1.0f;
+
+			for (int i = 0; i < 3; i++) {
+				glm::vec3 edge = v[(i + 1) % 3] - v[i];
+
+				normal_xy[i] = glm::vec2(-edge.y, edge.x) * sign_z;
+				offset_xy[i] = -glm::dot(normal_xy[i], glm::vec2(v[i].x, v[i].y))
+					+ std::max(0.0f, width * normal_xy[i].x) + std::max(0.0f, width * normal_xy[i].y);
+
+				normal_yz[i] = glm::vec2(-edge.z, edge.y) * sign_x;
+				offset_yz[i] = -glm::dot(normal_yz[i], glm::vec2(v[i].y, v[i].z))
+					+ std::max(0.0f, width * normal_yz[i].x) + std::max(0.0f, width * normal_yz[i].y);
+
+				normal_zx[i] = glm::vec2(-edge.x, edge.z) * sign_y;
+				offset_zx[i] = -glm::dot(normal_zx[i], glm::vec2(v[i].z, v[i].x))
+					+ std::max(0.0f, width * normal_zx[i].x) + std::max(0.0f, width * normal_zx[i].y);
+			}
+			return true;
+		}
+
+		/// <summary>
+		/// Whether the box with the given minimum corner overlaps the triangle.
+		/// </summary>
+		bool Overlaps(glm::vec3 p) const {
+			float distance = glm::dot(normal, p);
+			if ((distance + plane_near) * (distance + plane_far) > 0.0f) return false;
+
+			for (int i = 0; i < 3; i++) {
+				if (glm::dot(normal_xy[i], glm::vec2(p.x, p.y)) + offset_xy[i] < 0.0f) return false;
+				if (glm::dot(normal_yz[i], glm::vec2(p.y, p.z)) + offset_yz[i] < 0.0f) return false;
+				if (glm::dot(normal_zx[i], glm::vec2(p.z, p.x)) + offset_zx[i] < 0.0f) return false;
+			}
+			return true;
+		}
+	};
+
+	/// <summary>
+	/// Writes value into every voxel of the brick that the triangle overlaps. The triangle must be set up for unit boxes.
+	/// Rows that fail the yz test are skipped whole; along x, the remaining tests are linear in x and run four voxels at a time.
+	/// </summary>
+	void VoxelizeTriangle(const TriangleSetup& triangle, glm::ivec3 brick_origin, int brick_size, uint8_t value, uint8_t* voxels) {
+		glm::ivec3 lo = glm::max(glm::ivec3(glm::floor(triangle.min)) - brick_origin, glm::ivec3(0));
+		glm::ivec3 hi = glm::min(glm::ivec3(glm::floor(triangle.max)) - brick_origin, glm::ivec3(brick_size - 1));
+
+		for (int z = lo.z; z <= hi.z; z++)
+		for (int y = lo.y; y <= hi.y; y++) {
+			float py = static_cast<float>(brick_origin.y + y);
+			float pz = static_cast<float>(brick_origin.z + z);
+
+			bool row = true;
+			for (int i = 0; i < 3; i++)
+				row = row && glm::dot(triangle.normal_yz[i], glm::vec2(py, pz)) + triangle.offset_yz[i] >= 0.0f;
+			if (!row) continue;
+
+			// What remains of each test once y and z are fixed: a * x + b
+			float plane_base = triangle.normal.y * py + triangle.normal.z * pz;
+			float xy_base[3], zx_base[3];
+			for (int i = 0; i < 3; i++) {
+				xy_base[i] = triangle.normal_xy[i].y * py + triangle.offset_xy[i];
+				zx_base[i] = triangle.normal_zx[i].x * pz + triangle.offset_zx[i];
+			}
+
+			uint8_t* voxel_row = voxels + ((size_t)z * brick_size + y) * brick_size;
+			int x = lo.x;
+#ifdef VOXELIZER_SSE
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			for (; x + 3 <= hi.x; x += 4) {
+				__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(brick_origin.x + x)), lane);
+
+				__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.normal.x), px), _mm_set1_ps(plane_base));
+				__m128 straddle = _mm_mul_ps(_mm_add_ps(distance, _mm_set1_ps(triangle.plane_near)), _mm_add_ps(distance, _mm_set1_ps(triangle.plane_far)));
+				__m128 mask = _mm_cmple_ps(straddle, zero);
+
+				for (int i = 0; i < 3; i++) {
+					__m128 xy = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.normal_xy[i].x), px), _mm_set1_ps(xy_base[i]));
+					__m128 zx = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.normal_zx[i].y), px), _mm_set1_ps(zx_base[i]));
+					mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(xy, zero), _mm_cmpge_ps(zx, zero)));
+				}
+
+				int bits = _mm_movemask_ps(mask);
+				for (int k = 0; k < 4; k++)
+					if (bits & (1 << k)) voxel_row[x + k] = value;
+			}
+#endif
+			for (; x <= hi.x; x++) {
+				float px = static_cast<float>(brick_origin.x + x);
+
+				float distance = triangle.normal.x * px + plane_base;
+				bool overlaps = (distance + triangle.plane_near) * (distance + triangle.plane_far) <= 0.0f;
+				for (int i = 0; i < 3; i++)
+					overlaps = overlaps && triangle.normal_xy[i].x * px + xy_base[i] >= 0.0f && triangle.normal_zx[i].y * px + zx_base[i] >= 0.0f;
+
+				if (overlaps) voxel_row[x] = value;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Runs function(thread_index) on thread_count threads, including the calling one, and waits for all of them.
+	/// </summary>
+	template<typename Function>
+	void RunOnThreads(uint32_t thread_count, Function function) {
+		std::vector<std::thread> threads;
+		for (uint32_t t = 1; t < thread_count; t++)
+			threads.emplace_back(function, t);
+		function(0u);
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	float MillisecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+std::shared_ptr<Voxelizer> Voxelizer::Create(const std::vector<glm::vec3>& vertices, const std::vector<uint8_t>& values) {
+	if (vertices.size() != values.size() * 3)
+		throw std::invalid_argument("Voxelizer needs three vertices and one value per triangle!");
+
+	auto ret = std::make_shared<Voxelizer>();
+	ret->m_vertices = vertices;
+	ret->m_values = values;
+
+	if (!vertices.empty()) {
+		ret->m_min = ret->m_max = vertices[0];
+		for (const auto& vertex : vertices) {
+			ret->m_min = glm::min(ret->m_min, vertex);
+			ret->m_max = glm::max(ret->m_max, vertex);
+		}
+	}
+
+	return ret;
+}
+
+std::shared_ptr<Voxelizer> Voxelizer::CreateFromOBJ(const std::string& path) {
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+		throw std::runtime_error(warn + err);
+	}
+
+	std::vector<glm::vec3> vertices;
+	std::vector<uint8_t> values;
+	for (const auto& shape : shapes) {
+		// LoadObj triangulates, so every face has three indices
+		for (size_t face = 0; face < shape.mesh.indices.size() / 3; face++) {
+			for (size_t corner = 0; corner < 3; corner++) {
+				int index = shape.mesh.indices[face * 3 + corner].vertex_index;
+				vertices.push_back({
+					attrib.vertices[3 * index + 0],
+					attrib.vertices[3 * index + 1],
+					attrib.vertices[3 * index + 2]
+				});
+			}
+
+			// Value 1 is untextured white; materials cycle through the tracer's other palette entries
+			int material = face < shape.mesh.material_ids.size() ? shape.mesh.material_ids[face] : -1;
+			values.push_back(material < 0 ? 1 : static_cast<uint8_t>(2 + material % 6));
+		}
+	}
+
+	return Create(vertices, values);
+}
+
+std::shared_ptr<Octree> Voxelizer::Voxelize(uint32_t resolution, uint32_t brick_size, uint32_t thread_count, VoxelizerStats* stats) const {
+	if (brick_size == 0 || resolution % brick_size != 0)
+		throw std::invalid_argument("Voxelizer resolution must be a multiple of the brick size!");
+
+	uint32_t bricks_per_side = resolution / brick_size;
+	if ((bricks_per_side & (bricks_per_side - 1)) != 0)
+		throw std::invalid_argument("Voxelizer resolution must be the brick size times a power of two!");
+
+	uint32_t depth = 0;
+	while ((1u << depth) < bricks_per_side) depth++;
+
+	// Brick counts are kept in a dense grid, so cap it at 2^27 bricks (512 MiB of counters and offsets)
+	size_t brick_grid = (size_t)bricks_per_side * bricks_per_side * bricks_per_side;
+	if (brick_grid > (1ull << 27))
+		throw std::invalid_argument("Voxelizer resolution is too large for the brick size!");
+
+	if (thread_count == 0)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+	size_t triangle_count = m_values.size();
+	auto bin_start = std::chrono::steady_clock::now();
+
+	glm::vec3 offset;
+	float scale;
+	GetVoxelTransform(resolution, offset, scale);
+	std::vector<glm::vec3> vertices(m_vertices.size());
+
+	RunOnThreads(thread_count, [&](uint32_t thread) {
+		size_t begin = vertices.size() * thread / thread_count;
+		size_t end = vertices.size() * (thread + 1) / thread_count;
+		for (size_t i = begin; i < end; i++)
+			vertices[i] = (m_vertices[i] - offset) * scale;
+	});
+
+	// Bin triangles into the bricks they overlap: count, prefix sum, then scatter. Each pass splits the triangles evenly between threads.
+	auto for_each_brick = [&](size_t triangle, auto&& visit) {
+		TriangleSetup setup;
+		if (!setup.Setup(&vertices[triangle * 3], static_cast<float>(brick_size))) return;
+
+		glm::uvec3 lo = glm::uvec3(glm::clamp(glm::ivec3(glm::floor(setup.min / (float)brick_size)), glm::ivec3(0), glm::ivec3(bricks_per_side - 1)));
+		glm::uvec3 hi = glm::uvec3(glm::clamp(glm::ivec3(glm::floor(setup.max / (float)brick_size)), glm::ivec3(0), glm::ivec3(bricks_per_side - 1)));
+		for (uint32_t z = lo.z; z <= hi.z; z++)
+		for (uint32_t y = lo.y; y <= hi.y; y++)
+		for (uint32_t x = lo.x; x <= hi.x; x++) {
+			if (setup.Overlaps(glm::vec3(x, y, z) * (float)brick_size))
+				visit(((size_t)z * bricks_per_side + y) * bricks_per_side + x);
+		}
+	};
+
+	std::vector<std::atomic<uint32_t>> cursors(brick_grid);
+	RunOnThreads(thread_count, [&](uint32_t thread) {
+		size_t begin = triangle_count * thread / thread_count;
+		size_t end = triangle_count * (thread + 1) / thread_count;
+		for (size_t i = begin; i < end; i++)
+			for_each_brick(i, [&](size_t brick) { cursors[brick].fetch_add(1, std::memory_order_relaxed); });
+	});
+
+	std::vector<uint32_t> offsets(brick_grid + 1);
+	std::vector<uint32_t> occupied;
+	uint64_t total_refs = 0;
+	for (size_t brick = 0; brick < brick_grid; brick++) {
+		uint32_t count = cursors[brick].load(std::memory_order_relaxed);
+		if (total_refs + count > UINT32_MAX)
+			throw std::runtime_error("Voxelizer produced too many triangle references!");
+
+		offsets[brick] = static_cast<uint32_t>(total_refs);
+		cursors[brick].store(static_cast<uint32_t>(total_refs), std::memory_order_relaxed);
+		total_refs += count;
+		if (count > 0) occupied.push_back(static_cast<uint32_t>(brick));
+	}
+	offsets[brick_grid] = static_cast<uint32_t>(total_refs);
+
+	std::vector<uint32_t> refs(total_refs);
+	RunOnThreads(thread_count, [&](uint32_t thread) {
+		size_t begin = triangle_count * thread / thread_count;
+		size_t end = triangle_count * (thread + 1) / thread_count;
+		for (size_t i = begin; i < end; i++)
+			for_each_brick(i, [&](size_t brick) { refs[cursors[brick].fetch_add(1, std::memory_order_relaxed)] = static_cast<uint32_t>(i); });
+	});
+
+	float bin_ms = MillisecondsSince(bin_start);
+	auto voxelize_start = std::chrono::steady_clock::now();
+
+	// Voxelize the occupied bricks. Threads take bricks one at a time, since their triangle counts vary widely.
+	size_t brick_voxels = (size_t)brick_size * brick_size * brick_size;
+	std::atomic<size_t> next_brick{ 0 };
+	std::vector<std::vector<OctreeBrick>> thread_bricks(thread_count);
+
+	RunOnThreads(thread_count, [&](uint32_t thread) {
+		std::vector<uint8_t> voxels(brick_voxels);
+		for (size_t i = next_brick++; i < occupied.size(); i = next_brick++) {
+			uint32_t brick = occupied[i];
+			glm::uvec3 coord = glm::uvec3(brick % bricks_per_side, (brick / bricks_per_side) % bricks_per_side, brick / (bricks_per_side * bricks_per_side));
+			glm::ivec3 origin = glm::ivec3(coord * brick_size);
+
+			// Scattering is unordered, so sort to make overlapping triangles resolve the same way every run
+			std::sort(refs.begin() + offsets[brick], refs.begin() + offsets[brick + 1]);
+
+			std::fill(voxels.begin(), voxels.end(), 0);
+			for (uint32_t r = offsets[brick]; r < offsets[brick + 1]; r++) {
+				TriangleSetup setup;
+				if (!setup.Setup(&vertices[(size_t)refs[r] * 3], 1.0f)) continue;
+				VoxelizeTriangle(setup, origin, static_cast<int>(brick_size), m_values[refs[r]], voxels.data());
+			}
+
+			// A triangle that only grazes the brick's boundary may not cover any of its voxels
+			if (std::any_of(voxels.begin(), voxels.end(), [](uint8_t v) { return v != 0; }))
+				thread_bricks[thread].push_back({ coord, voxels });
+		}
+	});
+
+	std::vector<OctreeBrick> bricks;
+	for (auto& list : thread_bricks) {
+		std::move(list.begin(), list.end(), std::back_inserter(bricks));
+	}
+
+	float voxelize_ms = MillisecondsSince(voxelize_start);
+	auto build_start = std::chrono::steady_clock::now();
+
+	auto octree = Octree::CreateFromBricks(bricks, depth, brick_size);
+
+	if (stats) {
+		stats->thread_count = thread_count;
+		stats->triangle_count = triangle_count;
+		stats->brick_count = static_cast<uint32_t>(bricks.size());
+		stats->bin_ms = bin_ms;
+		stats->voxelize_ms = voxelize_ms;
+		stats->build_ms = MillisecondsSince(build_start);
+	}
+
+	return octree;
+}
+
+void Voxelizer::GetVoxelTransform(uint32_t resolution, glm::vec3& offset, float& scale) const {
+	// Scale the mesh uniformly into voxel space, keeping it just inside the far faces
+	glm::vec3 extent = m_max - m_min;
+	offset = m_min;
+	scale = resolution * 0.999f / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-20f));
+}
+
+void Voxelizer::RunBenchmark(const std::string& path, uint32_t resolution, uint32_t brick_size) {
+	auto voxelizer = CreateFromOBJ(path);
+	printf("Voxelizing %s: %llu triangles at %u^3, %u^3 bricks\n", path.c_str(), (unsigned long long)voxelizer->GetTriangleCount(), resolution, brick_size);
+
+	uint32_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t count = 1; count < max_threads; count *= 2)
+		thread_counts.push_back(count);
+	thread_counts.push_back(max_threads);
+
+	for (uint32_t count : thread_counts) {
+		VoxelizerStats stats{};
+		voxelizer->Voxelize(resolution, brick_size, count, &stats);
+		printf("%3u threads | bin %9.1f ms | voxelize %9.1f ms | build %8.1f ms | %8.2f M triangles/s | %10.0f bricks/s | %u bricks\n",
+			stats.thread_count, stats.bin_ms, stats.voxelize_ms, stats.build_ms,
+			stats.GetTrianglesPerSecond() / 1e6f, stats.GetBricksPerSecond(), stats.brick_count);
+	}
+}
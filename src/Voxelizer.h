@@ -0,0 +1,100 @@
+#pragma once
+#include "Octree.h"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Timings and counts of a single Voxelizer::Voxelize call.
+/// </summary>
+struct VoxelizerStats {
+
+	/// <summary> The number of worker threads used. </summary>
+	uint32_t thread_count;
+
+	/// <summary> The number of triangles in the mesh. </summary>
+	uint64_t triangle_count;
+
+	/// <summary> The number of non-empty bricks produced. </summary>
+	uint32_t brick_count;
+
+	/// <summary> Time spent binning triangles into bricks, in milliseconds. </summary>
+	float bin_ms;
+
+	/// <summary> Time spent voxelizing the binned bricks, in milliseconds. </summary>
+	float voxelize_ms;
+
+	/// <summary> Time spent building the octree from the bricks, in milliseconds. </summary>
+	float build_ms;
+
+	/// <summary> Gets the triangle throughput over the binning and voxelization passes. </summary>
+	float GetTrianglesPerSecond() const { return triangle_count / ((bin_ms + voxelize_ms) / 1000.0f); }
+
+	/// <summary> Gets the brick throughput of the voxelization pass. </summary>
+	float GetBricksPerSecond() const { return brick_count / (voxelize_ms / 1000.0f); }
+};
+
+/// <summary>
+/// Converts a triangle mesh into a sparse voxel octree on the CPU.
+/// Triangles are first binned into the bricks their bounds overlap, then every brick is voxelized independently,
+/// spread across worker threads. A voxel is set if the triangle overlaps its cube, decided with the separating axis
+/// test in the plane-and-projections form of Schwarz and Seidel, evaluated for four voxels at a time with SSE.
+/// </summary>
+class Voxelizer
+{
+private:
+
+	/// <summary> The triangle vertices, three per triangle. </summary>
+	std::vector<glm::vec3> m_vertices;
+
+	/// <summary> The voxel value written for each triangle. </summary>
+	std::vector<uint8_t> m_values;
+
+	/// <summary> The bounds of the mesh. </summary>
+	glm::vec3 m_min = glm::vec3(0.0f);
+	glm::vec3 m_max = glm::vec3(0.0f);
+
+public:
+
+	/// <summary>
+	/// Creates a voxelizer for a triangle soup.
+	/// </summary>
+	/// <param name="vertices"> The triangle vertices, three per triangle. </param>
+	/// <param name="values"> The voxel value of each triangle. Must be non-zero. </param>
+	static std::shared_ptr<Voxelizer> Create(const std::vector<glm::vec3>& vertices, const std::vector<uint8_t>& values);
+
+	/// <summary>
+	/// Loads an OBJ file through tiny_obj_loader. Each triangle's voxel value is derived from its material.
+	/// </summary>
+	static std::shared_ptr<Voxelizer> CreateFromOBJ(const std::string& path);
+
+	/// <summary>
+	/// Voxelizes the mesh into an octree. The mesh is scaled uniformly so its longest side spans the resolution.
+	/// </summary>
+	/// <param name="resolution"> The width of the octree, in voxels. Must be brick_size times a power of two. </param>
+	/// <param name="brick_size"> The width of the octree's bricks. </param>
+	/// <param name="thread_count"> The number of worker threads. 0 uses every hardware thread. </param>
+	/// <param name="stats"> Receives timings and counts, if not null. </param>
+	std::shared_ptr<Octree> Voxelize(uint32_t resolution, uint32_t brick_size, uint32_t thread_count, VoxelizerStats* stats = nullptr) const;
+
+	/// <summary>
+	/// Gets the transform from mesh space to voxel space at the given resolution: voxel = (position - offset) * scale.
+	/// The longest side of the mesh spans just under the resolution.
+	/// </summary>
+	void GetVoxelTransform(uint32_t resolution, glm::vec3& offset, float& scale) const;
+
+	/// <summary>
+	/// Voxelizes an OBJ file once per thread count (1, 2, 4, ... up to every hardware thread)
+	/// and prints triangles per second and bricks per second for each to stdout.
+	/// </summary>
+	static void RunBenchmark(const std::string& path, uint32_t resolution, uint32_t brick_size);
+
+	/// <summary> Gets the number of triangles. </summary>
+	uint64_t GetTriangleCount() const { return m_values.size(); }
+};
@@ -0,0 +1,286 @@
+#include "WavefrontTracer.h"
+
+namespace {
+	/// <summary> A ray as laid out in wavefront.glsl. </summary>
+	struct WavefrontRay {
+		float origin[3];
+		uint32_t pixel_kind;
+		float direction[3];
+		float t_max;
+	};
+
+	/// <summary> A hit as laid out in wavefront.glsl. </summary>
+	struct WavefrontHit {
+		uint32_t voxel;
+		float t;
+		uint32_t face_steps;
+		uint32_t lod;
+	};
+
+	/// <summary> A pixel record as laid out in wavefront.glsl. </summary>
+	struct WavefrontPixel {
+		uint32_t base_rg;
+		uint32_t base_b_ndotl;
+		uint32_t albedo_rg;
+		uint32_t albedo_b_distance;
+		uint32_t visibility;
+	};
+}
+
+std::shared_ptr<WavefrontTracer> WavefrontTracer::Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<BrickPool> brick_pool, std::shared_ptr<Octree> octree, uint32_t step_budget, const std::vector<std::shared_ptr<VWrap::Buffer>>& stats_buffers, std::shared_ptr<VWrap::Image> traced_image, std::shared_ptr<VWrap::ImageView> traced_image_view, std::shared_ptr<VWrap::Buffer> node_buffer, std::shared_ptr<VWrap::Buffer> lod_buffer, VkExtent2D extent) {
+	auto ret = std::make_shared<WavefrontTracer>();
+	ret->m_device = device;
+	ret->m_allocator = allocator;
+	ret->m_brick_pool = brick_pool;
+	ret->m_octree = octree;
+	ret->m_step_budget = step_budget;
+	ret->m_stats_buffers = stats_buffers;
+	ret->m_traced_image = traced_image;
+	ret->m_traced_image_view = traced_image_view;
+	ret->m_extent = extent;
+
+	ret->CreateBuffers();
+	ret->CreateDescriptors();
+	ret->CreatePipelines();
+	ret->WriteDescriptors(node_buffer, lod_buffer);
+
+	return ret;
+}
+
+void WavefrontTracer::CreateBuffers()
+{
+	VkDeviceSize pixels = (VkDeviceSize)m_extent.width * m_extent.height;
+
+	m_queue_buffer = VWrap::Buffer::Create(m_allocator,
+		2 * sizeof(Queue),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+
+	// Every pixel casts at most one primary ray, and every primary hit at most a shadow ray and an occlusion ray
+	m_ray_buffer = VWrap::Buffer::Create(m_allocator,
+		3 * pixels * sizeof(WavefrontRay),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+
+	m_hit_buffer = VWrap::Buffer::Create(m_allocator,
+		2 * pixels * sizeof(WavefrontHit),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+
+	m_pixel_buffer = VWrap::Buffer::Create(m_allocator,
+		pixels * sizeof(WavefrontPixel),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0);
+}
+
+VkDeviceSize WavefrontTracer::GetQueueBytes() const
+{
+	VkDeviceSize pixels = (VkDeviceSize)m_extent.width * m_extent.height;
+	return 2 * sizeof(Queue) + pixels * (3 * sizeof(WavefrontRay) + 2 * sizeof(WavefrontHit) + sizeof(WavefrontPixel));
+}
+
+void WavefrontTracer::CreateDescriptors()
+{
+	// The tracer's bindings 0-6 and its traced image, then the queues, rays, hits and pixel records
+	std::vector<VkDescriptorSetLayoutBinding> bindings(12);
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = i == 7 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	m_descriptor_set_layout = VWrap::DescriptorSetLayout::Create(m_device, bindings);
+
+	uint32_t max_sets = static_cast<uint32_t>(m_stats_buffers.size());
+	std::vector<VkDescriptorPoolSize> poolSizes(2);
+	poolSizes[0].descriptorCount = max_sets * static_cast<uint32_t>(bindings.size() - 1);
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = max_sets;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+	m_descriptor_pool = VWrap::DescriptorPool::Create(m_device, poolSizes, max_sets, 0);
+
+	std::vector<std::shared_ptr<VWrap::DescriptorSetLayout>> layouts(max_sets, m_descriptor_set_layout);
+	m_descriptor_sets = VWrap::DescriptorSet::CreateMany(m_descriptor_pool, layouts);
+}
+
+void WavefrontTracer::WriteDescriptors(std::shared_ptr<VWrap::Buffer> node_buffer, std::shared_ptr<VWrap::Buffer> lod_buffer)
+{
+	for (size_t i = 0; i < m_descriptor_sets.size(); i++) {
+
+		// Laid out as in tracer.glsl and wavefront.glsl; binding 7 is the image
+		std::array<VkDescriptorBufferInfo, 12> buffer_infos{};
+		buffer_infos[0].buffer = m_brick_pool->GetOccupancyBuffer()->Get();
+		buffer_infos[1].buffer = node_buffer->Get();
+		buffer_infos[2].buffer = m_stats_buffers[i]->Get();
+		buffer_infos[3].buffer = m_brick_pool->GetPageTableBuffer()->Get();
+		buffer_infos[4].buffer = m_brick_pool->GetFeedbackBuffer(static_cast<uint32_t>(i))->Get();
+		buffer_infos[5].buffer = m_brick_pool->GetMaterialBuffer()->Get();
+		buffer_infos[6].buffer = lod_buffer->Get();
+		buffer_infos[8].buffer = m_queue_buffer->Get();
+		buffer_infos[9].buffer = m_ray_buffer->Get();
+		buffer_infos[10].buffer = m_hit_buffer->Get();
+		buffer_infos[11].buffer = m_pixel_buffer->Get();
+
+		VkDescriptorImageInfo traced_image_info{};
+		traced_image_info.imageView = m_traced_image_view->Get();
+		traced_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		std::array<VkWriteDescriptorSet, 12> descriptorWrites{};
+		for (uint32_t j = 0; j < descriptorWrites.size(); j++) {
+			buffer_infos[j].offset = 0;
+			buffer_infos[j].range = VK_WHOLE_SIZE;
+
+			descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[j].descriptorCount = 1;
+			descriptorWrites[j].dstBinding = j;
+			descriptorWrites[j].dstSet = m_descriptor_sets[i]->Get();
+			descriptorWrites[j].dstArrayElement = 0;
+			if (j == 7) {
+				descriptorWrites[j].pImageInfo = &traced_image_info;
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			}
+			else {
+				descriptorWrites[j].pBufferInfo = &buffer_infos[j];
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			}
+		}
+
+		vkUpdateDescriptorSets(m_device->Get(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void WavefrontTracer::CreatePipelines()
+{
+	auto generate_shader_code = VWrap::readFile("../shaders/comp_wavefront_generate.spv");
+	auto trace_shader_code = VWrap::readFile("../shaders/comp_wavefront_trace.spv");
+	auto shade_shader_code = VWrap::readFile("../shaders/comp_wavefront_shade.spv");
+	auto resolve_shader_code = VWrap::readFile("../shaders/comp_wavefront_resolve.spv");
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(VWrap::PushConstantBlock);
+	std::vector<VkPushConstantRange> push_constant_ranges = { pushConstantRange };
+
+	// Must match the constant_ids in tracer.glsl and wavefront.glsl
+	struct SpecializationConstants {
+		int32_t brick_size;
+		int32_t max_depth;
+		int32_t step_budget;
+		VkBool32 use_materials;
+		int32_t brick_levels;
+		int32_t brick_words;
+		int32_t bounce;
+	} specialization_constants;
+	specialization_constants.brick_size = static_cast<int32_t>(m_octree->GetBrickSize());
+	specialization_constants.max_depth = static_cast<int32_t>(std::max(m_octree->GetDepth(), 1u));
+	specialization_constants.step_budget = static_cast<int32_t>(m_step_budget);
+	specialization_constants.use_materials = m_brick_pool->UsesMaterials() ? VK_TRUE : VK_FALSE;
+	specialization_constants.brick_levels = static_cast<int32_t>(m_brick_pool->GetLevelCount());
+	specialization_constants.brick_words = static_cast<int32_t>(m_brick_pool->GetSlotWords());
+	specialization_constants.bounce = 0;
+
+	std::array<VkSpecializationMapEntry, 7> specialization_entries{};
+	specialization_entries[0] = { 0, offsetof(SpecializationConstants, brick_size), sizeof(int32_t) };
+	specialization_entries[1] = { 1, offsetof(SpecializationConstants, max_depth), sizeof(int32_t) };
+	specialization_entries[2] = { 2, offsetof(SpecializationConstants, step_budget), sizeof(int32_t) };
+	specialization_entries[3] = { 3, offsetof(SpecializationConstants, use_materials), sizeof(VkBool32) };
+	specialization_entries[4] = { 4, offsetof(SpecializationConstants, brick_levels), sizeof(int32_t) };
+	specialization_entries[5] = { 5, offsetof(SpecializationConstants, brick_words), sizeof(int32_t) };
+	specialization_entries[6] = { 6, offsetof(SpecializationConstants, bounce), sizeof(int32_t) };
+
+	VkSpecializationInfo specialization_info{};
+	specialization_info.mapEntryCount = static_cast<uint32_t>(specialization_entries.size());
+	specialization_info.pMapEntries = specialization_entries.data();
+	specialization_info.dataSize = sizeof(SpecializationConstants);
+	specialization_info.pData = &specialization_constants;
+
+	m_generate_pipeline = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, push_constant_ranges, generate_shader_code, &specialization_info);
+	m_resolve_pipeline = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, push_constant_ranges, resolve_shader_code, &specialization_info);
+
+	for (int32_t bounce = 0; bounce < 2; bounce++) {
+		specialization_constants.bounce = bounce;
+		m_trace_pipelines[bounce] = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, push_constant_ranges, trace_shader_code, &specialization_info);
+		m_shade_pipelines[bounce] = VWrap::Pipeline::CreateCompute(m_device, m_descriptor_set_layout, push_constant_ranges, shade_shader_code, &specialization_info);
+	}
+}
+
+void WavefrontTracer::CmdBindStage(VkCommandBuffer command_buffer, std::shared_ptr<VWrap::Pipeline> pipeline, uint32_t frame, const VWrap::PushConstantBlock& push_constants)
+{
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->Get());
+
+	std::array<VkDescriptorSet, 1> descriptorSets = { m_descriptor_sets[frame]->Get() };
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
+
+	vkCmdPushConstants(command_buffer, pipeline->GetLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VWrap::PushConstantBlock), &push_constants);
+}
+
+void WavefrontTracer::CmdStageBarrier(VkCommandBuffer command_buffer)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void WavefrontTracer::CmdTrace(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, const VWrap::PushConstantBlock& push_constants, std::shared_ptr<GPUProfiler> profiler)
+{
+	auto vk_command_buffer = command_buffer->Get();
+
+	// Everything since the frame began, mostly brick uploads, so the stages below are timed on their own
+	profiler->CmdMarkStage(command_buffer, frame, "Uploads");
+
+	// The queues and image are shared by every frame in flight. The previous frame's stages and composite must be done with them.
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Both queues start empty, with indirect dispatches of no workgroups
+	std::array<Queue, 2> empty_queues = { Queue{ 0, 0, 1, 1 }, Queue{ 0, 0, 1, 1 } };
+	vkCmdUpdateBuffer(vk_command_buffer, m_queue_buffer->Get(), 0, sizeof(empty_queues), empty_queues.data());
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Only the render size is traced, from the top left of the image
+	uint32_t tiles_x = (static_cast<uint32_t>(push_constants.renderSize.x) + TILE_SIZE - 1) / TILE_SIZE;
+	uint32_t tiles_y = (static_cast<uint32_t>(push_constants.renderSize.y) + TILE_SIZE - 1) / TILE_SIZE;
+
+	CmdBindStage(vk_command_buffer, m_generate_pipeline, frame, push_constants);
+	vkCmdDispatch(vk_command_buffer, tiles_x, tiles_y, 1);
+	profiler->CmdMarkStage(command_buffer, frame, "Generate");
+	CmdStageBarrier(vk_command_buffer);
+
+	static const char* trace_names[2] = { "Trace (primary)", "Trace (secondary)" };
+	static const char* shade_names[2] = { "Shade (primary)", "Shade (secondary)" };
+	for (uint32_t bounce = 0; bounce < 2; bounce++) {
+		VkDeviceSize dispatch_offset = bounce * sizeof(Queue) + offsetof(Queue, groups_x);
+
+		CmdBindStage(vk_command_buffer, m_trace_pipelines[bounce], frame, push_constants);
+		vkCmdDispatchIndirect(vk_command_buffer, m_queue_buffer->Get(), dispatch_offset);
+		profiler->CmdMarkStage(command_buffer, frame, trace_names[bounce]);
+		CmdStageBarrier(vk_command_buffer);
+
+		CmdBindStage(vk_command_buffer, m_shade_pipelines[bounce], frame, push_constants);
+		vkCmdDispatchIndirect(vk_command_buffer, m_queue_buffer->Get(), dispatch_offset);
+		profiler->CmdMarkStage(command_buffer, frame, shade_names[bounce]);
+		CmdStageBarrier(vk_command_buffer);
+	}
+
+	CmdBindStage(vk_command_buffer, m_resolve_pipeline, frame, push_constants);
+	vkCmdDispatch(vk_command_buffer, tiles_x, tiles_y, 1);
+	profiler->CmdMarkStage(command_buffer, frame, "Resolve");
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include "vulkan/vulkan.h"
+#include "Buffer.h"
+#include "Device.h"
+#include "CommandBuffer.h"
+#include "DescriptorSet.h"
+#include "DescriptorSetLayout.h"
+#include "DescriptorPool.h"
+#include "Pipeline.h"
+#include "Allocator.h"
+#include "Image.h"
+#include "ImageView.h"
+#include "Utils.h"
+
+#include "Octree.h"
+#include "BrickPool.h"
+#include "GPUProfiler.h"
+
+#include <memory>
+#include <vector>
+#include <array>
+
+/// <summary>
+/// Traces the octree in separate compute stages that hand work to each other through queues in storage buffers, rather than
+/// one thread following each pixel from start to finish. Generate writes a primary ray for every pixel that enters the octree;
+/// trace runs a queue of rays through the octree; shade turns primary hits into pixel records and appends a shadow ray and an
+/// ambient occlusion ray for every lit surface; a second trace and shade mark which of those got through; and resolve lights the
+/// records into the traced image. Every append reserves its slots per workgroup, so each queue stays compact and the next stage
+/// is dispatched indirectly over exactly the rays that exist, instead of idling on pixels that missed or need no secondary rays.
+/// The queues scale with the screen: 148 bytes per pixel.
+/// </summary>
+class WavefrontTracer
+{
+private:
+
+	// DEVICE RESOURCES
+	std::shared_ptr<VWrap::Device> m_device;
+	std::shared_ptr<VWrap::Allocator> m_allocator;
+
+	// DESCRIPTORS
+	std::shared_ptr<VWrap::DescriptorSetLayout> m_descriptor_set_layout;
+	std::shared_ptr<VWrap::DescriptorPool> m_descriptor_pool;
+	std::vector<std::shared_ptr<VWrap::DescriptorSet>> m_descriptor_sets;
+
+	// PIPELINES
+	/// <summary> Writes the primary rays and finishes the pixels that miss the octree. </summary>
+	std::shared_ptr<VWrap::Pipeline> m_generate_pipeline;
+
+	/// <summary> Trace and shade the primary queue at index 0 and the secondary queue at index 1. </summary>
+	std::array<std::shared_ptr<VWrap::Pipeline>, 2> m_trace_pipelines;
+	std::array<std::shared_ptr<VWrap::Pipeline>, 2> m_shade_pipelines;
+
+	/// <summary> Lights the pixel records into the traced image. </summary>
+	std::shared_ptr<VWrap::Pipeline> m_resolve_pipeline;
+
+	// TRACER RESOURCES
+	/// <summary> The brick pool whose slots are traced. </summary>
+	std::shared_ptr<BrickPool> m_brick_pool;
+
+	/// <summary> The octree being traced. Its brick size and depth are specialization constants. </summary>
+	std::shared_ptr<Octree> m_octree;
+
+	/// <summary> The maximum number of traversal steps a single ray may take. </summary>
+	uint32_t m_step_budget = 1000;
+
+	/// <summary> The tracer's traversal counters, one per frame in flight. </summary>
+	std::vector<std::shared_ptr<VWrap::Buffer>> m_stats_buffers;
+
+	/// <summary> The image resolve writes, composited by the tracer. Kept in the general layout. </summary>
+	std::shared_ptr<VWrap::Image> m_traced_image;
+	std::shared_ptr<VWrap::ImageView> m_traced_image_view;
+
+	VkExtent2D m_extent{};
+
+	// QUEUES
+	/// <summary> The length and indirect dispatch of each ray queue. Must match Queue in wavefront.glsl. </summary>
+	struct Queue {
+		uint32_t count;
+		uint32_t groups_x;
+		uint32_t groups_y;
+		uint32_t groups_z;
+	};
+
+	/// <summary> Both queues' Queue, reset every frame. </summary>
+	std::shared_ptr<VWrap::Buffer> m_queue_buffer;
+
+	/// <summary> The primary queue's rays, one slot per pixel, followed by the secondary queue's, two per pixel. </summary>
+	std::shared_ptr<VWrap::Buffer> m_ray_buffer;
+
+	/// <summary> Where each ray of the queue being traced ended, at the ray's index. Sized for the larger, secondary queue. </summary>
+	std::shared_ptr<VWrap::Buffer> m_hit_buffer;
+
+	/// <summary> One record per pixel of what resolve needs to light it. </summary>
+	std::shared_ptr<VWrap::Buffer> m_pixel_buffer;
+
+	void CreateDescriptors();
+
+	/// <summary>
+	/// Creates every stage's pipeline. The trace and shade stages are built once per queue, which is a specialization constant.
+	/// </summary>
+	void CreatePipelines();
+
+	/// <summary>
+	/// Creates the queues at the current extent.
+	/// </summary>
+	void CreateBuffers();
+
+	/// <summary>
+	/// Binds a stage's pipeline, the frame's descriptor set and the push constants.
+	/// </summary>
+	void CmdBindStage(VkCommandBuffer command_buffer, std::shared_ptr<VWrap::Pipeline> pipeline, uint32_t frame, const VWrap::PushConstantBlock& push_constants);
+
+	/// <summary>
+	/// Makes a stage's writes visible to the next stage, and its queue lengths to the next indirect dispatch.
+	/// </summary>
+	void CmdStageBarrier(VkCommandBuffer command_buffer);
+
+public:
+
+	/// <summary> The number of invocations per workgroup. Must match local_size_x in wavefront.glsl. </summary>
+	static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+	/// <summary> The width and height of the tiles generate and resolve walk per workgroup. </summary>
+	static constexpr uint32_t TILE_SIZE = 8;
+
+	/// <summary>
+	/// Creates the wavefront stages and their queues for the given extent, and points them at the tracer's buffers.
+	/// </summary>
+	/// <param name="stats_buffers"> The traversal counters, one per frame in flight. Primary rays are counted as in the other paths. </param>
+	/// <param name="traced_image"> The storage image resolve writes, in the general layout, the size of extent. </param>
+	static std::shared_ptr<WavefrontTracer> Create(std::shared_ptr<VWrap::Device> device, std::shared_ptr<VWrap::Allocator> allocator, std::shared_ptr<BrickPool> brick_pool, std::shared_ptr<Octree> octree, uint32_t step_budget, const std::vector<std::shared_ptr<VWrap::Buffer>>& stats_buffers, std::shared_ptr<VWrap::Image> traced_image, std::shared_ptr<VWrap::ImageView> traced_image_view, std::shared_ptr<VWrap::Buffer> node_buffer, std::shared_ptr<VWrap::Buffer> lod_buffer, VkExtent2D extent);
+
+	/// <summary>
+	/// Updates the descriptor sets with the octree's node and level-of-detail buffers, the brick pool and the queues.
+	/// </summary>
+	void WriteDescriptors(std::shared_ptr<VWrap::Buffer> node_buffer, std::shared_ptr<VWrap::Buffer> lod_buffer);
+
+	/// <summary>
+	/// Records every stage, tracing the frame into the traced image. Must be recorded outside of the render pass.
+	/// Each stage's GPU time is marked on the profiler.
+	/// </summary>
+	void CmdTrace(std::shared_ptr<VWrap::CommandBuffer> command_buffer, uint32_t frame, const VWrap::PushConstantBlock& push_constants, std::shared_ptr<GPUProfiler> profiler);
+
+	/// <summary> Gets the VRAM used by the queues and pixel records, in bytes. </summary>
+	VkDeviceSize GetQueueBytes() const;
+};
@@ -1,4 +1,10 @@
 #include "Application.h"
+#include "Voxelizer.h"
+#include "OctreeFile.h"
+#include "ProceduralGenerator.h"
+#include "CPUTracer.h"
+#include "OctreeTracer.h"
+#include "StagingRing.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -8,12 +14,67 @@
 
 /// <summary>
 /// Entry point of our application. Creates the app, and runs it while catching any exceptions.
+/// Run with "--benchmark-voxelizer <obj> [resolution]" to time the voxelizer by thread count instead,
+/// with "--benchmark-octree-file [size]" to time loading an octree file against rebuilding the scene,
+/// with "--benchmark-procedural [size]" to time generating the Terrain scene,
+/// with "--render-cpu <png> [scene] [width] [height]" to render a scene on the CPU from the startup camera and save it,
+/// with "--benchmark-cpu-tracer [scene]" to time the CPU tracer by thread count, with "--test-octree" to check octree
+/// construction and the file round trip on small grids, with "--test-staging-ring" to check the staging ring's allocations
+/// without a device, or with "--test-gpu-voxelizer" to compare the GPU voxelizer with the CPU one on small meshes.
+/// Scenes are given by their TracerScene index.
 /// </summary>
 /// <returns> EXIT_FAILURE if an exception is thrown, otherwise EXIT_SUCCESS. </returns>
-int main() {
+int main(int argc, char** argv) {
     Application app;
 
     try {
+        if (argc >= 3 && std::string(argv[1]) == "--benchmark-voxelizer") {
+            uint32_t resolution = argc >= 4 ? static_cast<uint32_t>(std::stoul(argv[3])) : 1024;
+            Voxelizer::RunBenchmark(argv[2], resolution, 8);
+            return EXIT_SUCCESS;
+        }
+        if (argc >= 2 && std::string(argv[1]) == "--test-octree") {
+            Octree::RunTests();
+            return EXIT_SUCCESS;
+        }
+        if (argc >= 2 && std::string(argv[1]) == "--test-staging-ring") {
+            StagingRing::RunTests();
+            return EXIT_SUCCESS;
+        }
+        if (argc >= 2 && std::string(argv[1]) == "--test-gpu-voxelizer") {
+            app.TestGPUVoxelizer();
+            return EXIT_SUCCESS;
+        }
+        if (argc >= 2 && std::string(argv[1]) == "--benchmark-octree-file") {
+            uint32_t size = argc >= 3 ? static_cast<uint32_t>(std::stoul(argv[2])) : 1024;
+            OctreeFile::RunBenchmark(size);
+            return EXIT_SUCCESS;
+        }
+        if (argc >= 2 && std::string(argv[1]) == "--benchmark-procedural") {
+            uint32_t size = argc >= 3 ? static_cast<uint32_t>(std::stoul(argv[2])) : 4096;
+            ProceduralGenerator::RunBenchmark(size, 8);
+            return EXIT_SUCCESS;
+        }
+        if (argc >= 3 && std::string(argv[1]) == "--render-cpu") {
+            TracerScene scene = argc >= 4 ? static_cast<TracerScene>(std::stoul(argv[3])) : TracerScene::CITY;
+            uint32_t width = argc >= 5 ? static_cast<uint32_t>(std::stoul(argv[4])) : 1280;
+            uint32_t height = argc >= 6 ? static_cast<uint32_t>(std::stoul(argv[5])) : 720;
+
+            SceneStats scene_stats{};
+            auto tracer = CPUTracer::Create(OctreeTracer::BuildScene(scene, scene_stats), width, height);
+            CPUTracerStats stats{};
+            tracer->Render(Camera::Create(45, (float)width / (float)height, 0.1f, 10.0f), 0, &stats);
+            tracer->WritePNG(argv[2]);
+            printf("Rendered %ux%u with %u threads in %.2f ms, %.1f steps/ray\n", width, height, stats.thread_count, stats.render_ms, stats.GetAverageSteps());
+            return EXIT_SUCCESS;
+        }
+        if (argc >= 2 && std::string(argv[1]) == "--benchmark-cpu-tracer") {
+            TracerScene scene = argc >= 3 ? static_cast<TracerScene>(std::stoul(argv[2])) : TracerScene::CITY;
+            SceneStats scene_stats{};
+            CPUTracer::RunBenchmark(OctreeTracer::BuildScene(scene, scene_stats));
+            return EXIT_SUCCESS;
+        }
+
         app.Run();
     }
     catch (const std::exception& e) {